@@ -0,0 +1,320 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "array.h"
+#include "simd_abstraction.h"
+#include "thread_pool.h"
+
+// sweeps working sets from L1-resident to DRAM-bound and times the raw
+// dispatch kernels, the eager ops and expr_eval for every backend the host
+// can run. each case reports median and p99 over its repetitions, throughput,
+// and the fraction of a memcpy moving the same number of bytes ("roofline")
+
+typedef enum {
+    FORMAT_TABLE,
+    FORMAT_CSV,
+    FORMAT_JSON
+} bench_format_t;
+
+typedef struct {
+    const char* backend;
+    const char* op;
+    const char* shape;
+    size_t n;
+    int reps;
+    double median;
+    double p99;
+    double bytes;
+    double flops;
+    double roofline;
+} bench_result_t;
+
+typedef struct {
+    simd_dispatch_t* dispatch;
+    array_t* a;
+    array_t* b;
+    array_t* c;
+    array_t* out;
+    expr_t* expr;
+    float* src;
+    float* dst;
+    size_t n;
+} bench_case_t;
+
+typedef void (*bench_fn)(bench_case_t* bc);
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int compare_double(const void* x, const void* y) {
+    double a = *(const double*)x, b = *(const double*)y;
+    return (a > b) - (a < b);
+}
+
+static int reps_for(size_t bytes) {
+    // roughly 256MB of traffic per case, clamped so tiny sizes stay quick
+    size_t reps = (256u << 20) / (bytes ? bytes : 1);
+    if (reps < 5) reps = 5;
+    if (reps > 2000) reps = 2000;
+    return (int)reps;
+}
+
+// runs fn reps times after one warm-up call and fills median/p99
+static void bench_time(bench_fn fn, bench_case_t* bc, int reps, double* median, double* p99) {
+    double* times = malloc(reps * sizeof(double));
+    fn(bc);
+    for (int r = 0; r < reps; r++) {
+        double t0 = now_seconds();
+        fn(bc);
+        times[r] = now_seconds() - t0;
+    }
+    qsort(times, reps, sizeof(double), compare_double);
+    *median = times[reps / 2];
+    *p99 = times[(size_t)((reps - 1) * 0.99)];
+    free(times);
+}
+
+static void run_memcpy(bench_case_t* bc) {
+    memcpy(bc->dst, bc->src, bc->n * sizeof(float));
+}
+
+static void run_add_n(bench_case_t* bc) {
+    bc->dispatch->add_n(bc->out->data, bc->a->data, bc->b->data, bc->n);
+}
+
+static void run_mul_n(bench_case_t* bc) {
+    bc->dispatch->mul_n(bc->out->data, bc->a->data, bc->b->data, bc->n);
+}
+
+static void run_fmadd_n(bench_case_t* bc) {
+    bc->dispatch->fmadd_n(bc->out->data, bc->a->data, bc->b->data, bc->c->data, bc->n);
+}
+
+static void run_add_eager(bench_case_t* bc) {
+    array_add_eager(bc->out, bc->a, bc->b, bc->dispatch);
+}
+
+static void run_mul_eager(bench_case_t* bc) {
+    array_mul_eager(bc->out, bc->a, bc->b, bc->dispatch);
+}
+
+static void run_expr_eval(bench_case_t* bc) {
+    expr_eval(bc->expr, bc->out, bc->dispatch);
+}
+
+// time of a memcpy moving `bytes` in total (half read, half written)
+static double roofline_time(size_t bytes) {
+    bench_case_t bc = {0};
+    bc.n = bytes / 2 / sizeof(float);
+    if (bc.n == 0) return 0.0;
+    bc.src = malloc(bc.n * sizeof(float));
+    bc.dst = malloc(bc.n * sizeof(float));
+    memset(bc.src, 1, bc.n * sizeof(float));
+    memset(bc.dst, 0, bc.n * sizeof(float));
+
+    double median, p99;
+    bench_time(run_memcpy, &bc, reps_for(bytes), &median, &p99);
+    free(bc.src);
+    free(bc.dst);
+    return median;
+}
+
+static void print_result(const bench_result_t* r, bench_format_t format, FILE* out, int first) {
+    double gbps = r->bytes / r->median / 1e9;
+    double gflops = r->flops / r->median / 1e9;
+
+    switch (format) {
+        case FORMAT_TABLE:
+            fprintf(out, "%-8s %-12s %-10s %10zu %12.2f %12.2f %9.2f %9.2f %9.2f\n",
+                    r->backend, r->op, r->shape, r->n, r->median * 1e6, r->p99 * 1e6,
+                    gbps, gflops, r->roofline);
+            break;
+        case FORMAT_CSV:
+            fprintf(out, "%s,%s,%s,%zu,%d,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+                    r->backend, r->op, r->shape, r->n, r->reps, r->median * 1e6, r->p99 * 1e6,
+                    gbps, gflops, r->roofline);
+            break;
+        case FORMAT_JSON:
+            fprintf(out, "%s  {\"backend\": \"%s\", \"op\": \"%s\", \"shape\": \"%s\", \"n\": %zu, "
+                    "\"reps\": %d, \"median_us\": %.3f, \"p99_us\": %.3f, \"gb_per_s\": %.3f, "
+                    "\"gflop_per_s\": %.3f, \"roofline\": %.3f}",
+                    first ? "" : ",\n", r->backend, r->op, r->shape, r->n, r->reps,
+                    r->median * 1e6, r->p99 * 1e6, gbps, gflops, r->roofline);
+            break;
+    }
+}
+
+static void print_header(bench_format_t format, FILE* out) {
+    switch (format) {
+        case FORMAT_TABLE:
+            fprintf(out, "%-8s %-12s %-10s %10s %12s %12s %9s %9s %9s\n", "backend", "op", "shape", "n",
+                    "median(us)", "p99(us)", "GB/s", "GFLOP/s", "roofline");
+            break;
+        case FORMAT_CSV:
+            fprintf(out, "backend,op,shape,n,reps,median_us,p99_us,gb_per_s,gflop_per_s,roofline\n");
+            break;
+        case FORMAT_JSON:
+            fprintf(out, "[\n");
+            break;
+    }
+}
+
+static array_t* bench_array(size_t* shape, size_t ndim, float value) {
+    array_t* arr = array_create(shape, ndim);
+    array_fill(arr, value);
+    return arr;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "usage: %s [--format table|csv|json] [--output FILE] [--backend NAME] [--max-n N] [--threads N]\n", prog);
+}
+
+int main(int argc, char** argv) {
+    bench_format_t format = FORMAT_TABLE;
+    const char* output = NULL;
+    const char* only_backend = NULL;
+    size_t max_n = 8u << 20;
+    size_t threads = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "csv") == 0) format = FORMAT_CSV;
+            else if (strcmp(argv[i], "json") == 0) format = FORMAT_JSON;
+            else format = FORMAT_TABLE;
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+            only_backend = argv[++i];
+        } else if (strcmp(argv[i], "--max-n") == 0 && i + 1 < argc) {
+            max_n = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = strtoull(argv[++i], NULL, 10);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    FILE* out = output ? fopen(output, "w") : stdout;
+    if (!out) {
+        perror(output);
+        return 1;
+    }
+
+    // 16KB (L1) up to 32MB per operand (DRAM)
+    size_t sizes[] = {4u << 10, 32u << 10, 256u << 10, 2u << 20, 8u << 20};
+    const size_t cols = 256;
+    int first = 1;
+    // shared by every backend; 0 means one thread per CPU
+    thread_pool_t* pool = threads == 1 ? NULL : thread_pool_create(threads);
+
+    print_header(format, out);
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t n = sizes[s];
+        if (n > max_n) break;
+
+        size_t flat[1] = {n};
+        size_t matrix[2] = {n / cols, cols};
+        size_t row[1] = {cols};
+        size_t wide[2] = {n / cols, cols * 2};
+        size_t view_start[2] = {0, 0};
+        size_t view_end[2] = {n / cols, cols};
+
+        array_t* a = bench_array(flat, 1, 1.5f);
+        array_t* b = bench_array(flat, 1, 2.5f);
+        array_t* c = bench_array(flat, 1, 0.5f);
+        array_t* out_flat = bench_array(flat, 1, 0.0f);
+        array_t* m = bench_array(matrix, 2, 1.0f);
+        array_t* r = bench_array(row, 1, 2.0f);
+        array_t* out_matrix = bench_array(matrix, 2, 0.0f);
+        array_t* w = bench_array(wide, 2, 3.0f);
+        array_t* wv = array_view(w, view_start, view_end);
+
+        expr_t* expr_flat = expr_mul(expr_add(expr_from_array(a), expr_from_array(b)), expr_from_array(c));
+        expr_t* expr_view = expr_mul(expr_add(expr_from_array(wv), expr_from_array(m)), expr_from_array(m));
+
+        double roof2 = roofline_time(2 * n * sizeof(float));
+        double roof3 = roofline_time(3 * n * sizeof(float));
+        double roof4 = roofline_time(4 * n * sizeof(float));
+
+        for (int be = BACKEND_SCALAR; be <= BACKEND_NEON; be++) {
+            if (only_backend && strcmp(only_backend, simd_backend_name((simd_backend_t)be)) != 0) continue;
+            simd_dispatch_t* dispatch = simd_init_dispatch_backend((simd_backend_t)be);
+            if (!dispatch) continue;
+            dispatch->pool = pool;
+
+            struct {
+                const char* op;
+                const char* shape;
+                bench_fn fn;
+                array_t* a;
+                array_t* b;
+                array_t* out;
+                expr_t* expr;
+                double bytes;
+                double flops;
+                double roof;
+            } cases[] = {
+                {"add_n", "contig", run_add_n, a, b, out_flat, NULL, 3.0 * n * 4, 1.0 * n, roof3},
+                {"mul_n", "contig", run_mul_n, a, b, out_flat, NULL, 3.0 * n * 4, 1.0 * n, roof3},
+                {"fmadd_n", "contig", run_fmadd_n, a, b, out_flat, NULL, 4.0 * n * 4, 2.0 * n, roof4},
+                {"add_eager", "contig", run_add_eager, a, b, out_flat, NULL, 3.0 * n * 4, 1.0 * n, roof3},
+                {"mul_eager", "contig", run_mul_eager, a, b, out_flat, NULL, 3.0 * n * 4, 1.0 * n, roof3},
+                {"add_eager", "bcast_row", run_add_eager, m, r, out_matrix, NULL, 2.0 * n * 4, 1.0 * n, roof2},
+                {"mul_eager", "view", run_mul_eager, wv, m, out_matrix, NULL, 3.0 * n * 4, 1.0 * n, roof3},
+                {"expr_eval", "contig", run_expr_eval, a, b, out_flat, expr_flat, 4.0 * n * 4, 2.0 * n, roof4},
+                {"expr_eval", "view", run_expr_eval, wv, m, out_matrix, expr_view, 3.0 * n * 4, 2.0 * n, roof3},
+            };
+
+            for (size_t k = 0; k < sizeof(cases) / sizeof(cases[0]); k++) {
+                bench_case_t bc = {0};
+                bc.dispatch = dispatch;
+                bc.a = cases[k].a;
+                bc.b = cases[k].b;
+                bc.c = c;
+                bc.out = cases[k].out;
+                bc.expr = cases[k].expr;
+                bc.n = n;
+
+                bench_result_t res;
+                res.backend = simd_backend_name((simd_backend_t)be);
+                res.op = cases[k].op;
+                res.shape = cases[k].shape;
+                res.n = n;
+                res.reps = reps_for((size_t)cases[k].bytes);
+                res.bytes = cases[k].bytes;
+                res.flops = cases[k].flops;
+                bench_time(cases[k].fn, &bc, res.reps, &res.median, &res.p99);
+                res.roofline = cases[k].roof > 0 ? cases[k].roof / res.median : 0.0;
+
+                print_result(&res, format, out, first);
+                first = 0;
+            }
+
+            simd_free_dispatch(dispatch);
+        }
+
+        expr_free(expr_flat);
+        expr_free(expr_view);
+        array_free(wv);
+        array_free(w);
+        array_free(a);
+        array_free(b);
+        array_free(c);
+        array_free(out_flat);
+        array_free(m);
+        array_free(r);
+        array_free(out_matrix);
+    }
+
+    thread_pool_free(pool);
+    if (format == FORMAT_JSON) fprintf(out, "\n]\n");
+    if (out != stdout) fclose(out);
+    return 0;
+}
@@ -5,24 +5,177 @@
 #include <stdbool.h>
 #include "simd_abstraction.h"
 
+// arrays with up to this many dimensions keep shape and strides inside array_t
+#define ARRAY_INLINE_DIMS 4
+// alignment of every data buffer the library allocates (one cache line)
+#define ARRAY_ALIGNMENT 64
+
+typedef struct array_pool array_pool_t;
+
+typedef enum {
+    ARRAY_STORAGE_BORROWED,  // view, or data owned by the caller
+    ARRAY_STORAGE_INLINE,    // data follows the header in the same allocation
+    ARRAY_STORAGE_POOL,      // data came from `pool` and goes back on free
+    ARRAY_STORAGE_MAPPED     // data lies in a file mapping, unmapped on free
+} array_storage_t;
+
+// element formats. float16 and bfloat16 are storage formats: expressions
+// widen them to float32 on load and round back on store, so they halve
+// memory traffic without changing the arithmetic. float64 is computed in
+// float64 whenever an expression involves it
+typedef enum {
+    ARRAY_FLOAT32,
+    ARRAY_FLOAT64,
+    ARRAY_FLOAT16,
+    ARRAY_BFLOAT16,
+    ARRAY_INT32,
+    ARRAY_INT8
+} array_dtype_t;
+
+size_t array_dtype_size(array_dtype_t dtype);
+
 typedef struct {
-    float* data;           
+    // data is only meaningful for ARRAY_FLOAT32; raw points at the same
+    // elements whatever their format
+    union {
+        float* data;
+        void* raw;
+    };
+    array_dtype_t dtype;
     size_t* shape;         
     size_t* strides;      
     size_t ndim;           
     size_t size;           
     bool owns_data;       
     void* base;           
+    array_storage_t storage;
+    size_t data_bytes;     // size of the owned buffer, 0 when borrowed
+    array_pool_t* pool;
+    // whole file mapping of a mapped array (data_bytes is its length)
+    void* mapping;
+    size_t shape_inline[ARRAY_INLINE_DIMS];
+    size_t strides_inline[ARRAY_INLINE_DIMS];
 } array_t;
 
+// data is zeroed and ARRAY_ALIGNMENT-aligned; header, shape, strides and data
+// share one allocation when ndim <= ARRAY_INLINE_DIMS
 array_t* array_create(size_t* shape, size_t ndim);
 
+// recycles aligned data buffers of matching size across array lifetimes, so a
+// loop that creates and frees same-shaped temporaries stops hitting malloc and
+// faulting in fresh pages. max_bytes caps how much idle memory it keeps.
+// a pool is thread-safe and must outlive every array created from it.
+array_pool_t* array_pool_create(size_t max_bytes);
+void array_pool_free(array_pool_t* pool);
+
+// raw buffer interface used by pooled arrays; bytes must match on release
+void* array_pool_acquire(array_pool_t* pool, size_t bytes);
+void array_pool_release(array_pool_t* pool, void* ptr, size_t bytes);
+
+// like array_create, but the data buffer comes from the pool and its contents
+// are unspecified (as with malloc); array_free hands it back
+array_t* array_create_pooled(array_pool_t* pool, size_t* shape, size_t ndim);
+
 array_t* array_from_data(float* data, size_t* shape, size_t ndim);
 
+// as array_create / array_from_data, for any element format
+array_t* array_create_typed(size_t* shape, size_t ndim, array_dtype_t dtype);
+array_t* array_from_data_typed(void* data, size_t* shape, size_t ndim, array_dtype_t dtype);
+
+// a new contiguous array holding src converted to dtype, with the same
+// rounding and saturation as the dispatch table's conversion kernels
+array_t* array_astype(array_t* src, array_dtype_t dtype, simd_dispatch_t* dispatch);
+
 array_t* array_view(array_t* arr, size_t* start, size_t* end);
 
+// zero-copy views like array_view: they share arr's elements (base == arr)
+// and only rewrite shape and strides. array_slice takes every step[i]-th
+// element of [start[i], end[i]) (step may be NULL for 1; steps are positive,
+// as strides are unsigned). array_permute moves axis axes[i] of arr to
+// position i and array_transpose reverses the axes
+array_t* array_slice(array_t* arr, size_t* start, size_t* end, size_t* step);
+array_t* array_permute(array_t* arr, size_t* axes);
+array_t* array_transpose(array_t* arr);
+
+// whether the elements lie in row-major order with no gaps
+bool array_is_contiguous(array_t* arr);
+
+// arr's elements, in row-major order, in a new shape of the same size. a
+// view of arr when its strides allow one (always for a contiguous arr),
+// otherwise a new contiguous array holding a copy
+array_t* array_reshape(array_t* arr, size_t* shape, size_t ndim, simd_dispatch_t* dispatch);
+
+// arr itself as a view when it is already contiguous, otherwise a contiguous
+// copy (array_copy_eager). either way the result is freed with array_free
+array_t* array_make_contiguous(array_t* arr, simd_dispatch_t* dispatch);
+
+// whether a and b may share memory: true when the byte ranges their elements
+// span overlap, even if interleaved views never touch the same element
+bool array_shares_memory(array_t* a, array_t* b);
+
 void array_free(array_t* arr);
 
+// on-disk format: a fixed header (magic, version, byte order, dtype, ndim,
+// data offset and size) followed by the shape and strides as 64-bit values,
+// zero padding, and the raw elements from an ARRAY_ALIGNMENT-aligned offset
+// in the array's own dtype and native byte order. the header is smaller than
+// one page for any ndim up to ARRAY_MAP_MAX_DIMS
+#define ARRAY_MAP_MAX_DIMS 64
+
+typedef enum {
+    // read-only, shared with every process that maps the file
+    ARRAY_MAP_READ = 0,
+    // writable; stores go to the page cache and reach the file
+    ARRAY_MAP_WRITE = 1 << 0,
+    // writable, but copy-on-write: stores stay private to this mapping
+    ARRAY_MAP_PRIVATE = 1 << 1,
+    // fault every page in up front instead of on first touch
+    ARRAY_MAP_POPULATE = 1 << 2,
+    // madvise hints for the expected access pattern
+    ARRAY_MAP_SEQUENTIAL = 1 << 3,
+    ARRAY_MAP_RANDOM = 1 << 4,
+    ARRAY_MAP_WILLNEED = 1 << 5
+} array_map_flags_t;
+
+// writes arr (any view or broadcast array; elements are stored contiguously
+// in row-major order) to path. returns false and leaves errno set on failure
+bool array_save(array_t* arr, const char* path);
+
+// opens a file written by array_save as an array whose data points straight
+// into a mapping of the file, so nothing is read or copied until it is
+// touched and processes that map the same file share its pages through the
+// page cache. flags are array_map_flags_t values or'ed together. returns
+// NULL with errno set when the file cannot be mapped or is not a valid array
+// file (EINVAL). array_free unmaps it
+array_t* array_mmap(const char* path, unsigned flags);
+
+// sources and sinks stream a flat array that need not fit in memory, a
+// block at a time (see expr_eval_stream)
+typedef struct array_source array_source_t;
+typedef struct array_sink array_sink_t;
+
+// move elements [offset, offset + count) into dst or out of src and return
+// how many were moved; anything short of count is treated as a failure.
+// they are called from a background thread, one call at a time
+typedef size_t (*array_read_fn)(void* ctx, void* dst, size_t offset, size_t count);
+typedef size_t (*array_write_fn)(void* ctx, const void* src, size_t offset, size_t count);
+
+array_source_t* array_source_callback(array_dtype_t dtype, size_t size, array_read_fn read, void* ctx);
+// reads a contiguous file written by array_save or array_sink_create with
+// pread; NULL with errno set when it cannot
+array_source_t* array_source_open(const char* path);
+size_t array_source_size(const array_source_t* source);
+array_dtype_t array_source_dtype(const array_source_t* source);
+void array_source_free(array_source_t* source);
+
+array_sink_t* array_sink_callback(array_dtype_t dtype, array_write_fn write, void* ctx);
+// writes an array file of the given shape that array_mmap and
+// array_source_open can read back once it has been filled
+array_sink_t* array_sink_create(const char* path, array_dtype_t dtype, size_t* shape, size_t ndim);
+// false if the file could not be written completely
+bool array_sink_close(array_sink_t* sink);
+
+// element access converts from and to the array's format
 float array_get(array_t* arr, size_t* indices);
 
 void array_set(array_t* arr, size_t* indices, float value);
@@ -33,18 +186,138 @@ bool array_broadcastable(array_t* a, array_t* b);
 
 size_t* array_broadcast_shape(array_t* a, array_t* b, size_t* out_ndim);
 
+bool array_broadcast_strides(array_t* arr, size_t* target_shape, size_t target_ndim, size_t* out_strides);
+
 void array_broadcast_prepare(array_t* arr, size_t* target_shape, size_t target_ndim);
 
+// operands in other formats than float32 go through the expression
+// evaluator, which converts them on the fly. result may be a or b; a result
+// that overlaps them in any other way also goes through the evaluator
 void array_add_eager(array_t* result, array_t* a, array_t* b, simd_dispatch_t* dispatch);
 void array_mul_eager(array_t* result, array_t* a, array_t* b, simd_dispatch_t* dispatch);
 
+// in-place updates that reuse x's (or y's) storage instead of a result
+// array: x += y, x *= y, y += alpha * x and x *= alpha, with the second
+// operand broadcast to the first's shape. array_axpy runs the axpy_n kernel
+// over contiguous runs
+void array_add_inplace(array_t* x, array_t* y, simd_dispatch_t* dispatch);
+void array_mul_inplace(array_t* x, array_t* y, simd_dispatch_t* dispatch);
+void array_axpy(array_t* y, float alpha, array_t* x, simd_dispatch_t* dispatch);
+void array_scale_inplace(array_t* x, float alpha, simd_dispatch_t* dispatch);
+
+// a batch of same-sized small arrays, e.g. thousands of 16-256 element
+// vectors, that are operated on in one call instead of one array_t each.
+// item k starts at items[k] or, when items is NULL, at element k * stride
+// of data (stride n for a contiguous batch). every item is a flat run of
+// elements of dtype
+typedef struct {
+    array_dtype_t dtype;
+    void* const* items;
+    void* data;
+    size_t stride;
+} array_batch_t;
+
+void* array_batch_item(const array_batch_t* batch, size_t k);
+
+// result[k] = a[k] + b[k] (or *) for count items of n elements, split across
+// dispatch->pool by items once the batch is large. nothing is allocated,
+// checked or set up per item: float32 batches make one add_n / mul_n call
+// per item, other formats one expr_eval_batch pass. a result item may be
+// an operand item, but must not overlap one in any other way
+void array_add_batch(const array_batch_t* result, const array_batch_t* a, const array_batch_t* b,
+                     size_t count, size_t n, simd_dispatch_t* dispatch);
+void array_mul_batch(const array_batch_t* result, const array_batch_t* a, const array_batch_t* b,
+                     size_t count, size_t n, simd_dispatch_t* dispatch);
+
+// element-wise math with the dispatch table's SIMD kernels (see
+// simd_dispatch_t for their accuracy). float64 operands are computed with
+// libm, every other format as float32
+typedef enum {
+    ARRAY_UNARY_EXP,
+    ARRAY_UNARY_LOG,
+    ARRAY_UNARY_SIGMOID,
+    ARRAY_UNARY_TANH,
+    ARRAY_UNARY_SQRT,
+    ARRAY_UNARY_RSQRT
+} array_unary_op_t;
+
+// result and arr have the same shape and may be the same array
+void array_unary_eager(array_t* result, array_t* arr, array_unary_op_t op, simd_dispatch_t* dispatch);
+void array_exp_eager(array_t* result, array_t* arr, simd_dispatch_t* dispatch);
+void array_log_eager(array_t* result, array_t* arr, simd_dispatch_t* dispatch);
+void array_sigmoid_eager(array_t* result, array_t* arr, simd_dispatch_t* dispatch);
+void array_tanh_eager(array_t* result, array_t* arr, simd_dispatch_t* dispatch);
+void array_sqrt_eager(array_t* result, array_t* arr, simd_dispatch_t* dispatch);
+void array_rsqrt_eager(array_t* result, array_t* arr, simd_dispatch_t* dispatch);
+
+// result = a @ b for a (m x k), b (k x n) and result (m x n). operands may be
+// any views, including ones with swapped strides (a transpose), and are read
+// in place: blocks of a and b are packed into the micro-kernel's layout as
+// they are needed. the row blocks are split across dispatch->pool. float64
+// operands are computed in float64, other formats are converted to float32
+// first. result must not overlap a or b
+void array_matmul(array_t* result, array_t* a, array_t* b, simd_dispatch_t* dispatch);
+
+// one matmul per index of the leading dimensions: a (..., m, k) and
+// b (..., k, n) give result (..., m, n), with the leading dimensions
+// broadcast against each other as in the element-wise operations
+void array_matmul_batched(array_t* result, array_t* a, array_t* b, simd_dispatch_t* dispatch);
+
+// full reductions over any array or view (strides are honoured). large arrays
+// are split across dispatch->pool; the result is the same for any thread count.
+// array_sum adds fixed-size blocks with the SIMD kernels and combines the
+// block sums pairwise; ARRAY_SUM_KAHAN compensates every addition instead,
+// which is slower but keeps the error independent of the array size.
+// arrays in other formats are summed pairwise in their compute type
+typedef enum {
+    ARRAY_SUM_PAIRWISE,
+    ARRAY_SUM_KAHAN
+} array_sum_mode_t;
+
+float array_sum(array_t* arr, simd_dispatch_t* dispatch);
+float array_sum_mode(array_t* arr, array_sum_mode_t mode, simd_dispatch_t* dispatch);
+float array_mean(array_t* arr, simd_dispatch_t* dispatch);
+// -inf / +inf for an empty array
+float array_max(array_t* arr, simd_dispatch_t* dispatch);
+float array_min(array_t* arr, simd_dispatch_t* dispatch);
+// b is broadcast to a's shape
+float array_dot(array_t* a, array_t* b, simd_dispatch_t* dispatch);
+float array_norm2(array_t* arr, simd_dispatch_t* dispatch);
+
+typedef enum {
+    ARRAY_REDUCE_SUM,
+    ARRAY_REDUCE_MEAN,
+    ARRAY_REDUCE_MAX,
+    ARRAY_REDUCE_MIN
+} array_reduce_op_t;
+
+// reduces arr along one axis into result, whose shape is arr's with that axis
+// either removed or kept with extent 1
+void array_reduce_axis(array_t* result, array_t* arr, size_t axis, array_reduce_op_t op,
+                       simd_dispatch_t* dispatch);
+
+// reduces every axis on which result has extent 1 and arr does not, so several
+// axes can be reduced in one pass; result has the same ndim as arr
+void array_reduce_to(array_t* result, array_t* arr, array_reduce_op_t op, simd_dispatch_t* dispatch);
+
+void array_sum_axis(array_t* result, array_t* arr, size_t axis, simd_dispatch_t* dispatch);
+void array_mean_axis(array_t* result, array_t* arr, size_t axis, simd_dispatch_t* dispatch);
+void array_max_axis(array_t* result, array_t* arr, size_t axis, simd_dispatch_t* dispatch);
+void array_min_axis(array_t* result, array_t* arr, size_t axis, simd_dispatch_t* dispatch);
+
 typedef enum {
     EXPR_ARRAY,      
     EXPR_ADD,      
     EXPR_MUL,     
-    EXPR_SCALAR_MUL 
+    EXPR_SCALAR_MUL,
+    EXPR_SUB,
+    EXPR_UNARY,
+    EXPR_REDUCE
 } expr_type_t;
 
+// axis value of a reduction over every axis
+#define EXPR_ALL_AXES ((size_t)-1)
+
 typedef struct expr_t expr_t;
 
 struct expr_t {
@@ -64,25 +337,146 @@ struct expr_t {
             float scalar;
             expr_t* operand;
         } scalar_op;
+
+        struct {
+            expr_t* operand;
+            array_unary_op_t op;
+        } unary;
+        
+        struct {
+            expr_t* operand;
+            array_reduce_op_t op;
+            size_t axis;
+        } reduce;
     } data;
     
     size_t* shape;      
     size_t ndim;       
+    size_t shape_inline[ARRAY_INLINE_DIMS];
 };
 
 expr_t* expr_from_array(array_t* arr);
 
+// operands broadcast as in the eager operations and the node takes the
+// broadcast shape. broadcast leaves are read with stride 0 during evaluation,
+// so they are never expanded in memory and the caller's arrays keep their
+// own shape
 expr_t* expr_add(expr_t* left, expr_t* right);
 expr_t* expr_mul(expr_t* left, expr_t* right);
 
+expr_t* expr_sub(expr_t* left, expr_t* right);
+
 expr_t* expr_scalar_mul(float scalar, expr_t* operand);
 
+// element-wise math nodes; they fuse with the rest of the tree like any
+// other operation, one SIMD kernel call per block
+expr_t* expr_unary(expr_t* operand, array_unary_op_t op);
+expr_t* expr_exp(expr_t* operand);
+expr_t* expr_log(expr_t* operand);
+expr_t* expr_sigmoid(expr_t* operand);
+expr_t* expr_tanh(expr_t* operand);
+expr_t* expr_sqrt(expr_t* operand);
+expr_t* expr_rsqrt(expr_t* operand);
+
+// reductions keep the operand's ndim: the reduced axis (or every axis, for
+// EXPR_ALL_AXES) has extent 1 in the node's shape. expr_eval streams the
+// element-wise operand straight into the accumulators, so no temporary of the
+// operand's size is ever allocated. a reduction below the root is evaluated
+// first into a temporary of its reduced shape, which then broadcasts against
+// the rest of the tree, e.g. expr_sub(x, expr_sum_axis(x, 1)).
+// the result passed to expr_eval may also drop the reduced axis, and a full
+// reduction accepts any result of size 1
+expr_t* expr_reduce(expr_t* operand, array_reduce_op_t op);
+expr_t* expr_reduce_axis(expr_t* operand, size_t axis, array_reduce_op_t op);
+expr_t* expr_sum(expr_t* operand);
+expr_t* expr_sum_axis(expr_t* operand, size_t axis);
+
+// distinct leaf arrays one compiled program can read
+#define EXPR_MAX_LEAVES 31
+
+// leaves and result may have any mix of dtypes. each leaf is converted to
+// the compute type block by block as it is loaded and the value is rounded
+// into the result's format as it is stored; reductions accumulate in the
+// compute type and convert once at the end.
+// the result may be one of the leaves (x = x * a + b) and is then updated in
+// place in one pass. a result that overlaps a leaf in any other way, e.g. a
+// shifted view, a transpose or a row broadcast over its own array, is
+// evaluated into a temporary and copied over.
+// a tree reading more than EXPR_MAX_LEAVES distinct arrays is evaluated in
+// parts: the largest subtrees that fit are evaluated into temporaries first
 void expr_eval(expr_t* expr, array_t* result, simd_dispatch_t* dispatch);
 
+// evaluates a full reduction and returns its value
+float expr_eval_scalar(expr_t* expr, simd_dispatch_t* dispatch);
+
+// an expression compiled once and evaluated many times. a kernel captures
+// the tree's structure and scalars but not its arrays: its parameters are the
+// tree's distinct leaf arrays in the order they first appear, left to right,
+// and any arrays of the right shapes can be bound on each call. kernels come
+// from the same LRU cache expr_eval uses, keyed by that structure, so
+// expr_eval on a tree that was seen before also skips compilation.
+// strides are bound at evaluation time, so views and broadcast leaves share
+// one kernel with contiguous ones. a kernel reads at most EXPR_MAX_LEAVES
+// distinct arrays and reduces only at its root: expr_compile returns NULL for
+// any other tree
+typedef struct expr_kernel expr_kernel_t;
+
+expr_kernel_t* expr_compile(expr_t* expr);
+size_t expr_kernel_nleaves(const expr_kernel_t* kernel);
+void expr_kernel_eval(expr_kernel_t* kernel, array_t** leaves, array_t* result,
+                      simd_dispatch_t* dispatch);
+float expr_kernel_eval_scalar(expr_kernel_t* kernel, array_t** leaves, simd_dispatch_t* dispatch);
+
+// evaluates an element-wise expression once per item of a batch (see
+// array_batch_t): leaves[i] takes the place of the tree's i-th distinct
+// leaf, in the order expr_compile uses, and gives its format; the leaf
+// arrays only identify the parameters. items are flat runs of n elements
+// with no broadcasting. the kernel is looked up once and each item is one
+// run of its program, so a batch costs no per-item allocation or iterator
+// setup. a result item may be a leaf item but must not overlap one otherwise
+void expr_kernel_eval_batch(expr_kernel_t* kernel, const array_batch_t* leaves,
+                            const array_batch_t* result, size_t count, size_t n,
+                            simd_dispatch_t* dispatch);
+// leaves cannot be split into temporaries here, so expr_eval_batch returns
+// false with errno EINVAL for a tree reading more than EXPR_MAX_LEAVES
+// distinct arrays or containing a reduction
+bool expr_eval_batch(expr_t* expr, const array_batch_t* leaves, const array_batch_t* result,
+                     size_t count, size_t n, simd_dispatch_t* dispatch);
+void expr_kernel_free(expr_kernel_t* kernel);
+
+// number of kernels the cache keeps (64 by default); 0 turns caching off
+void expr_cache_set_capacity(size_t capacity);
+// drops every cached kernel, e.g. before checking for leaks at exit
+void expr_cache_clear(void);
+
+// default block length of expr_eval_stream, in elements
+#define ARRAY_STREAM_BLOCK (1u << 20)
+
+// evaluates expr over sources that are read block by block instead of being
+// held in memory. sources[i] takes the place of the tree's i-th distinct
+// leaf, in the order expr_compile uses; the leaf arrays only identify the
+// parameters and their data is never read. every source is a flat array of
+// the same size. each block of `block` elements (0 for ARRAY_STREAM_BLOCK)
+// is evaluated with the SIMD kernels while a background thread writes the
+// previous block to the sink and reads the next one, so compute and I/O
+// overlap. an element-wise expr streams every element to the sink in order;
+// a full reduction streams a single element. returns false if a source or
+// the sink failed, or with errno EINVAL for an axis reduction or a tree
+// expr_compile rejects
+bool expr_eval_stream(expr_t* expr, array_source_t** sources, array_sink_t* sink, size_t block,
+                      simd_dispatch_t* dispatch);
+
 void expr_free(expr_t* expr);
 
 void array_print(array_t* arr);
 void array_fill(array_t* arr, float value);
 array_t* array_copy(array_t* src);
 
+// same as above, but split across dispatch->pool when the array is large.
+// a 4-byte source read across its rows (a transposed view, or a permutation
+// that moves the last axis) is copied in L1-sized tiles with the transpose
+// kernel
+void array_fill_eager(array_t* arr, float value, simd_dispatch_t* dispatch);
+array_t* array_copy_eager(array_t* src, simd_dispatch_t* dispatch);
+
 #endif 
@@ -1,6 +1,7 @@
 #ifndef SIMD_ABSTRACTION_H
 #define SIMD_ABSTRACTION_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
 typedef enum {
@@ -15,9 +16,33 @@ typedef struct {
 	float data[8];
 } simd_vec_t;
 
-// detecting which SIMD the CPU supports
+// length of the repeated element pattern passed to fill_n
+#define SIMD_FILL_PATTERN 64
+
+// what the CPU and OS support, from CPUID and XGETBV run once per process
+typedef struct {
+	bool sse2;
+	// with the FMA and F16C extensions the AVX2 backend also uses
+	bool avx2;
+	bool avx512f;
+	bool avx512_bf16;
+	bool neon;
+	// widest backend the CPU supports, and the widest one this build can
+	// also run (simd_default_dispatch's choice unless overridden)
+	simd_backend_t detected;
+	simd_backend_t best;
+} simd_features_t;
+
+const simd_features_t* simd_features(void);
+
+// the widest backend the CPU supports, independent of the build
 simd_backend_t simd_detect(void);
 
+// "scalar", "sse2", "avx2", "avx512" or "neon"; simd_backend_from_name
+// parses the same names (and "sse") and returns false for anything else
+const char* simd_backend_name(simd_backend_t backend);
+bool simd_backend_from_name(const char* name, simd_backend_t* backend);
+
 // printing the detected SIMD
 void simd_print_backend(simd_backend_t backend);
 
@@ -31,15 +56,178 @@ typedef simd_vec_t (*simd_add_func)(simd_vec_t, simd_vec_t);
 typedef simd_vec_t (*simd_mul_func)(simd_vec_t, simd_vec_t);
 typedef simd_vec_t (*simd_fmadd_func)(simd_vec_t, simd_vec_t, simd_vec_t);
 
+// whole-array kernels: one call covers n floats and keeps values in native
+// registers, instead of one simd_vec_t round-trip per 8 floats
+typedef void (*simd_binary_n_func)(float* dst, const float* a, const float* b, size_t n);
+typedef void (*simd_fmadd_n_func)(float* dst, const float* a, const float* b, const float* c, size_t n);
+typedef void (*simd_axpy_n_func)(float* y, float alpha, const float* x, size_t n);
+typedef void (*simd_scalar_n_func)(float* dst, const float* a, float scalar, size_t n);
+typedef float (*simd_reduce_n_func)(const float* a, size_t n);
+typedef float (*simd_dot_n_func)(const float* a, const float* b, size_t n);
+typedef void (*simd_kahan_n_func)(const float* a, size_t n, float* sum, float* comp);
+typedef void (*simd_unary_n_func)(float* dst, const float* a, size_t n);
+// byte-level kernels that serve every element format
+typedef void (*simd_fill_n_func)(void* dst, const void* pattern, size_t bytes);
+typedef void (*simd_copy_n_func)(void* dst, const void* src, size_t bytes);
+// dst[i * ldd + j] = src[j * lds + i] for i < rows, j < cols: writes the
+// transpose of a cols x rows block of src as a rows x cols block of dst.
+// moves 4-byte elements of any format bit for bit
+typedef void (*simd_transpose_func)(float* dst, size_t ldd, const float* src, size_t lds,
+                                    size_t rows, size_t cols);
+// c = a * b, or c += a * b when accumulate is set, for one gemm_mr x gemm_nr
+// tile of c with rows ldc floats apart. a holds k columns of gemm_mr floats
+// and b holds k rows of gemm_nr floats, both packed contiguously
+typedef void (*simd_gemm_kernel_func)(size_t k, const float* a, const float* b, float* c,
+                                      size_t ldc, int accumulate);
+
+// storage formats other than float32 are computed on as float32 blocks:
+// load_*_n widens n stored values into dst, store_*_n rounds n floats into
+// the format. float64 is also a compute type with its own kernels
+typedef void (*simd_load_n_func)(float* dst, const void* src, size_t n);
+typedef void (*simd_store_n_func)(void* dst, const float* src, size_t n);
+typedef void (*simd_binary_f64_n_func)(double* dst, const double* a, const double* b, size_t n);
+typedef void (*simd_fmadd_f64_n_func)(double* dst, const double* a, const double* b, const double* c, size_t n);
+typedef void (*simd_scalar_f64_n_func)(double* dst, const double* a, double scalar, size_t n);
+typedef double (*simd_reduce_f64_n_func)(const double* a, size_t n);
+typedef void (*simd_unary_f64_n_func)(double* dst, const double* a, size_t n);
+
 typedef struct {
 	simd_backend_t backend;
+	// native float lanes of the whole-array kernels
+	size_t lanes;
 	simd_add_func add;
 	simd_mul_func mul;
 	simd_fmadd_func fmadd;
+
+	// dst = a + b, dst = a - b, dst = a * b, dst = a * b + c
+	simd_binary_n_func add_n;
+	simd_binary_n_func sub_n;
+	simd_binary_n_func mul_n;
+	simd_fmadd_n_func fmadd_n;
+	// y = alpha * x + y
+	simd_axpy_n_func axpy_n;
+	// dst = a * scalar, dst = a + scalar
+	simd_scalar_n_func scale_n;
+	simd_scalar_n_func add_scalar_n;
+
+	// non-temporal store variants for outputs too large to stay in cache.
+	// they prefetch their inputs ahead of the loads, since the stores no
+	// longer keep the memory pipeline busy, and end with a store fence
+	simd_binary_n_func add_n_stream;
+	simd_binary_n_func mul_n_stream;
+	simd_fmadd_n_func fmadd_n_stream;
+
+	// fill_n writes bytes bytes of pattern, a SIMD_FILL_PATTERN-byte line
+	// holding one element repeated, to a dst aligned to that element's size.
+	// copy_n copies bytes bytes between buffers that do not overlap. the
+	// _stream variants use non-temporal stores as above
+	simd_fill_n_func fill_n;
+	simd_fill_n_func fill_n_stream;
+	simd_copy_n_func copy_n;
+	simd_copy_n_func copy_n_stream;
+
+	// transposes in register tiles: 4x4 on SSE and 8x8 on AVX2 with
+	// element-wise edges, masked 16x16 on AVX-512. callers bound rows and
+	// cols so the block stays in L1
+	simd_transpose_func transpose;
+
+	// reductions over a[0..n), each spread over several independent vector
+	// accumulators. max_n and min_n return -inf / +inf for n == 0.
+	// sum_kahan_n continues a compensated sum: it adds a[0..n) to the running
+	// (*sum, *comp) pair, whose value is *sum - *comp, using per-lane
+	// compensation terms, so a long sum can be fed in blocks without losing
+	// the low-order bits at every block boundary
+	simd_reduce_n_func sum_n;
+	simd_kahan_n_func sum_kahan_n;
+	simd_reduce_n_func max_n;
+	simd_reduce_n_func min_n;
+	simd_dot_n_func dot_n;
+
+	// element-wise math; dst may be a. sqrt_n is correctly rounded, the rest
+	// are polynomial approximations whose worst error over every float32
+	// input, measured against the exact result, is
+	//   exp_n 1.01 ulp, log_n 0.83 ulp, sigmoid_n 2.4 ulp, tanh_n 1.33 ulp
+	// on every backend, and rsqrt_n 1.5 ulp (3.4 ulp on SSE2 and AVX2, whose
+	// hardware estimate has only 12 bits). special values follow C99: exp(-inf) = 0, results
+	// too large for a float are +inf, log(0) = -inf, log of a negative
+	// number and sqrt/rsqrt of one are NaN, rsqrt(0) = +inf, and NaN in
+	// gives NaN out
+	simd_unary_n_func exp_n;
+	simd_unary_n_func log_n;
+	simd_unary_n_func sigmoid_n;
+	simd_unary_n_func tanh_n;
+	simd_unary_n_func sqrt_n;
+	simd_unary_n_func rsqrt_n;
+
+	// register-blocked matrix multiply micro-kernel (see array_matmul); the
+	// tile is sized so its accumulators fill the backend's vector registers
+	size_t gemm_mr;
+	size_t gemm_nr;
+	simd_gemm_kernel_func gemm_kernel;
+
+	// conversions, all rounding to nearest even. float16 is IEEE binary16
+	// (F16C on x86), bfloat16 keeps float32's exponent (AVX-512 BF16 when
+	// present) and flushes subnormals to zero as the hardware instruction
+	// does. the integer stores saturate and turn NaN into 0. float64 stores
+	// widen exactly, float64 loads round
+	simd_load_n_func load_f64_n;
+	simd_store_n_func store_f64_n;
+	simd_load_n_func load_f16_n;
+	simd_store_n_func store_f16_n;
+	simd_load_n_func load_bf16_n;
+	simd_store_n_func store_bf16_n;
+	simd_load_n_func load_i32_n;
+	simd_store_n_func store_i32_n;
+	simd_load_n_func load_i8_n;
+	simd_store_n_func store_i8_n;
+
+	// float64 counterparts of the kernels above, with the same semantics
+	simd_binary_f64_n_func add_f64_n;
+	simd_binary_f64_n_func sub_f64_n;
+	simd_binary_f64_n_func mul_f64_n;
+	simd_fmadd_f64_n_func fmadd_f64_n;
+	simd_scalar_f64_n_func scale_f64_n;
+	simd_reduce_f64_n_func sum_f64_n;
+	simd_reduce_f64_n_func max_f64_n;
+	simd_reduce_f64_n_func min_f64_n;
+	// libm on every backend
+	simd_unary_f64_n_func exp_f64_n;
+	simd_unary_f64_n_func log_f64_n;
+	simd_unary_f64_n_func sigmoid_f64_n;
+	simd_unary_f64_n_func tanh_f64_n;
+	simd_unary_f64_n_func sqrt_f64_n;
+	simd_unary_f64_n_func rsqrt_f64_n;
+
+	// optional worker pool for large element-wise operations; NULL runs
+	// everything on the calling thread. owned by the caller (see thread_pool.h)
+	struct thread_pool* pool;
+
+	// optional per-operation counters, NULL when not collected. owned by the
+	// caller (see simd_stats.h)
+	struct simd_stats* stats;
 } simd_dispatch_t;
 
+// the process-wide table, built on first use by whichever thread gets there
+// first and shared from then on. it uses simd_features()->best unless the
+// backend was forced with simd_set_default_backend, or named in the
+// SIMD_BACKEND environment variable (e.g. SIMD_BACKEND=sse2); a name that
+// is unknown or not supported here is ignored. it has no pool or stats and
+// must not be modified or freed
+const simd_dispatch_t* simd_default_dispatch(void);
+
+// forces the default table's backend, for tests and A/B comparisons. takes
+// precedence over SIMD_BACKEND; returns false once the default table exists
+// or when the backend is not supported here
+bool simd_set_default_backend(simd_backend_t backend);
+
+// a caller-owned copy of the default table, to attach a pool or stats to.
+// silent, and nothing is detected again
 simd_dispatch_t* simd_init_dispatch(void);
 
+// builds the table for one specific backend, or returns NULL when the CPU or
+// the build does not support it
+simd_dispatch_t* simd_init_dispatch_backend(simd_backend_t backend);
+
 void simd_free_dispatch(simd_dispatch_t* dispatch);
 
 #endif
@@ -0,0 +1,70 @@
+#ifndef SIMD_STATS_H
+#define SIMD_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "simd_abstraction.h"
+
+// per-operation counters for a dispatch table. they are only recorded when
+// the library is built with -DSIMD_STATS (make STATS=1): otherwise every
+// hook compiles to nothing and the counters stay at zero. a stats object is
+// attached like the pool (dispatch->stats = simd_stats_create()), is owned
+// by the caller and may be shared by tables used from several threads.
+typedef struct simd_stats simd_stats_t;
+
+// an operation handed to the expression evaluator is counted under its own
+// name (as interpreted) and again under SIMD_STATS_EXPR
+typedef enum {
+    SIMD_STATS_ADD,
+    SIMD_STATS_MUL,
+    SIMD_STATS_AXPY,
+    SIMD_STATS_SCALE,
+    SIMD_STATS_UNARY,
+    SIMD_STATS_FILL,
+    SIMD_STATS_COPY,
+    SIMD_STATS_ASTYPE,
+    SIMD_STATS_REDUCE,
+    SIMD_STATS_MATMUL,
+    SIMD_STATS_EXPR,
+    SIMD_STATS_STREAM,
+    SIMD_STATS_NOPS
+} simd_stats_op_t;
+
+typedef struct {
+    uint64_t calls;
+    // elements written, or read for a reduction
+    uint64_t elements;
+    // bytes read and written, counting every operand once
+    uint64_t bytes;
+    // inner runs that went straight to a whole-array SIMD kernel (for
+    // matmul, batches that went to the packed micro-kernel). reductions
+    // do not split their calls this way
+    uint64_t fast;
+    // inner runs that were gathered, scattered or done element by element
+    uint64_t fallback;
+    // calls handed to the expression evaluator
+    uint64_t interpreted;
+    // time inside the calls, nested operations included: TSC ticks on x86,
+    // nanoseconds elsewhere
+    uint64_t cycles;
+} simd_stats_counters_t;
+
+// whether this build records anything
+bool simd_stats_enabled(void);
+
+simd_stats_t* simd_stats_create(void);
+void simd_stats_free(simd_stats_t* stats);
+void simd_stats_reset(simd_stats_t* stats);
+
+// a snapshot of one operation's counters
+void simd_stats_get(const simd_stats_t* stats, simd_stats_op_t op, simd_stats_counters_t* out);
+
+// "add", "mul", ... as used in the JSON
+const char* simd_stats_op_name(simd_stats_op_t op);
+
+// writes dispatch->stats as one JSON object holding the backend, the timer
+// unit and the counters of every operation. returns false if the write failed
+bool simd_stats_write_json(const simd_dispatch_t* dispatch, FILE* out);
+
+#endif
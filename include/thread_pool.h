@@ -0,0 +1,31 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stddef.h>
+
+// persistent pthread pool for element-wise work. it is created once and
+// attached to a dispatch table (dispatch->pool = thread_pool_create(0)); the
+// array layer then splits large operations across it and stays serial for
+// small ones.
+typedef struct thread_pool thread_pool_t;
+
+// [begin, end) is one chunk of the iteration space; worker is in
+// [0, thread_pool_size) and is stable for the duration of the call
+typedef void (*thread_pool_fn)(void* ctx, size_t begin, size_t end, size_t worker);
+
+// nthreads counts the calling thread; 0 uses every CPU the process may run on
+thread_pool_t* thread_pool_create(size_t nthreads);
+
+void thread_pool_free(thread_pool_t* pool);
+
+size_t thread_pool_size(const thread_pool_t* pool);
+
+// runs fn over [0, n) in chunks of `chunk` elements, one call per chunk, and
+// returns when all are done. each worker starts on its own contiguous share
+// of the chunks, so repeated calls touch the same memory from the same
+// (pinned) thread, and steals from the others once its share is exhausted.
+// a NULL or single-thread pool runs the chunks in order on the caller.
+void thread_pool_parallel_for(thread_pool_t* pool, size_t n, size_t chunk,
+                              thread_pool_fn fn, void* ctx);
+
+#endif
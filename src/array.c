@@ -1,7 +1,14 @@
 #include "array.h"
+#include "array_iter.h"
+#include "cpu_cache.h"
+#include "simd_backends.h"
+#include "simd_stats_record.h"
+#include "thread_pool.h"
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <sys/mman.h>
 #include <assert.h>
 
 static void compute_strides(size_t* strides, size_t* shape, size_t ndim) {
@@ -12,14 +19,39 @@ static void compute_strides(size_t* strides, size_t* shape, size_t ndim) {
     }
 }
 
-array_t* array_create(size_t* shape, size_t ndim) {
-    array_t* arr = malloc(sizeof(array_t));
+static size_t round_up(size_t n, size_t align) {
+    return (n + align - 1) & ~(align - 1);
+}
+
+size_t array_dtype_size(array_dtype_t dtype) {
+    switch (dtype) {
+        case ARRAY_FLOAT64: return sizeof(double);
+        case ARRAY_FLOAT16:
+        case ARRAY_BFLOAT16: return sizeof(uint16_t);
+        case ARRAY_INT8: return sizeof(int8_t);
+        default: return sizeof(float);
+    }
+}
+
+static size_t array_data_bytes(size_t size, array_dtype_t dtype) {
+    return round_up(size * array_dtype_size(dtype), ARRAY_ALIGNMENT);
+}
+
+// one allocation for the header, shape/strides (when they fit inline) and,
+// if data_bytes is non-zero, the data buffer on the next aligned boundary
+static array_t* array_alloc(size_t* shape, size_t ndim, size_t data_bytes) {
+    size_t header = round_up(sizeof(array_t), ARRAY_ALIGNMENT);
+    array_t* arr = aligned_alloc(ARRAY_ALIGNMENT, header + data_bytes);
     
     arr->ndim = ndim;
-    arr->shape = malloc(ndim * sizeof(size_t));
-    arr->strides = malloc(ndim * sizeof(size_t));
+    if (ndim <= ARRAY_INLINE_DIMS) {
+        arr->shape = arr->shape_inline;
+        arr->strides = arr->strides_inline;
+    } else {
+        arr->shape = malloc(ndim * sizeof(size_t));
+        arr->strides = malloc(ndim * sizeof(size_t));
+    }
     memcpy(arr->shape, shape, ndim * sizeof(size_t));
-    
     compute_strides(arr->strides, shape, ndim);
     
     arr->size = 1;
@@ -27,41 +59,60 @@ array_t* array_create(size_t* shape, size_t ndim) {
         arr->size *= shape[i];
     }
     
-    arr->data = calloc(arr->size, sizeof(float));
-    arr->owns_data = true;
+    arr->raw = data_bytes ? (char*)arr + header : NULL;
+    arr->dtype = ARRAY_FLOAT32;
+    arr->data_bytes = data_bytes;
+    arr->owns_data = data_bytes != 0;
+    arr->storage = data_bytes ? ARRAY_STORAGE_INLINE : ARRAY_STORAGE_BORROWED;
+    arr->pool = NULL;
+    arr->mapping = NULL;
     arr->base = NULL;
     
     return arr;
 }
 
-array_t* array_from_data(float* data, size_t* shape, size_t ndim) {
-    array_t* arr = malloc(sizeof(array_t));
-    
-    arr->ndim = ndim;
-    arr->shape = malloc(ndim * sizeof(size_t));
-    arr->strides = malloc(ndim * sizeof(size_t));
-    memcpy(arr->shape, shape, ndim * sizeof(size_t));
-    
-    compute_strides(arr->strides, shape, ndim);
-    
-    arr->size = 1;
+array_t* array_create(size_t* shape, size_t ndim) {
+    return array_create_typed(shape, ndim, ARRAY_FLOAT32);
+}
+
+array_t* array_create_typed(size_t* shape, size_t ndim, array_dtype_t dtype) {
+    size_t size = 1;
     for (size_t i = 0; i < ndim; i++) {
-        arr->size *= shape[i];
+        size *= shape[i];
     }
     
-    arr->data = data;  
-    arr->owns_data = false;
-    arr->base = NULL;
+    array_t* arr = array_alloc(shape, ndim, array_data_bytes(size, dtype));
+    arr->dtype = dtype;
+    memset(arr->raw, 0, arr->size * array_dtype_size(dtype));
     
     return arr;
 }
 
-array_t* array_view(array_t* arr, size_t* start, size_t* end) {
-    array_t* view = malloc(sizeof(array_t));
+array_t* array_create_pooled(array_pool_t* pool, size_t* shape, size_t ndim) {
+    array_t* arr = array_alloc(shape, ndim, 0);
     
-    view->ndim = arr->ndim;
-    view->shape = malloc(arr->ndim * sizeof(size_t));
-    view->strides = malloc(arr->ndim * sizeof(size_t));
+    arr->data_bytes = array_data_bytes(arr->size, ARRAY_FLOAT32);
+    arr->data = array_pool_acquire(pool, arr->data_bytes);
+    arr->owns_data = true;
+    arr->storage = ARRAY_STORAGE_POOL;
+    arr->pool = pool;
+    
+    return arr;
+}
+
+array_t* array_from_data(float* data, size_t* shape, size_t ndim) {
+    return array_from_data_typed(data, shape, ndim, ARRAY_FLOAT32);
+}
+
+array_t* array_from_data_typed(void* data, size_t* shape, size_t ndim, array_dtype_t dtype) {
+    array_t* arr = array_alloc(shape, ndim, 0);
+    arr->raw = data;
+    arr->dtype = dtype;
+    return arr;
+}
+
+array_t* array_view(array_t* arr, size_t* start, size_t* end) {
+    array_t* view = array_alloc(arr->shape, arr->ndim, 0);
     
     size_t offset = 0;
     for (size_t i = 0; i < arr->ndim; i++) {
@@ -75,19 +126,109 @@ array_t* array_view(array_t* arr, size_t* start, size_t* end) {
         view->size *= view->shape[i];
     }
     
-    view->data = arr->data + offset;  
-    view->owns_data = false;
+    view->raw = (char*)arr->raw + offset * array_dtype_size(arr->dtype);
+    view->dtype = arr->dtype;
+    view->base = arr;
+    
+    return view;
+}
+
+array_t* array_slice(array_t* arr, size_t* start, size_t* end, size_t* step) {
+    array_t* view = array_alloc(arr->shape, arr->ndim, 0);
+    
+    size_t offset = 0;
+    view->size = 1;
+    for (size_t i = 0; i < arr->ndim; i++) {
+        size_t s = step ? step[i] : 1;
+        assert(s > 0 && start[i] <= end[i] && end[i] <= arr->shape[i]);
+        view->shape[i] = (end[i] - start[i] + s - 1) / s;
+        view->strides[i] = arr->strides[i] * s;
+        view->size *= view->shape[i];
+        offset += start[i] * arr->strides[i];
+    }
+    
+    view->raw = (char*)arr->raw + offset * array_dtype_size(arr->dtype);
+    view->dtype = arr->dtype;
+    view->base = arr;
+    
+    return view;
+}
+
+array_t* array_permute(array_t* arr, size_t* axes) {
+    array_t* view = array_alloc(arr->shape, arr->ndim, 0);
+    
+    for (size_t i = 0; i < arr->ndim; i++) {
+        assert(axes[i] < arr->ndim);
+        for (size_t j = 0; j < i; j++) assert(axes[j] != axes[i]);
+        view->shape[i] = arr->shape[axes[i]];
+        view->strides[i] = arr->strides[axes[i]];
+    }
+    
+    view->raw = arr->raw;
+    view->dtype = arr->dtype;
+    view->base = arr;
+    
+    return view;
+}
+
+array_t* array_transpose(array_t* arr) {
+    array_t* view = array_alloc(arr->shape, arr->ndim, 0);
+    
+    for (size_t i = 0; i < arr->ndim; i++) {
+        view->shape[i] = arr->shape[arr->ndim - 1 - i];
+        view->strides[i] = arr->strides[arr->ndim - 1 - i];
+    }
+    
+    view->raw = arr->raw;
+    view->dtype = arr->dtype;
     view->base = arr;
     
     return view;
 }
 
+// row-major with no gaps; dimensions of extent 1 may have any stride
+bool array_is_contiguous(array_t* arr) {
+    size_t stride = 1;
+    for (int i = (int)arr->ndim - 1; i >= 0; i--) {
+        if (arr->shape[i] == 1) continue;
+        if (arr->strides[i] != stride) return false;
+        stride *= arr->shape[i];
+    }
+    return true;
+}
+
+// [lo, hi) of the bytes an array's elements can lie in
+static void array_extent(array_t* arr, uintptr_t* lo, uintptr_t* hi) {
+    size_t last = 0;
+    for (size_t d = 0; d < arr->ndim; d++) {
+        last += (arr->shape[d] - 1) * arr->strides[d];
+    }
+    *lo = (uintptr_t)arr->raw;
+    *hi = *lo + (last + 1) * array_dtype_size(arr->dtype);
+}
+
+bool array_shares_memory(array_t* a, array_t* b) {
+    if (a->size == 0 || b->size == 0) return false;
+    uintptr_t a_lo, a_hi, b_lo, b_hi;
+    array_extent(a, &a_lo, &a_hi);
+    array_extent(b, &b_lo, &b_hi);
+    return a_lo < b_hi && b_lo < a_hi;
+}
+
+static void array_free_layout(array_t* arr) {
+    if (arr->shape != arr->shape_inline) {
+        free(arr->shape);
+        free(arr->strides);
+    }
+}
+
 void array_free(array_t* arr) {
-    if (arr->owns_data && arr->data) {
-        free(arr->data);
+    if (arr->storage == ARRAY_STORAGE_POOL) {
+        array_pool_release(arr->pool, arr->data, arr->data_bytes);
+    } else if (arr->storage == ARRAY_STORAGE_MAPPED) {
+        munmap(arr->mapping, arr->data_bytes);
     }
-    free(arr->shape);
-    free(arr->strides);
+    array_free_layout(arr);
     free(arr);
 }
 
@@ -100,11 +241,32 @@ size_t array_offset(array_t* arr, size_t* indices) {
 }
 
 float array_get(array_t* arr, size_t* indices) {
-    return arr->data[array_offset(arr, indices)];
+    size_t offset = array_offset(arr, indices);
+    switch (arr->dtype) {
+        case ARRAY_FLOAT64: return (float)((const double*)arr->raw)[offset];
+        case ARRAY_FLOAT16: return simd_f16_to_float(((const uint16_t*)arr->raw)[offset]);
+        case ARRAY_BFLOAT16: return simd_bf16_to_float(((const uint16_t*)arr->raw)[offset]);
+        case ARRAY_INT32: return (float)((const int32_t*)arr->raw)[offset];
+        case ARRAY_INT8: return (float)((const int8_t*)arr->raw)[offset];
+        default: return arr->data[offset];
+    }
+}
+
+// value rounded into the given format and written to dst
+static void array_encode(array_dtype_t dtype, void* dst, float value) {
+    switch (dtype) {
+        case ARRAY_FLOAT64: *(double*)dst = value; break;
+        case ARRAY_FLOAT16: *(uint16_t*)dst = simd_float_to_f16(value); break;
+        case ARRAY_BFLOAT16: *(uint16_t*)dst = simd_float_to_bf16(value); break;
+        case ARRAY_INT32: *(int32_t*)dst = simd_float_to_i32(value); break;
+        case ARRAY_INT8: *(int8_t*)dst = simd_float_to_i8(value); break;
+        default: *(float*)dst = value; break;
+    }
 }
 
 void array_set(array_t* arr, size_t* indices, float value) {
-    arr->data[array_offset(arr, indices)] = value;
+    size_t size = array_dtype_size(arr->dtype);
+    array_encode(arr->dtype, (char*)arr->raw + array_offset(arr, indices) * size, value);
 }
 
 bool array_broadcastable(array_t* a, array_t* b) {
@@ -141,192 +303,691 @@ size_t* array_broadcast_shape(array_t* a, array_t* b, size_t* out_ndim) {
     return shape;
 }
 
-void array_broadcast_prepare(array_t* arr, size_t* target_shape, size_t target_ndim) {
-    size_t* new_strides = malloc(target_ndim * sizeof(size_t));
+bool array_broadcast_strides(array_t* arr, size_t* target_shape, size_t target_ndim, size_t* out_strides) {
+    if (arr->ndim > target_ndim) return false;
     
     for (int i = 0; i < (int)target_ndim; i++) {
         int arr_idx = (int)arr->ndim - (int)target_ndim + i;
         
         if (arr_idx < 0) {
-            new_strides[i] = 0;
-        } else if (arr->shape[arr_idx] == 1 && target_shape[i] > 1) {
-            new_strides[i] = 0;
+            out_strides[i] = 0;
+        } else if (arr->shape[arr_idx] == target_shape[i]) {
+            out_strides[i] = arr->strides[arr_idx];
+        } else if (arr->shape[arr_idx] == 1) {
+            out_strides[i] = 0;
         } else {
-            new_strides[i] = arr->strides[arr_idx];
+            return false;
         }
     }
+    return true;
+}
+
+void array_broadcast_prepare(array_t* arr, size_t* target_shape, size_t target_ndim) {
+    size_t* new_strides = malloc(target_ndim * sizeof(size_t));
+    bool ok = array_broadcast_strides(arr, target_shape, target_ndim, new_strides);
+    assert(ok);
+    (void)ok;
+    
+    // the array becomes a view with the target shape so later strided
+    // operations see matching shape, strides and ndim
+    array_free_layout(arr);
+    
+    if (target_ndim <= ARRAY_INLINE_DIMS) {
+        arr->shape = arr->shape_inline;
+        arr->strides = arr->strides_inline;
+        memcpy(arr->strides, new_strides, target_ndim * sizeof(size_t));
+        free(new_strides);
+    } else {
+        arr->shape = malloc(target_ndim * sizeof(size_t));
+        arr->strides = new_strides;
+    }
+    memcpy(arr->shape, target_shape, target_ndim * sizeof(size_t));
+    arr->ndim = target_ndim;
     
-    free(arr->strides);
-    arr->strides = new_strides;
+    arr->size = 1;
+    for (size_t i = 0; i < target_ndim; i++) {
+        arr->size *= target_shape[i];
+    }
 }
 
-void array_add_eager(array_t* result, array_t* a, array_t* b, simd_dispatch_t* dispatch) {
-    assert(array_broadcastable(a, b));
+// inner runs that are not contiguous are gathered into blocks of this size
+#define EAGER_BLOCK 256
+// shortest inner run, in bytes, worth writing with non-temporal stores
+#define ARRAY_STREAM_MIN_RUN 4096
+
+// an output larger than the last-level cache is written with non-temporal
+// stores: none of it would still be cached by the time it is read again,
+// and they skip the read for ownership of every line, a third of the memory
+// traffic of a + b. short or tiled runs keep regular stores, since every
+// streaming kernel call ends with a store fence
+static bool array_stream_output(const array_iter_t* it, size_t elem_size) {
+    return it->size * elem_size > cpu_cache_info()->llc && it->tile_rows == 0 &&
+           it->shape[it->ndim - 1] * elem_size >= ARRAY_STREAM_MIN_RUN;
+}
+
+typedef struct {
+    // op_n, or its streaming variant for the contiguous runs of a large output
+    simd_binary_n_func out_n;
+    simd_binary_n_func op_n;
+    simd_scalar_n_func op_scalar_n;
+    bool is_mul;
+    float* out;
+    const float* a;
+    const float* b;
+    simd_stats_t* stats;
+    simd_stats_op_t stats_op;
+} eager_binary_t;
+
+static inline float eager_scalar_op(const eager_binary_t* op, float x, float y) {
+    return op->is_mul ? x * y : x + y;
+}
+
+// one inner run of an element-wise binary op, specialised on the inner
+// strides: fully contiguous, one side broadcast (splat), or gathered
+static void eager_binary_inner(void* ctx, const size_t* offsets, const size_t* inner_strides, size_t n) {
+    eager_binary_t* op = ctx;
+    float* out = op->out + offsets[0];
+    const float* a = op->a + offsets[1];
+    const float* b = op->b + offsets[2];
+    size_t so = inner_strides[0], sa = inner_strides[1], sb = inner_strides[2];
+    
+    if (so == 1 && sa == 1 && sb == 1) {
+        SIMD_STATS_COUNT(op->stats, op->stats_op, fast);
+        op->out_n(out, a, b, n);
+        return;
+    }
+    if (so == 1 && sa == 1 && sb == 0) {
+        SIMD_STATS_COUNT(op->stats, op->stats_op, fast);
+        op->op_scalar_n(out, a, *b, n);
+        return;
+    }
+    if (so == 1 && sa == 0 && sb == 1) {
+        SIMD_STATS_COUNT(op->stats, op->stats_op, fast);
+        op->op_scalar_n(out, b, *a, n);
+        return;
+    }
+    SIMD_STATS_COUNT(op->stats, op->stats_op, fallback);
+    if (sa == 0 && sb == 0) {
+        float value = eager_scalar_op(op, *a, *b);
+        for (size_t i = 0; i < n; i++) {
+            out[i * so] = value;
+        }
+        return;
+    }
     
-    if (a->ndim == 1 && b->ndim == 1 && a->size == b->size && result->size == a->size) {
-        size_t i = 0;
-        for (; i + 8 <= a->size; i += 8) {
-            simd_vec_t va = simd_load(&a->data[i]);
-            simd_vec_t vb = simd_load(&b->data[i]);
-            simd_vec_t vr = dispatch->add(va, vb);
-            simd_store(&result->data[i], vr);
+    float a_buf[EAGER_BLOCK], b_buf[EAGER_BLOCK], out_buf[EAGER_BLOCK];
+    for (size_t j = 0; j < n; j += EAGER_BLOCK) {
+        size_t m = n - j < EAGER_BLOCK ? n - j : EAGER_BLOCK;
+        const float* pa = &a[j * sa];
+        const float* pb = &b[j * sb];
+        float* po = so == 1 ? &out[j] : out_buf;
+        
+        if (sa != 1) {
+            for (size_t i = 0; i < m; i++) a_buf[i] = pa[i * sa];
+            pa = a_buf;
+        }
+        if (sb != 1) {
+            for (size_t i = 0; i < m; i++) b_buf[i] = pb[i * sb];
+            pb = b_buf;
         }
         
-        for (; i < a->size; i++) {
-            result->data[i] = a->data[i] + b->data[i];
+        op->op_n(po, pa, pb, m);
+        
+        if (so != 1) {
+            for (size_t i = 0; i < m; i++) out[(j + i) * so] = out_buf[i];
         }
+    }
+}
+
+static void array_binary_eager(array_t* result, array_t* a, array_t* b, simd_dispatch_t* dispatch,
+                               simd_binary_n_func op_n, simd_binary_n_func op_n_stream,
+                               simd_scalar_n_func op_scalar_n, bool is_mul, simd_stats_op_t stats_op) {
+    size_t a_strides[ARRAY_ITER_MAX_DIMS];
+    size_t b_strides[ARRAY_ITER_MAX_DIMS];
+    
+    assert(result->ndim <= ARRAY_ITER_MAX_DIMS);
+    bool ok = array_broadcast_strides(a, result->shape, result->ndim, a_strides) &&
+              array_broadcast_strides(b, result->shape, result->ndim, b_strides);
+    assert(ok);
+    (void)ok;
+    
+    const size_t* strides[3] = {result->strides, a_strides, b_strides};
+    array_iter_t it;
+    array_iter_init(&it, result->shape, result->ndim, 3, strides);
+    
+    simd_binary_n_func out_n = array_stream_output(&it, sizeof(float)) ? op_n_stream : op_n;
+    eager_binary_t op = {out_n, op_n, op_scalar_n, is_mul, result->data, a->data, b->data,
+                         dispatch->stats, stats_op};
+    array_iter_parallel(&it, dispatch->pool, eager_binary_inner, &op, 0);
+}
+
+static inline size_t array_nbytes(const array_t* arr) {
+    return arr->size * array_dtype_size(arr->dtype);
+}
+
+static bool array_all_f32(array_t* result, array_t* a, array_t* b) {
+    return result->dtype == ARRAY_FLOAT32 && a->dtype == ARRAY_FLOAT32 && b->dtype == ARRAY_FLOAT32;
+}
+
+// an element-wise op can write over an operand in one pass only when the
+// operand is the result itself, element for element: every element is then
+// read before the same position is written. any other overlap (a shifted
+// view, a transpose, a row broadcast over its own array) is left to
+// expr_eval, which stages the result in a temporary
+static bool array_overwrites(array_t* result, array_t* operand) {
+    if (!array_shares_memory(result, operand)) return false;
+    if (operand->raw != result->raw || operand->dtype != result->dtype) return true;
+    
+    size_t strides[ARRAY_ITER_MAX_DIMS];
+    assert(result->ndim <= ARRAY_ITER_MAX_DIMS);
+    if (!array_broadcast_strides(operand, result->shape, result->ndim, strides)) return true;
+    for (size_t d = 0; d < result->ndim; d++) {
+        if (result->shape[d] > 1 && strides[d] != result->strides[d]) return true;
+    }
+    return false;
+}
+
+// whether the eager kernels can run on these operands as they are
+static bool array_eager_ok(array_t* result, array_t* a, array_t* b) {
+    return array_all_f32(result, a, b) && !array_overwrites(result, a) && !array_overwrites(result, b);
+}
+
+// any other mix of formats is left to the expression evaluator, which
+// converts block by block instead of materialising float32 copies
+static void array_binary_expr(array_t* result, array_t* a, array_t* b, simd_dispatch_t* dispatch,
+                              bool is_mul) {
+    expr_t* left = expr_from_array(a);
+    expr_t* right = expr_from_array(b);
+    expr_t* expr = is_mul ? expr_mul(left, right) : expr_add(left, right);
+    expr_eval(expr, result, dispatch);
+    expr_free(expr);
+}
+
+void array_add_eager(array_t* result, array_t* a, array_t* b, simd_dispatch_t* dispatch) {
+    assert(array_broadcastable(a, b));
+    SIMD_STATS_BEGIN(stats, dispatch->stats, SIMD_STATS_ADD);
+    if (!array_eager_ok(result, a, b)) {
+        SIMD_STATS_COUNT(dispatch->stats, SIMD_STATS_ADD, interpreted);
+        array_binary_expr(result, a, b, dispatch, false);
     } else {
-        for (size_t i = 0; i < result->size; i++) {
-            result->data[i] = a->data[i] + b->data[i];
-        }
+        array_binary_eager(result, a, b, dispatch, dispatch->add_n, dispatch->add_n_stream,
+                           dispatch->add_scalar_n, false, SIMD_STATS_ADD);
     }
+    SIMD_STATS_END(stats, result->size, array_nbytes(result) + array_nbytes(a) + array_nbytes(b));
 }
 
 void array_mul_eager(array_t* result, array_t* a, array_t* b, simd_dispatch_t* dispatch) {
     assert(array_broadcastable(a, b));
-    
-    if (a->ndim == 1 && b->ndim == 1 && a->size == b->size && result->size == a->size) {
-        size_t i = 0;
-        for (; i + 8 <= a->size; i += 8) {
-            simd_vec_t va = simd_load(&a->data[i]);
-            simd_vec_t vb = simd_load(&b->data[i]);
-            simd_vec_t vr = dispatch->mul(va, vb);
-            simd_store(&result->data[i], vr);
-        }
-        
-        for (; i < a->size; i++) {
-            result->data[i] = a->data[i] * b->data[i];
-        }
+    SIMD_STATS_BEGIN(stats, dispatch->stats, SIMD_STATS_MUL);
+    if (!array_eager_ok(result, a, b)) {
+        SIMD_STATS_COUNT(dispatch->stats, SIMD_STATS_MUL, interpreted);
+        array_binary_expr(result, a, b, dispatch, true);
     } else {
-        for (size_t i = 0; i < result->size; i++) {
-            result->data[i] = a->data[i] * b->data[i];
-        }
+        array_binary_eager(result, a, b, dispatch, dispatch->mul_n, dispatch->mul_n_stream,
+                           dispatch->scale_n, true, SIMD_STATS_MUL);
     }
+    SIMD_STATS_END(stats, result->size, array_nbytes(result) + array_nbytes(a) + array_nbytes(b));
 }
 
-expr_t* expr_from_array(array_t* arr) {
-    expr_t* expr = malloc(sizeof(expr_t));
-    expr->type = EXPR_ARRAY;
-    expr->data.leaf.array = arr;
-    
-    expr->ndim = arr->ndim;
-    expr->shape = malloc(arr->ndim * sizeof(size_t));
-    memcpy(expr->shape, arr->shape, arr->ndim * sizeof(size_t));
-    
-    return expr;
+void array_add_inplace(array_t* x, array_t* y, simd_dispatch_t* dispatch) {
+    array_add_eager(x, x, y, dispatch);
 }
 
-expr_t* expr_add(expr_t* left, expr_t* right) {
-    expr_t* expr = malloc(sizeof(expr_t));
-    expr->type = EXPR_ADD;
-    expr->data.binary.left = left;
-    expr->data.binary.right = right;
-    
-    expr->ndim = left->ndim;
-    expr->shape = malloc(left->ndim * sizeof(size_t));
-    memcpy(expr->shape, left->shape, left->ndim * sizeof(size_t));
-    
-    return expr;
+void array_mul_inplace(array_t* x, array_t* y, simd_dispatch_t* dispatch) {
+    array_mul_eager(x, x, y, dispatch);
 }
 
-expr_t* expr_mul(expr_t* left, expr_t* right) {
-    expr_t* expr = malloc(sizeof(expr_t));
-    expr->type = EXPR_MUL;
-    expr->data.binary.left = left;
-    expr->data.binary.right = right;
-    
-    expr->ndim = left->ndim;
-    expr->shape = malloc(left->ndim * sizeof(size_t));
-    memcpy(expr->shape, left->shape, left->ndim * sizeof(size_t));
-    
-    return expr;
+void* array_batch_item(const array_batch_t* batch, size_t k) {
+    if (batch->items) return batch->items[k];
+    return (char*)batch->data + k * batch->stride * array_dtype_size(batch->dtype);
 }
 
-expr_t* expr_scalar_mul(float scalar, expr_t* operand) {
-    expr_t* expr = malloc(sizeof(expr_t));
-    expr->type = EXPR_SCALAR_MUL;
-    expr->data.scalar_op.scalar = scalar;
-    expr->data.scalar_op.operand = operand;
-    
-    expr->ndim = operand->ndim;
-    expr->shape = malloc(operand->ndim * sizeof(size_t));
-    memcpy(expr->shape, operand->shape, operand->ndim * sizeof(size_t));
-    
-    return expr;
+typedef struct {
+    simd_binary_n_func op_n;
+    const array_batch_t* result;
+    const array_batch_t* a;
+    const array_batch_t* b;
+    size_t n;
+    simd_stats_t* stats;
+    simd_stats_op_t stats_op;
+} batch_binary_t;
+
+static void batch_binary_chunk(void* ctx, size_t begin, size_t end, size_t worker) {
+    batch_binary_t* op = ctx;
+    (void)worker;
+    for (size_t k = begin; k < end; k++) {
+        SIMD_STATS_COUNT(op->stats, op->stats_op, fast);
+        op->op_n(array_batch_item(op->result, k), array_batch_item(op->a, k),
+                 array_batch_item(op->b, k), op->n);
+    }
 }
 
-static float expr_eval_at(expr_t* expr, size_t* indices) {
-    switch (expr->type) {
-        case EXPR_ARRAY:
-            return array_get(expr->data.leaf.array, indices);
+// a float32 batch is one kernel call per item; other formats are handed to
+// expr_eval_batch with two leaves that only carry the operands' formats
+static void array_binary_batch(const array_batch_t* result, const array_batch_t* a,
+                               const array_batch_t* b, size_t count, size_t n,
+                               simd_dispatch_t* dispatch, bool is_mul, simd_stats_op_t stats_op) {
+    SIMD_STATS_BEGIN(stats, dispatch->stats, stats_op);
+    if (result->dtype != ARRAY_FLOAT32 || a->dtype != ARRAY_FLOAT32 || b->dtype != ARRAY_FLOAT32) {
+        SIMD_STATS_COUNT(dispatch->stats, stats_op, interpreted);
+        array_t* left_leaf = array_from_data_typed(NULL, &n, 1, a->dtype);
+        array_t* right_leaf = array_from_data_typed(NULL, &n, 1, b->dtype);
+        expr_t* left = expr_from_array(left_leaf);
+        expr_t* right = expr_from_array(right_leaf);
+        expr_t* expr = is_mul ? expr_mul(left, right) : expr_add(left, right);
+        array_batch_t leaves[2] = {*a, *b};
+        expr_eval_batch(expr, leaves, result, count, n, dispatch);
+        expr_free(expr);
+        array_free(right_leaf);
+        array_free(left_leaf);
+    } else {
+        batch_binary_t op = {is_mul ? dispatch->mul_n : dispatch->add_n, result, a, b, n,
+                             dispatch->stats, stats_op};
+        thread_pool_t* pool = count * n >= ARRAY_PARALLEL_MIN ? dispatch->pool : NULL;
+        thread_pool_parallel_for(pool, count, array_batch_chunk(n), batch_binary_chunk, &op);
+    }
+    SIMD_STATS_END(stats, count * n, count * n * (array_dtype_size(result->dtype) +
+                                                  array_dtype_size(a->dtype) +
+                                                  array_dtype_size(b->dtype)));
+}
+
+void array_add_batch(const array_batch_t* result, const array_batch_t* a, const array_batch_t* b,
+                     size_t count, size_t n, simd_dispatch_t* dispatch) {
+    array_binary_batch(result, a, b, count, n, dispatch, false, SIMD_STATS_ADD);
+}
+
+void array_mul_batch(const array_batch_t* result, const array_batch_t* a, const array_batch_t* b,
+                     size_t count, size_t n, simd_dispatch_t* dispatch) {
+    array_binary_batch(result, a, b, count, n, dispatch, true, SIMD_STATS_MUL);
+}
+
+typedef struct {
+    simd_axpy_n_func axpy_n;
+    simd_scalar_n_func add_scalar_n;
+    float alpha;
+    float* y;
+    const float* x;
+    simd_stats_t* stats;
+} axpy_op_t;
+
+// y is operand 0 and x operand 1, broadcast to y's shape
+static void axpy_inner(void* ctx, const size_t* offsets, const size_t* inner_strides, size_t n) {
+    axpy_op_t* op = ctx;
+    float* y = op->y + offsets[0];
+    const float* x = op->x + offsets[1];
+    size_t sy = inner_strides[0], sx = inner_strides[1];
+    
+    if (sy == 1 && sx == 1) {
+        SIMD_STATS_COUNT(op->stats, SIMD_STATS_AXPY, fast);
+        op->axpy_n(y, op->alpha, x, n);
+        return;
+    }
+    if (sy == 1 && sx == 0) {
+        SIMD_STATS_COUNT(op->stats, SIMD_STATS_AXPY, fast);
+        op->add_scalar_n(y, y, op->alpha * *x, n);
+        return;
+    }
+    SIMD_STATS_COUNT(op->stats, SIMD_STATS_AXPY, fallback);
+    for (size_t i = 0; i < n; i++) {
+        y[i * sy] += op->alpha * x[i * sx];
+    }
+}
+
+void array_axpy(array_t* y, float alpha, array_t* x, simd_dispatch_t* dispatch) {
+    assert(array_broadcastable(y, x));
+    SIMD_STATS_BEGIN(stats, dispatch->stats, SIMD_STATS_AXPY);
+    if (!array_eager_ok(y, y, x)) {
+        SIMD_STATS_COUNT(dispatch->stats, SIMD_STATS_AXPY, interpreted);
+        expr_t* expr = expr_add(expr_scalar_mul(alpha, expr_from_array(x)), expr_from_array(y));
+        expr_eval(expr, y, dispatch);
+        expr_free(expr);
+    } else {
+        size_t x_strides[ARRAY_ITER_MAX_DIMS];
+        assert(y->ndim <= ARRAY_ITER_MAX_DIMS);
+        bool ok = array_broadcast_strides(x, y->shape, y->ndim, x_strides);
+        assert(ok);
+        (void)ok;
         
-        case EXPR_ADD: {
-            float left = expr_eval_at(expr->data.binary.left, indices);
-            float right = expr_eval_at(expr->data.binary.right, indices);
-            return left + right;
-        }
+        const size_t* strides[2] = {y->strides, x_strides};
+        array_iter_t it;
+        array_iter_init(&it, y->shape, y->ndim, 2, strides);
         
-        case EXPR_MUL: {
-            float left = expr_eval_at(expr->data.binary.left, indices);
-            float right = expr_eval_at(expr->data.binary.right, indices);
-            return left * right;
-        }
+        axpy_op_t op = {dispatch->axpy_n, dispatch->add_scalar_n, alpha, y->data, x->data,
+                        dispatch->stats};
+        array_iter_parallel(&it, dispatch->pool, axpy_inner, &op, 0);
+    }
+    SIMD_STATS_END(stats, y->size, 2 * array_nbytes(y) + array_nbytes(x));
+}
+
+typedef struct {
+    simd_scalar_n_func scale_n;
+    float alpha;
+    float* x;
+    simd_stats_t* stats;
+} scale_op_t;
+
+static void scale_inner(void* ctx, const size_t* offsets, const size_t* inner_strides, size_t n) {
+    scale_op_t* op = ctx;
+    float* x = op->x + offsets[0];
+    size_t sx = inner_strides[0];
+    
+    if (sx == 1) {
+        SIMD_STATS_COUNT(op->stats, SIMD_STATS_SCALE, fast);
+        op->scale_n(x, x, op->alpha, n);
+        return;
+    }
+    SIMD_STATS_COUNT(op->stats, SIMD_STATS_SCALE, fallback);
+    for (size_t i = 0; i < n; i++) {
+        x[i * sx] *= op->alpha;
+    }
+}
+
+void array_scale_inplace(array_t* x, float alpha, simd_dispatch_t* dispatch) {
+    SIMD_STATS_BEGIN(stats, dispatch->stats, SIMD_STATS_SCALE);
+    if (x->dtype != ARRAY_FLOAT32) {
+        SIMD_STATS_COUNT(dispatch->stats, SIMD_STATS_SCALE, interpreted);
+        expr_t* expr = expr_scalar_mul(alpha, expr_from_array(x));
+        expr_eval(expr, x, dispatch);
+        expr_free(expr);
+    } else {
+        const size_t* strides[1] = {x->strides};
+        array_iter_t it;
+        array_iter_init(&it, x->shape, x->ndim, 1, strides);
         
-        case EXPR_SCALAR_MUL: {
-            float val = expr_eval_at(expr->data.scalar_op.operand, indices);
-            return expr->data.scalar_op.scalar * val;
-        }
+        scale_op_t op = {dispatch->scale_n, alpha, x->data, dispatch->stats};
+        array_iter_parallel(&it, dispatch->pool, scale_inner, &op, 0);
     }
-    return 0.0f;
+    SIMD_STATS_END(stats, x->size, 2 * array_nbytes(x));
 }
 
-void expr_eval(expr_t* expr, array_t* result, simd_dispatch_t* dispatch) {
-    size_t* indices = calloc(result->ndim, sizeof(size_t));
-    
-    for (size_t flat = 0; flat < result->size; flat++) {
-        size_t temp = flat;
-        for (int i = (int)result->ndim - 1; i >= 0; i--) {
-            indices[i] = temp % result->shape[i];
-            temp /= result->shape[i];
+// a single-node expression already runs the kernel a block at a time over
+// any strides, format and thread count
+void array_unary_eager(array_t* result, array_t* arr, array_unary_op_t op, simd_dispatch_t* dispatch) {
+    SIMD_STATS_BEGIN(stats, dispatch->stats, SIMD_STATS_UNARY);
+    SIMD_STATS_COUNT(dispatch->stats, SIMD_STATS_UNARY, interpreted);
+    expr_t* expr = expr_unary(expr_from_array(arr), op);
+    expr_eval(expr, result, dispatch);
+    expr_free(expr);
+    SIMD_STATS_END(stats, result->size, array_nbytes(result) + array_nbytes(arr));
+}
+
+void array_exp_eager(array_t* result, array_t* arr, simd_dispatch_t* dispatch) {
+    array_unary_eager(result, arr, ARRAY_UNARY_EXP, dispatch);
+}
+
+void array_log_eager(array_t* result, array_t* arr, simd_dispatch_t* dispatch) {
+    array_unary_eager(result, arr, ARRAY_UNARY_LOG, dispatch);
+}
+
+void array_sigmoid_eager(array_t* result, array_t* arr, simd_dispatch_t* dispatch) {
+    array_unary_eager(result, arr, ARRAY_UNARY_SIGMOID, dispatch);
+}
+
+void array_tanh_eager(array_t* result, array_t* arr, simd_dispatch_t* dispatch) {
+    array_unary_eager(result, arr, ARRAY_UNARY_TANH, dispatch);
+}
+
+void array_sqrt_eager(array_t* result, array_t* arr, simd_dispatch_t* dispatch) {
+    array_unary_eager(result, arr, ARRAY_UNARY_SQRT, dispatch);
+}
+
+void array_rsqrt_eager(array_t* result, array_t* arr, simd_dispatch_t* dispatch) {
+    array_unary_eager(result, arr, ARRAY_UNARY_RSQRT, dispatch);
+}
+
+// fill and copy move elements as opaque 1, 2, 4 or 8 byte words, so they
+// serve every format. contiguous runs go to the byte kernels, strided ones
+// are moved a word at a time
+#define ARRAY_FILL_WORDS(type)                                                  \
+    do {                                                                        \
+        type* out = (type*)op->data + offsets[0];                               \
+        type word;                                                              \
+        memcpy(&word, op->pattern, sizeof(type));                               \
+        for (size_t i = 0; i < n; i++) out[i * stride] = word;                  \
+    } while (0)
+
+typedef struct {
+    simd_fill_n_func fill_n;
+    simd_stats_t* stats;
+    void* data;
+    size_t size;
+    // the fill value in the array's format, repeated across the line
+    unsigned char pattern[SIMD_FILL_PATTERN];
+} fill_op_t;
+
+static void fill_inner(void* ctx, const size_t* offsets, const size_t* inner_strides, size_t n) {
+    fill_op_t* op = ctx;
+    size_t stride = inner_strides[0];
+    
+    if (stride == 1) {
+        SIMD_STATS_COUNT(op->stats, SIMD_STATS_FILL, fast);
+        op->fill_n((char*)op->data + offsets[0] * op->size, op->pattern, n * op->size);
+        return;
+    }
+    SIMD_STATS_COUNT(op->stats, SIMD_STATS_FILL, fallback);
+    switch (op->size) {
+        case 1: ARRAY_FILL_WORDS(uint8_t); break;
+        case 2: ARRAY_FILL_WORDS(uint16_t); break;
+        case 8: ARRAY_FILL_WORDS(uint64_t); break;
+        default: ARRAY_FILL_WORDS(uint32_t); break;
+    }
+}
+
+static void array_fill_on(array_t* arr, float value, const simd_dispatch_t* dispatch) {
+    const size_t* strides[1] = {arr->strides};
+    array_iter_t it;
+    array_iter_init(&it, arr->shape, arr->ndim, 1, strides);
+    
+    SIMD_STATS_BEGIN(stats, dispatch->stats, SIMD_STATS_FILL);
+    fill_op_t op;
+    op.stats = dispatch->stats;
+    op.data = arr->raw;
+    op.size = array_dtype_size(arr->dtype);
+    op.fill_n = array_stream_output(&it, op.size) ? dispatch->fill_n_stream : dispatch->fill_n;
+    array_encode(arr->dtype, op.pattern, value);
+    for (size_t i = op.size; i < SIMD_FILL_PATTERN; i += op.size) {
+        memcpy(op.pattern + i, op.pattern, op.size);
+    }
+    array_iter_parallel(&it, dispatch->pool, fill_inner, &op, 0);
+    SIMD_STATS_END(stats, arr->size, array_nbytes(arr));
+}
+
+// array_fill and array_copy take no dispatch table and run on the default one
+void array_fill(array_t* arr, float value) {
+    array_fill_on(arr, value, simd_default_dispatch());
+}
+
+void array_fill_eager(array_t* arr, float value, simd_dispatch_t* dispatch) {
+    array_fill_on(arr, value, dispatch);
+}
+
+#define ARRAY_COPY_WORDS(type)                                                  \
+    do {                                                                        \
+        type* dst = (type*)op->dst + offsets[0];                                \
+        const type* src = (const type*)op->src + offsets[1];                    \
+        for (size_t i = 0; i < n; i++) dst[i * sd] = src[i * ss];               \
+    } while (0)
+
+typedef struct {
+    simd_copy_n_func copy_n;
+    simd_transpose_func transpose;
+    simd_stats_t* stats;
+    void* dst;
+    const void* src;
+    size_t size;
+} copy_op_t;
+
+static void copy_inner(void* ctx, const size_t* offsets, const size_t* inner_strides, size_t n) {
+    copy_op_t* op = ctx;
+    size_t sd = inner_strides[0], ss = inner_strides[1];
+    
+    if (sd == 1 && ss == 1) {
+        SIMD_STATS_COUNT(op->stats, SIMD_STATS_COPY, fast);
+        op->copy_n((char*)op->dst + offsets[0] * op->size, (const char*)op->src + offsets[1] * op->size,
+                   n * op->size);
+        return;
+    }
+    SIMD_STATS_COUNT(op->stats, SIMD_STATS_COPY, fallback);
+    switch (op->size) {
+        case 1: ARRAY_COPY_WORDS(uint8_t); break;
+        case 2: ARRAY_COPY_WORDS(uint16_t); break;
+        case 8: ARRAY_COPY_WORDS(uint64_t); break;
+        default: ARRAY_COPY_WORDS(uint32_t); break;
+    }
+}
+
+// a tiled copy of 4-byte elements is a transpose when one operand runs along
+// the tile's rows and the other down its columns: the whole tile goes to the
+// transpose kernel, oriented so it writes dst's contiguous side
+static void copy_tile(void* ctx, const size_t* offsets, const size_t* row_strides,
+                      const size_t* col_strides, size_t rows, size_t cols) {
+    copy_op_t* op = ctx;
+    float* dst = (float*)op->dst + offsets[0];
+    const float* src = (const float*)op->src + offsets[1];
+    
+    if (col_strides[0] == 1 && row_strides[1] == 1) {
+        SIMD_STATS_COUNT(op->stats, SIMD_STATS_COPY, fast);
+        op->transpose(dst, row_strides[0], src, col_strides[1], rows, cols);
+    } else if (row_strides[0] == 1 && col_strides[1] == 1) {
+        SIMD_STATS_COUNT(op->stats, SIMD_STATS_COPY, fast);
+        op->transpose(dst, col_strides[0], src, row_strides[1], cols, rows);
+    } else {
+        size_t row_offsets[2] = {offsets[0], offsets[1]};
+        for (size_t r = 0; r < rows; r++) {
+            copy_inner(ctx, row_offsets, col_strides, cols);
+            row_offsets[0] += row_strides[0];
+            row_offsets[1] += row_strides[1];
         }
-        
-        result->data[flat] = expr_eval_at(expr, indices);
     }
-    
-    free(indices);
 }
 
-void expr_free(expr_t* expr) {
-    if (!expr) return;
+// copies src's elements into dst, where element i of src lands at
+// dst_strides . i (dst_strides are over src's shape)
+static void array_copy_into(void* dst, const size_t* dst_strides, array_t* src,
+                            const simd_dispatch_t* dispatch) {
+    SIMD_STATS_BEGIN(stats, dispatch->stats, SIMD_STATS_COPY);
+    // views and broadcast arrays are gathered through their strides
+    const size_t* strides[2] = {dst_strides, src->strides};
+    array_iter_t it;
+    array_iter_init(&it, src->shape, src->ndim, 2, strides);
+    
+    size_t size = array_dtype_size(src->dtype);
+    simd_copy_n_func copy_n = array_stream_output(&it, size) ? dispatch->copy_n_stream : dispatch->copy_n;
+    copy_op_t op = {copy_n, dispatch->transpose, dispatch->stats, dst, src->raw, size};
+    array_iter_parallel_tiles(&it, dispatch->pool, copy_inner, size == 4 ? copy_tile : NULL, &op, 0);
+    SIMD_STATS_END(stats, src->size, 2 * array_nbytes(src));
+}
+
+static array_t* array_copy_on(array_t* src, const simd_dispatch_t* dispatch) {
+    array_t* dst = array_create_typed(src->shape, src->ndim, src->dtype);
+    array_copy_into(dst->raw, dst->strides, src, dispatch);
+    return dst;
+}
+
+array_t* array_copy(array_t* src) {
+    return array_copy_on(src, simd_default_dispatch());
+}
+
+array_t* array_copy_eager(array_t* src, simd_dispatch_t* dispatch) {
+    return array_copy_on(src, dispatch);
+}
+
+// strides that lay arr's elements out in shape without moving them, if any.
+// dimensions of extent 1 are dropped from arr, then the old and new
+// dimensions are matched up in groups with equal products: a group of old
+// dimensions that step through memory as one block can be split any way
+// (numpy's attempt_nocopy_reshape)
+static bool reshape_strides(array_t* arr, size_t* shape, size_t ndim, size_t* strides) {
+    if (arr->size == 0) {
+        compute_strides(strides, shape, ndim);
+        return true;
+    }
     
-    switch (expr->type) {
-        case EXPR_ADD:
-        case EXPR_MUL:
-            expr_free(expr->data.binary.left);
-            expr_free(expr->data.binary.right);
-            break;
-        
-        case EXPR_SCALAR_MUL:
-            expr_free(expr->data.scalar_op.operand);
-            break;
-        
-        case EXPR_ARRAY:
-            break;
+    size_t old_shape[ARRAY_ITER_MAX_DIMS], old_strides[ARRAY_ITER_MAX_DIMS];
+    size_t old_ndim = 0;
+    for (size_t d = 0; d < arr->ndim; d++) {
+        if (arr->shape[d] == 1) continue;
+        old_shape[old_ndim] = arr->shape[d];
+        old_strides[old_ndim++] = arr->strides[d];
     }
     
-    free(expr->shape);
-    free(expr);
+    size_t oi = 0, ni = 0;
+    while (oi < old_ndim && ni < ndim) {
+        size_t oj = oi + 1, nj = ni + 1;
+        size_t old_count = old_shape[oi], new_count = shape[ni];
+        while (old_count != new_count) {
+            if (new_count < old_count) {
+                new_count *= shape[nj++];
+            } else {
+                old_count *= old_shape[oj++];
+            }
+        }
+        
+        for (size_t k = oi; k + 1 < oj; k++) {
+            if (old_strides[k] != old_shape[k + 1] * old_strides[k + 1]) return false;
+        }
+        strides[nj - 1] = old_strides[oj - 1];
+        for (size_t k = nj - 1; k > ni; k--) {
+            strides[k - 1] = strides[k] * shape[k];
+        }
+        oi = oj;
+        ni = nj;
+    }
+    // trailing dimensions of extent 1
+    for (; ni < ndim; ni++) {
+        strides[ni] = 1;
+    }
+    return true;
 }
 
-void array_fill(array_t* arr, float value) {
-    for (size_t i = 0; i < arr->size; i++) {
-        arr->data[i] = value;
+array_t* array_reshape(array_t* arr, size_t* shape, size_t ndim, simd_dispatch_t* dispatch) {
+    size_t size = 1;
+    for (size_t i = 0; i < ndim; i++) {
+        size *= shape[i];
+    }
+    assert(size == arr->size);
+    assert(arr->ndim <= ARRAY_ITER_MAX_DIMS);
+    
+    array_t* view = array_alloc(shape, ndim, 0);
+    if (reshape_strides(arr, shape, ndim, view->strides)) {
+        view->raw = arr->raw;
+        view->dtype = arr->dtype;
+        view->base = arr;
+        return view;
     }
+    array_free(view);
+    
+    // the new array holds arr's elements in row-major order, i.e. laid out
+    // by contiguous strides over arr's own shape
+    array_t* dst = array_create_typed(shape, ndim, arr->dtype);
+    size_t strides[ARRAY_ITER_MAX_DIMS];
+    compute_strides(strides, arr->shape, arr->ndim);
+    array_copy_into(dst->raw, strides, arr, dispatch);
+    return dst;
 }
 
-array_t* array_copy(array_t* src) {
-    array_t* dst = array_create(src->shape, src->ndim);
-    memcpy(dst->data, src->data, src->size * sizeof(float));
+array_t* array_make_contiguous(array_t* arr, simd_dispatch_t* dispatch) {
+    if (!array_is_contiguous(arr)) return array_copy_eager(arr, dispatch);
+    
+    array_t* view = array_alloc(arr->shape, arr->ndim, 0);
+    view->raw = arr->raw;
+    view->dtype = arr->dtype;
+    view->base = arr;
+    return view;
+}
+
+array_t* array_astype(array_t* src, array_dtype_t dtype, simd_dispatch_t* dispatch) {
+    if (src->dtype == dtype) return array_copy_eager(src, dispatch);
+    
+    // a lone leaf compiles to a load and a store, i.e. one conversion kernel
+    // call per block
+    SIMD_STATS_BEGIN(stats, dispatch->stats, SIMD_STATS_ASTYPE);
+    SIMD_STATS_COUNT(dispatch->stats, SIMD_STATS_ASTYPE, interpreted);
+    array_t* dst = array_create_typed(src->shape, src->ndim, dtype);
+    expr_t* expr = expr_from_array(src);
+    expr_eval(expr, dst, dispatch);
+    expr_free(expr);
+    SIMD_STATS_END(stats, dst->size, array_nbytes(dst) + array_nbytes(src));
     return dst;
 }
 
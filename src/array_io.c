@@ -0,0 +1,639 @@
+#include "array.h"
+#include "array_iter.h"
+#include "simd_stats_record.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <assert.h>
+
+#define ARRAY_FILE_MAGIC "SIMDARR"
+#define ARRAY_FILE_VERSION 1
+// written in native order; reads back differently on a machine of the
+// other endianness, whose elements would be byte-swapped too
+#define ARRAY_FILE_BYTE_ORDER 0x01020304u
+// strided arrays are gathered into blocks of this many elements per write
+#define ARRAY_SAVE_BLOCK 4096
+
+// followed by uint64 shape[ndim] and uint64 strides[ndim] (in elements),
+// then zeros up to data_offset
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t dtype;
+    uint32_t alignment;
+    uint64_t ndim;
+    uint64_t data_offset;
+    uint64_t data_bytes;
+} array_file_header_t;
+
+static size_t file_data_offset(size_t ndim) {
+    size_t end = sizeof(array_file_header_t) + 2 * ndim * sizeof(uint64_t);
+    return (end + ARRAY_ALIGNMENT - 1) & ~(size_t)(ARRAY_ALIGNMENT - 1);
+}
+
+// bound on the prologue (header, layout and padding) of any file
+#define ARRAY_FILE_PROLOGUE_MAX                                                 \
+    (sizeof(array_file_header_t) + 2 * ARRAY_MAP_MAX_DIMS * sizeof(uint64_t) + ARRAY_ALIGNMENT)
+
+// fills buf with everything in front of the data of a row-major contiguous
+// array and returns its length, which is the data offset
+static size_t file_prologue(unsigned char* buf, const size_t* shape, size_t ndim, array_dtype_t dtype) {
+    assert(ndim <= ARRAY_MAP_MAX_DIMS);
+    size_t offset = file_data_offset(ndim);
+    memset(buf, 0, offset);
+
+    size_t count = 1;
+    for (size_t d = 0; d < ndim; d++) count *= shape[d];
+
+    array_file_header_t header = {0};
+    memcpy(header.magic, ARRAY_FILE_MAGIC, sizeof(ARRAY_FILE_MAGIC));
+    header.version = ARRAY_FILE_VERSION;
+    header.byte_order = ARRAY_FILE_BYTE_ORDER;
+    header.dtype = (uint32_t)dtype;
+    header.alignment = ARRAY_ALIGNMENT;
+    header.ndim = ndim;
+    header.data_offset = offset;
+    header.data_bytes = (uint64_t)count * array_dtype_size(dtype);
+    memcpy(buf, &header, sizeof(header));
+
+    uint64_t* layout = (uint64_t*)(buf + sizeof(header));
+    uint64_t stride = 1;
+    for (size_t d = ndim; d-- > 0;) {
+        layout[d] = shape[d];
+        layout[ndim + d] = stride;
+        stride *= shape[d];
+    }
+    return offset;
+}
+
+typedef struct {
+    FILE* file;
+    const char* data;
+    size_t size;
+    unsigned char buf[ARRAY_SAVE_BLOCK * sizeof(double)];
+} save_writer_t;
+
+// contiguous runs go straight to stdio, which buffers them; strided runs
+// are packed first so there is one fwrite per block rather than per element
+static void save_inner(void* ctx, const size_t* offsets, const size_t* inner_strides, size_t n) {
+    save_writer_t* w = ctx;
+    const char* src = w->data + offsets[0] * w->size;
+    size_t stride = inner_strides[0] * w->size;
+
+    if (stride == w->size) {
+        fwrite(src, w->size, n, w->file);
+        return;
+    }
+    for (size_t j = 0; j < n; j += ARRAY_SAVE_BLOCK) {
+        size_t m = n - j < ARRAY_SAVE_BLOCK ? n - j : ARRAY_SAVE_BLOCK;
+        for (size_t i = 0; i < m; i++) {
+            memcpy(w->buf + i * w->size, src + (j + i) * stride, w->size);
+        }
+        fwrite(w->buf, w->size, m, w->file);
+    }
+}
+
+bool array_save(array_t* arr, const char* path) {
+    size_t size = array_dtype_size(arr->dtype);
+
+    // the file always holds the elements row-major and contiguous
+    unsigned char prologue[ARRAY_FILE_PROLOGUE_MAX];
+    size_t offset = file_prologue(prologue, arr->shape, arr->ndim, arr->dtype);
+
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+    fwrite(prologue, 1, offset, file);
+
+    if (arr->size > 0) {
+        assert(arr->ndim <= ARRAY_ITER_MAX_DIMS);
+        const size_t* strides[1] = {arr->strides};
+        array_iter_t it;
+        array_iter_init(&it, arr->shape, arr->ndim, 1, strides);
+
+        save_writer_t* w = malloc(sizeof(save_writer_t));
+        w->file = file;
+        w->data = arr->raw;
+        w->size = size;
+        array_iter_range(&it, 0, it.size, save_inner, w);
+        free(w);
+    }
+
+    bool ok = !ferror(file);
+    if (fclose(file) != 0) ok = false;
+    return ok;
+}
+
+// every element the strides can reach has to lie inside the data
+static bool file_layout_valid(const array_file_header_t* header, const uint64_t* layout) {
+    if (header->dtype > ARRAY_INT8 || header->ndim > ARRAY_MAP_MAX_DIMS) return false;
+
+    size_t itemsize = array_dtype_size((array_dtype_t)header->dtype);
+    uint64_t last = 0;
+    for (size_t d = 0; d < header->ndim; d++) {
+        uint64_t n = layout[d], s = layout[header->ndim + d];
+        if (n == 0) return true;
+        if (s != 0 && n - 1 > (UINT64_MAX - last) / s) return false;
+        last += (n - 1) * s;
+    }
+    return last < header->data_bytes / itemsize;
+}
+
+static bool file_header_valid(const array_file_header_t* header, size_t file_bytes) {
+    return memcmp(header->magic, ARRAY_FILE_MAGIC, sizeof(ARRAY_FILE_MAGIC)) == 0 &&
+           header->version == ARRAY_FILE_VERSION &&
+           header->byte_order == ARRAY_FILE_BYTE_ORDER &&
+           header->ndim <= ARRAY_MAP_MAX_DIMS &&
+           header->data_offset >= file_data_offset(header->ndim) &&
+           header->data_offset % ARRAY_ALIGNMENT == 0 &&
+           header->data_offset <= file_bytes &&
+           header->data_bytes <= file_bytes - header->data_offset;
+}
+
+static void file_advise(void* map, size_t bytes, unsigned flags) {
+    if (flags & ARRAY_MAP_SEQUENTIAL) madvise(map, bytes, MADV_SEQUENTIAL);
+    if (flags & ARRAY_MAP_RANDOM) madvise(map, bytes, MADV_RANDOM);
+    if (flags & ARRAY_MAP_WILLNEED) madvise(map, bytes, MADV_WILLNEED);
+}
+
+array_t* array_mmap(const char* path, unsigned flags) {
+    bool shared_write = (flags & ARRAY_MAP_WRITE) && !(flags & ARRAY_MAP_PRIVATE);
+    int fd = open(path, shared_write ? O_RDWR : O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return NULL;
+    }
+    size_t file_bytes = (size_t)st.st_size;
+    if (file_bytes < sizeof(array_file_header_t)) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    int prot = PROT_READ;
+    if (flags & (ARRAY_MAP_WRITE | ARRAY_MAP_PRIVATE)) prot |= PROT_WRITE;
+    int map_flags = (flags & ARRAY_MAP_PRIVATE) ? MAP_PRIVATE : MAP_SHARED;
+#ifdef MAP_POPULATE
+    if (flags & ARRAY_MAP_POPULATE) map_flags |= MAP_POPULATE;
+#endif
+
+    // the mapping keeps its own reference to the file
+    void* map = mmap(NULL, file_bytes, prot, map_flags, fd, 0);
+    int saved = errno;
+    close(fd);
+    if (map == MAP_FAILED) {
+        errno = saved;
+        return NULL;
+    }
+
+    const array_file_header_t* header = map;
+    const uint64_t* layout = (const uint64_t*)(header + 1);
+    if (!file_header_valid(header, file_bytes) || !file_layout_valid(header, layout)) {
+        munmap(map, file_bytes);
+        errno = EINVAL;
+        return NULL;
+    }
+    file_advise(map, file_bytes, flags);
+
+    size_t ndim = header->ndim;
+    size_t shape[ARRAY_MAP_MAX_DIMS];
+    for (size_t d = 0; d < ndim; d++) shape[d] = layout[d];
+
+    array_t* arr = array_from_data_typed((char*)map + header->data_offset, shape, ndim,
+                                         (array_dtype_t)header->dtype);
+    for (size_t d = 0; d < ndim; d++) arr->strides[d] = layout[ndim + d];
+    arr->storage = ARRAY_STORAGE_MAPPED;
+    arr->owns_data = true;
+    arr->mapping = map;
+    arr->data_bytes = file_bytes;
+    return arr;
+}
+
+struct array_source {
+    array_dtype_t dtype;
+    size_t size;
+    array_read_fn read;
+    void* ctx;
+    int fd;
+    off_t data_offset;
+};
+
+struct array_sink {
+    array_dtype_t dtype;
+    array_write_fn write;
+    void* ctx;
+    int fd;
+    off_t data_offset;
+    // elements the file expects and has been given
+    size_t size;
+    size_t written;
+    bool failed;
+};
+
+array_source_t* array_source_callback(array_dtype_t dtype, size_t size, array_read_fn read, void* ctx) {
+    array_source_t* source = calloc(1, sizeof(array_source_t));
+    source->dtype = dtype;
+    source->size = size;
+    source->read = read;
+    source->ctx = ctx;
+    source->fd = -1;
+    return source;
+}
+
+// pread and pwrite may move less than asked for without failing
+static size_t file_read(void* ctx, void* dst, size_t offset, size_t count) {
+    array_source_t* source = ctx;
+    size_t size = array_dtype_size(source->dtype);
+    size_t bytes = count * size, done = 0;
+    off_t at = source->data_offset + (off_t)(offset * size);
+    while (done < bytes) {
+        ssize_t n = pread(source->fd, (char*)dst + done, bytes - done, at + (off_t)done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += (size_t)n;
+    }
+    return done / size;
+}
+
+static size_t file_write(void* ctx, const void* src, size_t offset, size_t count) {
+    array_sink_t* sink = ctx;
+    size_t size = array_dtype_size(sink->dtype);
+    if (offset > sink->size || count > sink->size - offset) return 0;
+
+    size_t bytes = count * size, done = 0;
+    off_t at = sink->data_offset + (off_t)(offset * size);
+    while (done < bytes) {
+        ssize_t n = pwrite(sink->fd, (const char*)src + done, bytes - done, at + (off_t)done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += (size_t)n;
+    }
+    sink->written += done / size;
+    return done / size;
+}
+
+// a streamed file is read in order, so it has to be row-major and contiguous;
+// extent-1 dimensions may have any stride
+static bool file_layout_contiguous(const array_file_header_t* header, const uint64_t* layout) {
+    uint64_t stride = 1;
+    for (size_t d = header->ndim; d-- > 0;) {
+        if (layout[d] != 1 && layout[header->ndim + d] != stride) return false;
+        stride *= layout[d];
+    }
+    return true;
+}
+
+array_source_t* array_source_open(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    unsigned char prologue[ARRAY_FILE_PROLOGUE_MAX];
+    const array_file_header_t* header = (const array_file_header_t*)prologue;
+    const uint64_t* layout = (const uint64_t*)(header + 1);
+    if (fstat(fd, &st) != 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return NULL;
+    }
+
+    // the layout is only read once the header says how long it is
+    size_t file_bytes = (size_t)st.st_size;
+    bool ok = pread(fd, prologue, sizeof(*header), 0) == (ssize_t)sizeof(*header) &&
+              file_header_valid(header, file_bytes);
+    size_t layout_bytes = ok ? 2 * header->ndim * sizeof(uint64_t) : 0;
+    ok = ok && pread(fd, prologue + sizeof(*header), layout_bytes, sizeof(*header)) == (ssize_t)layout_bytes &&
+         file_layout_valid(header, layout) && file_layout_contiguous(header, layout);
+    if (!ok) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    size_t size = 1;
+    for (size_t d = 0; d < header->ndim; d++) size *= layout[d];
+
+    array_source_t* source = array_source_callback((array_dtype_t)header->dtype, size, file_read, NULL);
+    source->ctx = source;
+    source->fd = fd;
+    source->data_offset = (off_t)header->data_offset;
+    return source;
+}
+
+size_t array_source_size(const array_source_t* source) {
+    return source->size;
+}
+
+array_dtype_t array_source_dtype(const array_source_t* source) {
+    return source->dtype;
+}
+
+void array_source_free(array_source_t* source) {
+    if (!source) return;
+    if (source->fd >= 0) close(source->fd);
+    free(source);
+}
+
+array_sink_t* array_sink_callback(array_dtype_t dtype, array_write_fn write, void* ctx) {
+    array_sink_t* sink = calloc(1, sizeof(array_sink_t));
+    sink->dtype = dtype;
+    sink->write = write;
+    sink->ctx = ctx;
+    sink->fd = -1;
+    return sink;
+}
+
+array_sink_t* array_sink_create(const char* path, array_dtype_t dtype, size_t* shape, size_t ndim) {
+    unsigned char prologue[ARRAY_FILE_PROLOGUE_MAX];
+    size_t offset = file_prologue(prologue, shape, ndim, dtype);
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) return NULL;
+    if (write(fd, prologue, offset) != (ssize_t)offset) {
+        int saved = errno;
+        close(fd);
+        errno = saved ? saved : EIO;
+        return NULL;
+    }
+
+    array_sink_t* sink = array_sink_callback(dtype, file_write, NULL);
+    sink->ctx = sink;
+    sink->fd = fd;
+    sink->data_offset = (off_t)offset;
+    sink->size = 1;
+    for (size_t d = 0; d < ndim; d++) sink->size *= shape[d];
+    return sink;
+}
+
+bool array_sink_close(array_sink_t* sink) {
+    if (!sink) return false;
+    bool ok = !sink->failed;
+    if (sink->fd >= 0) {
+        if (sink->written != sink->size) ok = false;
+        if (close(sink->fd) != 0) ok = false;
+    }
+    free(sink);
+    return ok;
+}
+
+// the background half of expr_eval_stream. each job writes one finished
+// block to the sink and reads the next block from every source; the caller
+// computes the block in between, which lives in the other buffer of each pair
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    size_t posted;
+    size_t finished;
+    bool shutdown;
+    bool failed;
+
+    array_source_t** sources;
+    size_t nsources;
+    void** read_dst;
+    size_t read_offset;
+    size_t read_count;
+
+    array_sink_t* sink;
+    const void* write_src;
+    size_t write_offset;
+    size_t write_count;
+} stream_io_t;
+
+static void stream_io_run(stream_io_t* io) {
+    if (io->write_count > 0) {
+        array_sink_t* sink = io->sink;
+        if (sink->write(sink->ctx, io->write_src, io->write_offset, io->write_count) != io->write_count) {
+            sink->failed = true;
+            io->failed = true;
+        }
+    }
+    for (size_t i = 0; i < io->nsources && io->read_count > 0; i++) {
+        array_source_t* source = io->sources[i];
+        if (source->read(source->ctx, io->read_dst[i], io->read_offset, io->read_count) != io->read_count) {
+            io->failed = true;
+        }
+    }
+}
+
+static void* stream_io_main(void* arg) {
+    stream_io_t* io = arg;
+    size_t seen = 0;
+    for (;;) {
+        pthread_mutex_lock(&io->lock);
+        while (io->posted == seen && !io->shutdown) {
+            pthread_cond_wait(&io->start, &io->lock);
+        }
+        if (io->shutdown) {
+            pthread_mutex_unlock(&io->lock);
+            return NULL;
+        }
+        seen = io->posted;
+        pthread_mutex_unlock(&io->lock);
+
+        stream_io_run(io);
+
+        pthread_mutex_lock(&io->lock);
+        io->finished = seen;
+        pthread_cond_signal(&io->done);
+        pthread_mutex_unlock(&io->lock);
+    }
+}
+
+// hands the thread its next job; the previous one must have been waited for
+static void stream_io_post(stream_io_t* io, const void* write_src, size_t write_offset, size_t write_count,
+                           void** read_dst, size_t read_offset, size_t read_count) {
+    pthread_mutex_lock(&io->lock);
+    io->write_src = write_src;
+    io->write_offset = write_offset;
+    io->write_count = write_count;
+    io->read_dst = read_dst;
+    io->read_offset = read_offset;
+    io->read_count = read_count;
+    io->posted++;
+    pthread_cond_signal(&io->start);
+    pthread_mutex_unlock(&io->lock);
+}
+
+static bool stream_io_wait(stream_io_t* io) {
+    pthread_mutex_lock(&io->lock);
+    while (io->finished != io->posted) {
+        pthread_cond_wait(&io->done, &io->lock);
+    }
+    bool ok = !io->failed;
+    pthread_mutex_unlock(&io->lock);
+    return ok;
+}
+
+// a full reduction is evaluated one block at a time into a partial in the
+// compute type; the partials are combined in double
+static double stream_combine(array_reduce_op_t op, double total, double partial, size_t n) {
+    switch (op) {
+        case ARRAY_REDUCE_SUM: return total + partial;
+        case ARRAY_REDUCE_MEAN: return total + partial * (double)n;
+        case ARRAY_REDUCE_MAX: return partial > total ? partial : total;
+        case ARRAY_REDUCE_MIN: return partial < total ? partial : total;
+    }
+    return total;
+}
+
+static double stream_identity(array_reduce_op_t op) {
+    switch (op) {
+        case ARRAY_REDUCE_MAX: return -INFINITY;
+        case ARRAY_REDUCE_MIN: return INFINITY;
+        default: return 0.0;
+    }
+}
+
+bool expr_eval_stream(expr_t* expr, array_source_t** sources, array_sink_t* sink, size_t block,
+                      simd_dispatch_t* dispatch) {
+    bool reduce = expr->type == EXPR_REDUCE;
+    if (reduce && expr->data.reduce.axis != EXPR_ALL_AXES) {
+        errno = EINVAL;
+        return false;
+    }
+    if (block == 0) block = ARRAY_STREAM_BLOCK;
+    // sources are bound one per leaf, so a tree that needs temporaries
+    // cannot be evaluated in parts here
+    expr_kernel_t* kernel = expr_compile(expr);
+    if (!kernel) {
+        errno = EINVAL;
+        return false;
+    }
+    SIMD_STATS_BEGIN(stats, dispatch->stats, SIMD_STATS_STREAM);
+
+    size_t nsources = expr_kernel_nleaves(kernel);
+    size_t size = array_source_size(sources[0]);
+    bool wide = sink->dtype == ARRAY_FLOAT64;
+    for (size_t i = 0; i < nsources; i++) {
+        assert(array_source_size(sources[i]) == size);
+        if (sources[i]->dtype == ARRAY_FLOAT64) wide = true;
+    }
+
+    // every buffer is allocated at the full block length and viewed at the
+    // length of the block it holds. a reduction only ever outputs one element
+    size_t nblocks = (size + block - 1) / block;
+    size_t buffer_len = size < block ? size : block;
+    size_t out_len = reduce || buffer_len == 0 ? 1 : buffer_len;
+    array_t** buffers = malloc(2 * (nsources + 1) * sizeof(array_t*));
+    array_t** leaves = malloc(nsources * sizeof(array_t*));
+    void** in[2] = {malloc(nsources * sizeof(void*)), malloc(nsources * sizeof(void*))};
+    for (size_t s = 0; s < 2; s++) {
+        for (size_t i = 0; i <= nsources; i++) {
+            array_t** buffer = &buffers[s * (nsources + 1) + i];
+            if (i < nsources) {
+                *buffer = array_create_typed(&buffer_len, 1, sources[i]->dtype);
+                in[s][i] = (*buffer)->raw;
+            } else {
+                *buffer = array_create_typed(&out_len, 1, sink->dtype);
+            }
+        }
+    }
+    void* out[2] = {buffers[nsources]->raw, buffers[2 * nsources + 1]->raw};
+
+    size_t one = 1;
+    array_t* partial = reduce ? array_create_typed(&one, 1, wide ? ARRAY_FLOAT64 : ARRAY_FLOAT32) : NULL;
+    array_reduce_op_t op = reduce ? expr->data.reduce.op : ARRAY_REDUCE_SUM;
+    double total = stream_identity(op);
+
+    stream_io_t io = {0};
+    io.sources = sources;
+    io.nsources = nsources;
+    io.sink = sink;
+    pthread_mutex_init(&io.lock, NULL);
+    pthread_cond_init(&io.start, NULL);
+    pthread_cond_init(&io.done, NULL);
+    pthread_create(&io.thread, NULL, stream_io_main, &io);
+
+    bool ok = true;
+    if (nblocks > 0) {
+        stream_io_post(&io, NULL, 0, 0, in[0], 0, buffer_len);
+        ok = stream_io_wait(&io);
+    }
+
+    // block b is computed while the thread writes block b - 1 and reads b + 1
+    for (size_t b = 0; b < nblocks && ok; b++) {
+        size_t begin = b * block;
+        size_t n = size - begin < block ? size - begin : block;
+        size_t next = begin + n;
+        size_t next_n = size - next < block ? size - next : block;
+        size_t prev_n = b > 0 ? block : 0;
+        stream_io_post(&io, out[(b + 1) % 2], begin - prev_n, reduce ? 0 : prev_n, in[(b + 1) % 2], next,
+                       next_n);
+
+        for (size_t i = 0; i < nsources; i++) {
+            leaves[i] = array_from_data_typed(in[b % 2][i], &n, 1, sources[i]->dtype);
+        }
+        if (reduce) {
+            expr_kernel_eval(kernel, leaves, partial, dispatch);
+            double value = wide ? *(double*)partial->raw : (double)partial->data[0];
+            total = stream_combine(op, total, value, n);
+        } else {
+            array_t* result = array_from_data_typed(out[b % 2], &n, 1, sink->dtype);
+            expr_kernel_eval(kernel, leaves, result, dispatch);
+            array_free(result);
+        }
+        for (size_t i = 0; i < nsources; i++) array_free(leaves[i]);
+
+        ok = stream_io_wait(&io);
+        if (ok && b + 1 == nblocks && !reduce) {
+            stream_io_post(&io, out[b % 2], begin, n, NULL, 0, 0);
+            ok = stream_io_wait(&io);
+        }
+    }
+
+    // the reduced value goes through a one-element float64 array so it is
+    // rounded into the sink's format the same way expr_eval rounds a result
+    if (ok && reduce) {
+        if (op == ARRAY_REDUCE_MEAN) total = size > 0 ? total / (double)size : NAN;
+        array_t* value = array_from_data_typed(&total, &one, 1, ARRAY_FLOAT64);
+        expr_t* leaf = expr_from_array(value);
+        expr_eval(leaf, buffers[nsources], dispatch);
+        expr_free(leaf);
+        array_free(value);
+        stream_io_post(&io, out[0], 0, 1, NULL, 0, 0);
+        ok = stream_io_wait(&io);
+    }
+
+    pthread_mutex_lock(&io.lock);
+    io.shutdown = true;
+    pthread_cond_signal(&io.start);
+    pthread_mutex_unlock(&io.lock);
+    pthread_join(io.thread, NULL);
+    pthread_cond_destroy(&io.start);
+    pthread_cond_destroy(&io.done);
+    pthread_mutex_destroy(&io.lock);
+
+    if (partial) array_free(partial);
+    for (size_t i = 0; i < 2 * (nsources + 1); i++) array_free(buffers[i]);
+    free(buffers);
+    free(leaves);
+    free(in[0]);
+    free(in[1]);
+    expr_kernel_free(kernel);
+
+    // every element of every source is read once, and every output element
+    // written once
+#ifdef SIMD_STATS
+    size_t out_size = reduce ? 1 : size;
+    size_t bytes = out_size * array_dtype_size(sink->dtype);
+    for (size_t i = 0; i < nsources; i++) bytes += size * array_dtype_size(sources[i]->dtype);
+    SIMD_STATS_END(stats, out_size, bytes);
+#endif
+    return ok;
+}
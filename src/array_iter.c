@@ -0,0 +1,280 @@
+#include "array_iter.h"
+#include "cpu_cache.h"
+#include "thread_pool.h"
+#include <string.h>
+#include <assert.h>
+
+// > 0 when the operands would rather have dimension a outside dimension b,
+// counted over the operands that actually move along both
+static int iter_order_vote(size_t nops, const size_t* const* strides, size_t a, size_t b) {
+    int vote = 0;
+    for (size_t k = 0; k < nops; k++) {
+        size_t sa = strides[k][a], sb = strides[k][b];
+        if (sa == 0 || sb == 0) continue;
+        if (sa < sb) vote--;
+        else if (sa > sb) vote++;
+    }
+    return vote;
+}
+
+// square tile side, at least one cache line of floats. the strided operands
+// touch a new line per element, so their tiles must stay in L1 until every
+// line has been used up; the other operands only stream through, so the
+// tile over all operands just has to fit in L2
+static size_t iter_tile_size(size_t nstrided, size_t nops) {
+    const cpu_cache_info_t* cache = cpu_cache_info();
+    size_t tile = cache->line / sizeof(float);
+    for (;;) {
+        size_t next = 2 * tile * 2 * tile * sizeof(float);
+        if (tile >= 256 || nstrided * next > cache->l1d / 2 || nops * next > cache->l2 / 2) break;
+        tile *= 2;
+    }
+    return tile;
+}
+
+static void iter_plan_tiles(array_iter_t* it) {
+    it->tile_rows = 0;
+    it->tile_cols = 0;
+    if (it->ndim < 2) return;
+
+    size_t last = it->ndim - 1;
+    size_t row = last - 1;
+
+    // an operand that steps less along rows than along columns is read across
+    // a different cache line on every element of a row
+    size_t nstrided = 0;
+    for (size_t k = 0; k < it->nops; k++) {
+        size_t s_row = it->strides[row][k], s_col = it->strides[last][k];
+        if (s_col > 1 && s_row != 0 && s_row < s_col) nstrided++;
+    }
+    if (nstrided == 0) return;
+
+    size_t tile = iter_tile_size(nstrided, it->nops);
+    if (it->shape[row] < tile || it->shape[last] < tile) return;
+    it->tile_rows = tile;
+    it->tile_cols = tile;
+}
+
+void array_iter_init(array_iter_t* it, const size_t* shape, size_t ndim,
+                     size_t nops, const size_t* const* strides) {
+    assert(ndim <= ARRAY_ITER_MAX_DIMS);
+    assert(nops <= ARRAY_ITER_MAX_OPS);
+
+    it->nops = nops;
+    it->ndim = 0;
+    it->size = 1;
+
+    for (size_t d = 0; d < ndim; d++) {
+        it->size *= shape[d];
+    }
+
+    // unit dimensions are dropped; the rest are insertion-sorted outermost
+    // first by stride, keeping the given order unless most operands disagree
+    size_t order[ARRAY_ITER_MAX_DIMS];
+    size_t nkept = 0;
+    for (size_t d = 0; d < ndim; d++) {
+        if (shape[d] == 1) continue;
+        size_t j = nkept++;
+        while (j > 0 && iter_order_vote(nops, strides, d, order[j - 1]) > 0) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = d;
+    }
+
+    // merge each dimension into the previous kept one when every operand steps
+    // through them as one contiguous block
+    for (size_t i = 0; i < nkept; i++) {
+        size_t d = order[i];
+
+        if (it->ndim > 0) {
+            size_t prev = it->ndim - 1;
+            int mergeable = 1;
+            for (size_t k = 0; k < nops; k++) {
+                if (it->strides[prev][k] != strides[k][d] * shape[d]) {
+                    mergeable = 0;
+                    break;
+                }
+            }
+            if (mergeable) {
+                it->shape[prev] *= shape[d];
+                for (size_t k = 0; k < nops; k++) {
+                    it->strides[prev][k] = strides[k][d];
+                }
+                continue;
+            }
+        }
+
+        it->shape[it->ndim] = shape[d];
+        for (size_t k = 0; k < nops; k++) {
+            it->strides[it->ndim][k] = strides[k][d];
+        }
+        it->ndim++;
+    }
+
+    if (it->ndim == 0) {
+        it->ndim = 1;
+        it->shape[0] = 1;
+        memset(it->strides[0], 0, nops * sizeof(size_t));
+    }
+
+    iter_plan_tiles(it);
+}
+
+static void iter_decode(const array_iter_t* it, size_t pos, size_t* index, size_t* offsets) {
+    memset(offsets, 0, it->nops * sizeof(size_t));
+    for (int d = (int)it->ndim - 1; d >= 0; d--) {
+        index[d] = pos % it->shape[d];
+        pos /= it->shape[d];
+        for (size_t k = 0; k < it->nops; k++) {
+            offsets[k] += index[d] * it->strides[d][k];
+        }
+    }
+}
+
+static void iter_range_rows(const array_iter_t* it, size_t begin, size_t end,
+                            array_iter_fn fn, void* ctx) {
+    if (begin >= end) return;
+
+    size_t last = it->ndim - 1;
+    size_t index[ARRAY_ITER_MAX_DIMS];
+    size_t offsets[ARRAY_ITER_MAX_OPS];
+
+    // decode the starting position once, everything after is stride increments
+    iter_decode(it, begin, index, offsets);
+
+    size_t pos = begin;
+    while (pos < end) {
+        size_t n = it->shape[last] - index[last];
+        if (n > end - pos) n = end - pos;
+
+        fn(ctx, offsets, it->strides[last], n);
+        pos += n;
+        if (pos >= end) break;
+
+        // the run always ends on a row boundary here, so rewind the inner
+        // dimension and carry into the outer ones
+        for (size_t k = 0; k < it->nops; k++) {
+            offsets[k] -= index[last] * it->strides[last][k];
+        }
+        index[last] = 0;
+
+        for (int d = (int)last - 1; d >= 0; d--) {
+            index[d]++;
+            for (size_t k = 0; k < it->nops; k++) {
+                offsets[k] += it->strides[d][k];
+            }
+            if (index[d] < it->shape[d]) break;
+
+            for (size_t k = 0; k < it->nops; k++) {
+                offsets[k] -= it->shape[d] * it->strides[d][k];
+            }
+            index[d] = 0;
+        }
+    }
+}
+
+// partial rows at either end of the range go row by row; the full rows in
+// between are taken in bands of tile_rows (never crossing into the next outer
+// index) and each band is swept one tile_rows x tile_cols tile at a time
+static void iter_range_tiled(const array_iter_t* it, size_t begin, size_t end,
+                             array_iter_fn fn, array_iter_tile_fn tile_fn, void* ctx) {
+    size_t last = it->ndim - 1;
+    size_t row = last - 1;
+    size_t width = it->shape[last];
+    size_t height = it->shape[row];
+
+    size_t first_row = (begin + width - 1) / width;
+    size_t end_row = end / width;
+    if (first_row >= end_row) {
+        iter_range_rows(it, begin, end, fn, ctx);
+        return;
+    }
+    iter_range_rows(it, begin, first_row * width, fn, ctx);
+
+    size_t index[ARRAY_ITER_MAX_DIMS];
+    size_t offsets[ARRAY_ITER_MAX_OPS];
+    size_t tile_offsets[ARRAY_ITER_MAX_OPS];
+
+    for (size_t q = first_row; q < end_row;) {
+        size_t rows = height - q % height;
+        if (rows > it->tile_rows) rows = it->tile_rows;
+        if (rows > end_row - q) rows = end_row - q;
+
+        iter_decode(it, q * width, index, offsets);
+        for (size_t c = 0; c < width; c += it->tile_cols) {
+            size_t n = width - c < it->tile_cols ? width - c : it->tile_cols;
+            for (size_t k = 0; k < it->nops; k++) {
+                tile_offsets[k] = offsets[k] + c * it->strides[last][k];
+            }
+            if (tile_fn) {
+                tile_fn(ctx, tile_offsets, it->strides[row], it->strides[last], rows, n);
+                continue;
+            }
+            for (size_t r = 0; r < rows; r++) {
+                fn(ctx, tile_offsets, it->strides[last], n);
+                for (size_t k = 0; k < it->nops; k++) {
+                    tile_offsets[k] += it->strides[row][k];
+                }
+            }
+        }
+        q += rows;
+    }
+
+    iter_range_rows(it, end_row * width, end, fn, ctx);
+}
+
+static void iter_range(const array_iter_t* it, size_t begin, size_t end,
+                       array_iter_fn fn, array_iter_tile_fn tile_fn, void* ctx) {
+    if (end > it->size) end = it->size;
+    if (begin >= end) return;
+
+    if (it->tile_rows) {
+        iter_range_tiled(it, begin, end, fn, tile_fn, ctx);
+    } else {
+        iter_range_rows(it, begin, end, fn, ctx);
+    }
+}
+
+void array_iter_range(const array_iter_t* it, size_t begin, size_t end,
+                      array_iter_fn fn, void* ctx) {
+    iter_range(it, begin, end, fn, NULL, ctx);
+}
+
+typedef struct {
+    const array_iter_t* it;
+    array_iter_fn fn;
+    array_iter_tile_fn tile_fn;
+    char* ctx;
+    size_t ctx_size;
+} iter_parallel_t;
+
+static void iter_parallel_chunk(void* ctx, size_t begin, size_t end, size_t worker) {
+    iter_parallel_t* job = ctx;
+    iter_range(job->it, begin, end, job->fn, job->tile_fn, job->ctx + worker * job->ctx_size);
+}
+
+void array_iter_parallel(const array_iter_t* it, struct thread_pool* pool,
+                         array_iter_fn fn, void* ctx, size_t ctx_size) {
+    array_iter_parallel_tiles(it, pool, fn, NULL, ctx, ctx_size);
+}
+
+void array_iter_parallel_tiles(const array_iter_t* it, struct thread_pool* pool,
+                               array_iter_fn fn, array_iter_tile_fn tile_fn,
+                               void* ctx, size_t ctx_size) {
+    if (!pool || it->size < ARRAY_PARALLEL_MIN) {
+        iter_range(it, 0, it->size, fn, tile_fn, ctx);
+        return;
+    }
+
+    // a tiled iteration hands out whole bands of tile rows so that no tile is
+    // split between workers
+    size_t chunk = ARRAY_PARALLEL_CHUNK;
+    if (it->tile_rows) {
+        size_t band = it->tile_rows * it->shape[it->ndim - 1];
+        chunk = (chunk + band - 1) / band * band;
+    }
+
+    iter_parallel_t job = {it, fn, tile_fn, ctx, ctx_size};
+    thread_pool_parallel_for(pool, it->size, chunk, iter_parallel_chunk, &job);
+}
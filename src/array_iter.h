@@ -0,0 +1,75 @@
+#ifndef ARRAY_ITER_H
+#define ARRAY_ITER_H
+
+#include <stddef.h>
+
+#define ARRAY_ITER_MAX_DIMS 16
+#define ARRAY_ITER_MAX_OPS 32
+
+// operations smaller than this many elements stay on the calling thread
+#define ARRAY_PARALLEL_MIN (1u << 16)
+// elements per scheduling chunk: 64KB per float operand, well inside L2
+#define ARRAY_PARALLEL_CHUNK (1u << 14)
+
+// items of n elements per scheduling chunk of a batch: about
+// ARRAY_PARALLEL_CHUNK elements, and at least one item
+static inline size_t array_batch_chunk(size_t n) {
+    return n < ARRAY_PARALLEL_CHUNK ? ARRAY_PARALLEL_CHUNK / (n ? n : 1) : 1;
+}
+
+struct thread_pool;
+
+// walks an N-d index space shared by several operands that each have their own
+// strides (in elements). at init the dimensions are reordered so the operands'
+// smallest strides are innermost and contiguous dimensions are collapsed, so
+// the inner run is as long as possible; outer dimensions are advanced by adding
+// strides instead of decoding a flat index on every element.
+//
+// when the operands disagree about the inner dimension (a + transpose(b)) no
+// order streams all of them, so the two innermost dimensions are visited in
+// tiles that keep the strided operand's cache lines in L1 until they are used up
+typedef struct {
+    size_t ndim;
+    size_t nops;
+    size_t size;
+    size_t shape[ARRAY_ITER_MAX_DIMS];
+    size_t strides[ARRAY_ITER_MAX_DIMS][ARRAY_ITER_MAX_OPS];
+    // 0 when the iteration is not tiled
+    size_t tile_rows;
+    size_t tile_cols;
+} array_iter_t;
+
+// called once per inner run: offsets[k] is where operand k starts, inner_strides[k]
+// is its step along the run and n is the run length
+typedef void (*array_iter_fn)(void* ctx, const size_t* offsets, const size_t* inner_strides, size_t n);
+
+// called once per tile of a tiled iteration: offsets[k] is where operand k's
+// tile starts, row_strides[k] and col_strides[k] are its steps down and along
+// the tile, which is rows x cols
+typedef void (*array_iter_tile_fn)(void* ctx, const size_t* offsets, const size_t* row_strides,
+                                   const size_t* col_strides, size_t rows, size_t cols);
+
+// strides[k] points at operand k's ndim strides over the given shape
+void array_iter_init(array_iter_t* it, const size_t* shape, size_t ndim,
+                     size_t nops, const size_t* const* strides);
+
+// visits the flat positions [begin, end) of the iteration space, each exactly
+// once. rows are visited in order; a tiled iteration walks the full rows of
+// the range tile by tile instead
+void array_iter_range(const array_iter_t* it, size_t begin, size_t end,
+                      array_iter_fn fn, void* ctx);
+
+// visits the whole space, split across the pool in ARRAY_PARALLEL_CHUNK chunks
+// when it is large enough. worker w gets ctx + w * ctx_size, so a ctx_size of 0
+// shares one context and a non-zero size gives each worker its own scratch
+void array_iter_parallel(const array_iter_t* it, struct thread_pool* pool,
+                         array_iter_fn fn, void* ctx, size_t ctx_size);
+
+// as array_iter_parallel, but a tiled iteration hands each tile to tile_fn
+// in one call; the partial rows a range starts or ends with still go to fn.
+// an untiled iteration only calls fn
+void array_iter_parallel_tiles(const array_iter_t* it, struct thread_pool* pool,
+                               array_iter_fn fn, array_iter_tile_fn tile_fn,
+                               void* ctx, size_t ctx_size);
+
+#endif
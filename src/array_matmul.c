@@ -0,0 +1,343 @@
+#include "array.h"
+#include "cpu_cache.h"
+#include "simd_stats_record.h"
+#include "thread_pool.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+// largest gemm_mr x gemm_nr tile of any backend, for the edge scratch tile
+#define MATMUL_MAX_TILE (12 * 32)
+
+// strided 2-D operand: element (i, j) is at p[i * rs + j * cs]
+typedef struct {
+    const float* p;
+    size_t rs;
+    size_t cs;
+} matmul_operand_t;
+
+typedef struct {
+    const simd_dispatch_t* dispatch;
+    size_t m, n, k;
+    matmul_operand_t a;
+    matmul_operand_t b;
+    float* c;
+    size_t rsc, csc;
+
+    // current kc x nc block of b, packed into nr-wide micro-panels
+    size_t jc, nc, pc, kc;
+    const float* b_packed;
+    // per-worker mc x kc packing buffer for a
+    float* a_packed;
+    size_t mc;
+    size_t a_stride;
+} matmul_job_t;
+
+// cache blocking after Goto and van de Geijn: one kc x nr micro-panel of b
+// stays in L1 while the micro-kernel sweeps an mc x kc block of a held in
+// L2, and the kc x nc block of b is reused from the last-level cache by
+// every block of a
+static void matmul_blocking(const simd_dispatch_t* d, size_t* mc, size_t* kc, size_t* nc) {
+    const cpu_cache_info_t* cache = cpu_cache_info();
+    size_t mr = d->gemm_mr, nr = d->gemm_nr;
+
+    *kc = cache->l1d / 2 / (nr * sizeof(float));
+    if (*kc < 64) *kc = 64;
+    if (*kc > 512) *kc = 512;
+
+    *mc = cache->l2 / 2 / (*kc * sizeof(float)) / mr * mr;
+    if (*mc < mr) *mc = mr;
+
+    *nc = cache->llc / 2 / (*kc * sizeof(float)) / nr * nr;
+    if (*nc < nr) *nc = nr;
+    if (*nc > 8192) *nc = 8192 / nr * nr;
+}
+
+// rows [i0, i0 + m) and columns [p0, p0 + k) of a as mr-row micro-panels:
+// column p of a panel is mr consecutive floats, and rows past m are zero
+static void matmul_pack_a(float* dst, matmul_operand_t a, size_t i0, size_t m,
+                          size_t p0, size_t k, size_t mr) {
+    for (size_t i = 0; i < m; i += mr) {
+        size_t rows = m - i < mr ? m - i : mr;
+        const float* src = a.p + (i0 + i) * a.rs + p0 * a.cs;
+        if (a.rs == 1) {
+            // a transposed view: each column of the panel is contiguous
+            for (size_t p = 0; p < k; p++) {
+                memcpy(dst + p * mr, src + p * a.cs, rows * sizeof(float));
+                for (size_t r = rows; r < mr; r++) dst[p * mr + r] = 0.0f;
+            }
+        } else {
+            for (size_t r = 0; r < rows; r++) {
+                const float* row = src + r * a.rs;
+                for (size_t p = 0; p < k; p++) dst[p * mr + r] = row[p * a.cs];
+            }
+            for (size_t r = rows; r < mr; r++) {
+                for (size_t p = 0; p < k; p++) dst[p * mr + r] = 0.0f;
+            }
+        }
+        dst += mr * k;
+    }
+}
+
+// rows [p0, p0 + k) and columns [j0, j0 + n) of b as nr-column micro-panels:
+// row p of a panel is nr consecutive floats, and columns past n are zero
+static void matmul_pack_b(float* dst, matmul_operand_t b, size_t p0, size_t k,
+                          size_t j0, size_t n, size_t nr) {
+    size_t cols = n < nr ? n : nr;
+    const float* src = b.p + p0 * b.rs + j0 * b.cs;
+    if (b.cs == 1) {
+        for (size_t p = 0; p < k; p++) {
+            memcpy(dst + p * nr, src + p * b.rs, cols * sizeof(float));
+            for (size_t j = cols; j < nr; j++) dst[p * nr + j] = 0.0f;
+        }
+    } else {
+        // a transposed view: each column of the panel is contiguous
+        for (size_t j = 0; j < cols; j++) {
+            const float* col = src + j * b.cs;
+            for (size_t p = 0; p < k; p++) dst[p * nr + j] = col[p * b.rs];
+        }
+        for (size_t j = cols; j < nr; j++) {
+            for (size_t p = 0; p < k; p++) dst[p * nr + j] = 0.0f;
+        }
+    }
+}
+
+typedef struct {
+    const matmul_job_t* job;
+    float* dst;
+} matmul_pack_b_job_t;
+
+static void matmul_pack_b_chunk(void* ctx, size_t begin, size_t end, size_t worker) {
+    (void)worker;
+    const matmul_pack_b_job_t* pj = ctx;
+    const matmul_job_t* job = pj->job;
+    size_t nr = job->dispatch->gemm_nr;
+    for (size_t panel = begin; panel < end; panel++) {
+        size_t j = panel * nr;
+        matmul_pack_b(pj->dst + panel * nr * job->kc, job->b, job->pc, job->kc,
+                      job->jc + j, job->nc - j, nr);
+    }
+}
+
+// one mr x nr tile of c. full tiles of a row-major c are written in place;
+// edge tiles and other layouts go through a scratch tile
+static void matmul_tile(const matmul_job_t* job, const float* a_panel, const float* b_panel,
+                        size_t i, size_t j, size_t rows, size_t cols) {
+    size_t mr = job->dispatch->gemm_mr, nr = job->dispatch->gemm_nr;
+    int accumulate = job->pc > 0;
+    float* c = job->c + i * job->rsc + j * job->csc;
+
+    if (rows == mr && cols == nr && job->csc == 1) {
+        job->dispatch->gemm_kernel(job->kc, a_panel, b_panel, c, job->rsc, accumulate);
+        return;
+    }
+
+    float tile[MATMUL_MAX_TILE] __attribute__((aligned(ARRAY_ALIGNMENT)));
+    job->dispatch->gemm_kernel(job->kc, a_panel, b_panel, tile, nr, 0);
+    for (size_t r = 0; r < rows; r++) {
+        float* row = c + r * job->rsc;
+        for (size_t s = 0; s < cols; s++) {
+            float v = tile[r * nr + s];
+            row[s * job->csc] = accumulate ? row[s * job->csc] + v : v;
+        }
+    }
+}
+
+// rows [begin, end) of c for the current kc x nc block: pack that slice of
+// a once, then run the micro-kernel over every tile against the packed b
+static void matmul_rows(void* ctx, size_t begin, size_t end, size_t worker) {
+    const matmul_job_t* job = ctx;
+    size_t mr = job->dispatch->gemm_mr, nr = job->dispatch->gemm_nr;
+    float* a_packed = job->a_packed + worker * job->a_stride;
+
+    for (size_t ic = begin; ic < end; ic += job->mc) {
+        size_t mc = end - ic < job->mc ? end - ic : job->mc;
+        matmul_pack_a(a_packed, job->a, ic, mc, job->pc, job->kc, mr);
+
+        for (size_t jr = 0; jr < job->nc; jr += nr) {
+            size_t cols = job->nc - jr < nr ? job->nc - jr : nr;
+            const float* b_panel = job->b_packed + jr * job->kc;
+            for (size_t ir = 0; ir < mc; ir += mr) {
+                size_t rows = mc - ir < mr ? mc - ir : mr;
+                matmul_tile(job, a_packed + ir * job->kc, b_panel, ic + ir, job->jc + jr, rows, cols);
+            }
+        }
+    }
+}
+
+static void matmul_zero(float* c, size_t m, size_t n, size_t rsc, size_t csc) {
+    for (size_t i = 0; i < m; i++) {
+        for (size_t j = 0; j < n; j++) c[i * rsc + j * csc] = 0.0f;
+    }
+}
+
+static void matmul_f32(const simd_dispatch_t* d, size_t m, size_t n, size_t k,
+                       matmul_operand_t a, matmul_operand_t b,
+                       float* c, size_t rsc, size_t csc) {
+    if (m == 0 || n == 0) return;
+    if (k == 0) {
+        matmul_zero(c, m, n, rsc, csc);
+        return;
+    }
+
+    size_t mr = d->gemm_mr, nr = d->gemm_nr;
+    size_t mc, kc, nc;
+    matmul_blocking(d, &mc, &kc, &nc);
+    if (kc > k) kc = k;
+    if (nc > n) nc = (n + nr - 1) / nr * nr;
+
+    // rows are split across the workers a block of a at a time; a short c
+    // gets smaller blocks so that every worker still has rows to do
+    size_t nthreads = thread_pool_size(d->pool);
+    size_t share = (m + nthreads - 1) / nthreads;
+    share = (share + mr - 1) / mr * mr;
+    if (mc > share) mc = share;
+
+    // every worker's a buffer starts on a cache line, like the b buffer
+    size_t line = ARRAY_ALIGNMENT / sizeof(float);
+    size_t a_stride = ((mc + mr - 1) / mr * mr * kc + line - 1) / line * line;
+    size_t b_size = ((nc + nr - 1) / nr * nr * kc + line - 1) / line * line;
+    float* a_packed = aligned_alloc(ARRAY_ALIGNMENT, nthreads * a_stride * sizeof(float));
+    float* b_packed = aligned_alloc(ARRAY_ALIGNMENT, b_size * sizeof(float));
+
+    matmul_job_t job = {
+        .dispatch = d, .m = m, .n = n, .k = k, .a = a, .b = b,
+        .c = c, .rsc = rsc, .csc = csc,
+        .b_packed = b_packed, .a_packed = a_packed, .mc = mc, .a_stride = a_stride
+    };
+
+    for (size_t jc = 0; jc < n; jc += nc) {
+        job.jc = jc;
+        job.nc = n - jc < nc ? n - jc : nc;
+        for (size_t pc = 0; pc < k; pc += kc) {
+            job.pc = pc;
+            job.kc = k - pc < kc ? k - pc : kc;
+
+            matmul_pack_b_job_t pack = {&job, b_packed};
+            size_t panels = (job.nc + nr - 1) / nr;
+            thread_pool_parallel_for(d->pool, panels, (panels + nthreads - 1) / nthreads,
+                                     matmul_pack_b_chunk, &pack);
+            thread_pool_parallel_for(d->pool, m, mc, matmul_rows, &job);
+        }
+    }
+
+    free(a_packed);
+    free(b_packed);
+}
+
+// float64 operands get a plain row-times-panel loop: c's row is built in a
+// double accumulator from b's rows, which the compiler vectorizes when b is
+// contiguous along its columns
+static void matmul_f64(size_t m, size_t n, size_t k,
+                       const double* a, size_t rsa, size_t csa,
+                       const double* b, size_t rsb, size_t csb,
+                       double* c, size_t rsc, size_t csc) {
+    double* row = malloc((n ? n : 1) * sizeof(double));
+    for (size_t i = 0; i < m; i++) {
+        for (size_t j = 0; j < n; j++) row[j] = 0.0;
+        for (size_t p = 0; p < k; p++) {
+            double s = a[i * rsa + p * csa];
+            const double* brow = b + p * rsb;
+            if (csb == 1) {
+                for (size_t j = 0; j < n; j++) row[j] += s * brow[j];
+            } else {
+                for (size_t j = 0; j < n; j++) row[j] += s * brow[j * csb];
+            }
+        }
+        for (size_t j = 0; j < n; j++) c[i * rsc + j * csc] = row[j];
+    }
+    free(row);
+}
+
+// operands in the compute type are used as they are; anything else is
+// converted into a contiguous temporary first
+static array_t* matmul_operand(array_t* arr, array_dtype_t dtype, simd_dispatch_t* dispatch) {
+    return arr->dtype == dtype ? arr : array_astype(arr, dtype, dispatch);
+}
+
+void array_matmul_batched(array_t* result, array_t* a, array_t* b, simd_dispatch_t* dispatch) {
+    assert(a->ndim >= 2 && b->ndim >= 2);
+    size_t ndim = a->ndim > b->ndim ? a->ndim : b->ndim;
+    assert(result->ndim == ndim);
+
+    size_t m = a->shape[a->ndim - 2], k = a->shape[a->ndim - 1];
+    size_t n = b->shape[b->ndim - 1];
+    assert(b->shape[b->ndim - 2] == k);
+    assert(result->shape[ndim - 2] == m && result->shape[ndim - 1] == n);
+
+    // leading dimensions broadcast against each other as in the element-wise
+    // operations; a broadcast batch dimension is read with stride 0
+    size_t nbatch = ndim - 2;
+    size_t a_lead = a->ndim - 2, b_lead = b->ndim - 2;
+    size_t batches = 1;
+    for (size_t d = 0; d < nbatch; d++) {
+        size_t extent = result->shape[d];
+        assert(d + a_lead < nbatch || a->shape[d + a_lead - nbatch] == extent ||
+               a->shape[d + a_lead - nbatch] == 1);
+        assert(d + b_lead < nbatch || b->shape[d + b_lead - nbatch] == extent ||
+               b->shape[d + b_lead - nbatch] == 1);
+        batches *= extent;
+    }
+
+    SIMD_STATS_BEGIN(stats, dispatch->stats, SIMD_STATS_MATMUL);
+    array_dtype_t compute = ARRAY_FLOAT32;
+    if (a->dtype == ARRAY_FLOAT64 || b->dtype == ARRAY_FLOAT64 || result->dtype == ARRAY_FLOAT64) {
+        compute = ARRAY_FLOAT64;
+    }
+    array_t* ta = matmul_operand(a, compute, dispatch);
+    array_t* tb = matmul_operand(b, compute, dispatch);
+    array_t* tc = result->dtype == compute ? result : array_create_typed(result->shape, ndim, compute);
+
+    size_t* index = calloc(nbatch ? nbatch : 1, sizeof(size_t));
+    for (size_t batch = 0; batch < batches; batch++) {
+        size_t off_a = 0, off_b = 0, off_c = 0;
+        for (size_t d = 0; d < nbatch; d++) {
+            off_c += index[d] * tc->strides[d];
+            if (d + a_lead >= nbatch && ta->shape[d + a_lead - nbatch] > 1) {
+                off_a += index[d] * ta->strides[d + a_lead - nbatch];
+            }
+            if (d + b_lead >= nbatch && tb->shape[d + b_lead - nbatch] > 1) {
+                off_b += index[d] * tb->strides[d + b_lead - nbatch];
+            }
+        }
+
+        size_t rsa = ta->strides[a->ndim - 2], csa = ta->strides[a->ndim - 1];
+        size_t rsb = tb->strides[b->ndim - 2], csb = tb->strides[b->ndim - 1];
+        size_t rsc = tc->strides[ndim - 2], csc = tc->strides[ndim - 1];
+        // the float64 product is a plain loop
+        if (compute == ARRAY_FLOAT64) {
+            SIMD_STATS_COUNT(dispatch->stats, SIMD_STATS_MATMUL, fallback);
+            matmul_f64(m, n, k, (const double*)ta->raw + off_a, rsa, csa,
+                       (const double*)tb->raw + off_b, rsb, csb,
+                       (double*)tc->raw + off_c, rsc, csc);
+        } else {
+            SIMD_STATS_COUNT(dispatch->stats, SIMD_STATS_MATMUL, fast);
+            matmul_operand_t oa = {ta->data + off_a, rsa, csa};
+            matmul_operand_t ob = {tb->data + off_b, rsb, csb};
+            matmul_f32(dispatch, m, n, k, oa, ob, tc->data + off_c, rsc, csc);
+        }
+
+        for (size_t d = nbatch; d-- > 0;) {
+            if (++index[d] < result->shape[d]) break;
+            index[d] = 0;
+        }
+    }
+    free(index);
+
+    if (tc != result) {
+        expr_t* expr = expr_from_array(tc);
+        expr_eval(expr, result, dispatch);
+        expr_free(expr);
+        array_free(tc);
+    }
+    if (ta != a) array_free(ta);
+    if (tb != b) array_free(tb);
+    SIMD_STATS_END(stats, result->size, a->size * array_dtype_size(a->dtype) +
+                                        b->size * array_dtype_size(b->dtype) +
+                                        result->size * array_dtype_size(result->dtype));
+}
+
+void array_matmul(array_t* result, array_t* a, array_t* b, simd_dispatch_t* dispatch) {
+    assert(a->ndim == 2 && b->ndim == 2 && result->ndim == 2);
+    array_matmul_batched(result, a, b, dispatch);
+}
@@ -0,0 +1,95 @@
+#include "array.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+// idle buffers are kept in one free list per distinct byte size; the link to
+// the next buffer is stored in the first bytes of the buffer itself
+#define ARRAY_POOL_CLASSES 64
+
+typedef struct {
+    size_t bytes;
+    void* head;
+} pool_class_t;
+
+struct array_pool {
+    pthread_mutex_t lock;
+    size_t max_bytes;
+    size_t cached_bytes;
+    size_t nclasses;
+    pool_class_t classes[ARRAY_POOL_CLASSES];
+};
+
+array_pool_t* array_pool_create(size_t max_bytes) {
+    array_pool_t* pool = calloc(1, sizeof(array_pool_t));
+    pthread_mutex_init(&pool->lock, NULL);
+    pool->max_bytes = max_bytes;
+    return pool;
+}
+
+void array_pool_free(array_pool_t* pool) {
+    if (!pool) return;
+
+    for (size_t c = 0; c < pool->nclasses; c++) {
+        void* buf = pool->classes[c].head;
+        while (buf) {
+            void* next = *(void**)buf;
+            free(buf);
+            buf = next;
+        }
+    }
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+// aligned_alloc wants a multiple of the alignment, and the free list link
+// needs room in the buffer
+static size_t pool_bytes(size_t bytes) {
+    if (bytes == 0) bytes = 1;
+    return (bytes + ARRAY_ALIGNMENT - 1) & ~(size_t)(ARRAY_ALIGNMENT - 1);
+}
+
+static pool_class_t* pool_find_class(array_pool_t* pool, size_t bytes) {
+    for (size_t c = 0; c < pool->nclasses; c++) {
+        if (pool->classes[c].bytes == bytes) return &pool->classes[c];
+    }
+    return NULL;
+}
+
+void* array_pool_acquire(array_pool_t* pool, size_t bytes) {
+    bytes = pool_bytes(bytes);
+
+    pthread_mutex_lock(&pool->lock);
+    pool_class_t* cls = pool_find_class(pool, bytes);
+    if (cls && cls->head) {
+        void* buf = cls->head;
+        cls->head = *(void**)buf;
+        pool->cached_bytes -= bytes;
+        pthread_mutex_unlock(&pool->lock);
+        return buf;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return aligned_alloc(ARRAY_ALIGNMENT, bytes);
+}
+
+void array_pool_release(array_pool_t* pool, void* ptr, size_t bytes) {
+    if (!ptr) return;
+    bytes = pool_bytes(bytes);
+
+    pthread_mutex_lock(&pool->lock);
+    pool_class_t* cls = pool_find_class(pool, bytes);
+    if (!cls && pool->nclasses < ARRAY_POOL_CLASSES) {
+        cls = &pool->classes[pool->nclasses++];
+        cls->bytes = bytes;
+        cls->head = NULL;
+    }
+    if (cls && pool->cached_bytes + bytes <= pool->max_bytes) {
+        *(void**)ptr = cls->head;
+        cls->head = ptr;
+        pool->cached_bytes += bytes;
+        ptr = NULL;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    free(ptr);
+}
@@ -0,0 +1,439 @@
+#include "array.h"
+#include "array_iter.h"
+#include "simd_stats_record.h"
+#include "thread_pool.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+// contiguous runs are handed to the kernels in pieces of at most this many
+// elements; strided runs and short contiguous runs are gathered up to the
+// same size first, so a kernel call always has enough work to fill its
+// accumulators
+#define REDUCE_BLOCK 2048
+#define REDUCE_MIN_RUN 64
+
+typedef enum {
+    REDUCE_SUM,
+    REDUCE_SUM_KAHAN,
+    REDUCE_MAX,
+    REDUCE_MIN,
+    REDUCE_DOT
+} reduce_kind_t;
+
+typedef struct {
+    reduce_kind_t kind;
+    simd_reduce_n_func reduce_n;
+    simd_kahan_n_func kahan_n;
+    simd_dot_n_func dot_n;
+    const float* a;
+    const float* b;
+    const array_iter_t* it;
+    size_t chunk;
+    float* partials;
+    float* comps;
+} reduce_job_t;
+
+// one chunk's running value. block results are folded in as they come, and
+// the gather buffers collect elements that cannot go to a kernel directly
+typedef struct {
+    const reduce_job_t* job;
+    float value;
+    float comp;
+    size_t buffered;
+    float a_buf[REDUCE_BLOCK];
+    float b_buf[REDUCE_BLOCK];
+} reduce_acc_t;
+
+// compensated summation step: *sum += x, with the lost low-order bits kept
+// in *comp (the true total is *sum - *comp)
+static void reduce_kahan_add(float* sum, float* comp, float x) {
+    float y = x - *comp;
+    float t = *sum + y;
+    *comp = (t - *sum) - y;
+    *sum = t;
+}
+
+static float reduce_identity(reduce_kind_t kind) {
+    switch (kind) {
+        case REDUCE_MAX: return -INFINITY;
+        case REDUCE_MIN: return INFINITY;
+        default: return 0.0f;
+    }
+}
+
+static void reduce_fold(reduce_acc_t* acc, float x) {
+    switch (acc->job->kind) {
+        case REDUCE_MAX: if (x > acc->value) acc->value = x; break;
+        case REDUCE_MIN: if (x < acc->value) acc->value = x; break;
+        default: acc->value += x; break;
+    }
+}
+
+static void reduce_block(reduce_acc_t* acc, const float* a, const float* b, size_t n) {
+    const reduce_job_t* job = acc->job;
+    if (job->kind == REDUCE_SUM_KAHAN) {
+        job->kahan_n(a, n, &acc->value, &acc->comp);
+    } else {
+        reduce_fold(acc, job->kind == REDUCE_DOT ? job->dot_n(a, b, n) : job->reduce_n(a, n));
+    }
+}
+
+static void reduce_flush(reduce_acc_t* acc) {
+    if (acc->buffered == 0) return;
+    reduce_block(acc, acc->a_buf, acc->b_buf, acc->buffered);
+    acc->buffered = 0;
+}
+
+static void reduce_inner(void* ctx, const size_t* offsets, const size_t* inner_strides, size_t n) {
+    reduce_acc_t* acc = ctx;
+    const reduce_job_t* job = acc->job;
+    bool dot = job->kind == REDUCE_DOT;
+    const float* a = job->a + offsets[0];
+    const float* b = dot ? job->b + offsets[1] : NULL;
+    size_t sa = inner_strides[0];
+    size_t sb = dot ? inner_strides[1] : 1;
+    
+    if (sa == 1 && sb == 1 && n >= REDUCE_MIN_RUN) {
+        for (size_t j = 0; j < n; j += REDUCE_BLOCK) {
+            size_t m = n - j < REDUCE_BLOCK ? n - j : REDUCE_BLOCK;
+            reduce_block(acc, a + j, dot ? b + j : NULL, m);
+        }
+        return;
+    }
+    
+    for (size_t i = 0; i < n; i++) {
+        acc->a_buf[acc->buffered] = a[i * sa];
+        if (dot) acc->b_buf[acc->buffered] = b[i * sb];
+        if (++acc->buffered == REDUCE_BLOCK) reduce_flush(acc);
+    }
+}
+
+// one partial per fixed chunk, however many chunks [begin, end) spans
+static void reduce_chunk(void* ctx, size_t begin, size_t end, size_t worker) {
+    const reduce_job_t* job = ctx;
+    (void)worker;
+    
+    for (size_t c = begin / job->chunk; c * job->chunk < end; c++) {
+        size_t chunk_end = (c + 1) * job->chunk < end ? (c + 1) * job->chunk : end;
+        reduce_acc_t acc;
+        acc.job = job;
+        acc.value = reduce_identity(job->kind);
+        acc.comp = 0.0f;
+        acc.buffered = 0;
+        
+        array_iter_range(job->it, c * job->chunk, chunk_end, reduce_inner, &acc);
+        reduce_flush(&acc);
+        
+        job->partials[c] = acc.value;
+        job->comps[c] = acc.comp;
+    }
+}
+
+// arrays in other formats than float32 are reduced by the expression
+// evaluator, which converts them block by block and accumulates in float64
+// when they are float64. it sums pairwise only, so the Kahan mode falls back
+// to the pairwise sum there
+static float reduce_full_expr(reduce_kind_t kind, array_t* a, array_t* b, simd_dispatch_t* dispatch) {
+    expr_t* operand = b ? expr_mul(expr_from_array(a), expr_from_array(b)) : expr_from_array(a);
+    expr_t* expr = expr_reduce(operand, kind == REDUCE_MAX ? ARRAY_REDUCE_MAX :
+                                        kind == REDUCE_MIN ? ARRAY_REDUCE_MIN : ARRAY_REDUCE_SUM);
+    float value = expr_eval_scalar(expr, dispatch);
+    expr_free(expr);
+    return value;
+}
+
+// the iteration space is always cut into the same fixed chunks and their
+// partials are combined in a fixed order, so the result does not depend on
+// the number of threads or on which worker ran which chunk
+static float reduce_full_f32(reduce_kind_t kind, array_t* a, array_t* b, simd_dispatch_t* dispatch) {
+    size_t b_strides[ARRAY_ITER_MAX_DIMS];
+    const size_t* strides[2] = {a->strides, b_strides};
+    
+    assert(a->ndim <= ARRAY_ITER_MAX_DIMS);
+    if (b) {
+        bool ok = array_broadcast_strides(b, a->shape, a->ndim, b_strides);
+        assert(ok);
+        (void)ok;
+    }
+    
+    array_iter_t it;
+    array_iter_init(&it, a->shape, a->ndim, b ? 2 : 1, strides);
+    if (it.size == 0) return reduce_identity(kind);
+    
+    size_t chunk = ARRAY_PARALLEL_CHUNK;
+    size_t nchunks = (it.size + chunk - 1) / chunk;
+    float* partials = malloc(2 * nchunks * sizeof(float));
+    
+    reduce_job_t job;
+    job.kind = kind;
+    job.reduce_n = kind == REDUCE_SUM ? dispatch->sum_n :
+                   kind == REDUCE_MAX ? dispatch->max_n :
+                   kind == REDUCE_MIN ? dispatch->min_n : NULL;
+    job.kahan_n = dispatch->sum_kahan_n;
+    job.dot_n = dispatch->dot_n;
+    job.a = a->data;
+    job.b = b ? b->data : NULL;
+    job.it = &it;
+    job.chunk = chunk;
+    job.partials = partials;
+    job.comps = partials + nchunks;
+    
+    if (dispatch->pool && it.size >= ARRAY_PARALLEL_MIN) {
+        thread_pool_parallel_for(dispatch->pool, it.size, chunk, reduce_chunk, &job);
+    } else {
+        reduce_chunk(&job, 0, it.size, 0);
+    }
+    
+    float result;
+    if (kind == REDUCE_SUM_KAHAN) {
+        float comp = 0.0f;
+        result = 0.0f;
+        for (size_t c = 0; c < nchunks; c++) {
+            reduce_kahan_add(&result, &comp, partials[c]);
+            reduce_kahan_add(&result, &comp, -job.comps[c]);
+        }
+        result -= comp;
+    } else if (kind == REDUCE_MAX || kind == REDUCE_MIN) {
+        result = partials[0];
+        for (size_t c = 1; c < nchunks; c++) {
+            float x = partials[c];
+            if (kind == REDUCE_MAX ? x > result : x < result) result = x;
+        }
+    } else {
+        // pairwise over the chunk partials: the rounding error grows with
+        // log(nchunks) instead of nchunks
+        for (size_t step = 1; step < nchunks; step *= 2) {
+            for (size_t c = 0; c + step < nchunks; c += 2 * step) {
+                partials[c] += partials[c + step];
+            }
+        }
+        result = partials[0];
+    }
+    
+    free(partials);
+    return result;
+}
+
+static float reduce_full(reduce_kind_t kind, array_t* a, array_t* b, simd_dispatch_t* dispatch) {
+    SIMD_STATS_BEGIN(stats, dispatch->stats, SIMD_STATS_REDUCE);
+    float value;
+    if (a->dtype != ARRAY_FLOAT32 || (b && b->dtype != ARRAY_FLOAT32)) {
+        SIMD_STATS_COUNT(dispatch->stats, SIMD_STATS_REDUCE, interpreted);
+        value = reduce_full_expr(kind, a, b, dispatch);
+    } else {
+        value = reduce_full_f32(kind, a, b, dispatch);
+    }
+    SIMD_STATS_END(stats, a->size, a->size * array_dtype_size(a->dtype) +
+                                   (b ? b->size * array_dtype_size(b->dtype) : 0));
+    return value;
+}
+
+float array_sum(array_t* arr, simd_dispatch_t* dispatch) {
+    return reduce_full(REDUCE_SUM, arr, NULL, dispatch);
+}
+
+float array_sum_mode(array_t* arr, array_sum_mode_t mode, simd_dispatch_t* dispatch) {
+    return reduce_full(mode == ARRAY_SUM_KAHAN ? REDUCE_SUM_KAHAN : REDUCE_SUM, arr, NULL, dispatch);
+}
+
+float array_mean(array_t* arr, simd_dispatch_t* dispatch) {
+    return array_sum(arr, dispatch) / (float)arr->size;
+}
+
+float array_max(array_t* arr, simd_dispatch_t* dispatch) {
+    return reduce_full(REDUCE_MAX, arr, NULL, dispatch);
+}
+
+float array_min(array_t* arr, simd_dispatch_t* dispatch) {
+    return reduce_full(REDUCE_MIN, arr, NULL, dispatch);
+}
+
+float array_dot(array_t* a, array_t* b, simd_dispatch_t* dispatch) {
+    return reduce_full(REDUCE_DOT, a, b, dispatch);
+}
+
+float array_norm2(array_t* arr, simd_dispatch_t* dispatch) {
+    return sqrtf(reduce_full(REDUCE_DOT, arr, arr, dispatch));
+}
+
+typedef struct {
+    array_reduce_op_t op;
+    simd_dispatch_t* dispatch;
+    float* out;
+    const float* a;
+    float a_buf[REDUCE_BLOCK];
+} reduce_axis_t;
+
+// one inner run of an axis reduction. when the run lies along a reduced axis
+// (out stride 0) it collapses into one kernel call; otherwise each element
+// of the run accumulates into its own output, which for a contiguous run is
+// an element-wise kernel over the output row
+static void reduce_axis_inner(void* ctx, const size_t* offsets, const size_t* inner_strides, size_t n) {
+    reduce_axis_t* job = ctx;
+    simd_dispatch_t* dispatch = job->dispatch;
+    float* out = job->out + offsets[0];
+    const float* a = job->a + offsets[1];
+    size_t so = inner_strides[0], sa = inner_strides[1];
+    bool is_sum = job->op == ARRAY_REDUCE_SUM || job->op == ARRAY_REDUCE_MEAN;
+    
+    if (so == 0) {
+        for (size_t j = 0; j < n; j += REDUCE_BLOCK) {
+            size_t m = n - j < REDUCE_BLOCK ? n - j : REDUCE_BLOCK;
+            const float* pa = &a[j * sa];
+            if (sa != 1) {
+                for (size_t i = 0; i < m; i++) job->a_buf[i] = pa[i * sa];
+                pa = job->a_buf;
+            }
+            
+            if (is_sum) {
+                *out += dispatch->sum_n(pa, m);
+            } else if (job->op == ARRAY_REDUCE_MAX) {
+                float x = dispatch->max_n(pa, m);
+                if (x > *out) *out = x;
+            } else {
+                float x = dispatch->min_n(pa, m);
+                if (x < *out) *out = x;
+            }
+        }
+        return;
+    }
+    
+    if (is_sum && so == 1 && sa == 1) {
+        dispatch->add_n(out, out, a, n);
+    } else if (is_sum) {
+        for (size_t i = 0; i < n; i++) out[i * so] += a[i * sa];
+    } else if (job->op == ARRAY_REDUCE_MAX) {
+        for (size_t i = 0; i < n; i++) {
+            float x = a[i * sa];
+            if (x > out[i * so]) out[i * so] = x;
+        }
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            float x = a[i * sa];
+            if (x < out[i * so]) out[i * so] = x;
+        }
+    }
+}
+
+typedef struct {
+    float* data;
+    float scale;
+} reduce_scale_t;
+
+static void reduce_scale_inner(void* ctx, const size_t* offsets, const size_t* inner_strides, size_t n) {
+    reduce_scale_t* op = ctx;
+    float* out = op->data + offsets[0];
+    for (size_t i = 0; i < n; i++) out[i * inner_strides[0]] *= op->scale;
+}
+
+// result_strides are the output's strides over arr's shape, 0 on every
+// reduced axis
+static void reduce_into(array_t* result, const size_t* result_strides, array_t* arr,
+                        array_reduce_op_t op, simd_dispatch_t* dispatch) {
+    SIMD_STATS_BEGIN(stats, dispatch->stats, SIMD_STATS_REDUCE);
+    array_fill(result, op == ARRAY_REDUCE_MAX ? -INFINITY :
+                       op == ARRAY_REDUCE_MIN ? INFINITY : 0.0f);
+    
+    const size_t* strides[2] = {result_strides, arr->strides};
+    array_iter_t it;
+    array_iter_init(&it, arr->shape, arr->ndim, 2, strides);
+    
+    // several input elements land on the same output, so this stays on the
+    // calling thread rather than splitting the input across the pool
+    reduce_axis_t* job = malloc(sizeof(reduce_axis_t));
+    job->op = op;
+    job->dispatch = dispatch;
+    job->out = result->data;
+    job->a = arr->data;
+    array_iter_range(&it, 0, it.size, reduce_axis_inner, job);
+    free(job);
+    
+    if (op == ARRAY_REDUCE_MEAN && result->size > 0) {
+        const size_t* own[1] = {result->strides};
+        array_iter_t out_it;
+        array_iter_init(&out_it, result->shape, result->ndim, 1, own);
+        
+        reduce_scale_t scale = {result->data, (float)result->size / (float)arr->size};
+        array_iter_range(&out_it, 0, out_it.size, reduce_scale_inner, &scale);
+    }
+    SIMD_STATS_END(stats, arr->size, (arr->size + result->size) * sizeof(float));
+}
+
+void array_reduce_axis(array_t* result, array_t* arr, size_t axis, array_reduce_op_t op,
+                       simd_dispatch_t* dispatch) {
+    size_t result_strides[ARRAY_ITER_MAX_DIMS];
+    bool keepdims = result->ndim == arr->ndim;
+    
+    if (arr->dtype != ARRAY_FLOAT32 || result->dtype != ARRAY_FLOAT32) {
+        SIMD_STATS_BEGIN(stats, dispatch->stats, SIMD_STATS_REDUCE);
+        SIMD_STATS_COUNT(dispatch->stats, SIMD_STATS_REDUCE, interpreted);
+        expr_t* expr = expr_reduce_axis(expr_from_array(arr), axis, op);
+        expr_eval(expr, result, dispatch);
+        expr_free(expr);
+        SIMD_STATS_END(stats, arr->size, arr->size * array_dtype_size(arr->dtype) +
+                                         result->size * array_dtype_size(result->dtype));
+        return;
+    }
+    
+    assert(arr->ndim <= ARRAY_ITER_MAX_DIMS);
+    assert(axis < arr->ndim);
+    assert(keepdims || result->ndim + 1 == arr->ndim);
+    
+    for (size_t d = 0, r = 0; d < arr->ndim; d++) {
+        if (d == axis) {
+            assert(!keepdims || result->shape[d] == 1);
+            result_strides[d] = 0;
+            if (keepdims) r++;
+            continue;
+        }
+        assert(result->shape[r] == arr->shape[d]);
+        result_strides[d] = result->strides[r++];
+    }
+    
+    reduce_into(result, result_strides, arr, op, dispatch);
+}
+
+void array_reduce_to(array_t* result, array_t* arr, array_reduce_op_t op, simd_dispatch_t* dispatch) {
+    size_t result_strides[ARRAY_ITER_MAX_DIMS];
+    
+    // expressions reduce one axis at a time, so other formats are reduced
+    // through float32 copies here
+    if (arr->dtype != ARRAY_FLOAT32 || result->dtype != ARRAY_FLOAT32) {
+        array_t* src = array_astype(arr, ARRAY_FLOAT32, dispatch);
+        array_t* acc = array_create(result->shape, result->ndim);
+        array_reduce_to(acc, src, op, dispatch);
+        
+        expr_t* expr = expr_from_array(acc);
+        expr_eval(expr, result, dispatch);
+        expr_free(expr);
+        array_free(acc);
+        array_free(src);
+        return;
+    }
+    
+    assert(arr->ndim <= ARRAY_ITER_MAX_DIMS);
+    assert(result->ndim == arr->ndim);
+    bool ok = array_broadcast_strides(result, arr->shape, arr->ndim, result_strides);
+    assert(ok);
+    (void)ok;
+    
+    reduce_into(result, result_strides, arr, op, dispatch);
+}
+
+void array_sum_axis(array_t* result, array_t* arr, size_t axis, simd_dispatch_t* dispatch) {
+    array_reduce_axis(result, arr, axis, ARRAY_REDUCE_SUM, dispatch);
+}
+
+void array_mean_axis(array_t* result, array_t* arr, size_t axis, simd_dispatch_t* dispatch) {
+    array_reduce_axis(result, arr, axis, ARRAY_REDUCE_MEAN, dispatch);
+}
+
+void array_max_axis(array_t* result, array_t* arr, size_t axis, simd_dispatch_t* dispatch) {
+    array_reduce_axis(result, arr, axis, ARRAY_REDUCE_MAX, dispatch);
+}
+
+void array_min_axis(array_t* result, array_t* arr, size_t axis, simd_dispatch_t* dispatch) {
+    array_reduce_axis(result, arr, axis, ARRAY_REDUCE_MIN, dispatch);
+}
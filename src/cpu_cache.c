@@ -0,0 +1,65 @@
+#include "cpu_cache.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static cpu_cache_info_t cache_info = {32 * 1024, 1024 * 1024, 8 * 1024 * 1024, 64};
+static pthread_once_t cache_once = PTHREAD_ONCE_INIT;
+
+#ifdef __linux__
+static int cache_read_line(const char* dir, const char* name, char* buf, size_t len) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    FILE* f = fopen(path, "r");
+    if (!f) return 0;
+    int ok = fgets(buf, (int)len, f) != NULL;
+    fclose(f);
+    if (ok) buf[strcspn(buf, "\n")] = '\0';
+    return ok;
+}
+
+// sysfs sizes look like "48K" or "2048K", occasionally "32M"
+static size_t cache_parse_size(const char* s) {
+    char* end;
+    unsigned long long n = strtoull(s, &end, 10);
+    if (*end == 'K') n *= 1024;
+    else if (*end == 'M') n *= 1024 * 1024;
+    return (size_t)n;
+}
+
+static void cache_detect(void) {
+    size_t llc_level = 0;
+    for (int index = 0; index < 16; index++) {
+        char dir[128], level[16], type[32], size[32], line[32];
+        snprintf(dir, sizeof(dir), "/sys/devices/system/cpu/cpu0/cache/index%d", index);
+        if (!cache_read_line(dir, "level", level, sizeof(level))) break;
+        if (!cache_read_line(dir, "type", type, sizeof(type))) continue;
+        if (!cache_read_line(dir, "size", size, sizeof(size))) continue;
+        if (strcmp(type, "Instruction") == 0) continue;
+
+        size_t bytes = cache_parse_size(size);
+        size_t lvl = (size_t)strtoul(level, NULL, 10);
+        if (bytes == 0) continue;
+
+        if (lvl == 1) cache_info.l1d = bytes;
+        if (lvl == 2) cache_info.l2 = bytes;
+        if (lvl >= llc_level) {
+            llc_level = lvl;
+            cache_info.llc = bytes;
+        }
+        if (cache_read_line(dir, "coherency_line_size", line, sizeof(line))) {
+            size_t n = (size_t)strtoul(line, NULL, 10);
+            if (n > 0) cache_info.line = n;
+        }
+    }
+}
+#else
+static void cache_detect(void) {
+}
+#endif
+
+const cpu_cache_info_t* cpu_cache_info(void) {
+    pthread_once(&cache_once, cache_detect);
+    return &cache_info;
+}
@@ -0,0 +1,17 @@
+#ifndef CPU_CACHE_H
+#define CPU_CACHE_H
+
+#include <stddef.h>
+
+// data cache sizes in bytes as seen by cpu0. read once from sysfs on Linux;
+// anything that cannot be read keeps a conservative default
+typedef struct {
+    size_t l1d;
+    size_t l2;
+    size_t llc;
+    size_t line;
+} cpu_cache_info_t;
+
+const cpu_cache_info_t* cpu_cache_info(void);
+
+#endif
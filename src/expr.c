@@ -0,0 +1,1753 @@
+#include "array.h"
+#include "array_iter.h"
+#include "simd_stats_record.h"
+#include "thread_pool.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+
+// elements processed per instruction dispatch; a multiple of the vector width
+// small enough that every register of a typical program stays in L1. a
+// balanced tree of depth d needs about d + 1 registers, and deeper programs
+// simply get more scratch
+#define EXPR_BLOCK 256
+// compiled kernels kept by expr_eval, least recently used evicted first
+#define EXPR_CACHE_CAPACITY 64
+
+// one iterator operand is taken by the result
+#if EXPR_MAX_LEAVES >= ARRAY_ITER_MAX_OPS
+#error "EXPR_MAX_LEAVES leaves and the result must fit the iterator's operands"
+#endif
+
+// one allocation per node unless the shape is too long to keep inline
+static expr_t* expr_alloc(expr_type_t type, const size_t* shape, size_t ndim) {
+    expr_t* expr = malloc(sizeof(expr_t));
+    expr->type = type;
+
+    expr->ndim = ndim;
+    expr->shape = ndim <= ARRAY_INLINE_DIMS ? expr->shape_inline : malloc(ndim * sizeof(size_t));
+    memcpy(expr->shape, shape, ndim * sizeof(size_t));
+
+    return expr;
+}
+
+expr_t* expr_from_array(array_t* arr) {
+    expr_t* expr = expr_alloc(EXPR_ARRAY, arr->shape, arr->ndim);
+    expr->data.leaf.array = arr;
+    return expr;
+}
+
+// the node takes the broadcast shape of its operands, with the same rules as
+// the eager operations
+static expr_t* expr_binary(expr_type_t type, expr_t* left, expr_t* right) {
+    array_t l = {.shape = left->shape, .ndim = left->ndim};
+    array_t r = {.shape = right->shape, .ndim = right->ndim};
+    assert(array_broadcastable(&l, &r));
+
+    size_t ndim;
+    size_t* shape = array_broadcast_shape(&l, &r, &ndim);
+    expr_t* expr = expr_alloc(type, shape, ndim);
+    free(shape);
+
+    expr->data.binary.left = left;
+    expr->data.binary.right = right;
+    return expr;
+}
+
+expr_t* expr_add(expr_t* left, expr_t* right) {
+    return expr_binary(EXPR_ADD, left, right);
+}
+
+expr_t* expr_mul(expr_t* left, expr_t* right) {
+    return expr_binary(EXPR_MUL, left, right);
+}
+
+expr_t* expr_sub(expr_t* left, expr_t* right) {
+    return expr_binary(EXPR_SUB, left, right);
+}
+
+expr_t* expr_scalar_mul(float scalar, expr_t* operand) {
+    expr_t* expr = expr_alloc(EXPR_SCALAR_MUL, operand->shape, operand->ndim);
+    expr->data.scalar_op.scalar = scalar;
+    expr->data.scalar_op.operand = operand;
+    return expr;
+}
+
+expr_t* expr_unary(expr_t* operand, array_unary_op_t op) {
+    expr_t* expr = expr_alloc(EXPR_UNARY, operand->shape, operand->ndim);
+    expr->data.unary.operand = operand;
+    expr->data.unary.op = op;
+    return expr;
+}
+
+expr_t* expr_exp(expr_t* operand) {
+    return expr_unary(operand, ARRAY_UNARY_EXP);
+}
+
+expr_t* expr_log(expr_t* operand) {
+    return expr_unary(operand, ARRAY_UNARY_LOG);
+}
+
+expr_t* expr_sigmoid(expr_t* operand) {
+    return expr_unary(operand, ARRAY_UNARY_SIGMOID);
+}
+
+expr_t* expr_tanh(expr_t* operand) {
+    return expr_unary(operand, ARRAY_UNARY_TANH);
+}
+
+expr_t* expr_sqrt(expr_t* operand) {
+    return expr_unary(operand, ARRAY_UNARY_SQRT);
+}
+
+expr_t* expr_rsqrt(expr_t* operand) {
+    return expr_unary(operand, ARRAY_UNARY_RSQRT);
+}
+
+expr_t* expr_reduce_axis(expr_t* operand, size_t axis, array_reduce_op_t op) {
+    assert(axis == EXPR_ALL_AXES || axis < operand->ndim);
+    expr_t* expr = expr_alloc(EXPR_REDUCE, operand->shape, operand->ndim);
+    for (size_t d = 0; d < expr->ndim; d++) {
+        if (axis == EXPR_ALL_AXES || d == axis) expr->shape[d] = 1;
+    }
+    expr->data.reduce.operand = operand;
+    expr->data.reduce.op = op;
+    expr->data.reduce.axis = axis;
+    return expr;
+}
+
+expr_t* expr_reduce(expr_t* operand, array_reduce_op_t op) {
+    return expr_reduce_axis(operand, EXPR_ALL_AXES, op);
+}
+
+expr_t* expr_sum(expr_t* operand) {
+    return expr_reduce_axis(operand, EXPR_ALL_AXES, ARRAY_REDUCE_SUM);
+}
+
+expr_t* expr_sum_axis(expr_t* operand, size_t axis) {
+    return expr_reduce_axis(operand, axis, ARRAY_REDUCE_SUM);
+}
+
+// the tree is flattened into a register program once per evaluation; every
+// instruction then runs over a whole block of lanes so the interpretation cost
+// is paid per EXPR_BLOCK elements instead of per element
+typedef enum {
+    EXPR_OP_LOAD,
+    EXPR_OP_ADD,
+    EXPR_OP_SUB,
+    EXPR_OP_MUL,
+    EXPR_OP_SCALE,
+    EXPR_OP_FMA,
+    EXPR_OP_UNARY
+} expr_opcode_t;
+
+// dst = a op b, dst = a * b + c for EXPR_OP_FMA, or dst = fn(a)
+typedef struct {
+    expr_opcode_t op;
+    size_t dst;
+    size_t a;
+    size_t b;
+    size_t c;
+    size_t leaf;
+    float scalar;
+    array_unary_op_t fn;
+} expr_instr_t;
+
+// a program refers to its leaves by slot; the arrays are bound per evaluation
+typedef struct {
+    expr_instr_t* code;
+    size_t ncode;
+    size_t cap;
+    size_t nleaves;
+    size_t nregs;
+    // register holding the program's value after the last instruction
+    size_t result;
+    // open-addressed table of code indices while lowering, SIZE_MAX when empty
+    size_t* index;
+    size_t index_cap;
+} expr_program_t;
+
+// compilation runs in three passes over an SSA form in which an instruction's
+// dst is its own index:
+//   1. the tree is lowered with scalar chains folded, children emitted in
+//      Sethi-Ullman order and every instruction hash-consed, so a leaf or
+//      subexpression that appears twice is loaded or computed once
+//   2. an add whose operand is a single-use mul becomes one fmadd, and
+//      instructions nothing reads any more are dropped
+//   3. values are packed into block registers by liveness, so a register is
+//      reused as soon as its last reader has run
+static size_t program_emit(expr_program_t* prog, expr_instr_t instr) {
+    if (prog->ncode == prog->cap) {
+        prog->cap = prog->cap ? prog->cap * 2 : 16;
+        prog->code = realloc(prog->code, prog->cap * sizeof(expr_instr_t));
+    }
+    instr.dst = prog->ncode;
+    prog->code[prog->ncode] = instr;
+    return prog->ncode++;
+}
+
+// FNV-1a over the fields interning compares
+static size_t program_hash(const expr_instr_t* in) {
+    uint32_t scalar;
+    memcpy(&scalar, &in->scalar, sizeof(scalar));
+    uint64_t fields[7] = {in->op, in->a, in->b, in->c, in->leaf, scalar, in->fn};
+    uint64_t h = 1469598103934665603ull;
+    for (size_t i = 0; i < 7; i++) {
+        h ^= fields[i];
+        h *= 1099511628211ull;
+    }
+    return (size_t)(h ^ (h >> 32));
+}
+
+static void program_index_insert(expr_program_t* prog, size_t i) {
+    size_t mask = prog->index_cap - 1;
+    size_t slot = program_hash(&prog->code[i]) & mask;
+    while (prog->index[slot] != SIZE_MAX) slot = (slot + 1) & mask;
+    prog->index[slot] = i;
+}
+
+static size_t program_intern(expr_program_t* prog, expr_instr_t instr) {
+    // kept at most half full
+    if (2 * (prog->ncode + 1) > prog->index_cap) {
+        free(prog->index);
+        prog->index_cap = prog->index_cap ? prog->index_cap * 2 : 64;
+        prog->index = malloc(prog->index_cap * sizeof(size_t));
+        memset(prog->index, 0xff, prog->index_cap * sizeof(size_t));
+        for (size_t i = 0; i < prog->ncode; i++) program_index_insert(prog, i);
+    }
+
+    size_t mask = prog->index_cap - 1;
+    for (size_t slot = program_hash(&instr) & mask; prog->index[slot] != SIZE_MAX;
+         slot = (slot + 1) & mask) {
+        const expr_instr_t* in = &prog->code[prog->index[slot]];
+        if (in->op == instr.op && in->a == instr.a && in->b == instr.b && in->c == instr.c &&
+            in->leaf == instr.leaf && in->scalar == instr.scalar && in->fn == instr.fn) {
+            return prog->index[slot];
+        }
+    }
+    size_t i = program_emit(prog, instr);
+    program_index_insert(prog, i);
+    return i;
+}
+
+// Sethi-Ullman number: block registers needed to evaluate the subtree when
+// the more demanding child always goes first
+static size_t program_need(expr_t* expr) {
+    switch (expr->type) {
+        case EXPR_ADD:
+        case EXPR_SUB:
+        case EXPR_MUL: {
+            size_t l = program_need(expr->data.binary.left);
+            size_t r = program_need(expr->data.binary.right);
+            return l == r ? l + 1 : (l > r ? l : r);
+        }
+        case EXPR_SCALAR_MUL:
+            return program_need(expr->data.scalar_op.operand);
+        case EXPR_UNARY:
+            return program_need(expr->data.unary.operand);
+        default:
+            return 1;
+    }
+}
+
+static size_t program_leaf(array_t* const* leaves, size_t nleaves, const array_t* arr) {
+    for (size_t i = 0; i < nleaves; i++) {
+        if (leaves[i] == arr) return i;
+    }
+    assert(!"leaf missing from the binding");
+    return 0;
+}
+
+static size_t program_lower(expr_program_t* prog, expr_t* expr, array_t* const* leaves) {
+    expr_instr_t instr = {0};
+
+    switch (expr->type) {
+        case EXPR_ARRAY:
+            instr.op = EXPR_OP_LOAD;
+            instr.leaf = program_leaf(leaves, prog->nleaves, expr->data.leaf.array);
+            break;
+
+        case EXPR_ADD:
+        case EXPR_SUB:
+        case EXPR_MUL: {
+            expr_t* left = expr->data.binary.left;
+            expr_t* right = expr->data.binary.right;
+            if (program_need(right) > program_need(left)) {
+                instr.b = program_lower(prog, right, leaves);
+                instr.a = program_lower(prog, left, leaves);
+            } else {
+                instr.a = program_lower(prog, left, leaves);
+                instr.b = program_lower(prog, right, leaves);
+            }
+            instr.op = expr->type == EXPR_ADD ? EXPR_OP_ADD :
+                       expr->type == EXPR_SUB ? EXPR_OP_SUB : EXPR_OP_MUL;
+            // canonical operand order lets a * b and b * a share one value
+            if (instr.op != EXPR_OP_SUB && instr.a > instr.b) {
+                size_t t = instr.a;
+                instr.a = instr.b;
+                instr.b = t;
+            }
+            break;
+        }
+
+        case EXPR_SCALAR_MUL: {
+            float scalar = expr->data.scalar_op.scalar;
+            expr_t* operand = expr->data.scalar_op.operand;
+            while (operand->type == EXPR_SCALAR_MUL) {
+                scalar *= operand->data.scalar_op.scalar;
+                operand = operand->data.scalar_op.operand;
+            }
+
+            size_t v = program_lower(prog, operand, leaves);
+            if (scalar == 1.0f) return v;
+
+            instr.op = EXPR_OP_SCALE;
+            instr.a = v;
+            instr.scalar = scalar;
+            break;
+        }
+
+        case EXPR_UNARY:
+            instr.op = EXPR_OP_UNARY;
+            instr.a = program_lower(prog, expr->data.unary.operand, leaves);
+            instr.fn = expr->data.unary.op;
+            break;
+
+        case EXPR_REDUCE:
+            // unreachable: a tree with a reduction below its root is flagged
+            // by signature_walk and split or rejected before compiling
+            assert(!"reduction below the root of a compiled expression");
+            break;
+    }
+
+    return program_intern(prog, instr);
+}
+
+static size_t program_arity(expr_opcode_t op) {
+    switch (op) {
+        case EXPR_OP_LOAD: return 0;
+        case EXPR_OP_SCALE:
+        case EXPR_OP_UNARY: return 1;
+        case EXPR_OP_FMA: return 3;
+        default: return 2;
+    }
+}
+
+static size_t* program_operand(expr_instr_t* in, size_t k) {
+    return k == 0 ? &in->a : k == 1 ? &in->b : &in->c;
+}
+
+static void program_fuse_fma(expr_program_t* prog, size_t root, size_t* uses) {
+    memset(uses, 0, prog->ncode * sizeof(size_t));
+    uses[root]++;
+    for (size_t i = 0; i < prog->ncode; i++) {
+        for (size_t k = 0; k < program_arity(prog->code[i].op); k++) {
+            uses[*program_operand(&prog->code[i], k)]++;
+        }
+    }
+
+    for (size_t i = 0; i < prog->ncode; i++) {
+        expr_instr_t* in = &prog->code[i];
+        if (in->op != EXPR_OP_ADD) continue;
+
+        for (size_t k = 0; k < 2; k++) {
+            size_t m = k == 0 ? in->a : in->b;
+            size_t other = k == 0 ? in->b : in->a;
+            if (prog->code[m].op != EXPR_OP_MUL || uses[m] != 1) continue;
+
+            in->op = EXPR_OP_FMA;
+            in->a = prog->code[m].a;
+            in->b = prog->code[m].b;
+            in->c = other;
+            uses[m] = 0;
+            break;
+        }
+    }
+}
+
+// drops instructions the root no longer depends on and renumbers the rest
+static size_t program_prune(expr_program_t* prog, size_t root, size_t* map) {
+    bool* live = calloc(prog->ncode, sizeof(bool));
+    live[root] = true;
+    for (size_t i = prog->ncode; i-- > 0;) {
+        if (!live[i]) continue;
+        for (size_t k = 0; k < program_arity(prog->code[i].op); k++) {
+            live[*program_operand(&prog->code[i], k)] = true;
+        }
+    }
+
+    size_t n = 0;
+    for (size_t i = 0; i < prog->ncode; i++) {
+        if (!live[i]) continue;
+        expr_instr_t in = prog->code[i];
+        for (size_t k = 0; k < program_arity(in.op); k++) {
+            size_t* v = program_operand(&in, k);
+            *v = map[*v];
+        }
+        in.dst = n;
+        map[i] = n;
+        prog->code[n++] = in;
+    }
+    prog->ncode = n;
+
+    free(live);
+    return map[root];
+}
+
+// linear-scan allocation: operands whose last reader is this instruction
+// release their register before dst is chosen, so an element-wise op can
+// write in place over an input it was the last to need. there is no fixed
+// register file: no program needs more registers than it has instructions
+static void program_allocate(expr_program_t* prog, size_t root, size_t* last_use) {
+    size_t* reg_of = malloc(prog->ncode * sizeof(size_t));
+    bool* busy = calloc(prog->ncode, sizeof(bool));
+
+    for (size_t i = 0; i < prog->ncode; i++) last_use[i] = i;
+    for (size_t i = 0; i < prog->ncode; i++) {
+        for (size_t k = 0; k < program_arity(prog->code[i].op); k++) {
+            last_use[*program_operand(&prog->code[i], k)] = i;
+        }
+    }
+    last_use[root] = prog->ncode;
+
+    prog->nregs = 0;
+    for (size_t i = 0; i < prog->ncode; i++) {
+        expr_instr_t* in = &prog->code[i];
+        for (size_t k = 0; k < program_arity(in->op); k++) {
+            size_t* v = program_operand(in, k);
+            if (last_use[*v] == i) busy[reg_of[*v]] = false;
+            *v = reg_of[*v];
+        }
+
+        size_t r = 0;
+        while (busy[r]) r++;
+        busy[r] = true;
+        reg_of[i] = r;
+        in->dst = r;
+        if (r + 1 > prog->nregs) prog->nregs = r + 1;
+    }
+
+    prog->result = reg_of[root];
+    free(busy);
+    free(reg_of);
+}
+
+// leaves[0..nleaves) are the distinct arrays of the tree; slot i is leaves[i]
+static void program_compile(expr_program_t* prog, expr_t* expr, array_t* const* leaves, size_t nleaves) {
+    memset(prog, 0, sizeof(*prog));
+    prog->nleaves = nleaves;
+
+    size_t root = program_lower(prog, expr, leaves);
+    free(prog->index);
+    prog->index = NULL;
+    prog->index_cap = 0;
+
+    size_t* work = malloc(prog->ncode * sizeof(size_t));
+    program_fuse_fma(prog, root, work);
+    root = program_prune(prog, root, work);
+    program_allocate(prog, root, work);
+    free(work);
+}
+
+static void program_free(expr_program_t* prog) {
+    free(prog->code);
+}
+
+// a kernel is everything expr_eval derives from the tree: the compiled program
+// and, for a reduction root, what to reduce. it depends only on the tree's
+// structure, scalars and which leaves are the same array, so one kernel
+// serves every evaluation of that shape of tree whatever arrays it is given.
+// the structure is kept as a token string for exact comparison on lookup
+struct expr_kernel {
+    uint64_t hash;
+    uint64_t* tokens;
+    size_t ntokens;
+
+    expr_program_t prog;
+    bool reduce;
+    array_reduce_op_t reduce_op;
+    size_t reduce_axis;
+
+    // held by the cache while the kernel is listed there, and by every caller
+    // between lookup and release
+    size_t refs;
+    bool cached;
+    expr_kernel_t* prev;
+    expr_kernel_t* next;
+};
+
+// pre-order serialisation of a tree plus its distinct leaves in order of
+// first appearance. a leaf is recorded by its slot, so two trees that differ
+// only in their arrays produce the same tokens
+typedef struct {
+    uint64_t* tokens;
+    size_t ntokens;
+    size_t cap;
+    uint64_t inline_tokens[64];
+    array_t* leaves[EXPR_MAX_LEAVES];
+    size_t nleaves;
+    // the tree cannot be compiled as one program: it reads more than
+    // EXPR_MAX_LEAVES distinct arrays or has a reduction below its root
+    bool split;
+} expr_signature_t;
+
+static void signature_push(expr_signature_t* sig, uint64_t token) {
+    if (sig->ntokens == sig->cap) {
+        sig->cap *= 2;
+        if (sig->tokens == sig->inline_tokens) {
+            sig->tokens = malloc(sig->cap * sizeof(uint64_t));
+            memcpy(sig->tokens, sig->inline_tokens, sig->ntokens * sizeof(uint64_t));
+        } else {
+            sig->tokens = realloc(sig->tokens, sig->cap * sizeof(uint64_t));
+        }
+    }
+    sig->tokens[sig->ntokens++] = token;
+}
+
+static uint64_t signature_float(float x) {
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    return bits;
+}
+
+static void signature_walk(expr_signature_t* sig, expr_t* expr) {
+    signature_push(sig, (uint64_t)expr->type);
+
+    switch (expr->type) {
+        case EXPR_ARRAY: {
+            array_t* arr = expr->data.leaf.array;
+            size_t slot = 0;
+            while (slot < sig->nleaves && sig->leaves[slot] != arr) slot++;
+            if (slot == sig->nleaves) {
+                if (sig->nleaves == EXPR_MAX_LEAVES) sig->split = true;
+                else sig->leaves[sig->nleaves++] = arr;
+            }
+            signature_push(sig, slot);
+            break;
+        }
+
+        case EXPR_ADD:
+        case EXPR_SUB:
+        case EXPR_MUL:
+            signature_walk(sig, expr->data.binary.left);
+            signature_walk(sig, expr->data.binary.right);
+            break;
+
+        case EXPR_SCALAR_MUL:
+            signature_push(sig, signature_float(expr->data.scalar_op.scalar));
+            signature_walk(sig, expr->data.scalar_op.operand);
+            break;
+
+        case EXPR_UNARY:
+            signature_push(sig, (uint64_t)expr->data.unary.op);
+            signature_walk(sig, expr->data.unary.operand);
+            break;
+
+        case EXPR_REDUCE:
+            // only the root's type token precedes a root reduction
+            if (sig->ntokens > 1) sig->split = true;
+            signature_push(sig, (uint64_t)expr->data.reduce.op);
+            signature_push(sig, (uint64_t)expr->data.reduce.axis);
+            signature_walk(sig, expr->data.reduce.operand);
+            break;
+    }
+}
+
+static void signature_build(expr_signature_t* sig, expr_t* expr) {
+    sig->tokens = sig->inline_tokens;
+    sig->ntokens = 0;
+    sig->cap = sizeof(sig->inline_tokens) / sizeof(sig->inline_tokens[0]);
+    sig->nleaves = 0;
+    sig->split = false;
+    signature_walk(sig, expr);
+}
+
+static void signature_free(expr_signature_t* sig) {
+    if (sig->tokens != sig->inline_tokens) free(sig->tokens);
+}
+
+// FNV-1a over the tokens
+static uint64_t signature_hash(const expr_signature_t* sig) {
+    uint64_t h = 1469598103934665603ull;
+    for (size_t i = 0; i < sig->ntokens; i++) {
+        h ^= sig->tokens[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static expr_kernel_t* kernel_build(expr_t* expr, const expr_signature_t* sig, uint64_t hash) {
+    expr_kernel_t* kernel = calloc(1, sizeof(expr_kernel_t));
+    kernel->hash = hash;
+    kernel->ntokens = sig->ntokens;
+    kernel->tokens = malloc(sig->ntokens * sizeof(uint64_t));
+    memcpy(kernel->tokens, sig->tokens, sig->ntokens * sizeof(uint64_t));
+    kernel->refs = 1;
+
+    if (expr->type == EXPR_REDUCE) {
+        kernel->reduce = true;
+        kernel->reduce_op = expr->data.reduce.op;
+        kernel->reduce_axis = expr->data.reduce.axis;
+        expr = expr->data.reduce.operand;
+    }
+    program_compile(&kernel->prog, expr, sig->leaves, sig->nleaves);
+    return kernel;
+}
+
+static void kernel_destroy(expr_kernel_t* kernel) {
+    program_free(&kernel->prog);
+    free(kernel->tokens);
+    free(kernel);
+}
+
+// process-wide LRU of compiled kernels, most recently used at the head
+static struct {
+    pthread_mutex_t lock;
+    expr_kernel_t* head;
+    expr_kernel_t* tail;
+    size_t count;
+    size_t capacity;
+} expr_cache = {PTHREAD_MUTEX_INITIALIZER, NULL, NULL, 0, EXPR_CACHE_CAPACITY};
+
+static void cache_unlink(expr_kernel_t* kernel) {
+    if (kernel->prev) kernel->prev->next = kernel->next;
+    else expr_cache.head = kernel->next;
+    if (kernel->next) kernel->next->prev = kernel->prev;
+    else expr_cache.tail = kernel->prev;
+    kernel->prev = kernel->next = NULL;
+}
+
+static void cache_push_front(expr_kernel_t* kernel) {
+    kernel->prev = NULL;
+    kernel->next = expr_cache.head;
+    if (expr_cache.head) expr_cache.head->prev = kernel;
+    expr_cache.head = kernel;
+    if (!expr_cache.tail) expr_cache.tail = kernel;
+}
+
+// drops the cache's reference; returns the kernel if that was the last one
+// so it can be destroyed outside the lock
+static expr_kernel_t* cache_evict(expr_kernel_t* kernel) {
+    cache_unlink(kernel);
+    kernel->cached = false;
+    expr_cache.count--;
+    return --kernel->refs == 0 ? kernel : NULL;
+}
+
+static void cache_trim(size_t capacity) {
+    while (expr_cache.count > capacity) {
+        expr_kernel_t* dead = cache_evict(expr_cache.tail);
+        if (dead) kernel_destroy(dead);
+    }
+}
+
+static expr_kernel_t* kernel_acquire(expr_t* expr, const expr_signature_t* sig) {
+    uint64_t hash = signature_hash(sig);
+
+    pthread_mutex_lock(&expr_cache.lock);
+    for (expr_kernel_t* k = expr_cache.head; k; k = k->next) {
+        if (k->hash == hash && k->ntokens == sig->ntokens &&
+            memcmp(k->tokens, sig->tokens, sig->ntokens * sizeof(uint64_t)) == 0) {
+            cache_unlink(k);
+            cache_push_front(k);
+            k->refs++;
+            pthread_mutex_unlock(&expr_cache.lock);
+            return k;
+        }
+    }
+    pthread_mutex_unlock(&expr_cache.lock);
+
+    // compile outside the lock; a concurrent miss on the same tree just
+    // compiles it twice and both copies end up cached for a while
+    expr_kernel_t* kernel = kernel_build(expr, sig, hash);
+
+    pthread_mutex_lock(&expr_cache.lock);
+    if (expr_cache.capacity > 0) {
+        kernel->refs++;
+        kernel->cached = true;
+        cache_push_front(kernel);
+        expr_cache.count++;
+        cache_trim(expr_cache.capacity);
+    }
+    pthread_mutex_unlock(&expr_cache.lock);
+    return kernel;
+}
+
+static void kernel_release(expr_kernel_t* kernel) {
+    pthread_mutex_lock(&expr_cache.lock);
+    bool dead = --kernel->refs == 0;
+    pthread_mutex_unlock(&expr_cache.lock);
+    if (dead) kernel_destroy(kernel);
+}
+
+void expr_cache_set_capacity(size_t capacity) {
+    pthread_mutex_lock(&expr_cache.lock);
+    expr_cache.capacity = capacity;
+    cache_trim(capacity);
+    pthread_mutex_unlock(&expr_cache.lock);
+}
+
+void expr_cache_clear(void) {
+    pthread_mutex_lock(&expr_cache.lock);
+    cache_trim(0);
+    pthread_mutex_unlock(&expr_cache.lock);
+}
+
+// compute types: float64 whenever a leaf or the result is float64, float32
+// otherwise. every other format is storage only and is converted as it is
+// loaded or stored, so one compiled program serves any mix of formats
+static bool expr_wide(array_t* const* leaves, size_t nleaves, const array_t* result) {
+    if (result && result->dtype == ARRAY_FLOAT64) return true;
+    for (size_t i = 0; i < nleaves; i++) {
+        if (leaves[i]->dtype == ARRAY_FLOAT64) return true;
+    }
+    return false;
+}
+
+static array_dtype_t expr_compute_dtype(bool wide) {
+    return wide ? ARRAY_FLOAT64 : ARRAY_FLOAT32;
+}
+
+static simd_unary_n_func expr_unary_kernel(const simd_dispatch_t* dispatch, array_unary_op_t fn) {
+    switch (fn) {
+        case ARRAY_UNARY_EXP: return dispatch->exp_n;
+        case ARRAY_UNARY_LOG: return dispatch->log_n;
+        case ARRAY_UNARY_SIGMOID: return dispatch->sigmoid_n;
+        case ARRAY_UNARY_TANH: return dispatch->tanh_n;
+        case ARRAY_UNARY_SQRT: return dispatch->sqrt_n;
+        default: return dispatch->rsqrt_n;
+    }
+}
+
+static simd_unary_f64_n_func expr_unary_f64_kernel(const simd_dispatch_t* dispatch, array_unary_op_t fn) {
+    switch (fn) {
+        case ARRAY_UNARY_EXP: return dispatch->exp_f64_n;
+        case ARRAY_UNARY_LOG: return dispatch->log_f64_n;
+        case ARRAY_UNARY_SIGMOID: return dispatch->sigmoid_f64_n;
+        case ARRAY_UNARY_TANH: return dispatch->tanh_f64_n;
+        case ARRAY_UNARY_SQRT: return dispatch->sqrt_f64_n;
+        default: return dispatch->rsqrt_f64_n;
+    }
+}
+
+// kernels between a storage format and float32; NULL for float32 itself
+static simd_load_n_func expr_load_kernel(const simd_dispatch_t* dispatch, array_dtype_t dtype) {
+    switch (dtype) {
+        case ARRAY_FLOAT64: return dispatch->load_f64_n;
+        case ARRAY_FLOAT16: return dispatch->load_f16_n;
+        case ARRAY_BFLOAT16: return dispatch->load_bf16_n;
+        case ARRAY_INT32: return dispatch->load_i32_n;
+        case ARRAY_INT8: return dispatch->load_i8_n;
+        default: return NULL;
+    }
+}
+
+static simd_store_n_func expr_store_kernel(const simd_dispatch_t* dispatch, array_dtype_t dtype) {
+    switch (dtype) {
+        case ARRAY_FLOAT64: return dispatch->store_f64_n;
+        case ARRAY_FLOAT16: return dispatch->store_f16_n;
+        case ARRAY_BFLOAT16: return dispatch->store_bf16_n;
+        case ARRAY_INT32: return dispatch->store_i32_n;
+        case ARRAY_INT8: return dispatch->store_i8_n;
+        default: return NULL;
+    }
+}
+
+// int32 goes to and from float64 directly, since float32 cannot hold every
+// int32 exactly
+static int32_t expr_f64_to_i32(double x) {
+    if (x != x) return 0;
+    if (x >= 2147483647.0) return INT32_MAX;
+    if (x <= -2147483648.0) return INT32_MIN;
+    return (int32_t)nearbyint(x);
+}
+
+// n elements of `size` bytes, `stride` elements apart, to or from a packed buffer
+#define EXPR_MOVE_WORDS(type, dst_index, src_index)                             \
+    do {                                                                        \
+        type* d = dst;                                                          \
+        const type* s = src;                                                    \
+        for (size_t i = 0; i < n; i++) d[dst_index] = s[src_index];             \
+    } while (0)
+
+static void expr_gather(void* dst, const void* src, size_t stride, size_t n, size_t size) {
+    switch (size) {
+        case 1: EXPR_MOVE_WORDS(uint8_t, i, i * stride); break;
+        case 2: EXPR_MOVE_WORDS(uint16_t, i, i * stride); break;
+        case 8: EXPR_MOVE_WORDS(uint64_t, i, i * stride); break;
+        default: EXPR_MOVE_WORDS(uint32_t, i, i * stride); break;
+    }
+}
+
+static void expr_scatter(void* dst, size_t stride, const void* src, size_t n, size_t size) {
+    switch (size) {
+        case 1: EXPR_MOVE_WORDS(uint8_t, i * stride, i); break;
+        case 2: EXPR_MOVE_WORDS(uint16_t, i * stride, i); break;
+        case 8: EXPR_MOVE_WORDS(uint64_t, i * stride, i); break;
+        default: EXPR_MOVE_WORDS(uint32_t, i * stride, i); break;
+    }
+}
+
+// a block register wide enough for either compute type
+typedef unsigned char expr_reg_t[EXPR_BLOCK * sizeof(double)];
+
+typedef struct {
+    const expr_program_t* prog;
+    array_t* const* leaves;
+    simd_dispatch_t* dispatch;
+    void* result;
+    array_dtype_t result_dtype;
+    // compute in float64 instead of float32
+    bool wide;
+    // element sizes, looked up once rather than per block
+    size_t result_size;
+    size_t leaf_size[ARRAY_ITER_MAX_OPS];
+    // prog->nregs block registers, then one block of raw gathered elements
+    // and one of float32 values on their way between two other formats
+    expr_reg_t* scratch;
+    // where each register's current block is read from: its scratch block, or
+    // a leaf read in place
+    const void** regs;
+    // set when the program feeds a reduction instead of being stored
+    bool reducing;
+    array_reduce_op_t reduce_op;
+} expr_run_t;
+
+static void* expr_stage(const expr_run_t* run) {
+    return run->scratch[run->prog->nregs];
+}
+
+static float* expr_narrow(const expr_run_t* run) {
+    return (float*)run->scratch[run->prog->nregs + 1];
+}
+
+// n packed values of format dtype into the compute type
+static void expr_convert_in(const expr_run_t* run, array_dtype_t dtype, void* dst, const void* src,
+                            size_t n) {
+    simd_dispatch_t* dispatch = run->dispatch;
+    if (dtype == expr_compute_dtype(run->wide)) {
+        memcpy(dst, src, n * array_dtype_size(dtype));
+    } else if (!run->wide) {
+        expr_load_kernel(dispatch, dtype)(dst, src, n);
+    } else if (dtype == ARRAY_FLOAT32) {
+        dispatch->store_f64_n(dst, src, n);
+    } else if (dtype == ARRAY_INT32) {
+        double* out = dst;
+        const int32_t* in = src;
+        for (size_t i = 0; i < n; i++) out[i] = in[i];
+    } else {
+        float* narrow = expr_narrow(run);
+        expr_load_kernel(dispatch, dtype)(narrow, src, n);
+        dispatch->store_f64_n(dst, narrow, n);
+    }
+}
+
+// n compute-type values into packed values of the result's format
+static void expr_convert_out(const expr_run_t* run, void* dst, const void* src, size_t n) {
+    simd_dispatch_t* dispatch = run->dispatch;
+    array_dtype_t dtype = run->result_dtype;
+    if (dtype == expr_compute_dtype(run->wide)) {
+        memcpy(dst, src, n * array_dtype_size(dtype));
+    } else if (!run->wide) {
+        expr_store_kernel(dispatch, dtype)(dst, src, n);
+    } else if (dtype == ARRAY_FLOAT32) {
+        dispatch->load_f64_n(dst, src, n);
+    } else if (dtype == ARRAY_INT32) {
+        int32_t* out = dst;
+        const double* in = src;
+        for (size_t i = 0; i < n; i++) out[i] = expr_f64_to_i32(in[i]);
+    } else {
+        float* narrow = expr_narrow(run);
+        dispatch->load_f64_n(narrow, src, n);
+        expr_store_kernel(dispatch, dtype)(dst, narrow, n);
+    }
+}
+
+// one block of leaf values in the compute type: the leaf itself when it is
+// contiguous and already in that type, dst otherwise
+static const void* expr_load_block(const expr_run_t* run, const array_t* leaf, size_t size,
+                                   const void* src, size_t stride, size_t m, void* dst) {
+    array_dtype_t dtype = leaf->dtype;
+    bool native = dtype == expr_compute_dtype(run->wide);
+
+    if (native && stride == 1) return src;
+
+    if (stride == 0) {
+        // broadcast along the run: one value splatted across the block,
+        // never a materialised copy of the leaf. conversion goes through a
+        // temporary: value's address must not escape or the loop cannot
+        // keep it in a register
+        if (run->wide) {
+            double value, converted;
+            if (native) {
+                value = *(const double*)src;
+            } else {
+                expr_convert_in(run, dtype, &converted, src, 1);
+                value = converted;
+            }
+            for (size_t i = 0; i < m; i++) ((double*)dst)[i] = value;
+        } else {
+            float value, converted;
+            if (native) {
+                value = *(const float*)src;
+            } else {
+                expr_convert_in(run, dtype, &converted, src, 1);
+                value = converted;
+            }
+            for (size_t i = 0; i < m; i++) ((float*)dst)[i] = value;
+        }
+        return dst;
+    }
+    if (native) {
+        expr_gather(dst, src, stride, m, size);
+        return dst;
+    }
+    if (stride != 1) {
+        expr_gather(expr_stage(run), src, stride, m, size);
+        src = expr_stage(run);
+    }
+    expr_convert_in(run, dtype, dst, src, m);
+    return dst;
+}
+
+// folds one block of program output into the reduction. along a reduced axis
+// the output stride is 0 and the block collapses into a single kernel call;
+// otherwise every lane accumulates into its own output element
+static void expr_reduce_block(const expr_run_t* run, float* out, size_t out_stride,
+                              const float* value, size_t m) {
+    simd_dispatch_t* dispatch = run->dispatch;
+    bool is_sum = run->reduce_op == ARRAY_REDUCE_SUM || run->reduce_op == ARRAY_REDUCE_MEAN;
+
+    if (out_stride == 0) {
+        if (is_sum) {
+            *out += dispatch->sum_n(value, m);
+        } else if (run->reduce_op == ARRAY_REDUCE_MAX) {
+            float x = dispatch->max_n(value, m);
+            if (x > *out) *out = x;
+        } else {
+            float x = dispatch->min_n(value, m);
+            if (x < *out) *out = x;
+        }
+    } else if (is_sum && out_stride == 1) {
+        dispatch->add_n(out, out, value, m);
+    } else if (is_sum) {
+        for (size_t i = 0; i < m; i++) out[i * out_stride] += value[i];
+    } else if (run->reduce_op == ARRAY_REDUCE_MAX) {
+        for (size_t i = 0; i < m; i++) {
+            if (value[i] > out[i * out_stride]) out[i * out_stride] = value[i];
+        }
+    } else {
+        for (size_t i = 0; i < m; i++) {
+            if (value[i] < out[i * out_stride]) out[i * out_stride] = value[i];
+        }
+    }
+}
+
+static void expr_reduce_block_f64(const expr_run_t* run, double* out, size_t out_stride,
+                                  const double* value, size_t m) {
+    simd_dispatch_t* dispatch = run->dispatch;
+    bool is_sum = run->reduce_op == ARRAY_REDUCE_SUM || run->reduce_op == ARRAY_REDUCE_MEAN;
+
+    if (out_stride == 0) {
+        if (is_sum) {
+            *out += dispatch->sum_f64_n(value, m);
+        } else if (run->reduce_op == ARRAY_REDUCE_MAX) {
+            double x = dispatch->max_f64_n(value, m);
+            if (x > *out) *out = x;
+        } else {
+            double x = dispatch->min_f64_n(value, m);
+            if (x < *out) *out = x;
+        }
+    } else if (is_sum && out_stride == 1) {
+        dispatch->add_f64_n(out, out, value, m);
+    } else if (is_sum) {
+        for (size_t i = 0; i < m; i++) out[i * out_stride] += value[i];
+    } else if (run->reduce_op == ARRAY_REDUCE_MAX) {
+        for (size_t i = 0; i < m; i++) {
+            if (value[i] > out[i * out_stride]) out[i * out_stride] = value[i];
+        }
+    } else {
+        for (size_t i = 0; i < m; i++) {
+            if (value[i] < out[i * out_stride]) out[i * out_stride] = value[i];
+        }
+    }
+}
+
+// operand 0 is the result, operand 1 + i is leaf i
+static void expr_run_inner(void* ctx, const size_t* offsets, const size_t* inner_strides, size_t n) {
+    expr_run_t* run = ctx;
+    const expr_program_t* prog = run->prog;
+    simd_dispatch_t* dispatch = run->dispatch;
+    const void** regs = run->regs;
+
+    size_t out_stride = inner_strides[0];
+    size_t out_size = run->result_size;
+#ifdef SIMD_STATS
+    // a run is fast when every operand is read or written in place
+    bool contiguous = out_stride == 1 || (run->reducing && out_stride == 0);
+    for (size_t i = 0; i < prog->nleaves && contiguous; i++) {
+        contiguous = inner_strides[1 + i] == 1;
+    }
+    if (contiguous) SIMD_STATS_COUNT(dispatch->stats, SIMD_STATS_EXPR, fast);
+    else SIMD_STATS_COUNT(dispatch->stats, SIMD_STATS_EXPR, fallback);
+#endif
+
+    // the final instruction writes straight into a contiguous result of the
+    // compute type
+    bool direct = out_stride == 1 && !run->reducing &&
+                  run->result_dtype == expr_compute_dtype(run->wide);
+
+    for (size_t j = 0; j < n; j += EXPR_BLOCK) {
+        size_t m = n - j < EXPR_BLOCK ? n - j : EXPR_BLOCK;
+        char* out = (char*)run->result + (offsets[0] + j * out_stride) * out_size;
+
+        for (size_t pc = 0; pc < prog->ncode; pc++) {
+            const expr_instr_t* in = &prog->code[pc];
+            void* dst = (direct && pc + 1 == prog->ncode && in->dst == prog->result &&
+                         in->op != EXPR_OP_LOAD)
+                ? (void*)out : (void*)run->scratch[in->dst];
+
+            switch (in->op) {
+                case EXPR_OP_LOAD: {
+                    const array_t* leaf = run->leaves[in->leaf];
+                    size_t size = run->leaf_size[in->leaf];
+                    size_t s = inner_strides[1 + in->leaf];
+                    const char* src = (const char*)leaf->raw + (offsets[1 + in->leaf] + j * s) * size;
+                    regs[in->dst] = expr_load_block(run, leaf, size, src, s, m, dst);
+                    break;
+                }
+                case EXPR_OP_ADD:
+                    if (run->wide) dispatch->add_f64_n(dst, regs[in->a], regs[in->b], m);
+                    else dispatch->add_n(dst, regs[in->a], regs[in->b], m);
+                    regs[in->dst] = dst;
+                    break;
+                case EXPR_OP_SUB:
+                    if (run->wide) dispatch->sub_f64_n(dst, regs[in->a], regs[in->b], m);
+                    else dispatch->sub_n(dst, regs[in->a], regs[in->b], m);
+                    regs[in->dst] = dst;
+                    break;
+                case EXPR_OP_MUL:
+                    if (run->wide) dispatch->mul_f64_n(dst, regs[in->a], regs[in->b], m);
+                    else dispatch->mul_n(dst, regs[in->a], regs[in->b], m);
+                    regs[in->dst] = dst;
+                    break;
+                case EXPR_OP_SCALE:
+                    if (run->wide) dispatch->scale_f64_n(dst, regs[in->a], in->scalar, m);
+                    else dispatch->scale_n(dst, regs[in->a], in->scalar, m);
+                    regs[in->dst] = dst;
+                    break;
+                case EXPR_OP_FMA:
+                    if (run->wide) dispatch->fmadd_f64_n(dst, regs[in->a], regs[in->b], regs[in->c], m);
+                    else dispatch->fmadd_n(dst, regs[in->a], regs[in->b], regs[in->c], m);
+                    regs[in->dst] = dst;
+                    break;
+                case EXPR_OP_UNARY:
+                    if (run->wide) expr_unary_f64_kernel(dispatch, in->fn)(dst, regs[in->a], m);
+                    else expr_unary_kernel(dispatch, in->fn)(dst, regs[in->a], m);
+                    regs[in->dst] = dst;
+                    break;
+            }
+        }
+
+        const void* value = regs[prog->result];
+        if (run->reducing) {
+            // accumulators are always of the compute type
+            if (run->wide) expr_reduce_block_f64(run, (double*)out, out_stride, value, m);
+            else expr_reduce_block(run, (float*)out, out_stride, value, m);
+        } else if (value == out) {
+            continue;
+        } else if (out_stride == 1) {
+            expr_convert_out(run, out, value, m);
+        } else if (run->result_dtype == expr_compute_dtype(run->wide)) {
+            expr_scatter(out, out_stride, value, m, out_size);
+        } else {
+            expr_convert_out(run, expr_stage(run), value, m);
+            expr_scatter(out, out_stride, expr_stage(run), m, out_size);
+        }
+    }
+}
+
+// leaf strides over the iteration shape, 0 along every axis a leaf is
+// broadcast on. the leaves themselves are left untouched
+typedef struct {
+    size_t strides[ARRAY_ITER_MAX_OPS][ARRAY_ITER_MAX_DIMS];
+    const size_t* ops[ARRAY_ITER_MAX_OPS];
+} expr_binding_t;
+
+// strides for operand 0 (the result) are left to the caller
+static void expr_bind_leaves(expr_binding_t* bind, array_t* const* leaves, size_t nleaves,
+                             const size_t* shape, size_t ndim) {
+    assert(ndim <= ARRAY_ITER_MAX_DIMS);
+    for (size_t i = 0; i < nleaves; i++) {
+        bool ok = array_broadcast_strides(leaves[i], (size_t*)shape, ndim, bind->strides[1 + i]);
+        assert(ok);
+        (void)ok;
+        bind->ops[1 + i] = bind->strides[1 + i];
+    }
+}
+
+// the shape a reduction iterates over: every leaf broadcast together, which
+// is the shape of the reduced operand
+static size_t expr_leaves_shape(array_t* const* leaves, size_t nleaves, size_t* shape) {
+    size_t ndim = 0;
+    for (size_t i = 0; i < nleaves; i++) {
+        if (leaves[i]->ndim > ndim) ndim = leaves[i]->ndim;
+    }
+    assert(ndim <= ARRAY_ITER_MAX_DIMS);
+    for (size_t d = 0; d < ndim; d++) shape[d] = 1;
+
+    for (size_t i = 0; i < nleaves; i++) {
+        const array_t* leaf = leaves[i];
+        size_t lead = ndim - leaf->ndim;
+        for (size_t d = 0; d < leaf->ndim; d++) {
+            size_t n = leaf->shape[d];
+            assert(n == 1 || shape[lead + d] == 1 || shape[lead + d] == n);
+            if (n != 1) shape[lead + d] = n;
+        }
+    }
+    return ndim;
+}
+
+// each worker gets its own block registers
+static expr_run_t* expr_runs_create(const expr_kernel_t* kernel, array_t* const* leaves,
+                                    simd_dispatch_t* dispatch, void* result,
+                                    array_dtype_t result_dtype, bool wide) {
+    size_t nworkers = thread_pool_size(dispatch->pool);
+    expr_run_t* runs = malloc(nworkers * sizeof(expr_run_t));
+    for (size_t w = 0; w < nworkers; w++) {
+        runs[w].prog = &kernel->prog;
+        runs[w].leaves = leaves;
+        runs[w].dispatch = dispatch;
+        runs[w].result = result;
+        runs[w].result_dtype = result_dtype;
+        runs[w].wide = wide;
+        runs[w].result_size = array_dtype_size(result_dtype);
+        for (size_t i = 0; i < kernel->prog.nleaves; i++) {
+            runs[w].leaf_size[i] = array_dtype_size(leaves[i]->dtype);
+        }
+        runs[w].scratch = aligned_alloc(ARRAY_ALIGNMENT, (kernel->prog.nregs + 2) * sizeof(expr_reg_t));
+        runs[w].regs = malloc(kernel->prog.nregs * sizeof(const void*));
+        runs[w].reducing = kernel->reduce;
+        runs[w].reduce_op = kernel->reduce_op;
+    }
+    return runs;
+}
+
+static void expr_runs_free(expr_run_t* runs, simd_dispatch_t* dispatch) {
+    size_t nworkers = thread_pool_size(dispatch->pool);
+    for (size_t w = 0; w < nworkers; w++) {
+        free(runs[w].scratch);
+        free(runs[w].regs);
+    }
+    free(runs);
+}
+
+static float expr_reduce_identity(array_reduce_op_t op) {
+    return op == ARRAY_REDUCE_MAX ? -INFINITY : op == ARRAY_REDUCE_MIN ? INFINITY : 0.0f;
+}
+
+typedef struct {
+    const array_iter_t* it;
+    expr_run_t* runs;
+    // one float or double per chunk, matching the compute type
+    void* partials;
+    float identity;
+} expr_total_job_t;
+
+// one partial per fixed chunk, however many chunks [begin, end) spans
+static void expr_total_chunk(void* ctx, size_t begin, size_t end, size_t worker) {
+    expr_total_job_t* job = ctx;
+    expr_run_t* run = &job->runs[worker];
+
+    for (size_t c = begin / ARRAY_PARALLEL_CHUNK; c * ARRAY_PARALLEL_CHUNK < end; c++) {
+        size_t chunk_end = (c + 1) * ARRAY_PARALLEL_CHUNK < end ? (c + 1) * ARRAY_PARALLEL_CHUNK : end;
+        if (run->wide) {
+            double* acc = (double*)job->partials + c;
+            *acc = job->identity;
+            run->result = acc;
+        } else {
+            float* acc = (float*)job->partials + c;
+            *acc = job->identity;
+            run->result = acc;
+        }
+        array_iter_range(job->it, c * ARRAY_PARALLEL_CHUNK, chunk_end, expr_run_inner, run);
+    }
+}
+
+// max and min keep the extreme partial; sums are combined pairwise, as
+// array_sum does, in the compute type
+#define EXPR_COMBINE_PARTIALS(name, type)                                       \
+    static double name(array_reduce_op_t op, type* partials, size_t nchunks,    \
+                       size_t count) {                                          \
+        type value;                                                             \
+        if (op == ARRAY_REDUCE_MAX || op == ARRAY_REDUCE_MIN) {                 \
+            value = partials[0];                                                \
+            for (size_t c = 1; c < nchunks; c++) {                              \
+                type x = partials[c];                                           \
+                if (op == ARRAY_REDUCE_MAX ? x > value : x < value) value = x;  \
+            }                                                                   \
+            return value;                                                       \
+        }                                                                       \
+        for (size_t step = 1; step < nchunks; step *= 2) {                      \
+            for (size_t c = 0; c + step < nchunks; c += 2 * step) {             \
+                partials[c] += partials[c + step];                              \
+            }                                                                   \
+        }                                                                       \
+        value = partials[0];                                                    \
+        if (op == ARRAY_REDUCE_MEAN) value /= (type)count;                      \
+        return value;                                                           \
+    }
+
+EXPR_COMBINE_PARTIALS(expr_combine_f32, float)
+EXPR_COMBINE_PARTIALS(expr_combine_f64, double)
+
+// a full reduction gives every fixed-size chunk of the iteration space its own
+// accumulator (the result operand has stride 0 on every axis), so chunks run
+// in parallel without sharing anything and the partials combine in a fixed
+// order regardless of the thread count
+static double expr_reduce_total(const expr_kernel_t* kernel, array_t* const* leaves, bool wide,
+                                simd_dispatch_t* dispatch) {
+    array_reduce_op_t op = kernel->reduce_op;
+    size_t shape[ARRAY_ITER_MAX_DIMS];
+    size_t ndim = expr_leaves_shape(leaves, kernel->prog.nleaves, shape);
+
+    size_t zeros[ARRAY_ITER_MAX_DIMS] = {0};
+    expr_binding_t bind;
+    bind.ops[0] = zeros;
+    expr_bind_leaves(&bind, leaves, kernel->prog.nleaves, shape, ndim);
+
+    array_iter_t it;
+    array_iter_init(&it, shape, ndim, 1 + kernel->prog.nleaves, bind.ops);
+
+    float identity = expr_reduce_identity(op);
+    if (it.size == 0) return op == ARRAY_REDUCE_MEAN ? NAN : identity;
+
+    size_t nchunks = (it.size + ARRAY_PARALLEL_CHUNK - 1) / ARRAY_PARALLEL_CHUNK;
+    void* partials = malloc(nchunks * sizeof(double));
+    array_dtype_t compute = expr_compute_dtype(wide);
+    expr_run_t* runs = expr_runs_create(kernel, leaves, dispatch, NULL, compute, wide);
+    expr_total_job_t job = {&it, runs, partials, identity};
+
+    if (dispatch->pool && it.size >= ARRAY_PARALLEL_MIN) {
+        thread_pool_parallel_for(dispatch->pool, it.size, ARRAY_PARALLEL_CHUNK, expr_total_chunk, &job);
+    } else {
+        expr_total_chunk(&job, 0, it.size, 0);
+    }
+
+    double value = wide ? expr_combine_f64(op, partials, nchunks, it.size)
+                        : expr_combine_f32(op, partials, nchunks, it.size);
+
+    expr_runs_free(runs, dispatch);
+    free(partials);
+    return value;
+}
+
+// writes a full reduction's value into a result of any format
+static void expr_store_scalar(array_t* result, double value, simd_dispatch_t* dispatch) {
+    float narrow = (float)value;
+    switch (result->dtype) {
+        case ARRAY_FLOAT64: *(double*)result->raw = value; break;
+        case ARRAY_FLOAT32: result->data[0] = narrow; break;
+        case ARRAY_INT32: *(int32_t*)result->raw = expr_f64_to_i32(value); break;
+        default: expr_store_kernel(dispatch, result->dtype)(result->raw, &narrow, 1); break;
+    }
+}
+
+typedef struct {
+    void* data;
+    bool wide;
+    double scale;
+} expr_scale_t;
+
+static void expr_scale_inner(void* ctx, const size_t* offsets, const size_t* inner_strides, size_t n) {
+    expr_scale_t* op = ctx;
+    if (op->wide) {
+        double* out = (double*)op->data + offsets[0];
+        for (size_t i = 0; i < n; i++) out[i * inner_strides[0]] *= op->scale;
+    } else {
+        float* out = (float*)op->data + offsets[0];
+        float scale = (float)op->scale;
+        for (size_t i = 0; i < n; i++) out[i * inner_strides[0]] *= scale;
+    }
+}
+
+// an axis reduction walks the operand's shape with the result as operand 0 at
+// stride 0 along the reduced axis. several inputs land on each output, so it
+// runs on the calling thread. accumulators are in the compute type: a result
+// in another format gets a temporary that is converted into it at the end
+static void expr_reduce_axis_eval(const expr_kernel_t* kernel, array_t* const* leaves,
+                                  array_t* result, bool wide, simd_dispatch_t* dispatch) {
+    array_reduce_op_t op = kernel->reduce_op;
+    size_t axis = kernel->reduce_axis;
+    size_t shape[ARRAY_ITER_MAX_DIMS];
+    size_t ndim = expr_leaves_shape(leaves, kernel->prog.nleaves, shape);
+    bool keepdims = result->ndim == ndim;
+
+    assert(axis < ndim);
+    assert(keepdims || result->ndim + 1 == ndim);
+
+    array_dtype_t compute = expr_compute_dtype(wide);
+    array_t* acc = result->dtype == compute ? result
+                                            : array_create_typed(result->shape, result->ndim, compute);
+
+    size_t result_strides[ARRAY_ITER_MAX_DIMS];
+    for (size_t d = 0, r = 0; d < ndim; d++) {
+        if (d == axis) {
+            assert(!keepdims || result->shape[d] == 1);
+            result_strides[d] = 0;
+            if (keepdims) r++;
+            continue;
+        }
+        assert(result->shape[r] == shape[d]);
+        result_strides[d] = acc->strides[r++];
+    }
+
+    expr_binding_t bind;
+    bind.ops[0] = result_strides;
+    expr_bind_leaves(&bind, leaves, kernel->prog.nleaves, shape, ndim);
+
+    array_iter_t it;
+    array_iter_init(&it, shape, ndim, 1 + kernel->prog.nleaves, bind.ops);
+
+    array_fill(acc, expr_reduce_identity(op));
+    expr_run_t* runs = expr_runs_create(kernel, leaves, dispatch, acc->raw, compute, wide);
+    array_iter_range(&it, 0, it.size, expr_run_inner, runs);
+    expr_runs_free(runs, dispatch);
+
+    if (op == ARRAY_REDUCE_MEAN) {
+        const size_t* own[1] = {acc->strides};
+        array_iter_t out_it;
+        array_iter_init(&out_it, acc->shape, acc->ndim, 1, own);
+
+        expr_scale_t scale = {acc->raw, wide, 1.0 / (double)shape[axis]};
+        array_iter_range(&out_it, 0, out_it.size, expr_scale_inner, &scale);
+    }
+
+    if (acc != result) {
+        expr_t* leaf = expr_from_array(acc);
+        expr_eval(leaf, result, dispatch);
+        expr_free(leaf);
+        array_free(acc);
+    }
+}
+
+expr_kernel_t* expr_compile(expr_t* expr) {
+    expr_signature_t sig;
+    signature_build(&sig, expr);
+    if (sig.split) {
+        signature_free(&sig);
+        return NULL;
+    }
+    expr_kernel_t* kernel = kernel_acquire(expr, &sig);
+    signature_free(&sig);
+    return kernel;
+}
+
+size_t expr_kernel_nleaves(const expr_kernel_t* kernel) {
+    return kernel->prog.nleaves;
+}
+
+void expr_kernel_free(expr_kernel_t* kernel) {
+    if (kernel) kernel_release(kernel);
+}
+
+// bytes read from the leaves, each counted once however it is broadcast
+static inline size_t expr_leaf_bytes(array_t* const* leaves, size_t nleaves) {
+    size_t bytes = 0;
+    for (size_t i = 0; i < nleaves; i++) {
+        bytes += leaves[i]->size * array_dtype_size(leaves[i]->dtype);
+    }
+    return bytes;
+}
+
+// every block of every leaf is loaded before the block of the result at the
+// same position is stored, so a result can overwrite a leaf in one pass when
+// it is that leaf element for element. any other overlap, or any overlap at
+// all for an axis reduction (which fills its result before reading), would
+// read elements that were already written. bind is NULL for a reduction
+static bool expr_result_conflicts(array_t* const* leaves, size_t nleaves, array_t* result,
+                                  const expr_binding_t* bind) {
+    for (size_t i = 0; i < nleaves; i++) {
+        array_t* leaf = leaves[i];
+        if (!array_shares_memory(leaf, result)) continue;
+        if (!bind || leaf->raw != result->raw || leaf->dtype != result->dtype) return true;
+        for (size_t d = 0; d < result->ndim; d++) {
+            if (result->shape[d] > 1 && bind->strides[1 + i][d] != result->strides[d]) return true;
+        }
+    }
+    return false;
+}
+
+static void expr_kernel_eval_into(expr_kernel_t* kernel, array_t** leaves, array_t* result,
+                                  simd_dispatch_t* dispatch);
+
+// evaluates into a temporary of the result's shape and format, then copies it
+// over with a lone-leaf expression
+static void expr_eval_staged(expr_kernel_t* kernel, array_t** leaves, array_t* result,
+                             simd_dispatch_t* dispatch) {
+    array_t* staged = array_create_typed(result->shape, result->ndim, result->dtype);
+    expr_kernel_eval_into(kernel, leaves, staged, dispatch);
+
+    expr_t* leaf = expr_from_array(staged);
+    expr_eval(leaf, result, dispatch);
+    expr_free(leaf);
+    array_free(staged);
+}
+
+static void expr_kernel_eval_into(expr_kernel_t* kernel, array_t** leaves, array_t* result,
+                                  simd_dispatch_t* dispatch) {
+    bool wide = expr_wide(leaves, kernel->prog.nleaves, result);
+    if (kernel->reduce) {
+        if (kernel->reduce_axis == EXPR_ALL_AXES) {
+            assert(result->size == 1);
+            expr_store_scalar(result, expr_reduce_total(kernel, leaves, wide, dispatch), dispatch);
+        } else if (expr_result_conflicts(leaves, kernel->prog.nleaves, result, NULL)) {
+            expr_eval_staged(kernel, leaves, result, dispatch);
+        } else {
+            expr_reduce_axis_eval(kernel, leaves, result, wide, dispatch);
+        }
+        return;
+    }
+
+    expr_binding_t bind;
+    bind.ops[0] = result->strides;
+    expr_bind_leaves(&bind, leaves, kernel->prog.nleaves, result->shape, result->ndim);
+    if (expr_result_conflicts(leaves, kernel->prog.nleaves, result, &bind)) {
+        expr_eval_staged(kernel, leaves, result, dispatch);
+        return;
+    }
+
+    array_iter_t it;
+    array_iter_init(&it, result->shape, result->ndim, 1 + kernel->prog.nleaves, bind.ops);
+
+    expr_run_t* runs = expr_runs_create(kernel, leaves, dispatch, result->raw, result->dtype, wide);
+    array_iter_parallel(&it, dispatch->pool, expr_run_inner, runs, sizeof(expr_run_t));
+    expr_runs_free(runs, dispatch);
+}
+
+void expr_kernel_eval(expr_kernel_t* kernel, array_t** leaves, array_t* result,
+                      simd_dispatch_t* dispatch) {
+    SIMD_STATS_BEGIN(stats, dispatch->stats, SIMD_STATS_EXPR);
+    expr_kernel_eval_into(kernel, leaves, result, dispatch);
+    SIMD_STATS_END(stats, result->size, expr_leaf_bytes(leaves, kernel->prog.nleaves) +
+                                        result->size * array_dtype_size(result->dtype));
+}
+
+float expr_kernel_eval_scalar(expr_kernel_t* kernel, array_t** leaves, simd_dispatch_t* dispatch) {
+    assert(kernel->reduce && kernel->reduce_axis == EXPR_ALL_AXES);
+    SIMD_STATS_BEGIN(stats, dispatch->stats, SIMD_STATS_EXPR);
+    bool wide = expr_wide(leaves, kernel->prog.nleaves, NULL);
+    float value = (float)expr_reduce_total(kernel, leaves, wide, dispatch);
+    SIMD_STATS_END(stats, 1, expr_leaf_bytes(leaves, kernel->prog.nleaves));
+    return value;
+}
+
+typedef struct {
+    expr_run_t* runs;
+    // per worker: nleaves leaf headers that are pointed at each item in turn,
+    // and the pointers to them the worker's run reads its leaves through
+    array_t* headers;
+    array_t** views;
+    const array_batch_t* leaves;
+    const array_batch_t* result;
+    size_t nleaves;
+    size_t n;
+} expr_batch_job_t;
+
+// every item is one contiguous run, so it goes straight to expr_run_inner
+// without an iterator
+static void expr_batch_chunk(void* ctx, size_t begin, size_t end, size_t worker) {
+    expr_batch_job_t* job = ctx;
+    expr_run_t* run = &job->runs[worker];
+    array_t* headers = job->headers + worker * job->nleaves;
+    size_t offsets[ARRAY_ITER_MAX_OPS] = {0};
+    size_t strides[ARRAY_ITER_MAX_OPS];
+    for (size_t i = 0; i <= job->nleaves; i++) strides[i] = 1;
+
+    for (size_t k = begin; k < end; k++) {
+        for (size_t i = 0; i < job->nleaves; i++) {
+            headers[i].raw = array_batch_item(&job->leaves[i], k);
+        }
+        run->result = array_batch_item(job->result, k);
+        expr_run_inner(run, offsets, strides, job->n);
+    }
+}
+
+void expr_kernel_eval_batch(expr_kernel_t* kernel, const array_batch_t* leaves,
+                            const array_batch_t* result, size_t count, size_t n,
+                            simd_dispatch_t* dispatch) {
+    assert(!kernel->reduce);
+    SIMD_STATS_BEGIN(stats, dispatch->stats, SIMD_STATS_EXPR);
+    size_t nleaves = kernel->prog.nleaves;
+    size_t nworkers = thread_pool_size(dispatch->pool);
+
+    // headers carry each parameter's format; their data is set per item
+    expr_batch_job_t job;
+    job.headers = calloc(nworkers * nleaves, sizeof(array_t));
+    job.views = malloc(nworkers * nleaves * sizeof(array_t*));
+    for (size_t w = 0; w < nworkers; w++) {
+        for (size_t i = 0; i < nleaves; i++) {
+            array_t* header = &job.headers[w * nleaves + i];
+            header->dtype = leaves[i].dtype;
+            header->shape = header->shape_inline;
+            header->strides = header->strides_inline;
+            header->ndim = 1;
+            header->shape[0] = n;
+            header->strides[0] = 1;
+            header->size = n;
+            job.views[w * nleaves + i] = header;
+        }
+    }
+    array_t result_header = {.dtype = result->dtype};
+    bool wide = expr_wide(job.views, nleaves, &result_header);
+
+    job.runs = expr_runs_create(kernel, job.views, dispatch, NULL, result->dtype, wide);
+    for (size_t w = 0; w < nworkers; w++) {
+        job.runs[w].leaves = job.views + w * nleaves;
+    }
+    job.leaves = leaves;
+    job.result = result;
+    job.nleaves = nleaves;
+    job.n = n;
+
+    thread_pool_t* pool = count * n >= ARRAY_PARALLEL_MIN ? dispatch->pool : NULL;
+    thread_pool_parallel_for(pool, count, array_batch_chunk(n), expr_batch_chunk, &job);
+
+    expr_runs_free(job.runs, dispatch);
+    free(job.views);
+    free(job.headers);
+
+    size_t bytes = array_dtype_size(result->dtype);
+    for (size_t i = 0; i < nleaves; i++) {
+        bytes += array_dtype_size(leaves[i].dtype);
+    }
+    SIMD_STATS_END(stats, count * n, count * n * bytes);
+}
+
+// distinct leaf arrays of a tree appended to leaves[0..n), counting stops
+// once there are more than EXPR_MAX_LEAVES
+static size_t expr_collect_leaves(expr_t* expr, array_t** leaves, size_t n) {
+    if (n > EXPR_MAX_LEAVES) return n;
+
+    switch (expr->type) {
+        case EXPR_ARRAY:
+            for (size_t i = 0; i < n; i++) {
+                if (leaves[i] == expr->data.leaf.array) return n;
+            }
+            leaves[n] = expr->data.leaf.array;
+            return n + 1;
+
+        case EXPR_ADD:
+        case EXPR_SUB:
+        case EXPR_MUL:
+            n = expr_collect_leaves(expr->data.binary.left, leaves, n);
+            return expr_collect_leaves(expr->data.binary.right, leaves, n);
+
+        case EXPR_SCALAR_MUL:
+            return expr_collect_leaves(expr->data.scalar_op.operand, leaves, n);
+
+        case EXPR_UNARY:
+            return expr_collect_leaves(expr->data.unary.operand, leaves, n);
+
+        case EXPR_REDUCE:
+            return expr_collect_leaves(expr->data.reduce.operand, leaves, n);
+    }
+    return n;
+}
+
+// distinct leaves read by a and b together (b may be NULL)
+static size_t expr_count_leaves(expr_t* a, expr_t* b) {
+    array_t* leaves[EXPR_MAX_LEAVES + 1];
+    size_t n = expr_collect_leaves(a, leaves, 0);
+    return b ? expr_collect_leaves(b, leaves, n) : n;
+}
+
+// temporaries holding the parts of a tree that was split
+typedef struct {
+    array_t** arrays;
+    size_t n;
+    size_t cap;
+} expr_temps_t;
+
+// evaluates expr, which takes ownership of, into a new temporary and
+// returns a leaf reading it. float64 leaves keep a float64 temporary
+static expr_t* expr_materialize(expr_t* expr, expr_temps_t* temps, simd_dispatch_t* dispatch) {
+    array_t* leaves[EXPR_MAX_LEAVES + 1];
+    size_t n = expr_collect_leaves(expr, leaves, 0);
+    array_t* tmp = array_create_typed(expr->shape, expr->ndim,
+                                      expr_wide(leaves, n, NULL) ? ARRAY_FLOAT64 : ARRAY_FLOAT32);
+    expr_eval(expr, tmp, dispatch);
+    expr_free(expr);
+
+    if (temps->n == temps->cap) {
+        temps->cap = temps->cap ? temps->cap * 2 : 4;
+        temps->arrays = realloc(temps->arrays, temps->cap * sizeof(array_t*));
+    }
+    temps->arrays[temps->n++] = tmp;
+    return expr_from_array(tmp);
+}
+
+static expr_t* expr_split(expr_t* expr, expr_temps_t* temps, simd_dispatch_t* dispatch);
+
+// a reduction below the root is evaluated first, into a temporary of its
+// reduced shape that broadcasts against the rest of the tree
+static expr_t* expr_split_operand(expr_t* operand, expr_temps_t* temps, simd_dispatch_t* dispatch) {
+    expr_t* split = expr_split(operand, temps, dispatch);
+    return split->type == EXPR_REDUCE ? expr_materialize(split, temps, dispatch) : split;
+}
+
+// a copy of expr that compiles as one program: nested reductions become
+// temporaries, and where the two operands of a node read more than
+// EXPR_MAX_LEAVES arrays between them, the one reading more (then, if needed,
+// the other) is evaluated into a temporary first; everything below the cut
+// still fuses into one program
+static expr_t* expr_split(expr_t* expr, expr_temps_t* temps, simd_dispatch_t* dispatch) {
+    switch (expr->type) {
+        case EXPR_ARRAY:
+            return expr_from_array(expr->data.leaf.array);
+
+        case EXPR_SCALAR_MUL:
+            return expr_scalar_mul(expr->data.scalar_op.scalar,
+                                   expr_split_operand(expr->data.scalar_op.operand, temps, dispatch));
+
+        case EXPR_UNARY:
+            return expr_unary(expr_split_operand(expr->data.unary.operand, temps, dispatch),
+                              expr->data.unary.op);
+
+        case EXPR_REDUCE:
+            return expr_reduce_axis(expr_split_operand(expr->data.reduce.operand, temps, dispatch),
+                                    expr->data.reduce.axis, expr->data.reduce.op);
+
+        case EXPR_ADD:
+        case EXPR_SUB:
+        case EXPR_MUL:
+            break;
+    }
+
+    expr_t* left = expr_split_operand(expr->data.binary.left, temps, dispatch);
+    expr_t* right = expr_split_operand(expr->data.binary.right, temps, dispatch);
+    if (expr_count_leaves(left, right) > EXPR_MAX_LEAVES) {
+        if (expr_count_leaves(left, NULL) >= expr_count_leaves(right, NULL)) {
+            left = expr_materialize(left, temps, dispatch);
+        } else {
+            right = expr_materialize(right, temps, dispatch);
+        }
+    }
+    if (expr_count_leaves(left, right) > EXPR_MAX_LEAVES) {
+        if (left->type == EXPR_ARRAY) right = expr_materialize(right, temps, dispatch);
+        else left = expr_materialize(left, temps, dispatch);
+    }
+
+    return expr->type == EXPR_ADD ? expr_add(left, right) :
+           expr->type == EXPR_SUB ? expr_sub(left, right) : expr_mul(left, right);
+}
+
+static void expr_temps_free(expr_temps_t* temps) {
+    for (size_t i = 0; i < temps->n; i++) {
+        array_free(temps->arrays[i]);
+    }
+    free(temps->arrays);
+}
+
+void expr_eval(expr_t* expr, array_t* result, simd_dispatch_t* dispatch) {
+    if (expr->type != EXPR_REDUCE) {
+        assert(result->ndim == expr->ndim);
+        assert(memcmp(result->shape, expr->shape, expr->ndim * sizeof(size_t)) == 0);
+    }
+
+    expr_signature_t sig;
+    signature_build(&sig, expr);
+    if (sig.split) {
+        signature_free(&sig);
+        expr_temps_t temps = {NULL, 0, 0};
+        expr_t* split = expr_split(expr, &temps, dispatch);
+        expr_eval(split, result, dispatch);
+        expr_free(split);
+        expr_temps_free(&temps);
+        return;
+    }
+    expr_kernel_t* kernel = kernel_acquire(expr, &sig);
+
+    expr_kernel_eval(kernel, sig.leaves, result, dispatch);
+
+    kernel_release(kernel);
+    signature_free(&sig);
+}
+
+bool expr_eval_batch(expr_t* expr, const array_batch_t* leaves, const array_batch_t* result,
+                     size_t count, size_t n, simd_dispatch_t* dispatch) {
+    // batch leaves map one to one onto tree leaves, so there is nothing to
+    // bind a temporary to and the tree cannot be evaluated in parts
+    expr_signature_t sig;
+    signature_build(&sig, expr);
+    if (sig.split || expr->type == EXPR_REDUCE) {
+        signature_free(&sig);
+        errno = EINVAL;
+        return false;
+    }
+    expr_kernel_t* kernel = kernel_acquire(expr, &sig);
+
+    expr_kernel_eval_batch(kernel, leaves, result, count, n, dispatch);
+
+    kernel_release(kernel);
+    signature_free(&sig);
+    return true;
+}
+
+float expr_eval_scalar(expr_t* expr, simd_dispatch_t* dispatch) {
+    expr_signature_t sig;
+    signature_build(&sig, expr);
+    if (sig.split) {
+        signature_free(&sig);
+        expr_temps_t temps = {NULL, 0, 0};
+        expr_t* split = expr_split(expr, &temps, dispatch);
+        float value = expr_eval_scalar(split, dispatch);
+        expr_free(split);
+        expr_temps_free(&temps);
+        return value;
+    }
+    expr_kernel_t* kernel = kernel_acquire(expr, &sig);
+
+    float value = expr_kernel_eval_scalar(kernel, sig.leaves, dispatch);
+
+    kernel_release(kernel);
+    signature_free(&sig);
+    return value;
+}
+
+void expr_free(expr_t* expr) {
+    if (!expr) return;
+
+    switch (expr->type) {
+        case EXPR_ADD:
+        case EXPR_SUB:
+        case EXPR_MUL:
+            expr_free(expr->data.binary.left);
+            expr_free(expr->data.binary.right);
+            break;
+
+        case EXPR_SCALAR_MUL:
+            expr_free(expr->data.scalar_op.operand);
+            break;
+
+        case EXPR_UNARY:
+            expr_free(expr->data.unary.operand);
+            break;
+
+        case EXPR_REDUCE:
+            expr_free(expr->data.reduce.operand);
+            break;
+
+        case EXPR_ARRAY:
+            break;
+    }
+
+    if (expr->shape != expr->shape_inline) {
+        free(expr->shape);
+    }
+    free(expr);
+}
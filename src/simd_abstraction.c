@@ -1,12 +1,10 @@
 #include "simd_abstraction.h"
+#include "simd_backends.h"
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#ifdef __AVX2__
-#include <immintrin.h>
-#endif
-
 #ifdef __SSE2__
 #include <emmintrin.h>
 #endif
@@ -15,18 +13,159 @@
 #include <arm_neon.h>
 #endif
 
-simd_backend_t simd_detect(void) {
-    #if defined(__AVX512F__)
-        return BACKEND_AVX512;
-    #elif defined(__AVX2__)
-        return BACKEND_AVX2;
-    #elif defined(__SSE2__)
-        return BACKEND_SSE;
-    #elif defined(__ARM_NEON)
-        return BACKEND_NEON;
-    #else
-        return BACKEND_SCALAR;
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <cpuid.h>
+
+static unsigned long long cpu_xgetbv(void) {
+    unsigned int lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((unsigned long long)hi << 32) | lo;
+}
+
+// CPUID only says the instructions exist; the OS must also have enabled
+// saving of the wider register state in XCR0 or they fault on first use
+static int cpu_os_saves(unsigned long long state) {
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_OSXSAVE)) {
+        return 0;
+    }
+    return (cpu_xgetbv() & state) == state;
+}
+
+static int cpu_has_sse2(void) {
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return (edx & bit_SSE2) != 0;
+    }
+    return 0;
+}
+
+// the AVX2 backend also uses FMA and the F16C conversions, which every AVX2
+// CPU has in practice
+static int cpu_has_avx2(void) {
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_FMA) || !(ecx & bit_F16C)) {
+        return 0;
+    }
+    if (__get_cpuid_max(0, NULL) >= 7) {
+        __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx);
+        // XMM and YMM state
+        return (ebx & bit_AVX2) != 0 && cpu_os_saves(0x6);
+    }
+    return 0;
+}
+
+static int cpu_has_avx512f(void) {
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (__get_cpuid_max(0, NULL) >= 7) {
+        __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx);
+        // XMM, YMM, opmask, upper halves of ZMM0-15 and ZMM16-31
+        return (ebx & bit_AVX512F) != 0 && cpu_os_saves(0xE6);
+    }
+    return 0;
+}
+
+static int cpu_has_avx512_bf16(void) {
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (!cpu_has_avx512f() || __get_cpuid_max(0, NULL) < 7) return 0;
+    __get_cpuid_count(7, 1, &eax, &ebx, &ecx, &edx);
+    return (eax & bit_AVX512BF16) != 0;
+}
+#else
+static int cpu_has_sse2(void) { return 0; }
+static int cpu_has_avx2(void) { return 0; }
+static int cpu_has_avx512f(void) { return 0; }
+static int cpu_has_avx512_bf16(void) { return 0; }
+#endif
+
+// CPUID and XGETBV run once per process; everything else reads the answers
+// cached here
+static pthread_once_t features_once = PTHREAD_ONCE_INIT;
+static simd_features_t features;
+
+// whether this build has the backend's kernels and the CPU can run them
+static bool backend_available(simd_backend_t backend) {
+    switch (backend) {
+        case BACKEND_SCALAR:
+            return true;
+        case BACKEND_SSE:
+            #ifdef SIMD_HAVE_SSE2
+            return features.sse2;
+            #else
+            return false;
+            #endif
+        case BACKEND_AVX2:
+            #ifdef SIMD_HAVE_AVX2
+            return features.avx2;
+            #else
+            return false;
+            #endif
+        case BACKEND_AVX512:
+            #ifdef SIMD_HAVE_AVX512
+            return features.avx512f;
+            #else
+            return false;
+            #endif
+        default:
+            return false;
+    }
+}
+
+static void features_init(void) {
+    features.sse2 = cpu_has_sse2();
+    features.avx2 = cpu_has_avx2();
+    features.avx512f = cpu_has_avx512f();
+    features.avx512_bf16 = cpu_has_avx512_bf16();
+    #if defined(__ARM_NEON)
+    features.neon = true;
     #endif
+
+    if (features.avx512f) features.detected = BACKEND_AVX512;
+    else if (features.avx2) features.detected = BACKEND_AVX2;
+    else if (features.sse2) features.detected = BACKEND_SSE;
+    else if (features.neon) features.detected = BACKEND_NEON;
+    else features.detected = BACKEND_SCALAR;
+
+    // the widest backend at or below the detected one that was compiled in
+    features.best = BACKEND_SCALAR;
+    for (int b = BACKEND_AVX512; b > BACKEND_SCALAR; b--) {
+        if (b <= (int)features.detected && backend_available((simd_backend_t)b)) {
+            features.best = (simd_backend_t)b;
+            break;
+        }
+    }
+}
+
+const simd_features_t* simd_features(void) {
+    pthread_once(&features_once, features_init);
+    return &features;
+}
+
+int simd_cpu_has_avx512_bf16(void) {
+    return simd_features()->avx512_bf16;
+}
+
+simd_backend_t simd_detect(void) {
+    return simd_features()->detected;
+}
+
+const char* simd_backend_name(simd_backend_t backend) {
+    static const char* names[] = {"scalar", "sse2", "avx2", "avx512", "neon"};
+    return (unsigned)backend < sizeof(names) / sizeof(names[0]) ? names[backend] : "unknown";
+}
+
+bool simd_backend_from_name(const char* name, simd_backend_t* backend) {
+    for (int b = BACKEND_SCALAR; b <= BACKEND_NEON; b++) {
+        if (strcmp(name, simd_backend_name((simd_backend_t)b)) == 0) {
+            *backend = (simd_backend_t)b;
+            return true;
+        }
+    }
+    if (strcmp(name, "sse") == 0) {
+        *backend = BACKEND_SSE;
+        return true;
+    }
+    return false;
 }
 
 void simd_print_backend(simd_backend_t backend) {
@@ -37,7 +176,8 @@ void simd_print_backend(simd_backend_t backend) {
         "AVX-512 (16 floats)",
         "NEON (4 floats)"
     };
-    printf("SIMD Backend: %s\n", names[backend]);
+    bool known = (unsigned)backend < sizeof(names) / sizeof(names[0]);
+    printf("SIMD Backend: %s\n", known ? names[backend] : "unknown");
 }
 
 simd_vec_t simd_load(const float* ptr) {
@@ -85,160 +225,90 @@ void simd_store(float* ptr, simd_vec_t vec) {
         }
     #endif
 }
-static simd_vec_t simd_add_scalar(simd_vec_t a, simd_vec_t b) {
-    simd_vec_t result;
-    for(int i = 0; i < 8; i++) 
-        result.data[i] = a.data[i] + b.data[i];
-    
-    return result;
-}
 
-static simd_vec_t simd_mul_scalar(simd_vec_t a, simd_vec_t b) {
-    simd_vec_t result;
-    for(int i = 0; i < 8; i++) 
-        result.data[i] = a.data[i] * b.data[i];
-    
-    return result;
-}
+simd_dispatch_t* simd_init_dispatch_backend(simd_backend_t backend) {
+    // backend_available reads the cached features
+    simd_features();
+    if (!backend_available(backend)) return NULL;
 
-static simd_vec_t simd_fmadd_scalar(simd_vec_t a, simd_vec_t b, simd_vec_t c) {
-    simd_vec_t result;
-    for(int i = 0; i < 8; i++) 
-        result.data[i] = a.data[i] * b.data[i] + c.data[i];
-    
-    return result;
-}
+    simd_dispatch_t* dispatch = malloc(sizeof(simd_dispatch_t));
+    dispatch->backend = backend;
+    dispatch->pool = NULL;
+    dispatch->stats = NULL;
 
-#ifdef __SSE2__
-static simd_vec_t simd_add_sse(simd_vec_t a, simd_vec_t b) {
-    simd_vec_t result;
-    
-    __m128 va_low = _mm_loadu_ps(a.data);
-    __m128 vb_low = _mm_loadu_ps(b.data);
-    __m128 vr_low = _mm_add_ps(va_low, vb_low);
-    _mm_storeu_ps(result.data, vr_low);
-    
-    __m128 va_high = _mm_loadu_ps(a.data + 4);
-    __m128 vb_high = _mm_loadu_ps(b.data + 4);
-    __m128 vr_high = _mm_add_ps(va_high, vb_high);
-    _mm_storeu_ps(result.data + 4, vr_high);
-    
-    return result;
+    // backend_available has ruled out every backend that was not compiled in
+    switch (backend) {
+        case BACKEND_SSE:
+            #ifdef SIMD_HAVE_SSE2
+            dispatch->lanes = 4;
+            simd_use_sse(dispatch);
+            #endif
+            break;
+        case BACKEND_AVX2:
+            #ifdef SIMD_HAVE_AVX2
+            dispatch->lanes = 8;
+            simd_use_avx2(dispatch);
+            #endif
+            break;
+        case BACKEND_AVX512:
+            #ifdef SIMD_HAVE_AVX512
+            dispatch->lanes = 16;
+            simd_use_avx512(dispatch);
+            #endif
+            break;
+        default:
+            dispatch->lanes = 1;
+            simd_use_scalar(dispatch);
+            break;
+    }
+    return dispatch;
 }
 
-static simd_vec_t simd_mul_sse(simd_vec_t a, simd_vec_t b) {
-    simd_vec_t result;
-    
-    __m128 va_low = _mm_loadu_ps(a.data);
-    __m128 vb_low = _mm_loadu_ps(b.data);
-    __m128 vr_low = _mm_mul_ps(va_low, vb_low);
-    _mm_storeu_ps(result.data, vr_low);
-    
-    __m128 va_high = _mm_loadu_ps(a.data + 4);
-    __m128 vb_high = _mm_loadu_ps(b.data + 4);
-    __m128 vr_high = _mm_mul_ps(va_high, vb_high);
-    _mm_storeu_ps(result.data + 4, vr_high);
-    
-    return result;
-}
+// the process-wide table. simd_set_default_backend and SIMD_BACKEND are only
+// looked at when it is built, on first use
+static pthread_once_t default_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t default_lock = PTHREAD_MUTEX_INITIALIZER;
+static simd_dispatch_t* default_dispatch;
+static bool default_built;
+static bool default_forced;
+static simd_backend_t default_request;
 
-static simd_vec_t simd_fmadd_sse(simd_vec_t a, simd_vec_t b, simd_vec_t c) {
-    simd_vec_t temp = simd_mul_sse(a, b);
-    return simd_add_sse(temp, c);
-}
-#endif
+static void default_init(void) {
+    pthread_mutex_lock(&default_lock);
+    simd_backend_t backend = simd_features()->best;
+    const char* env = getenv("SIMD_BACKEND");
+    simd_backend_t named;
 
-#ifdef __AVX2__
-static simd_vec_t simd_add_avx2(simd_vec_t a, simd_vec_t b) {
-    simd_vec_t result;
-    __m256 va = _mm256_loadu_ps(a.data);
-    __m256 vb = _mm256_loadu_ps(b.data);
-    __m256 vr = _mm256_add_ps(va, vb);
-    _mm256_storeu_ps(result.data, vr);
-    return result;
-}
-
-static simd_vec_t simd_mul_avx2(simd_vec_t a, simd_vec_t b) {
-    simd_vec_t result;
-    __m256 va = _mm256_loadu_ps(a.data);
-    __m256 vb = _mm256_loadu_ps(b.data);
-    __m256 vr = _mm256_mul_ps(va, vb);
-    _mm256_storeu_ps(result.data, vr);
-    return result;
-}
-
-static simd_vec_t simd_fmadd_avx2(simd_vec_t a, simd_vec_t b, simd_vec_t c) {
-    simd_vec_t result;
-    __m256 va = _mm256_loadu_ps(a.data);
-    __m256 vb = _mm256_loadu_ps(b.data);
-    __m256 vc = _mm256_loadu_ps(c.data);
-    __m256 vr = _mm256_fmadd_ps(va, vb, vc);
-    _mm256_storeu_ps(result.data, vr);
-    return result;
+    if (default_forced) {
+        backend = default_request;
+    } else if (env && simd_backend_from_name(env, &named) && backend_available(named)) {
+        backend = named;
+    }
+    default_dispatch = simd_init_dispatch_backend(backend);
+    default_built = true;
+    pthread_mutex_unlock(&default_lock);
 }
-#endif
 
-#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
-#include <cpuid.h>
-
-static int cpu_has_sse2(void) {
-    unsigned int eax, ebx, ecx, edx;
-    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
-        return (edx & bit_SSE2) != 0;
-    }
-    return 0;
+const simd_dispatch_t* simd_default_dispatch(void) {
+    pthread_once(&default_once, default_init);
+    return default_dispatch;
 }
 
-static int cpu_has_avx2(void) {
-    unsigned int eax, ebx, ecx, edx;
-    if (__get_cpuid_max(0, NULL) >= 7) {
-        __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx);
-        return (ebx & bit_AVX2) != 0;
+bool simd_set_default_backend(simd_backend_t backend) {
+    simd_features();
+    pthread_mutex_lock(&default_lock);
+    bool ok = !default_built && backend_available(backend);
+    if (ok) {
+        default_forced = true;
+        default_request = backend;
     }
-    return 0;
+    pthread_mutex_unlock(&default_lock);
+    return ok;
 }
-#else
-static int cpu_has_sse2(void) { return 0; }
-static int cpu_has_avx2(void) { return 0; }
-#endif
 
 simd_dispatch_t* simd_init_dispatch(void) {
     simd_dispatch_t* dispatch = malloc(sizeof(simd_dispatch_t));
-    
-    if (cpu_has_avx2()) {
-        dispatch->backend = BACKEND_AVX2;
-        #ifdef __AVX2__
-        dispatch->add = simd_add_avx2;
-        dispatch->mul = simd_mul_avx2;
-        dispatch->fmadd = simd_fmadd_avx2;
-        printf("Using AVX2 implementation\n");
-        #else
-        dispatch->add = simd_add_scalar;
-        dispatch->mul = simd_mul_scalar;
-        dispatch->fmadd = simd_fmadd_scalar;
-        printf("AVX2 detected but not compiled in, using scalar\n");
-        #endif
-    } else if (cpu_has_sse2()) {
-        dispatch->backend = BACKEND_SSE;
-        #ifdef __SSE2__
-        dispatch->add = simd_add_sse;
-        dispatch->mul = simd_mul_sse;
-        dispatch->fmadd = simd_fmadd_sse;
-        printf("Using SSE2 implementation\n");
-        #else
-        dispatch->add = simd_add_scalar;
-        dispatch->mul = simd_mul_scalar;
-        dispatch->fmadd = simd_fmadd_scalar;
-        printf("SSE2 detected but not compiled in, using scalar\n");
-        #endif
-    } else {
-        dispatch->backend = BACKEND_SCALAR;
-        dispatch->add = simd_add_scalar;
-        dispatch->mul = simd_mul_scalar;
-        dispatch->fmadd = simd_fmadd_scalar;
-        printf("Using scalar fallback\n");
-    }
-    
+    *dispatch = *simd_default_dispatch();
     return dispatch;
 }
 
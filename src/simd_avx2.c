@@ -0,0 +1,740 @@
+#include "simd_backends.h"
+
+#ifdef SIMD_HAVE_AVX2
+#include <immintrin.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+static SIMD_TARGET_AVX2 simd_vec_t simd_add_avx2(simd_vec_t a, simd_vec_t b) {
+    simd_vec_t result;
+    __m256 va = _mm256_loadu_ps(a.data);
+    __m256 vb = _mm256_loadu_ps(b.data);
+    __m256 vr = _mm256_add_ps(va, vb);
+    _mm256_storeu_ps(result.data, vr);
+    return result;
+}
+
+static SIMD_TARGET_AVX2 simd_vec_t simd_mul_avx2(simd_vec_t a, simd_vec_t b) {
+    simd_vec_t result;
+    __m256 va = _mm256_loadu_ps(a.data);
+    __m256 vb = _mm256_loadu_ps(b.data);
+    __m256 vr = _mm256_mul_ps(va, vb);
+    _mm256_storeu_ps(result.data, vr);
+    return result;
+}
+
+static SIMD_TARGET_AVX2 simd_vec_t simd_fmadd_avx2(simd_vec_t a, simd_vec_t b, simd_vec_t c) {
+    simd_vec_t result;
+    __m256 va = _mm256_loadu_ps(a.data);
+    __m256 vb = _mm256_loadu_ps(b.data);
+    __m256 vc = _mm256_loadu_ps(c.data);
+    __m256 vr = _mm256_fmadd_ps(va, vb, vc);
+    _mm256_storeu_ps(result.data, vr);
+    return result;
+}
+
+#define AVX2_BINARY_N(name, vop, op, store, prefetch, finish)                   \
+static SIMD_TARGET_AVX2 void name(float* dst, const float* a, const float* b, size_t n) { \
+    size_t i = 0;                                                               \
+    for (; i < n && ((uintptr_t)(dst + i) & 31); i++)                           \
+        dst[i] = a[i] op b[i];                                                  \
+    for (; i + 32 <= n; i += 32) {                                              \
+        prefetch(a + i);                                                        \
+        prefetch(a + i + 16);                                                   \
+        prefetch(b + i);                                                        \
+        prefetch(b + i + 16);                                                   \
+        __m256 r0 = vop(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));        \
+        __m256 r1 = vop(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8)); \
+        __m256 r2 = vop(_mm256_loadu_ps(a + i + 16), _mm256_loadu_ps(b + i + 16)); \
+        __m256 r3 = vop(_mm256_loadu_ps(a + i + 24), _mm256_loadu_ps(b + i + 24)); \
+        store(dst + i, r0);                                                     \
+        store(dst + i + 8, r1);                                                 \
+        store(dst + i + 16, r2);                                                \
+        store(dst + i + 24, r3);                                                \
+    }                                                                           \
+    for (; i + 8 <= n; i += 8)                                                  \
+        store(dst + i, vop(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));    \
+    finish;                                                                     \
+    for (; i < n; i++)                                                          \
+        dst[i] = a[i] op b[i];                                                  \
+}
+
+#define AVX2_FMADD_N(name, store, prefetch, finish)                             \
+static SIMD_TARGET_AVX2 void name(float* dst, const float* a, const float* b, const float* c, size_t n) { \
+    size_t i = 0;                                                               \
+    for (; i < n && ((uintptr_t)(dst + i) & 31); i++)                           \
+        dst[i] = a[i] * b[i] + c[i];                                            \
+    for (; i + 16 <= n; i += 16) {                                              \
+        prefetch(a + i);                                                        \
+        prefetch(b + i);                                                        \
+        prefetch(c + i);                                                        \
+        __m256 r0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), \
+                                    _mm256_loadu_ps(c + i));                    \
+        __m256 r1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), \
+                                    _mm256_loadu_ps(c + i + 8));                \
+        store(dst + i, r0);                                                     \
+        store(dst + i + 8, r1);                                                 \
+    }                                                                           \
+    for (; i + 8 <= n; i += 8)                                                  \
+        store(dst + i, _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), \
+                                       _mm256_loadu_ps(c + i)));                \
+    finish;                                                                     \
+    for (; i < n; i++)                                                          \
+        dst[i] = a[i] * b[i] + c[i];                                            \
+}
+
+AVX2_BINARY_N(simd_add_n_avx2, _mm256_add_ps, +, _mm256_store_ps, SIMD_NO_PREFETCH, (void)0)
+AVX2_BINARY_N(simd_sub_n_avx2, _mm256_sub_ps, -, _mm256_store_ps, SIMD_NO_PREFETCH, (void)0)
+AVX2_BINARY_N(simd_mul_n_avx2, _mm256_mul_ps, *, _mm256_store_ps, SIMD_NO_PREFETCH, (void)0)
+AVX2_FMADD_N(simd_fmadd_n_avx2, _mm256_store_ps, SIMD_NO_PREFETCH, (void)0)
+AVX2_BINARY_N(simd_add_n_stream_avx2, _mm256_add_ps, +, _mm256_stream_ps, SIMD_PREFETCH, _mm_sfence())
+AVX2_BINARY_N(simd_mul_n_stream_avx2, _mm256_mul_ps, *, _mm256_stream_ps, SIMD_PREFETCH, _mm_sfence())
+AVX2_FMADD_N(simd_fmadd_n_stream_avx2, _mm256_stream_ps, SIMD_PREFETCH, _mm_sfence())
+
+// fill and copy as in the SSE2 backend, 32 bytes at a time
+#define AVX2_FILL_N(name, store, finish)                                        \
+static SIMD_TARGET_AVX2 void name(void* dst, const void* pattern, size_t bytes) { \
+    char* d = dst;                                                              \
+    size_t i = (32 - ((uintptr_t)d & 31)) & 31;                                 \
+    if (i > bytes) i = bytes;                                                   \
+    memcpy(d, pattern, i);                                                      \
+    __m256i v = _mm256_loadu_si256((const __m256i*)pattern);                    \
+    for (; i + 128 <= bytes; i += 128) {                                        \
+        store((__m256i*)(d + i), v);                                            \
+        store((__m256i*)(d + i + 32), v);                                       \
+        store((__m256i*)(d + i + 64), v);                                       \
+        store((__m256i*)(d + i + 96), v);                                       \
+    }                                                                           \
+    for (; i + 32 <= bytes; i += 32)                                            \
+        store((__m256i*)(d + i), v);                                            \
+    finish;                                                                     \
+    memcpy(d + i, pattern, bytes - i);                                          \
+}
+
+#define AVX2_COPY_N(name, store, prefetch, finish)                              \
+static SIMD_TARGET_AVX2 void name(void* dst, const void* src, size_t bytes) {   \
+    char* d = dst;                                                              \
+    const char* s = src;                                                        \
+    size_t i = (32 - ((uintptr_t)d & 31)) & 31;                                 \
+    if (i > bytes) i = bytes;                                                   \
+    memcpy(d, s, i);                                                            \
+    for (; i + 128 <= bytes; i += 128) {                                        \
+        prefetch(s + i);                                                        \
+        prefetch(s + i + 64);                                                   \
+        __m256i r0 = _mm256_loadu_si256((const __m256i*)(s + i));               \
+        __m256i r1 = _mm256_loadu_si256((const __m256i*)(s + i + 32));          \
+        __m256i r2 = _mm256_loadu_si256((const __m256i*)(s + i + 64));          \
+        __m256i r3 = _mm256_loadu_si256((const __m256i*)(s + i + 96));          \
+        store((__m256i*)(d + i), r0);                                           \
+        store((__m256i*)(d + i + 32), r1);                                      \
+        store((__m256i*)(d + i + 64), r2);                                      \
+        store((__m256i*)(d + i + 96), r3);                                      \
+    }                                                                           \
+    for (; i + 32 <= bytes; i += 32)                                            \
+        store((__m256i*)(d + i), _mm256_loadu_si256((const __m256i*)(s + i)));  \
+    finish;                                                                     \
+    memcpy(d + i, s + i, bytes - i);                                            \
+}
+
+AVX2_FILL_N(simd_fill_n_avx2, _mm256_store_si256, (void)0)
+AVX2_FILL_N(simd_fill_n_stream_avx2, _mm256_stream_si256, _mm_sfence())
+AVX2_COPY_N(simd_copy_n_avx2, _mm256_store_si256, SIMD_NO_PREFETCH, (void)0)
+AVX2_COPY_N(simd_copy_n_stream_avx2, _mm256_stream_si256, SIMD_PREFETCH, _mm_sfence())
+
+// 8x8 transpose: interleave pairs of rows, then pairs of pairs, then swap
+// the 128-bit halves
+static inline SIMD_TARGET_AVX2 void avx2_transpose8(float* dst, size_t ldd, const float* src, size_t lds) {
+    __m256 r[8], t[8];
+    for (int k = 0; k < 8; k++)
+        r[k] = _mm256_loadu_ps(src + k * lds);
+    for (int k = 0; k < 8; k += 2) {
+        t[k] = _mm256_unpacklo_ps(r[k], r[k + 1]);
+        t[k + 1] = _mm256_unpackhi_ps(r[k], r[k + 1]);
+    }
+    for (int k = 0; k < 8; k += 4) {
+        r[k] = _mm256_shuffle_ps(t[k], t[k + 2], _MM_SHUFFLE(1, 0, 1, 0));
+        r[k + 1] = _mm256_shuffle_ps(t[k], t[k + 2], _MM_SHUFFLE(3, 2, 3, 2));
+        r[k + 2] = _mm256_shuffle_ps(t[k + 1], t[k + 3], _MM_SHUFFLE(1, 0, 1, 0));
+        r[k + 3] = _mm256_shuffle_ps(t[k + 1], t[k + 3], _MM_SHUFFLE(3, 2, 3, 2));
+    }
+    for (int k = 0; k < 4; k++) {
+        _mm256_storeu_ps(dst + k * ldd, _mm256_permute2f128_ps(r[k], r[k + 4], 0x20));
+        _mm256_storeu_ps(dst + (k + 4) * ldd, _mm256_permute2f128_ps(r[k], r[k + 4], 0x31));
+    }
+}
+
+static SIMD_TARGET_AVX2 void simd_transpose_avx2(float* dst, size_t ldd, const float* src, size_t lds,
+                                                 size_t rows, size_t cols) {
+    size_t i = 0;
+    for (; i + 8 <= rows; i += 8) {
+        size_t j = 0;
+        for (; j + 8 <= cols; j += 8)
+            avx2_transpose8(dst + i * ldd + j, ldd, src + j * lds + i, lds);
+        for (; j < cols; j++)
+            for (size_t k = i; k < i + 8; k++)
+                dst[k * ldd + j] = src[j * lds + k];
+    }
+    for (; i < rows; i++)
+        for (size_t j = 0; j < cols; j++)
+            dst[i * ldd + j] = src[j * lds + i];
+}
+
+static SIMD_TARGET_AVX2 void simd_axpy_n_avx2(float* y, float alpha, const float* x, size_t n) {
+    __m256 va = _mm256_set1_ps(alpha);
+    size_t i = 0;
+    for (; i < n && ((uintptr_t)(y + i) & 31); i++)
+        y[i] = alpha * x[i] + y[i];
+    for (; i + 32 <= n; i += 32) {
+        __m256 r0 = _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i), _mm256_load_ps(y + i));
+        __m256 r1 = _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i + 8), _mm256_load_ps(y + i + 8));
+        __m256 r2 = _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i + 16), _mm256_load_ps(y + i + 16));
+        __m256 r3 = _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i + 24), _mm256_load_ps(y + i + 24));
+        _mm256_store_ps(y + i, r0);
+        _mm256_store_ps(y + i + 8, r1);
+        _mm256_store_ps(y + i + 16, r2);
+        _mm256_store_ps(y + i + 24, r3);
+    }
+    for (; i + 8 <= n; i += 8)
+        _mm256_store_ps(y + i, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i), _mm256_load_ps(y + i)));
+    for (; i < n; i++)
+        y[i] = alpha * x[i] + y[i];
+}
+
+#define AVX2_SCALAR_N(name, vop, op)                                            \
+static SIMD_TARGET_AVX2 void name(float* dst, const float* a, float scalar, size_t n) { \
+    __m256 vs = _mm256_set1_ps(scalar);                                         \
+    size_t i = 0;                                                               \
+    for (; i < n && ((uintptr_t)(dst + i) & 31); i++)                           \
+        dst[i] = a[i] op scalar;                                                \
+    for (; i + 32 <= n; i += 32) {                                              \
+        __m256 r0 = vop(_mm256_loadu_ps(a + i), vs);                            \
+        __m256 r1 = vop(_mm256_loadu_ps(a + i + 8), vs);                        \
+        __m256 r2 = vop(_mm256_loadu_ps(a + i + 16), vs);                       \
+        __m256 r3 = vop(_mm256_loadu_ps(a + i + 24), vs);                       \
+        _mm256_store_ps(dst + i, r0);                                           \
+        _mm256_store_ps(dst + i + 8, r1);                                       \
+        _mm256_store_ps(dst + i + 16, r2);                                      \
+        _mm256_store_ps(dst + i + 24, r3);                                      \
+    }                                                                           \
+    for (; i + 8 <= n; i += 8)                                                  \
+        _mm256_store_ps(dst + i, vop(_mm256_loadu_ps(a + i), vs));              \
+    for (; i < n; i++)                                                          \
+        dst[i] = a[i] op scalar;                                                \
+}
+
+AVX2_SCALAR_N(simd_scale_n_avx2, _mm256_mul_ps, *)
+AVX2_SCALAR_N(simd_add_scalar_n_avx2, _mm256_add_ps, +)
+
+// hop is the 128-bit form of vop, used to fold the two halves together
+#define AVX2_REDUCE_N(name, vop, hop, combine, identity)                        \
+static SIMD_TARGET_AVX2 float name(const float* a, size_t n) {                  \
+    __m256 r0 = _mm256_set1_ps(identity), r1 = r0, r2 = r0, r3 = r0;            \
+    size_t i = 0;                                                               \
+    for (; i + 32 <= n; i += 32) {                                              \
+        r0 = vop(r0, _mm256_loadu_ps(a + i));                                   \
+        r1 = vop(r1, _mm256_loadu_ps(a + i + 8));                               \
+        r2 = vop(r2, _mm256_loadu_ps(a + i + 16));                              \
+        r3 = vop(r3, _mm256_loadu_ps(a + i + 24));                              \
+    }                                                                           \
+    for (; i + 8 <= n; i += 8)                                                  \
+        r0 = vop(r0, _mm256_loadu_ps(a + i));                                   \
+    r0 = vop(vop(r0, r1), vop(r2, r3));                                         \
+    __m128 half = hop(_mm256_castps256_ps128(r0), _mm256_extractf128_ps(r0, 1)); \
+    float lanes[4];                                                             \
+    _mm_storeu_ps(lanes, half);                                                 \
+    float result = combine(combine(lanes[0], lanes[1]), combine(lanes[2], lanes[3])); \
+    for (; i < n; i++)                                                          \
+        result = combine(result, a[i]);                                         \
+    return result;                                                              \
+}
+
+AVX2_REDUCE_N(simd_sum_n_avx2, _mm256_add_ps, _mm_add_ps, simd_combine_add, 0.0f)
+AVX2_REDUCE_N(simd_max_n_avx2, _mm256_max_ps, _mm_max_ps, simd_combine_max, -INFINITY)
+AVX2_REDUCE_N(simd_min_n_avx2, _mm256_min_ps, _mm_min_ps, simd_combine_min, INFINITY)
+
+// two independent sum/compensation pairs, so consecutive steps do not wait
+// on each other's four-deep add chain
+static SIMD_TARGET_AVX2 void simd_sum_kahan_n_avx2(const float* a, size_t n, float* sum_out, float* comp_out) {
+    __m256 s0 = _mm256_setzero_ps(), c0 = s0, s1 = s0, c1 = s0;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 y0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), c0);
+        __m256 y1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), c1);
+        __m256 t0 = _mm256_add_ps(s0, y0);
+        __m256 t1 = _mm256_add_ps(s1, y1);
+        c0 = _mm256_sub_ps(_mm256_sub_ps(t0, s0), y0);
+        c1 = _mm256_sub_ps(_mm256_sub_ps(t1, s1), y1);
+        s0 = t0;
+        s1 = t1;
+    }
+    float sums[16], comps[16];
+    _mm256_storeu_ps(sums, s0);
+    _mm256_storeu_ps(sums + 8, s1);
+    _mm256_storeu_ps(comps, c0);
+    _mm256_storeu_ps(comps + 8, c1);
+    for (int k = 0; k < 16; k++) {
+        simd_kahan_add(sum_out, comp_out, sums[k]);
+        simd_kahan_add(sum_out, comp_out, -comps[k]);
+    }
+    for (; i < n; i++)
+        simd_kahan_add(sum_out, comp_out, a[i]);
+}
+
+static SIMD_TARGET_AVX2 float simd_dot_n_avx2(const float* a, const float* b, size_t n) {
+    __m256 r0 = _mm256_setzero_ps(), r1 = r0, r2 = r0, r3 = r0;
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        r0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), r0);
+        r1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), r1);
+        r2 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 16), _mm256_loadu_ps(b + i + 16), r2);
+        r3 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 24), _mm256_loadu_ps(b + i + 24), r3);
+    }
+    for (; i + 8 <= n; i += 8)
+        r0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), r0);
+    r0 = _mm256_add_ps(_mm256_add_ps(r0, r1), _mm256_add_ps(r2, r3));
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(r0), _mm256_extractf128_ps(r0, 1));
+    float lanes[4];
+    _mm_storeu_ps(lanes, half);
+    float result = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for (; i < n; i++)
+        result += a[i] * b[i];
+    return result;
+}
+
+static SIMD_TARGET_AVX2 void simd_load_f64_n_avx2(float* dst, const void* src, size_t n) {
+    const double* s = src;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128 lo = _mm256_cvtpd_ps(_mm256_loadu_pd(s + i));
+        __m128 hi = _mm256_cvtpd_ps(_mm256_loadu_pd(s + i + 4));
+        _mm256_storeu_ps(dst + i, _mm256_set_m128(hi, lo));
+    }
+    for (; i < n; i++)
+        dst[i] = (float)s[i];
+}
+
+static SIMD_TARGET_AVX2 void simd_store_f64_n_avx2(void* dst, const float* src, size_t n) {
+    double* d = dst;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_pd(d + i, _mm256_cvtps_pd(_mm_loadu_ps(src + i)));
+        _mm256_storeu_pd(d + i + 4, _mm256_cvtps_pd(_mm_loadu_ps(src + i + 4)));
+    }
+    for (; i < n; i++)
+        d[i] = src[i];
+}
+
+static SIMD_TARGET_AVX2 void simd_load_f16_n_avx2(float* dst, const void* src, size_t n) {
+    const uint16_t* s = src;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(s + i))));
+    for (; i < n; i++)
+        dst[i] = simd_f16_to_float(s[i]);
+}
+
+static SIMD_TARGET_AVX2 void simd_store_f16_n_avx2(void* dst, const float* src, size_t n) {
+    uint16_t* d = dst;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128((__m128i*)(d + i), h);
+    }
+    for (; i < n; i++)
+        d[i] = simd_float_to_f16(src[i]);
+}
+
+static SIMD_TARGET_AVX2 void simd_load_bf16_n_avx2(float* dst, const void* src, size_t n) {
+    const uint16_t* s = src;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i w = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(s + i)));
+        _mm256_storeu_ps(dst + i, _mm256_castsi256_ps(_mm256_slli_epi32(w, 16)));
+    }
+    for (; i < n; i++)
+        dst[i] = simd_bf16_to_float(s[i]);
+}
+
+// simd_float_to_bf16 on eight lanes: round the low half to nearest even,
+// quiet NaNs, flush zero exponents to signed zero
+static SIMD_TARGET_AVX2 void simd_store_bf16_n_avx2(void* dst, const float* src, size_t n) {
+    uint16_t* d = dst;
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i bias = _mm256_set1_epi32(0x7fff);
+    const __m256i exp_mask = _mm256_set1_epi32(0x7f800000);
+    const __m256i sign_mask = _mm256_set1_epi32(0x8000);
+    const __m256i quiet = _mm256_set1_epi32(0x40);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_loadu_ps(src + i);
+        __m256i bits = _mm256_castps_si256(x);
+        __m256i high = _mm256_srli_epi32(bits, 16);
+        __m256i odd = _mm256_and_si256(high, one);
+        __m256i rounded = _mm256_srli_epi32(_mm256_add_epi32(bits, _mm256_add_epi32(bias, odd)), 16);
+        __m256i nan = _mm256_castps_si256(_mm256_cmp_ps(x, x, _CMP_UNORD_Q));
+        __m256i tiny = _mm256_cmpeq_epi32(_mm256_and_si256(bits, exp_mask), _mm256_setzero_si256());
+        __m256i r = _mm256_blendv_epi8(rounded, _mm256_or_si256(high, quiet), nan);
+        r = _mm256_blendv_epi8(r, _mm256_and_si256(high, sign_mask), tiny);
+        // packus works per 128-bit half, so gather the two low quarters
+        r = _mm256_permute4x64_epi64(_mm256_packus_epi32(r, r), 0x08);
+        _mm_storeu_si128((__m128i*)(d + i), _mm256_castsi256_si128(r));
+    }
+    for (; i < n; i++)
+        d[i] = simd_float_to_bf16(src[i]);
+}
+
+static SIMD_TARGET_AVX2 void simd_load_i32_n_avx2(float* dst, const void* src, size_t n) {
+    const int32_t* s = src;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(dst + i, _mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)(s + i))));
+    for (; i < n; i++)
+        dst[i] = (float)s[i];
+}
+
+// cvtps2dq already gives INT32_MIN for NaN and anything out of range, so NaN
+// lanes are zeroed first and positive overflow is patched to INT32_MAX after
+static SIMD_TARGET_AVX2 void simd_store_i32_n_avx2(void* dst, const float* src, size_t n) {
+    int32_t* d = dst;
+    const __m256 limit = _mm256_set1_ps(2147483648.0f);
+    const __m256i max = _mm256_set1_epi32(INT32_MAX);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_loadu_ps(src + i);
+        x = _mm256_and_ps(x, _mm256_cmp_ps(x, x, _CMP_ORD_Q));
+        __m256i r = _mm256_cvtps_epi32(x);
+        r = _mm256_blendv_epi8(r, max, _mm256_castps_si256(_mm256_cmp_ps(x, limit, _CMP_GE_OQ)));
+        _mm256_storeu_si256((__m256i*)(d + i), r);
+    }
+    for (; i < n; i++)
+        d[i] = simd_float_to_i32(src[i]);
+}
+
+static SIMD_TARGET_AVX2 void simd_load_i8_n_avx2(float* dst, const void* src, size_t n) {
+    const int8_t* s = src;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i w = _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)(s + i)));
+        _mm256_storeu_ps(dst + i, _mm256_cvtepi32_ps(w));
+    }
+    for (; i < n; i++)
+        dst[i] = (float)s[i];
+}
+
+static SIMD_TARGET_AVX2 void simd_store_i8_n_avx2(void* dst, const float* src, size_t n) {
+    int8_t* d = dst;
+    const __m256 lo = _mm256_set1_ps(-128.0f);
+    const __m256 hi = _mm256_set1_ps(127.0f);
+    const __m256i gather = _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_loadu_ps(src + i);
+        x = _mm256_and_ps(x, _mm256_cmp_ps(x, x, _CMP_ORD_Q));
+        __m256i r = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(x, lo), hi));
+        r = _mm256_packs_epi32(r, r);
+        r = _mm256_packs_epi16(r, r);
+        // each 128-bit half now starts with its four bytes
+        r = _mm256_permutevar8x32_epi32(r, gather);
+        _mm_storel_epi64((__m128i*)(d + i), _mm256_castsi256_si128(r));
+    }
+    for (; i < n; i++)
+        d[i] = simd_float_to_i8(src[i]);
+}
+
+#define AVX2_BINARY_F64_N(name, vop, op)                                        \
+static SIMD_TARGET_AVX2 void name(double* dst, const double* a, const double* b, size_t n) { \
+    size_t i = 0;                                                               \
+    for (; i + 16 <= n; i += 16) {                                              \
+        __m256d r0 = vop(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i));       \
+        __m256d r1 = vop(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)); \
+        __m256d r2 = vop(_mm256_loadu_pd(a + i + 8), _mm256_loadu_pd(b + i + 8)); \
+        __m256d r3 = vop(_mm256_loadu_pd(a + i + 12), _mm256_loadu_pd(b + i + 12)); \
+        _mm256_storeu_pd(dst + i, r0);                                          \
+        _mm256_storeu_pd(dst + i + 4, r1);                                      \
+        _mm256_storeu_pd(dst + i + 8, r2);                                      \
+        _mm256_storeu_pd(dst + i + 12, r3);                                     \
+    }                                                                           \
+    for (; i + 4 <= n; i += 4)                                                  \
+        _mm256_storeu_pd(dst + i, vop(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i))); \
+    for (; i < n; i++)                                                          \
+        dst[i] = a[i] op b[i];                                                  \
+}
+
+AVX2_BINARY_F64_N(simd_add_f64_n_avx2, _mm256_add_pd, +)
+AVX2_BINARY_F64_N(simd_sub_f64_n_avx2, _mm256_sub_pd, -)
+AVX2_BINARY_F64_N(simd_mul_f64_n_avx2, _mm256_mul_pd, *)
+
+static SIMD_TARGET_AVX2 void simd_fmadd_f64_n_avx2(double* dst, const double* a, const double* b, const double* c, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256d r0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), _mm256_loadu_pd(c + i));
+        __m256d r1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4),
+                                     _mm256_loadu_pd(c + i + 4));
+        _mm256_storeu_pd(dst + i, r0);
+        _mm256_storeu_pd(dst + i + 4, r1);
+    }
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(dst + i, _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i),
+                                                  _mm256_loadu_pd(c + i)));
+    for (; i < n; i++)
+        dst[i] = a[i] * b[i] + c[i];
+}
+
+static SIMD_TARGET_AVX2 void simd_scale_f64_n_avx2(double* dst, const double* a, double scalar, size_t n) {
+    __m256d vs = _mm256_set1_pd(scalar);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_pd(dst + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), vs));
+        _mm256_storeu_pd(dst + i + 4, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), vs));
+    }
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(dst + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), vs));
+    for (; i < n; i++)
+        dst[i] = a[i] * scalar;
+}
+
+#define AVX2_REDUCE_F64_N(name, vop, combine, identity)                         \
+static SIMD_TARGET_AVX2 double name(const double* a, size_t n) {                \
+    __m256d id = _mm256_set1_pd(identity);                                      \
+    __m256d r0 = id, r1 = id, r2 = id, r3 = id;                                 \
+    size_t i = 0;                                                               \
+    for (; i + 16 <= n; i += 16) {                                              \
+        r0 = vop(r0, _mm256_loadu_pd(a + i));                                   \
+        r1 = vop(r1, _mm256_loadu_pd(a + i + 4));                               \
+        r2 = vop(r2, _mm256_loadu_pd(a + i + 8));                               \
+        r3 = vop(r3, _mm256_loadu_pd(a + i + 12));                              \
+    }                                                                           \
+    for (; i + 4 <= n; i += 4)                                                  \
+        r0 = vop(r0, _mm256_loadu_pd(a + i));                                   \
+    double lanes[4];                                                            \
+    _mm256_storeu_pd(lanes, vop(vop(r0, r1), vop(r2, r3)));                     \
+    double result = combine(combine(lanes[0], lanes[1]), combine(lanes[2], lanes[3])); \
+    for (; i < n; i++)                                                          \
+        result = combine(result, a[i]);                                         \
+    return result;                                                              \
+}
+
+AVX2_REDUCE_F64_N(simd_sum_f64_n_avx2, _mm256_add_pd, simd_combine_add_f64, 0.0)
+AVX2_REDUCE_F64_N(simd_max_f64_n_avx2, _mm256_max_pd, simd_combine_max_f64, -INFINITY)
+AVX2_REDUCE_F64_N(simd_min_f64_n_avx2, _mm256_min_pd, simd_combine_min_f64, INFINITY)
+
+// the vector forms of simd_exp_f32 and friends, with fused multiply-adds
+static inline SIMD_TARGET_AVX2 __m256 avx2_exp_ps(__m256 x) {
+    // min and max return their second operand for NaN, which keeps it
+    x = _mm256_max_ps(_mm256_set1_ps(SIMD_EXP_MIN), _mm256_min_ps(_mm256_set1_ps(SIMD_EXP_MAX), x));
+
+    __m256 k = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(SIMD_LOG2E)),
+                               _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 r = _mm256_fnmadd_ps(k, _mm256_set1_ps(SIMD_LN2_HI), x);
+    r = _mm256_fnmadd_ps(k, _mm256_set1_ps(SIMD_LN2_LO), r);
+
+    __m256 p = _mm256_set1_ps(SIMD_EXP_P0);
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(SIMD_EXP_P1));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(SIMD_EXP_P2));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(SIMD_EXP_P3));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(SIMD_EXP_P4));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(SIMD_EXP_P5));
+    p = _mm256_add_ps(_mm256_fmadd_ps(p, _mm256_mul_ps(r, r), r), _mm256_set1_ps(1.0f));
+
+    __m256i ki = _mm256_cvtps_epi32(k);
+    __m256i k1 = _mm256_srai_epi32(ki, 1);
+    __m256i k2 = _mm256_sub_epi32(ki, k1);
+    __m256i bias = _mm256_set1_epi32(127);
+    __m256 s1 = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(k1, bias), 23));
+    __m256 s2 = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(k2, bias), 23));
+    return _mm256_mul_ps(_mm256_mul_ps(p, s1), s2);
+}
+
+static inline SIMD_TARGET_AVX2 __m256 avx2_log_ps(__m256 x) {
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256 zero = _mm256_setzero_ps();
+    __m256 sub = _mm256_cmp_ps(x, _mm256_set1_ps(0x1p-126f), _CMP_LT_OQ);
+    __m256 xs = _mm256_blendv_ps(x, _mm256_mul_ps(x, _mm256_set1_ps(0x1p25f)), sub);
+
+    __m256i bits = _mm256_castps_si256(xs);
+    __m256i exp = _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(126));
+    __m256 e = _mm256_add_ps(_mm256_cvtepi32_ps(exp), _mm256_and_ps(sub, _mm256_set1_ps(-25.0f)));
+    __m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)),
+                                                   _mm256_set1_epi32(0x3f000000)));
+    __m256 small = _mm256_cmp_ps(m, _mm256_set1_ps(SIMD_SQRT_HALF), _CMP_LT_OQ);
+    e = _mm256_sub_ps(e, _mm256_and_ps(small, one));
+    m = _mm256_add_ps(_mm256_sub_ps(m, one), _mm256_and_ps(small, m));
+
+    __m256 z = _mm256_mul_ps(m, m);
+    __m256 p = _mm256_set1_ps(SIMD_LOG_P0);
+    p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(SIMD_LOG_P1));
+    p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(SIMD_LOG_P2));
+    p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(SIMD_LOG_P3));
+    p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(SIMD_LOG_P4));
+    p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(SIMD_LOG_P5));
+    p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(SIMD_LOG_P6));
+    p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(SIMD_LOG_P7));
+    p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(SIMD_LOG_P8));
+
+    __m256 y = _mm256_mul_ps(_mm256_mul_ps(p, m), z);
+    y = _mm256_fmadd_ps(e, _mm256_set1_ps(SIMD_LN2_LO), y);
+    y = _mm256_fnmadd_ps(_mm256_set1_ps(0.5f), z, y);
+    __m256 r = _mm256_fmadd_ps(e, _mm256_set1_ps(SIMD_LN2_HI), _mm256_add_ps(m, y));
+
+    // +inf stays +inf, zeros give -inf, and negative or NaN lanes become an
+    // all-ones NaN
+    __m256 inf = _mm256_set1_ps(INFINITY);
+    r = _mm256_blendv_ps(r, inf, _mm256_cmp_ps(x, inf, _CMP_EQ_OQ));
+    r = _mm256_blendv_ps(r, _mm256_set1_ps(-INFINITY), _mm256_cmp_ps(x, zero, _CMP_EQ_OQ));
+    return _mm256_or_ps(r, _mm256_cmp_ps(x, zero, _CMP_NGE_UQ));
+}
+
+static inline SIMD_TARGET_AVX2 __m256 avx2_sigmoid_ps(__m256 x) {
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256 e = avx2_exp_ps(_mm256_or_ps(x, _mm256_set1_ps(-0.0f)));
+    __m256 num = _mm256_blendv_ps(one, e, _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LT_OQ));
+    return _mm256_div_ps(num, _mm256_add_ps(one, e));
+}
+
+static inline SIMD_TARGET_AVX2 __m256 avx2_tanh_ps(__m256 x) {
+    __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256 z = _mm256_andnot_ps(sign, x);
+
+    __m256 s = _mm256_mul_ps(x, x);
+    __m256 p = _mm256_set1_ps(SIMD_TANH_P0);
+    p = _mm256_fmadd_ps(p, s, _mm256_set1_ps(SIMD_TANH_P1));
+    p = _mm256_fmadd_ps(p, s, _mm256_set1_ps(SIMD_TANH_P2));
+    p = _mm256_fmadd_ps(p, s, _mm256_set1_ps(SIMD_TANH_P3));
+    p = _mm256_fmadd_ps(p, s, _mm256_set1_ps(SIMD_TANH_P4));
+    __m256 near = _mm256_fmadd_ps(_mm256_mul_ps(p, s), z, z);
+
+    __m256 e = avx2_exp_ps(_mm256_add_ps(z, z));
+    __m256 far = _mm256_sub_ps(one, _mm256_div_ps(_mm256_set1_ps(2.0f), _mm256_add_ps(e, one)));
+    __m256 r = _mm256_blendv_ps(far, near, _mm256_cmp_ps(z, _mm256_set1_ps(SIMD_TANH_SMALL), _CMP_LT_OQ));
+    return _mm256_or_ps(r, _mm256_and_ps(sign, x));
+}
+
+// the 12-bit estimate refined by one Newton step. subnormals are scaled into
+// range first; zeros, infinities, negatives and NaN keep the estimate, which
+// is already exact for them
+static inline SIMD_TARGET_AVX2 __m256 avx2_rsqrt_ps(__m256 x) {
+    __m256 sub = _mm256_cmp_ps(x, _mm256_set1_ps(0x1p-126f), _CMP_LT_OQ);
+    __m256 xs = _mm256_blendv_ps(x, _mm256_mul_ps(x, _mm256_set1_ps(0x1p24f)), sub);
+
+    __m256 y = _mm256_rsqrt_ps(xs);
+    __m256 residual = _mm256_fnmadd_ps(_mm256_mul_ps(xs, y), y, _mm256_set1_ps(1.0f));
+    __m256 nr = _mm256_fmadd_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), y), residual, y);
+    __m256 finite = _mm256_and_ps(_mm256_cmp_ps(xs, _mm256_setzero_ps(), _CMP_GT_OQ),
+                                  _mm256_cmp_ps(xs, _mm256_set1_ps(INFINITY), _CMP_LT_OQ));
+    __m256 r = _mm256_blendv_ps(y, nr, finite);
+    return _mm256_mul_ps(r, _mm256_blendv_ps(_mm256_set1_ps(1.0f), _mm256_set1_ps(0x1p12f), sub));
+}
+
+#define AVX2_UNARY_N(name, vfunc, func)                                         \
+static SIMD_TARGET_AVX2 void name(float* dst, const float* a, size_t n) {       \
+    size_t i = 0;                                                               \
+    for (; i < n && ((uintptr_t)(dst + i) & 31); i++)                           \
+        dst[i] = func(a[i]);                                                    \
+    for (; i + 16 <= n; i += 16) {                                              \
+        __m256 r0 = vfunc(_mm256_loadu_ps(a + i));                              \
+        __m256 r1 = vfunc(_mm256_loadu_ps(a + i + 8));                          \
+        _mm256_store_ps(dst + i, r0);                                           \
+        _mm256_store_ps(dst + i + 8, r1);                                       \
+    }                                                                           \
+    for (; i + 8 <= n; i += 8)                                                  \
+        _mm256_store_ps(dst + i, vfunc(_mm256_loadu_ps(a + i)));                \
+    for (; i < n; i++)                                                          \
+        dst[i] = func(a[i]);                                                    \
+}
+
+AVX2_UNARY_N(simd_exp_n_avx2, avx2_exp_ps, simd_exp_f32)
+AVX2_UNARY_N(simd_log_n_avx2, avx2_log_ps, simd_log_f32)
+AVX2_UNARY_N(simd_sigmoid_n_avx2, avx2_sigmoid_ps, simd_sigmoid_f32)
+AVX2_UNARY_N(simd_tanh_n_avx2, avx2_tanh_ps, simd_tanh_f32)
+AVX2_UNARY_N(simd_sqrt_n_avx2, _mm256_sqrt_ps, sqrtf)
+AVX2_UNARY_N(simd_rsqrt_n_avx2, avx2_rsqrt_ps, simd_rsqrt_f32)
+
+// 6x16 tile: twelve accumulators, two b vectors and a broadcast fill the
+// sixteen ymm registers, and each step issues twelve independent FMAs,
+// enough to cover the FMA latency on both ports. rows unrolled as for SSE2
+static SIMD_TARGET_AVX2 void simd_gemm_kernel_avx2(size_t k, const float* a, const float* b, float* c,
+                                                   size_t ldc, int accumulate) {
+    __m256 acc[6][2];
+    #pragma GCC unroll 6
+    for (int i = 0; i < 6; i++) {
+        acc[i][0] = _mm256_setzero_ps();
+        acc[i][1] = _mm256_setzero_ps();
+    }
+    for (size_t p = 0; p < k; p++) {
+        __m256 b0 = _mm256_load_ps(b + p * 16);
+        __m256 b1 = _mm256_load_ps(b + p * 16 + 8);
+        #pragma GCC unroll 6
+        for (int i = 0; i < 6; i++) {
+            __m256 ai = _mm256_broadcast_ss(a + p * 6 + i);
+            acc[i][0] = _mm256_fmadd_ps(ai, b0, acc[i][0]);
+            acc[i][1] = _mm256_fmadd_ps(ai, b1, acc[i][1]);
+        }
+    }
+    #pragma GCC unroll 6
+    for (int i = 0; i < 6; i++) {
+        float* row = c + i * ldc;
+        if (accumulate) {
+            acc[i][0] = _mm256_add_ps(acc[i][0], _mm256_loadu_ps(row));
+            acc[i][1] = _mm256_add_ps(acc[i][1], _mm256_loadu_ps(row + 8));
+        }
+        _mm256_storeu_ps(row, acc[i][0]);
+        _mm256_storeu_ps(row + 8, acc[i][1]);
+    }
+}
+
+void simd_use_avx2(simd_dispatch_t* dispatch) {
+    dispatch->add = simd_add_avx2;
+    dispatch->mul = simd_mul_avx2;
+    dispatch->fmadd = simd_fmadd_avx2;
+    dispatch->add_n = simd_add_n_avx2;
+    dispatch->sub_n = simd_sub_n_avx2;
+    dispatch->mul_n = simd_mul_n_avx2;
+    dispatch->fmadd_n = simd_fmadd_n_avx2;
+    dispatch->axpy_n = simd_axpy_n_avx2;
+    dispatch->scale_n = simd_scale_n_avx2;
+    dispatch->add_scalar_n = simd_add_scalar_n_avx2;
+    dispatch->add_n_stream = simd_add_n_stream_avx2;
+    dispatch->mul_n_stream = simd_mul_n_stream_avx2;
+    dispatch->fmadd_n_stream = simd_fmadd_n_stream_avx2;
+    dispatch->fill_n = simd_fill_n_avx2;
+    dispatch->fill_n_stream = simd_fill_n_stream_avx2;
+    dispatch->copy_n = simd_copy_n_avx2;
+    dispatch->copy_n_stream = simd_copy_n_stream_avx2;
+    dispatch->transpose = simd_transpose_avx2;
+    dispatch->sum_n = simd_sum_n_avx2;
+    dispatch->sum_kahan_n = simd_sum_kahan_n_avx2;
+    dispatch->max_n = simd_max_n_avx2;
+    dispatch->min_n = simd_min_n_avx2;
+    dispatch->dot_n = simd_dot_n_avx2;
+    dispatch->exp_n = simd_exp_n_avx2;
+    dispatch->log_n = simd_log_n_avx2;
+    dispatch->sigmoid_n = simd_sigmoid_n_avx2;
+    dispatch->tanh_n = simd_tanh_n_avx2;
+    dispatch->sqrt_n = simd_sqrt_n_avx2;
+    dispatch->rsqrt_n = simd_rsqrt_n_avx2;
+    dispatch->gemm_mr = 6;
+    dispatch->gemm_nr = 16;
+    dispatch->gemm_kernel = simd_gemm_kernel_avx2;
+    dispatch->load_f64_n = simd_load_f64_n_avx2;
+    dispatch->store_f64_n = simd_store_f64_n_avx2;
+    dispatch->load_f16_n = simd_load_f16_n_avx2;
+    dispatch->store_f16_n = simd_store_f16_n_avx2;
+    dispatch->load_bf16_n = simd_load_bf16_n_avx2;
+    dispatch->store_bf16_n = simd_store_bf16_n_avx2;
+    dispatch->load_i32_n = simd_load_i32_n_avx2;
+    dispatch->store_i32_n = simd_store_i32_n_avx2;
+    dispatch->load_i8_n = simd_load_i8_n_avx2;
+    dispatch->store_i8_n = simd_store_i8_n_avx2;
+    dispatch->add_f64_n = simd_add_f64_n_avx2;
+    dispatch->sub_f64_n = simd_sub_f64_n_avx2;
+    dispatch->mul_f64_n = simd_mul_f64_n_avx2;
+    dispatch->fmadd_f64_n = simd_fmadd_f64_n_avx2;
+    dispatch->scale_f64_n = simd_scale_f64_n_avx2;
+    dispatch->sum_f64_n = simd_sum_f64_n_avx2;
+    dispatch->max_f64_n = simd_max_f64_n_avx2;
+    dispatch->min_f64_n = simd_min_f64_n_avx2;
+    simd_use_math_f64(dispatch);
+}
+#endif
@@ -0,0 +1,792 @@
+#include "simd_backends.h"
+
+#ifdef SIMD_HAVE_AVX512
+#include <immintrin.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+// 16-lane AVX-512F kernels. heads and tails are handled with masked loads and
+// stores, so no kernel falls back to a scalar remainder loop
+
+static inline SIMD_TARGET_AVX512 __mmask16 avx512_mask(size_t n) {
+    return (__mmask16)((1u << n) - 1);
+}
+
+// number of leading elements to process before dst reaches a 64-byte boundary
+static inline size_t avx512_head(const float* dst, size_t n) {
+    size_t head = ((64 - ((uintptr_t)dst & 63)) & 63) / sizeof(float);
+    return head < n ? head : n;
+}
+
+static SIMD_TARGET_AVX512 simd_vec_t simd_add_avx512(simd_vec_t a, simd_vec_t b) {
+    simd_vec_t result;
+    __m512 va = _mm512_maskz_loadu_ps(0xFF, a.data);
+    __m512 vb = _mm512_maskz_loadu_ps(0xFF, b.data);
+    _mm512_mask_storeu_ps(result.data, 0xFF, _mm512_add_ps(va, vb));
+    return result;
+}
+
+static SIMD_TARGET_AVX512 simd_vec_t simd_mul_avx512(simd_vec_t a, simd_vec_t b) {
+    simd_vec_t result;
+    __m512 va = _mm512_maskz_loadu_ps(0xFF, a.data);
+    __m512 vb = _mm512_maskz_loadu_ps(0xFF, b.data);
+    _mm512_mask_storeu_ps(result.data, 0xFF, _mm512_mul_ps(va, vb));
+    return result;
+}
+
+static SIMD_TARGET_AVX512 simd_vec_t simd_fmadd_avx512(simd_vec_t a, simd_vec_t b, simd_vec_t c) {
+    simd_vec_t result;
+    __m512 va = _mm512_maskz_loadu_ps(0xFF, a.data);
+    __m512 vb = _mm512_maskz_loadu_ps(0xFF, b.data);
+    __m512 vc = _mm512_maskz_loadu_ps(0xFF, c.data);
+    _mm512_mask_storeu_ps(result.data, 0xFF, _mm512_fmadd_ps(va, vb, vc));
+    return result;
+}
+
+#define AVX512_BINARY_N(name, vop, store, prefetch, finish)                     \
+static SIMD_TARGET_AVX512 void name(float* dst, const float* a, const float* b, size_t n) { \
+    size_t i = avx512_head(dst, n);                                             \
+    if (i) {                                                                    \
+        __mmask16 m = avx512_mask(i);                                           \
+        _mm512_mask_storeu_ps(dst, m, vop(_mm512_maskz_loadu_ps(m, a),          \
+                                          _mm512_maskz_loadu_ps(m, b)));        \
+    }                                                                           \
+    for (; i + 64 <= n; i += 64) {                                              \
+        for (size_t l = 0; l < 64; l += 16) {                                   \
+            prefetch(a + i + l);                                                \
+            prefetch(b + i + l);                                                \
+        }                                                                       \
+        __m512 r0 = vop(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));        \
+        __m512 r1 = vop(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16)); \
+        __m512 r2 = vop(_mm512_loadu_ps(a + i + 32), _mm512_loadu_ps(b + i + 32)); \
+        __m512 r3 = vop(_mm512_loadu_ps(a + i + 48), _mm512_loadu_ps(b + i + 48)); \
+        store(dst + i, r0);                                                     \
+        store(dst + i + 16, r1);                                                \
+        store(dst + i + 32, r2);                                                \
+        store(dst + i + 48, r3);                                                \
+    }                                                                           \
+    for (; i + 16 <= n; i += 16)                                                \
+        store(dst + i, vop(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i)));    \
+    finish;                                                                     \
+    if (i < n) {                                                                \
+        __mmask16 m = avx512_mask(n - i);                                       \
+        _mm512_mask_storeu_ps(dst + i, m, vop(_mm512_maskz_loadu_ps(m, a + i),  \
+                                              _mm512_maskz_loadu_ps(m, b + i))); \
+    }                                                                           \
+}
+
+#define AVX512_FMADD_N(name, store, prefetch, finish)                           \
+static SIMD_TARGET_AVX512 void name(float* dst, const float* a, const float* b, const float* c, size_t n) { \
+    size_t i = avx512_head(dst, n);                                             \
+    if (i) {                                                                    \
+        __mmask16 m = avx512_mask(i);                                           \
+        _mm512_mask_storeu_ps(dst, m, _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, a), \
+                                                      _mm512_maskz_loadu_ps(m, b), \
+                                                      _mm512_maskz_loadu_ps(m, c))); \
+    }                                                                           \
+    for (; i + 32 <= n; i += 32) {                                              \
+        for (size_t l = 0; l < 32; l += 16) {                                   \
+            prefetch(a + i + l);                                                \
+            prefetch(b + i + l);                                                \
+            prefetch(c + i + l);                                                \
+        }                                                                       \
+        __m512 r0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), \
+                                    _mm512_loadu_ps(c + i));                    \
+        __m512 r1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), \
+                                    _mm512_loadu_ps(c + i + 16));               \
+        store(dst + i, r0);                                                     \
+        store(dst + i + 16, r1);                                                \
+    }                                                                           \
+    for (; i + 16 <= n; i += 16)                                                \
+        store(dst + i, _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), \
+                                       _mm512_loadu_ps(c + i)));                \
+    finish;                                                                     \
+    if (i < n) {                                                                \
+        __mmask16 m = avx512_mask(n - i);                                       \
+        _mm512_mask_storeu_ps(dst + i, m, _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, a + i), \
+                                                          _mm512_maskz_loadu_ps(m, b + i), \
+                                                          _mm512_maskz_loadu_ps(m, c + i))); \
+    }                                                                           \
+}
+
+AVX512_BINARY_N(simd_add_n_avx512, _mm512_add_ps, _mm512_store_ps, SIMD_NO_PREFETCH, (void)0)
+AVX512_BINARY_N(simd_sub_n_avx512, _mm512_sub_ps, _mm512_store_ps, SIMD_NO_PREFETCH, (void)0)
+AVX512_BINARY_N(simd_mul_n_avx512, _mm512_mul_ps, _mm512_store_ps, SIMD_NO_PREFETCH, (void)0)
+AVX512_FMADD_N(simd_fmadd_n_avx512, _mm512_store_ps, SIMD_NO_PREFETCH, (void)0)
+AVX512_BINARY_N(simd_add_n_stream_avx512, _mm512_add_ps, _mm512_stream_ps, SIMD_PREFETCH, _mm_sfence())
+AVX512_BINARY_N(simd_mul_n_stream_avx512, _mm512_mul_ps, _mm512_stream_ps, SIMD_PREFETCH, _mm_sfence())
+AVX512_FMADD_N(simd_fmadd_n_stream_avx512, _mm512_stream_ps, SIMD_PREFETCH, _mm_sfence())
+
+// fill and copy as in the SSE2 backend, a cache line at a time. byte-sized
+// heads and tails would need AVX-512BW masks, so they stay with memcpy
+#define AVX512_FILL_N(name, store, finish)                                      \
+static SIMD_TARGET_AVX512 void name(void* dst, const void* pattern, size_t bytes) { \
+    char* d = dst;                                                              \
+    size_t i = (64 - ((uintptr_t)d & 63)) & 63;                                 \
+    if (i > bytes) i = bytes;                                                   \
+    memcpy(d, pattern, i);                                                      \
+    __m512i v = _mm512_loadu_si512(pattern);                                    \
+    for (; i + 256 <= bytes; i += 256) {                                        \
+        store((__m512i*)(d + i), v);                                            \
+        store((__m512i*)(d + i + 64), v);                                       \
+        store((__m512i*)(d + i + 128), v);                                      \
+        store((__m512i*)(d + i + 192), v);                                      \
+    }                                                                           \
+    for (; i + 64 <= bytes; i += 64)                                            \
+        store((__m512i*)(d + i), v);                                            \
+    finish;                                                                     \
+    memcpy(d + i, pattern, bytes - i);                                          \
+}
+
+#define AVX512_COPY_N(name, store, prefetch, finish)                            \
+static SIMD_TARGET_AVX512 void name(void* dst, const void* src, size_t bytes) { \
+    char* d = dst;                                                              \
+    const char* s = src;                                                        \
+    size_t i = (64 - ((uintptr_t)d & 63)) & 63;                                 \
+    if (i > bytes) i = bytes;                                                   \
+    memcpy(d, s, i);                                                            \
+    for (; i + 256 <= bytes; i += 256) {                                        \
+        for (size_t l = 0; l < 256; l += 64) prefetch(s + i + l);               \
+        __m512i r0 = _mm512_loadu_si512(s + i);                                 \
+        __m512i r1 = _mm512_loadu_si512(s + i + 64);                            \
+        __m512i r2 = _mm512_loadu_si512(s + i + 128);                           \
+        __m512i r3 = _mm512_loadu_si512(s + i + 192);                           \
+        store((__m512i*)(d + i), r0);                                           \
+        store((__m512i*)(d + i + 64), r1);                                      \
+        store((__m512i*)(d + i + 128), r2);                                     \
+        store((__m512i*)(d + i + 192), r3);                                     \
+    }                                                                           \
+    for (; i + 64 <= bytes; i += 64)                                            \
+        store((__m512i*)(d + i), _mm512_loadu_si512(s + i));                    \
+    finish;                                                                     \
+    memcpy(d + i, s + i, bytes - i);                                            \
+}
+
+AVX512_FILL_N(simd_fill_n_avx512, _mm512_store_si512, (void)0)
+AVX512_FILL_N(simd_fill_n_stream_avx512, _mm512_stream_si512, _mm_sfence())
+AVX512_COPY_N(simd_copy_n_avx512, _mm512_store_si512, SIMD_NO_PREFETCH, (void)0)
+AVX512_COPY_N(simd_copy_n_stream_avx512, _mm512_stream_si512, SIMD_PREFETCH, _mm_sfence())
+
+// one tile of up to 16x16: rows of the tile come from cols source rows
+// masked to rows lanes (missing rows read as zero), then interleave pairs of
+// rows, pairs of pairs, and regroup 128-bit lanes twice
+static inline SIMD_TARGET_AVX512 void avx512_transpose16(float* dst, size_t ldd, const float* src,
+                                                         size_t lds, size_t rows, size_t cols) {
+    __mmask16 load = avx512_mask(rows), store = avx512_mask(cols);
+    __m512 r[16], t[16];
+    for (size_t k = 0; k < 16; k++)
+        r[k] = k < cols ? _mm512_maskz_loadu_ps(load, src + k * lds) : _mm512_setzero_ps();
+    for (int k = 0; k < 16; k += 2) {
+        t[k] = _mm512_unpacklo_ps(r[k], r[k + 1]);
+        t[k + 1] = _mm512_unpackhi_ps(r[k], r[k + 1]);
+    }
+    for (int k = 0; k < 16; k += 4) {
+        r[k] = _mm512_shuffle_ps(t[k], t[k + 2], _MM_SHUFFLE(1, 0, 1, 0));
+        r[k + 1] = _mm512_shuffle_ps(t[k], t[k + 2], _MM_SHUFFLE(3, 2, 3, 2));
+        r[k + 2] = _mm512_shuffle_ps(t[k + 1], t[k + 3], _MM_SHUFFLE(1, 0, 1, 0));
+        r[k + 3] = _mm512_shuffle_ps(t[k + 1], t[k + 3], _MM_SHUFFLE(3, 2, 3, 2));
+    }
+    for (int k = 0; k < 16; k += 8) {
+        for (int q = 0; q < 4; q++) {
+            t[k + q] = _mm512_shuffle_f32x4(r[k + q], r[k + q + 4], 0x88);
+            t[k + q + 4] = _mm512_shuffle_f32x4(r[k + q], r[k + q + 4], 0xdd);
+        }
+    }
+    for (size_t k = 0; k < 8; k++) {
+        if (k < rows)
+            _mm512_mask_storeu_ps(dst + k * ldd, store, _mm512_shuffle_f32x4(t[k], t[k + 8], 0x88));
+        if (k + 8 < rows)
+            _mm512_mask_storeu_ps(dst + (k + 8) * ldd, store,
+                                  _mm512_shuffle_f32x4(t[k], t[k + 8], 0xdd));
+    }
+}
+
+static SIMD_TARGET_AVX512 void simd_transpose_avx512(float* dst, size_t ldd, const float* src,
+                                                     size_t lds, size_t rows, size_t cols) {
+    for (size_t i = 0; i < rows; i += 16) {
+        size_t ri = rows - i < 16 ? rows - i : 16;
+        for (size_t j = 0; j < cols; j += 16) {
+            size_t cj = cols - j < 16 ? cols - j : 16;
+            avx512_transpose16(dst + i * ldd + j, ldd, src + j * lds + i, lds, ri, cj);
+        }
+    }
+}
+
+static SIMD_TARGET_AVX512 void simd_axpy_n_avx512(float* y, float alpha, const float* x, size_t n) {
+    __m512 va = _mm512_set1_ps(alpha);
+    size_t i = avx512_head(y, n);
+    if (i) {
+        __mmask16 m = avx512_mask(i);
+        _mm512_mask_storeu_ps(y, m, _mm512_fmadd_ps(va, _mm512_maskz_loadu_ps(m, x),
+                                                    _mm512_maskz_loadu_ps(m, y)));
+    }
+    for (; i + 64 <= n; i += 64) {
+        __m512 r0 = _mm512_fmadd_ps(va, _mm512_loadu_ps(x + i), _mm512_load_ps(y + i));
+        __m512 r1 = _mm512_fmadd_ps(va, _mm512_loadu_ps(x + i + 16), _mm512_load_ps(y + i + 16));
+        __m512 r2 = _mm512_fmadd_ps(va, _mm512_loadu_ps(x + i + 32), _mm512_load_ps(y + i + 32));
+        __m512 r3 = _mm512_fmadd_ps(va, _mm512_loadu_ps(x + i + 48), _mm512_load_ps(y + i + 48));
+        _mm512_store_ps(y + i, r0);
+        _mm512_store_ps(y + i + 16, r1);
+        _mm512_store_ps(y + i + 32, r2);
+        _mm512_store_ps(y + i + 48, r3);
+    }
+    for (; i + 16 <= n; i += 16)
+        _mm512_store_ps(y + i, _mm512_fmadd_ps(va, _mm512_loadu_ps(x + i), _mm512_load_ps(y + i)));
+    if (i < n) {
+        __mmask16 m = avx512_mask(n - i);
+        _mm512_mask_storeu_ps(y + i, m, _mm512_fmadd_ps(va, _mm512_maskz_loadu_ps(m, x + i),
+                                                        _mm512_maskz_loadu_ps(m, y + i)));
+    }
+}
+
+#define AVX512_SCALAR_N(name, vop)                                              \
+static SIMD_TARGET_AVX512 void name(float* dst, const float* a, float scalar, size_t n) { \
+    __m512 vs = _mm512_set1_ps(scalar);                                         \
+    size_t i = avx512_head(dst, n);                                             \
+    if (i) {                                                                    \
+        __mmask16 m = avx512_mask(i);                                           \
+        _mm512_mask_storeu_ps(dst, m, vop(_mm512_maskz_loadu_ps(m, a), vs));    \
+    }                                                                           \
+    for (; i + 64 <= n; i += 64) {                                              \
+        __m512 r0 = vop(_mm512_loadu_ps(a + i), vs);                            \
+        __m512 r1 = vop(_mm512_loadu_ps(a + i + 16), vs);                       \
+        __m512 r2 = vop(_mm512_loadu_ps(a + i + 32), vs);                       \
+        __m512 r3 = vop(_mm512_loadu_ps(a + i + 48), vs);                       \
+        _mm512_store_ps(dst + i, r0);                                           \
+        _mm512_store_ps(dst + i + 16, r1);                                      \
+        _mm512_store_ps(dst + i + 32, r2);                                      \
+        _mm512_store_ps(dst + i + 48, r3);                                      \
+    }                                                                           \
+    for (; i + 16 <= n; i += 16)                                                \
+        _mm512_store_ps(dst + i, vop(_mm512_loadu_ps(a + i), vs));              \
+    if (i < n) {                                                                \
+        __mmask16 m = avx512_mask(n - i);                                       \
+        _mm512_mask_storeu_ps(dst + i, m, vop(_mm512_maskz_loadu_ps(m, a + i), vs)); \
+    }                                                                           \
+}
+
+AVX512_SCALAR_N(simd_scale_n_avx512, _mm512_mul_ps)
+AVX512_SCALAR_N(simd_add_scalar_n_avx512, _mm512_add_ps)
+
+// the tail is a masked load whose inactive lanes hold the identity, so it
+// folds into the accumulators like a full vector
+#define AVX512_REDUCE_N(name, vop, hreduce, identity)                           \
+static SIMD_TARGET_AVX512 float name(const float* a, size_t n) {                \
+    __m512 id = _mm512_set1_ps(identity);                                       \
+    __m512 r0 = id, r1 = id, r2 = id, r3 = id;                                  \
+    size_t i = 0;                                                               \
+    for (; i + 64 <= n; i += 64) {                                              \
+        r0 = vop(r0, _mm512_loadu_ps(a + i));                                   \
+        r1 = vop(r1, _mm512_loadu_ps(a + i + 16));                              \
+        r2 = vop(r2, _mm512_loadu_ps(a + i + 32));                              \
+        r3 = vop(r3, _mm512_loadu_ps(a + i + 48));                              \
+    }                                                                           \
+    for (; i + 16 <= n; i += 16)                                                \
+        r0 = vop(r0, _mm512_loadu_ps(a + i));                                   \
+    if (i < n)                                                                  \
+        r1 = vop(r1, _mm512_mask_loadu_ps(id, avx512_mask(n - i), a + i));      \
+    return hreduce(vop(vop(r0, r1), vop(r2, r3)));                              \
+}
+
+AVX512_REDUCE_N(simd_sum_n_avx512, _mm512_add_ps, _mm512_reduce_add_ps, 0.0f)
+AVX512_REDUCE_N(simd_max_n_avx512, _mm512_max_ps, _mm512_reduce_max_ps, -INFINITY)
+AVX512_REDUCE_N(simd_min_n_avx512, _mm512_min_ps, _mm512_reduce_min_ps, INFINITY)
+
+static SIMD_TARGET_AVX512 void simd_sum_kahan_n_avx512(const float* a, size_t n, float* sum_out, float* comp_out) {
+    __m512 s0 = _mm512_setzero_ps(), c0 = s0, s1 = s0, c1 = s0;
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m512 y0 = _mm512_sub_ps(_mm512_loadu_ps(a + i), c0);
+        __m512 y1 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 16), c1);
+        __m512 t0 = _mm512_add_ps(s0, y0);
+        __m512 t1 = _mm512_add_ps(s1, y1);
+        c0 = _mm512_sub_ps(_mm512_sub_ps(t0, s0), y0);
+        c1 = _mm512_sub_ps(_mm512_sub_ps(t1, s1), y1);
+        s0 = t0;
+        s1 = t1;
+    }
+    for (; i < n; i += 16) {
+        __mmask16 m = n - i < 16 ? avx512_mask(n - i) : 0xFFFF;
+        __m512 y0 = _mm512_sub_ps(_mm512_maskz_loadu_ps(m, a + i), c0);
+        __m512 t0 = _mm512_add_ps(s0, y0);
+        c0 = _mm512_sub_ps(_mm512_sub_ps(t0, s0), y0);
+        s0 = t0;
+    }
+    float sums[32], comps[32];
+    _mm512_storeu_ps(sums, s0);
+    _mm512_storeu_ps(sums + 16, s1);
+    _mm512_storeu_ps(comps, c0);
+    _mm512_storeu_ps(comps + 16, c1);
+    for (int k = 0; k < 32; k++) {
+        simd_kahan_add(sum_out, comp_out, sums[k]);
+        simd_kahan_add(sum_out, comp_out, -comps[k]);
+    }
+}
+
+static SIMD_TARGET_AVX512 float simd_dot_n_avx512(const float* a, const float* b, size_t n) {
+    __m512 r0 = _mm512_setzero_ps(), r1 = r0, r2 = r0, r3 = r0;
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        r0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), r0);
+        r1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), r1);
+        r2 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 32), _mm512_loadu_ps(b + i + 32), r2);
+        r3 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 48), _mm512_loadu_ps(b + i + 48), r3);
+    }
+    for (; i + 16 <= n; i += 16)
+        r0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), r0);
+    if (i < n) {
+        __mmask16 m = avx512_mask(n - i);
+        r1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, a + i), _mm512_maskz_loadu_ps(m, b + i), r1);
+    }
+    return _mm512_reduce_add_ps(_mm512_add_ps(_mm512_add_ps(r0, r1), _mm512_add_ps(r2, r3)));
+}
+
+// conversions run 16 lanes at a time. masked tails narrower than 512 bits
+// would need AVX-512BW/VL, so remainders use the scalar helpers, which round
+// identically
+static SIMD_TARGET_AVX512 void simd_load_f64_n_avx512(float* dst, const void* src, size_t n) {
+    const double* s = src;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        _mm256_storeu_ps(dst + i, _mm512_cvtpd_ps(_mm512_loadu_pd(s + i)));
+        _mm256_storeu_ps(dst + i + 8, _mm512_cvtpd_ps(_mm512_loadu_pd(s + i + 8)));
+    }
+    for (; i < n; i++)
+        dst[i] = (float)s[i];
+}
+
+static SIMD_TARGET_AVX512 void simd_store_f64_n_avx512(void* dst, const float* src, size_t n) {
+    double* d = dst;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        _mm512_storeu_pd(d + i, _mm512_cvtps_pd(_mm256_loadu_ps(src + i)));
+        _mm512_storeu_pd(d + i + 8, _mm512_cvtps_pd(_mm256_loadu_ps(src + i + 8)));
+    }
+    for (; i < n; i++)
+        d[i] = src[i];
+}
+
+static SIMD_TARGET_AVX512 void simd_load_f16_n_avx512(float* dst, const void* src, size_t n) {
+    const uint16_t* s = src;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+        _mm512_storeu_ps(dst + i, _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i*)(s + i))));
+    for (; i < n; i++)
+        dst[i] = simd_f16_to_float(s[i]);
+}
+
+static SIMD_TARGET_AVX512 void simd_store_f16_n_avx512(void* dst, const float* src, size_t n) {
+    uint16_t* d = dst;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i h = _mm512_cvtps_ph(_mm512_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm256_storeu_si256((__m256i*)(d + i), h);
+    }
+    for (; i < n; i++)
+        d[i] = simd_float_to_f16(src[i]);
+}
+
+static SIMD_TARGET_AVX512 void simd_load_bf16_n_avx512(float* dst, const void* src, size_t n) {
+    const uint16_t* s = src;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i w = _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i*)(s + i)));
+        _mm512_storeu_ps(dst + i, _mm512_castsi512_ps(_mm512_slli_epi32(w, 16)));
+    }
+    for (; i < n; i++)
+        dst[i] = simd_bf16_to_float(s[i]);
+}
+
+// simd_float_to_bf16 on sixteen lanes, for CPUs without AVX-512 BF16
+static SIMD_TARGET_AVX512 void simd_store_bf16_n_avx512(void* dst, const float* src, size_t n) {
+    uint16_t* d = dst;
+    const __m512i one = _mm512_set1_epi32(1);
+    const __m512i bias = _mm512_set1_epi32(0x7fff);
+    const __m512i exp_mask = _mm512_set1_epi32(0x7f800000);
+    const __m512i sign_mask = _mm512_set1_epi32(0x8000);
+    const __m512i quiet = _mm512_set1_epi32(0x40);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512 x = _mm512_loadu_ps(src + i);
+        __m512i bits = _mm512_castps_si512(x);
+        __m512i high = _mm512_srli_epi32(bits, 16);
+        __m512i odd = _mm512_and_si512(high, one);
+        __m512i r = _mm512_srli_epi32(_mm512_add_epi32(bits, _mm512_add_epi32(bias, odd)), 16);
+        __mmask16 nan = _mm512_cmp_ps_mask(x, x, _CMP_UNORD_Q);
+        __mmask16 tiny = _mm512_testn_epi32_mask(bits, exp_mask);
+        r = _mm512_mask_mov_epi32(r, nan, _mm512_or_si512(high, quiet));
+        r = _mm512_mask_mov_epi32(r, tiny, _mm512_and_si512(high, sign_mask));
+        _mm256_storeu_si256((__m256i*)(d + i), _mm512_cvtepi32_epi16(r));
+    }
+    for (; i < n; i++)
+        d[i] = simd_float_to_bf16(src[i]);
+}
+
+static SIMD_TARGET_AVX512_BF16 void simd_store_bf16_n_avx512bf16(void* dst, const float* src, size_t n) {
+    uint16_t* d = dst;
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m512bh h = _mm512_cvtne2ps_pbh(_mm512_loadu_ps(src + i + 16), _mm512_loadu_ps(src + i));
+        _mm512_storeu_si512(d + i, (__m512i)h);
+    }
+    for (; i + 16 <= n; i += 16) {
+        __m256bh h = _mm512_cvtneps_pbh(_mm512_loadu_ps(src + i));
+        _mm256_storeu_si256((__m256i*)(d + i), (__m256i)h);
+    }
+    for (; i < n; i++)
+        d[i] = simd_float_to_bf16(src[i]);
+}
+
+static SIMD_TARGET_AVX512 void simd_load_i32_n_avx512(float* dst, const void* src, size_t n) {
+    const int32_t* s = src;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+        _mm512_storeu_ps(dst + i, _mm512_cvtepi32_ps(_mm512_loadu_si512(s + i)));
+    if (i < n) {
+        __mmask16 m = avx512_mask(n - i);
+        _mm512_mask_storeu_ps(dst + i, m, _mm512_cvtepi32_ps(_mm512_maskz_loadu_epi32(m, s + i)));
+    }
+}
+
+// as in the AVX2 version: NaN lanes are zeroed before the conversion and
+// positive overflow, which converts to INT32_MIN, is patched afterwards
+static SIMD_TARGET_AVX512 void simd_store_i32_n_avx512(void* dst, const float* src, size_t n) {
+    int32_t* d = dst;
+    const __m512 limit = _mm512_set1_ps(2147483648.0f);
+    const __m512i max = _mm512_set1_epi32(INT32_MAX);
+    for (size_t i = 0; i < n; i += 16) {
+        __mmask16 m = n - i < 16 ? avx512_mask(n - i) : 0xFFFF;
+        __m512 x = _mm512_maskz_loadu_ps(m, src + i);
+        x = _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(x, x, _CMP_ORD_Q), x);
+        __m512i r = _mm512_cvtps_epi32(x);
+        r = _mm512_mask_mov_epi32(r, _mm512_cmp_ps_mask(x, limit, _CMP_GE_OQ), max);
+        _mm512_mask_storeu_epi32(d + i, m, r);
+    }
+}
+
+static SIMD_TARGET_AVX512 void simd_load_i8_n_avx512(float* dst, const void* src, size_t n) {
+    const int8_t* s = src;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i w = _mm512_cvtepi8_epi32(_mm_loadu_si128((const __m128i*)(s + i)));
+        _mm512_storeu_ps(dst + i, _mm512_cvtepi32_ps(w));
+    }
+    for (; i < n; i++)
+        dst[i] = (float)s[i];
+}
+
+static SIMD_TARGET_AVX512 void simd_store_i8_n_avx512(void* dst, const float* src, size_t n) {
+    int8_t* d = dst;
+    const __m512 lo = _mm512_set1_ps(-128.0f);
+    const __m512 hi = _mm512_set1_ps(127.0f);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512 x = _mm512_loadu_ps(src + i);
+        x = _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(x, x, _CMP_ORD_Q), x);
+        __m512i r = _mm512_cvtps_epi32(_mm512_min_ps(_mm512_max_ps(x, lo), hi));
+        _mm_storeu_si128((__m128i*)(d + i), _mm512_cvtepi32_epi8(r));
+    }
+    for (; i < n; i++)
+        d[i] = simd_float_to_i8(src[i]);
+}
+
+static inline SIMD_TARGET_AVX512 __mmask8 avx512_mask_f64(size_t n) {
+    return (__mmask8)((1u << n) - 1);
+}
+
+#define AVX512_BINARY_F64_N(name, vop)                                          \
+static SIMD_TARGET_AVX512 void name(double* dst, const double* a, const double* b, size_t n) { \
+    size_t i = 0;                                                               \
+    for (; i + 32 <= n; i += 32) {                                              \
+        __m512d r0 = vop(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i));       \
+        __m512d r1 = vop(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8)); \
+        __m512d r2 = vop(_mm512_loadu_pd(a + i + 16), _mm512_loadu_pd(b + i + 16)); \
+        __m512d r3 = vop(_mm512_loadu_pd(a + i + 24), _mm512_loadu_pd(b + i + 24)); \
+        _mm512_storeu_pd(dst + i, r0);                                          \
+        _mm512_storeu_pd(dst + i + 8, r1);                                      \
+        _mm512_storeu_pd(dst + i + 16, r2);                                     \
+        _mm512_storeu_pd(dst + i + 24, r3);                                     \
+    }                                                                           \
+    for (; i + 8 <= n; i += 8)                                                  \
+        _mm512_storeu_pd(dst + i, vop(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i))); \
+    if (i < n) {                                                                \
+        __mmask8 m = avx512_mask_f64(n - i);                                    \
+        _mm512_mask_storeu_pd(dst + i, m, vop(_mm512_maskz_loadu_pd(m, a + i),  \
+                                              _mm512_maskz_loadu_pd(m, b + i))); \
+    }                                                                           \
+}
+
+AVX512_BINARY_F64_N(simd_add_f64_n_avx512, _mm512_add_pd)
+AVX512_BINARY_F64_N(simd_sub_f64_n_avx512, _mm512_sub_pd)
+AVX512_BINARY_F64_N(simd_mul_f64_n_avx512, _mm512_mul_pd)
+
+static SIMD_TARGET_AVX512 void simd_fmadd_f64_n_avx512(double* dst, const double* a, const double* b, const double* c, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512d r0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), _mm512_loadu_pd(c + i));
+        __m512d r1 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8),
+                                     _mm512_loadu_pd(c + i + 8));
+        _mm512_storeu_pd(dst + i, r0);
+        _mm512_storeu_pd(dst + i + 8, r1);
+    }
+    for (; i < n; i += 8) {
+        __mmask8 m = n - i < 8 ? avx512_mask_f64(n - i) : 0xFF;
+        _mm512_mask_storeu_pd(dst + i, m, _mm512_fmadd_pd(_mm512_maskz_loadu_pd(m, a + i),
+                                                          _mm512_maskz_loadu_pd(m, b + i),
+                                                          _mm512_maskz_loadu_pd(m, c + i)));
+    }
+}
+
+static SIMD_TARGET_AVX512 void simd_scale_f64_n_avx512(double* dst, const double* a, double scalar, size_t n) {
+    __m512d vs = _mm512_set1_pd(scalar);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        _mm512_storeu_pd(dst + i, _mm512_mul_pd(_mm512_loadu_pd(a + i), vs));
+        _mm512_storeu_pd(dst + i + 8, _mm512_mul_pd(_mm512_loadu_pd(a + i + 8), vs));
+    }
+    for (; i < n; i += 8) {
+        __mmask8 m = n - i < 8 ? avx512_mask_f64(n - i) : 0xFF;
+        _mm512_mask_storeu_pd(dst + i, m, _mm512_mul_pd(_mm512_maskz_loadu_pd(m, a + i), vs));
+    }
+}
+
+#define AVX512_REDUCE_F64_N(name, vop, hreduce, identity)                       \
+static SIMD_TARGET_AVX512 double name(const double* a, size_t n) {              \
+    __m512d id = _mm512_set1_pd(identity);                                      \
+    __m512d r0 = id, r1 = id, r2 = id, r3 = id;                                 \
+    size_t i = 0;                                                               \
+    for (; i + 32 <= n; i += 32) {                                              \
+        r0 = vop(r0, _mm512_loadu_pd(a + i));                                   \
+        r1 = vop(r1, _mm512_loadu_pd(a + i + 8));                               \
+        r2 = vop(r2, _mm512_loadu_pd(a + i + 16));                              \
+        r3 = vop(r3, _mm512_loadu_pd(a + i + 24));                              \
+    }                                                                           \
+    for (; i + 8 <= n; i += 8)                                                  \
+        r0 = vop(r0, _mm512_loadu_pd(a + i));                                   \
+    if (i < n)                                                                  \
+        r1 = vop(r1, _mm512_mask_loadu_pd(id, avx512_mask_f64(n - i), a + i));  \
+    return hreduce(vop(vop(r0, r1), vop(r2, r3)));                              \
+}
+
+AVX512_REDUCE_F64_N(simd_sum_f64_n_avx512, _mm512_add_pd, _mm512_reduce_add_pd, 0.0)
+AVX512_REDUCE_F64_N(simd_max_f64_n_avx512, _mm512_max_pd, _mm512_reduce_max_pd, -INFINITY)
+AVX512_REDUCE_F64_N(simd_min_f64_n_avx512, _mm512_min_pd, _mm512_reduce_min_pd, INFINITY)
+
+// the vector forms of simd_exp_f32 and friends. scalef applies 2^k with a
+// single rounding and getexp/getmant split subnormals directly, so neither
+// needs the scaling steps of the other backends; the bitwise float ops are
+// AVX512DQ, hence the integer casts
+static inline SIMD_TARGET_AVX512 __m512 avx512_exp_ps(__m512 x) {
+    // min and max return their second operand for NaN, which keeps it
+    x = _mm512_max_ps(_mm512_set1_ps(SIMD_EXP_MIN), _mm512_min_ps(_mm512_set1_ps(SIMD_EXP_MAX), x));
+
+    __m512 k = _mm512_roundscale_ps(_mm512_mul_ps(x, _mm512_set1_ps(SIMD_LOG2E)),
+                                    _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m512 r = _mm512_fnmadd_ps(k, _mm512_set1_ps(SIMD_LN2_HI), x);
+    r = _mm512_fnmadd_ps(k, _mm512_set1_ps(SIMD_LN2_LO), r);
+
+    __m512 p = _mm512_set1_ps(SIMD_EXP_P0);
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(SIMD_EXP_P1));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(SIMD_EXP_P2));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(SIMD_EXP_P3));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(SIMD_EXP_P4));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(SIMD_EXP_P5));
+    p = _mm512_add_ps(_mm512_fmadd_ps(p, _mm512_mul_ps(r, r), r), _mm512_set1_ps(1.0f));
+    return _mm512_scalef_ps(p, k);
+}
+
+static inline SIMD_TARGET_AVX512 __m512 avx512_log_ps(__m512 x) {
+    __m512 one = _mm512_set1_ps(1.0f);
+    __m512 zero = _mm512_setzero_ps();
+
+    // x = m 2^e with m in [1, 2); the upper part of the range is halved so
+    // m - 1 covers [sqrt(1/2) - 1, sqrt(2) - 1) as in the other backends
+    __m512 m = _mm512_getmant_ps(x, _MM_MANT_NORM_1_2, _MM_MANT_SIGN_zero);
+    __m512 e = _mm512_getexp_ps(x);
+    __mmask16 big = _mm512_cmp_ps_mask(m, _mm512_set1_ps(2.0f * SIMD_SQRT_HALF), _CMP_GE_OQ);
+    m = _mm512_sub_ps(_mm512_mask_mul_ps(m, big, m, _mm512_set1_ps(0.5f)), one);
+    e = _mm512_mask_add_ps(e, big, e, one);
+
+    __m512 z = _mm512_mul_ps(m, m);
+    __m512 p = _mm512_set1_ps(SIMD_LOG_P0);
+    p = _mm512_fmadd_ps(p, m, _mm512_set1_ps(SIMD_LOG_P1));
+    p = _mm512_fmadd_ps(p, m, _mm512_set1_ps(SIMD_LOG_P2));
+    p = _mm512_fmadd_ps(p, m, _mm512_set1_ps(SIMD_LOG_P3));
+    p = _mm512_fmadd_ps(p, m, _mm512_set1_ps(SIMD_LOG_P4));
+    p = _mm512_fmadd_ps(p, m, _mm512_set1_ps(SIMD_LOG_P5));
+    p = _mm512_fmadd_ps(p, m, _mm512_set1_ps(SIMD_LOG_P6));
+    p = _mm512_fmadd_ps(p, m, _mm512_set1_ps(SIMD_LOG_P7));
+    p = _mm512_fmadd_ps(p, m, _mm512_set1_ps(SIMD_LOG_P8));
+
+    __m512 y = _mm512_mul_ps(_mm512_mul_ps(p, m), z);
+    y = _mm512_fmadd_ps(e, _mm512_set1_ps(SIMD_LN2_LO), y);
+    y = _mm512_fnmadd_ps(_mm512_set1_ps(0.5f), z, y);
+    __m512 r = _mm512_fmadd_ps(e, _mm512_set1_ps(SIMD_LN2_HI), _mm512_add_ps(m, y));
+
+    __m512 inf = _mm512_set1_ps(INFINITY);
+    r = _mm512_mask_mov_ps(r, _mm512_cmp_ps_mask(x, inf, _CMP_EQ_OQ), inf);
+    r = _mm512_mask_mov_ps(r, _mm512_cmp_ps_mask(x, zero, _CMP_EQ_OQ), _mm512_set1_ps(-INFINITY));
+    return _mm512_mask_mov_ps(r, _mm512_cmp_ps_mask(x, zero, _CMP_NGE_UQ), _mm512_set1_ps(NAN));
+}
+
+static inline SIMD_TARGET_AVX512 __m512 avx512_sigmoid_ps(__m512 x) {
+    __m512 one = _mm512_set1_ps(1.0f);
+    __m512i sign = _mm512_set1_epi32((int)0x80000000);
+    __m512 e = avx512_exp_ps(_mm512_castsi512_ps(_mm512_or_epi32(_mm512_castps_si512(x), sign)));
+    __m512 num = _mm512_mask_mov_ps(one, _mm512_cmp_ps_mask(x, _mm512_setzero_ps(), _CMP_LT_OQ), e);
+    return _mm512_div_ps(num, _mm512_add_ps(one, e));
+}
+
+static inline SIMD_TARGET_AVX512 __m512 avx512_tanh_ps(__m512 x) {
+    __m512i sign = _mm512_set1_epi32((int)0x80000000);
+    __m512 one = _mm512_set1_ps(1.0f);
+    __m512 z = _mm512_abs_ps(x);
+
+    __m512 s = _mm512_mul_ps(x, x);
+    __m512 p = _mm512_set1_ps(SIMD_TANH_P0);
+    p = _mm512_fmadd_ps(p, s, _mm512_set1_ps(SIMD_TANH_P1));
+    p = _mm512_fmadd_ps(p, s, _mm512_set1_ps(SIMD_TANH_P2));
+    p = _mm512_fmadd_ps(p, s, _mm512_set1_ps(SIMD_TANH_P3));
+    p = _mm512_fmadd_ps(p, s, _mm512_set1_ps(SIMD_TANH_P4));
+    __m512 near = _mm512_fmadd_ps(_mm512_mul_ps(p, s), z, z);
+
+    __m512 e = avx512_exp_ps(_mm512_add_ps(z, z));
+    __m512 far = _mm512_sub_ps(one, _mm512_div_ps(_mm512_set1_ps(2.0f), _mm512_add_ps(e, one)));
+    __mmask16 small = _mm512_cmp_ps_mask(z, _mm512_set1_ps(SIMD_TANH_SMALL), _CMP_LT_OQ);
+    __m512 r = _mm512_mask_blend_ps(small, far, near);
+    return _mm512_castsi512_ps(_mm512_or_epi32(_mm512_castps_si512(r),
+                                               _mm512_and_epi32(_mm512_castps_si512(x), sign)));
+}
+
+// the 14-bit estimate refined by one Newton step, with subnormals scaled
+// into range and the estimate kept where it is already exact (see SSE2)
+static inline SIMD_TARGET_AVX512 __m512 avx512_rsqrt_ps(__m512 x) {
+    __mmask16 sub = _mm512_cmp_ps_mask(x, _mm512_set1_ps(0x1p-126f), _CMP_LT_OQ);
+    __m512 xs = _mm512_mask_mul_ps(x, sub, x, _mm512_set1_ps(0x1p24f));
+
+    __m512 y = _mm512_rsqrt14_ps(xs);
+    __m512 residual = _mm512_fnmadd_ps(_mm512_mul_ps(xs, y), y, _mm512_set1_ps(1.0f));
+    __m512 nr = _mm512_fmadd_ps(_mm512_mul_ps(_mm512_set1_ps(0.5f), y), residual, y);
+    __mmask16 finite = _mm512_cmp_ps_mask(xs, _mm512_setzero_ps(), _CMP_GT_OQ) &
+                       _mm512_cmp_ps_mask(xs, _mm512_set1_ps(INFINITY), _CMP_LT_OQ);
+    __m512 r = _mm512_mask_blend_ps(finite, y, nr);
+    return _mm512_mask_mul_ps(r, sub, r, _mm512_set1_ps(0x1p12f));
+}
+
+#define AVX512_UNARY_N(name, vfunc)                                             \
+static SIMD_TARGET_AVX512 void name(float* dst, const float* a, size_t n) {     \
+    size_t i = avx512_head(dst, n);                                             \
+    if (i) {                                                                    \
+        __mmask16 m = avx512_mask(i);                                           \
+        _mm512_mask_storeu_ps(dst, m, vfunc(_mm512_maskz_loadu_ps(m, a)));      \
+    }                                                                           \
+    for (; i + 32 <= n; i += 32) {                                              \
+        __m512 r0 = vfunc(_mm512_loadu_ps(a + i));                              \
+        __m512 r1 = vfunc(_mm512_loadu_ps(a + i + 16));                         \
+        _mm512_store_ps(dst + i, r0);                                           \
+        _mm512_store_ps(dst + i + 16, r1);                                      \
+    }                                                                           \
+    for (; i + 16 <= n; i += 16)                                                \
+        _mm512_store_ps(dst + i, vfunc(_mm512_loadu_ps(a + i)));                \
+    if (i < n) {                                                                \
+        __mmask16 m = avx512_mask(n - i);                                       \
+        _mm512_mask_storeu_ps(dst + i, m, vfunc(_mm512_maskz_loadu_ps(m, a + i))); \
+    }                                                                           \
+}
+
+AVX512_UNARY_N(simd_exp_n_avx512, avx512_exp_ps)
+AVX512_UNARY_N(simd_log_n_avx512, avx512_log_ps)
+AVX512_UNARY_N(simd_sigmoid_n_avx512, avx512_sigmoid_ps)
+AVX512_UNARY_N(simd_tanh_n_avx512, avx512_tanh_ps)
+AVX512_UNARY_N(simd_sqrt_n_avx512, _mm512_sqrt_ps)
+AVX512_UNARY_N(simd_rsqrt_n_avx512, avx512_rsqrt_ps)
+
+// 12x32 tile: 24 accumulators plus two b vectors and a broadcast stay
+// within the 32 zmm registers, and each step loads 14 values for 24 FMAs.
+// rows unrolled as for SSE2
+static SIMD_TARGET_AVX512 void simd_gemm_kernel_avx512(size_t k, const float* a, const float* b, float* c,
+                                                       size_t ldc, int accumulate) {
+    __m512 acc[12][2];
+    #pragma GCC unroll 12
+    for (int i = 0; i < 12; i++) {
+        acc[i][0] = _mm512_setzero_ps();
+        acc[i][1] = _mm512_setzero_ps();
+    }
+    for (size_t p = 0; p < k; p++) {
+        __m512 b0 = _mm512_load_ps(b + p * 32);
+        __m512 b1 = _mm512_load_ps(b + p * 32 + 16);
+        #pragma GCC unroll 12
+        for (int i = 0; i < 12; i++) {
+            __m512 ai = _mm512_set1_ps(a[p * 12 + i]);
+            acc[i][0] = _mm512_fmadd_ps(ai, b0, acc[i][0]);
+            acc[i][1] = _mm512_fmadd_ps(ai, b1, acc[i][1]);
+        }
+    }
+    #pragma GCC unroll 12
+    for (int i = 0; i < 12; i++) {
+        float* row = c + i * ldc;
+        if (accumulate) {
+            acc[i][0] = _mm512_add_ps(acc[i][0], _mm512_loadu_ps(row));
+            acc[i][1] = _mm512_add_ps(acc[i][1], _mm512_loadu_ps(row + 16));
+        }
+        _mm512_storeu_ps(row, acc[i][0]);
+        _mm512_storeu_ps(row + 16, acc[i][1]);
+    }
+}
+
+void simd_use_avx512(simd_dispatch_t* dispatch) {
+    dispatch->add = simd_add_avx512;
+    dispatch->mul = simd_mul_avx512;
+    dispatch->fmadd = simd_fmadd_avx512;
+    dispatch->add_n = simd_add_n_avx512;
+    dispatch->sub_n = simd_sub_n_avx512;
+    dispatch->mul_n = simd_mul_n_avx512;
+    dispatch->fmadd_n = simd_fmadd_n_avx512;
+    dispatch->axpy_n = simd_axpy_n_avx512;
+    dispatch->scale_n = simd_scale_n_avx512;
+    dispatch->add_scalar_n = simd_add_scalar_n_avx512;
+    dispatch->add_n_stream = simd_add_n_stream_avx512;
+    dispatch->mul_n_stream = simd_mul_n_stream_avx512;
+    dispatch->fmadd_n_stream = simd_fmadd_n_stream_avx512;
+    dispatch->fill_n = simd_fill_n_avx512;
+    dispatch->fill_n_stream = simd_fill_n_stream_avx512;
+    dispatch->copy_n = simd_copy_n_avx512;
+    dispatch->copy_n_stream = simd_copy_n_stream_avx512;
+    dispatch->transpose = simd_transpose_avx512;
+    dispatch->sum_n = simd_sum_n_avx512;
+    dispatch->sum_kahan_n = simd_sum_kahan_n_avx512;
+    dispatch->max_n = simd_max_n_avx512;
+    dispatch->min_n = simd_min_n_avx512;
+    dispatch->dot_n = simd_dot_n_avx512;
+    dispatch->exp_n = simd_exp_n_avx512;
+    dispatch->log_n = simd_log_n_avx512;
+    dispatch->sigmoid_n = simd_sigmoid_n_avx512;
+    dispatch->tanh_n = simd_tanh_n_avx512;
+    dispatch->sqrt_n = simd_sqrt_n_avx512;
+    dispatch->rsqrt_n = simd_rsqrt_n_avx512;
+    dispatch->gemm_mr = 12;
+    dispatch->gemm_nr = 32;
+    dispatch->gemm_kernel = simd_gemm_kernel_avx512;
+    dispatch->load_f64_n = simd_load_f64_n_avx512;
+    dispatch->store_f64_n = simd_store_f64_n_avx512;
+    dispatch->load_f16_n = simd_load_f16_n_avx512;
+    dispatch->store_f16_n = simd_store_f16_n_avx512;
+    dispatch->load_bf16_n = simd_load_bf16_n_avx512;
+    dispatch->store_bf16_n = simd_cpu_has_avx512_bf16() ? simd_store_bf16_n_avx512bf16
+                                                        : simd_store_bf16_n_avx512;
+    dispatch->load_i32_n = simd_load_i32_n_avx512;
+    dispatch->store_i32_n = simd_store_i32_n_avx512;
+    dispatch->load_i8_n = simd_load_i8_n_avx512;
+    dispatch->store_i8_n = simd_store_i8_n_avx512;
+    dispatch->add_f64_n = simd_add_f64_n_avx512;
+    dispatch->sub_f64_n = simd_sub_f64_n_avx512;
+    dispatch->mul_f64_n = simd_mul_f64_n_avx512;
+    dispatch->fmadd_f64_n = simd_fmadd_f64_n_avx512;
+    dispatch->scale_f64_n = simd_scale_f64_n_avx512;
+    dispatch->sum_f64_n = simd_sum_f64_n_avx512;
+    dispatch->max_f64_n = simd_max_f64_n_avx512;
+    dispatch->min_f64_n = simd_min_f64_n_avx512;
+    simd_use_math_f64(dispatch);
+}
+#endif
@@ -0,0 +1,277 @@
+#ifndef SIMD_BACKENDS_H
+#define SIMD_BACKENDS_H
+
+#include "simd_abstraction.h"
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+// each backend lives in its own translation unit and marks every function
+// with a target attribute, so the library itself is built for the baseline
+// ISA and never executes an instruction the CPU check has not cleared.
+//
+// the whole-array kernels keep values in native registers for the whole loop,
+// unroll the main body, peel the head so stores to dst are aligned, and have
+// a non-temporal variant for outputs that should bypass the cache
+void simd_use_scalar(simd_dispatch_t* dispatch);
+
+// installs the portable conversion and float64 kernels, for backends that
+// have no vector versions of them
+void simd_use_scalar_formats(simd_dispatch_t* dispatch);
+
+// installs the float64 math kernels, which every backend takes from libm
+void simd_use_math_f64(simd_dispatch_t* dispatch);
+
+// scalar combine steps shared by the reduction kernels, for lane folding and
+// remainders. max/min follow the maxps/minps convention of returning b when
+// the comparison is false
+static inline float simd_combine_add(float a, float b) { return a + b; }
+static inline float simd_combine_max(float a, float b) { return a > b ? a : b; }
+static inline float simd_combine_min(float a, float b) { return a < b ? a : b; }
+
+// one step of compensated summation: *sum += x, with the lost low-order bits
+// kept in *comp. the compensated total is *sum - *comp
+static inline void simd_kahan_add(float* sum, float* comp, float x) {
+    float y = x - *comp;
+    float t = *sum + y;
+    *comp = (t - *sum) - y;
+    *sum = t;
+}
+
+static inline double simd_combine_add_f64(double a, double b) { return a + b; }
+static inline double simd_combine_max_f64(double a, double b) { return a > b ? a : b; }
+static inline double simd_combine_min_f64(double a, double b) { return a < b ? a : b; }
+
+// single-value conversions matching the vector kernels bit for bit; they
+// also cover the vector kernels' remainders
+static inline uint32_t simd_float_bits(float x) {
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    return bits;
+}
+
+static inline float simd_bits_float(uint32_t bits) {
+    float x;
+    memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+static inline float simd_f16_to_float(uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ff;
+    if (exp == 0) {
+        // zero or subnormal: mant units of 2^-24
+        return simd_bits_float(sign | simd_float_bits((float)mant * 0x1p-24f));
+    }
+    if (exp == 31) {
+        // NaNs come back quiet, as vcvtph2ps returns them
+        return simd_bits_float(sign | 0x7f800000 | (mant << 13) | (mant ? 0x400000 : 0));
+    }
+    return simd_bits_float(sign | ((exp + 112) << 23) | (mant << 13));
+}
+
+static inline uint16_t simd_float_to_f16(float x) {
+    uint32_t bits = simd_float_bits(x);
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t abs = bits & 0x7fffffff;
+
+    if (abs >= 0x7f800000) {
+        // infinity, or a NaN made quiet with the top of its payload kept
+        return (uint16_t)(sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 | ((abs >> 13) & 0x3ff) : 0));
+    }
+    // 65520 and above round to infinity
+    if (abs >= 0x477ff000) return (uint16_t)(sign | 0x7c00);
+    if (abs < 0x38800000) {
+        // below the smallest normal half: adding 0.5 leaves the value rounded
+        // to a multiple of 2^-24 in the low mantissa bits
+        uint32_t r = simd_float_bits(simd_bits_float(abs) + 0.5f) - 0x3f000000;
+        return (uint16_t)(sign | r);
+    }
+    // rebias the exponent and round the 13 dropped bits to nearest even
+    abs += 0xc8000fff + ((abs >> 13) & 1);
+    return (uint16_t)(sign | (abs >> 13));
+}
+
+static inline float simd_bf16_to_float(uint16_t h) {
+    return simd_bits_float((uint32_t)h << 16);
+}
+
+static inline uint16_t simd_float_to_bf16(float x) {
+    uint32_t bits = simd_float_bits(x);
+    if ((bits & 0x7fffffff) > 0x7f800000) return (uint16_t)((bits >> 16) | 0x40);
+    if ((bits & 0x7f800000) == 0) return (uint16_t)((bits >> 16) & 0x8000);
+    bits += 0x7fff + ((bits >> 16) & 1);
+    return (uint16_t)(bits >> 16);
+}
+
+static inline int32_t simd_float_to_i32(float x) {
+    if (isnan(x)) return 0;
+    if (x >= 2147483648.0f) return INT32_MAX;
+    if (x <= -2147483648.0f) return INT32_MIN;
+    return (int32_t)nearbyintf(x);
+}
+
+static inline int8_t simd_float_to_i8(float x) {
+    if (isnan(x)) return 0;
+    if (x >= 127.0f) return 127;
+    if (x <= -128.0f) return -128;
+    return (int8_t)nearbyintf(x);
+}
+
+// float32 math shared by every backend (Cephes expf/logf/tanhf). the vector
+// kernels run the same steps lane-wise, with fused multiply-adds where the
+// ISA has them, and use these for their remainders.
+//
+// exp splits x = k ln2 + r with ln2 in two parts, so k ln2 is exact, and
+// approximates e^r on |r| <= ln2 / 2. 2^k is applied as two halves so
+// results that underflow into subnormals are rounded only once. inputs are
+// clamped to where the result is certain to be +inf or 0; NaN passes through
+#define SIMD_EXP_MAX 89.0f
+#define SIMD_EXP_MIN -104.0f
+#define SIMD_LOG2E 1.44269504088896341f
+#define SIMD_LN2_HI 0.693359375f
+#define SIMD_LN2_LO -2.12194440e-4f
+// adding and subtracting 1.5 * 2^23 rounds to the nearest integer without
+// SSE4.1's round instruction
+#define SIMD_ROUND_MAGIC 12582912.0f
+#define SIMD_EXP_P0 1.9875691500e-4f
+#define SIMD_EXP_P1 1.3981999507e-3f
+#define SIMD_EXP_P2 8.3334519073e-3f
+#define SIMD_EXP_P3 4.1665795894e-2f
+#define SIMD_EXP_P4 1.6666665459e-1f
+#define SIMD_EXP_P5 5.0000001201e-1f
+
+// log splits x = m 2^e with m in [sqrt(1/2), sqrt(2)) and approximates
+// log(1 + f) for f = m - 1; subnormal inputs are scaled up by 2^25 first
+#define SIMD_SQRT_HALF 0.707106781186547524f
+#define SIMD_LOG_P0 7.0376836292e-2f
+#define SIMD_LOG_P1 -1.1514610310e-1f
+#define SIMD_LOG_P2 1.1676998740e-1f
+#define SIMD_LOG_P3 -1.2420140846e-1f
+#define SIMD_LOG_P4 1.4249322787e-1f
+#define SIMD_LOG_P5 -1.6668057665e-1f
+#define SIMD_LOG_P6 2.0000714765e-1f
+#define SIMD_LOG_P7 -2.4999993993e-1f
+#define SIMD_LOG_P8 3.3333331174e-1f
+
+// tanh is an odd polynomial below 0.625 and 1 - 2 / (e^2|x| + 1) above
+#define SIMD_TANH_SMALL 0.625f
+#define SIMD_TANH_P0 -5.70498872745e-3f
+#define SIMD_TANH_P1 2.06390887954e-2f
+#define SIMD_TANH_P2 -5.37397155531e-2f
+#define SIMD_TANH_P3 1.33314422036e-1f
+#define SIMD_TANH_P4 -3.33332819422e-1f
+
+static inline float simd_exp_f32(float x) {
+    if (isnan(x)) return x;
+    if (x > SIMD_EXP_MAX) x = SIMD_EXP_MAX;
+    if (x < SIMD_EXP_MIN) x = SIMD_EXP_MIN;
+
+    float k = (x * SIMD_LOG2E + SIMD_ROUND_MAGIC) - SIMD_ROUND_MAGIC;
+    float r = x - k * SIMD_LN2_HI;
+    r = r - k * SIMD_LN2_LO;
+
+    float p = SIMD_EXP_P0;
+    p = p * r + SIMD_EXP_P1;
+    p = p * r + SIMD_EXP_P2;
+    p = p * r + SIMD_EXP_P3;
+    p = p * r + SIMD_EXP_P4;
+    p = p * r + SIMD_EXP_P5;
+    p = p * (r * r) + r + 1.0f;
+
+    int32_t ki = (int32_t)k;
+    int32_t k1 = ki >> 1;
+    float s1 = simd_bits_float((uint32_t)(k1 + 127) << 23);
+    float s2 = simd_bits_float((uint32_t)(ki - k1 + 127) << 23);
+    return p * s1 * s2;
+}
+
+static inline float simd_log_f32(float x) {
+    if (isnan(x) || x < 0.0f) return NAN;
+    if (x == 0.0f) return -INFINITY;
+    if (x == INFINITY) return x;
+
+    float e = 0.0f;
+    if (x < 0x1p-126f) {
+        x *= 0x1p25f;
+        e = -25.0f;
+    }
+    uint32_t bits = simd_float_bits(x);
+    e += (float)((int32_t)(bits >> 23) - 126);
+    float m = simd_bits_float((bits & 0x007fffff) | 0x3f000000);
+    if (m < SIMD_SQRT_HALF) {
+        e -= 1.0f;
+        m = (m - 1.0f) + m;
+    } else {
+        m = m - 1.0f;
+    }
+
+    float z = m * m;
+    float p = SIMD_LOG_P0;
+    p = p * m + SIMD_LOG_P1;
+    p = p * m + SIMD_LOG_P2;
+    p = p * m + SIMD_LOG_P3;
+    p = p * m + SIMD_LOG_P4;
+    p = p * m + SIMD_LOG_P5;
+    p = p * m + SIMD_LOG_P6;
+    p = p * m + SIMD_LOG_P7;
+    p = p * m + SIMD_LOG_P8;
+
+    float y = p * m * z;
+    y = y + e * SIMD_LN2_LO;
+    y = y - 0.5f * z;
+    float r = m + y;
+    return r + e * SIMD_LN2_HI;
+}
+
+// e^-|x| never overflows, and for negative x the result is e / (1 + e),
+// which keeps full relative precision far into the tail
+static inline float simd_sigmoid_f32(float x) {
+    float e = simd_exp_f32(-fabsf(x));
+    return (x < 0.0f ? e : 1.0f) / (1.0f + e);
+}
+
+static inline float simd_tanh_f32(float x) {
+    float z = fabsf(x);
+    if (z < SIMD_TANH_SMALL) {
+        float s = x * x;
+        float p = SIMD_TANH_P0;
+        p = p * s + SIMD_TANH_P1;
+        p = p * s + SIMD_TANH_P2;
+        p = p * s + SIMD_TANH_P3;
+        p = p * s + SIMD_TANH_P4;
+        return copysignf(p * s * z + z, x);
+    }
+    float r = 1.0f - 2.0f / (simd_exp_f32(z + z) + 1.0f);
+    return copysignf(r, x);
+}
+
+static inline float simd_rsqrt_f32(float x) {
+    return 1.0f / sqrtf(x);
+}
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_HAVE_SSE2 1
+#define SIMD_HAVE_AVX2 1
+#define SIMD_HAVE_AVX512 1
+#define SIMD_TARGET_SSE2 __attribute__((target("sse2")))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2,fma,f16c")))
+#define SIMD_TARGET_AVX512 __attribute__((target("avx512f")))
+#define SIMD_TARGET_AVX512_BF16 __attribute__((target("avx512f,avx512bf16")))
+
+// AVX-512 BF16 is optional on top of AVX-512F
+int simd_cpu_has_avx512_bf16(void);
+
+// the stream kernels prefetch every input line this many bytes before they
+// load it: about one DRAM latency's worth of lines at full bandwidth
+#define SIMD_PREFETCH_DISTANCE 1024
+#define SIMD_PREFETCH(p) _mm_prefetch((const char*)(p) + SIMD_PREFETCH_DISTANCE, _MM_HINT_T0)
+#define SIMD_NO_PREFETCH(p) ((void)0)
+
+void simd_use_sse(simd_dispatch_t* dispatch);
+void simd_use_avx2(simd_dispatch_t* dispatch);
+void simd_use_avx512(simd_dispatch_t* dispatch);
+#endif
+
+#endif
@@ -0,0 +1,346 @@
+#include "simd_backends.h"
+#include <math.h>
+#include <string.h>
+
+// portable reference kernels, built with the baseline flags only
+
+static simd_vec_t simd_add_scalar(simd_vec_t a, simd_vec_t b) {
+    simd_vec_t result;
+    for(int i = 0; i < 8; i++) 
+        result.data[i] = a.data[i] + b.data[i];
+    
+    return result;
+}
+
+static simd_vec_t simd_mul_scalar(simd_vec_t a, simd_vec_t b) {
+    simd_vec_t result;
+    for(int i = 0; i < 8; i++) 
+        result.data[i] = a.data[i] * b.data[i];
+    
+    return result;
+}
+
+static simd_vec_t simd_fmadd_scalar(simd_vec_t a, simd_vec_t b, simd_vec_t c) {
+    simd_vec_t result;
+    for(int i = 0; i < 8; i++) 
+        result.data[i] = a.data[i] * b.data[i] + c.data[i];
+    
+    return result;
+}
+
+static void simd_add_n_scalar(float* dst, const float* a, const float* b, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        dst[i] = a[i] + b[i];
+}
+
+static void simd_sub_n_scalar(float* dst, const float* a, const float* b, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        dst[i] = a[i] - b[i];
+}
+
+static void simd_mul_n_scalar(float* dst, const float* a, const float* b, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        dst[i] = a[i] * b[i];
+}
+
+static void simd_fmadd_n_scalar(float* dst, const float* a, const float* b, const float* c, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        dst[i] = a[i] * b[i] + c[i];
+}
+
+static void simd_axpy_n_scalar(float* y, float alpha, const float* x, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        y[i] = alpha * x[i] + y[i];
+}
+
+static void simd_scale_n_scalar(float* dst, const float* a, float scalar, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        dst[i] = a[i] * scalar;
+}
+
+static void simd_add_scalar_n_scalar(float* dst, const float* a, float scalar, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        dst[i] = a[i] + scalar;
+}
+
+#define SCALAR_REDUCE_N(name, combine, identity)                                \
+static float name(const float* a, size_t n) {                                   \
+    float r0 = identity, r1 = identity, r2 = identity, r3 = identity;           \
+    size_t i = 0;                                                               \
+    for (; i + 4 <= n; i += 4) {                                                \
+        r0 = combine(r0, a[i]);                                                 \
+        r1 = combine(r1, a[i + 1]);                                             \
+        r2 = combine(r2, a[i + 2]);                                             \
+        r3 = combine(r3, a[i + 3]);                                             \
+    }                                                                           \
+    for (; i < n; i++)                                                          \
+        r0 = combine(r0, a[i]);                                                 \
+    return combine(combine(r0, r1), combine(r2, r3));                           \
+}
+
+SCALAR_REDUCE_N(simd_sum_n_scalar, simd_combine_add, 0.0f)
+SCALAR_REDUCE_N(simd_max_n_scalar, simd_combine_max, -INFINITY)
+SCALAR_REDUCE_N(simd_min_n_scalar, simd_combine_min, INFINITY)
+
+static void simd_sum_kahan_n_scalar(const float* a, size_t n, float* sum, float* comp) {
+    for (size_t i = 0; i < n; i++)
+        simd_kahan_add(sum, comp, a[i]);
+}
+
+static float simd_dot_n_scalar(const float* a, const float* b, size_t n) {
+    float r0 = 0.0f, r1 = 0.0f, r2 = 0.0f, r3 = 0.0f;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        r0 += a[i] * b[i];
+        r1 += a[i + 1] * b[i + 1];
+        r2 += a[i + 2] * b[i + 2];
+        r3 += a[i + 3] * b[i + 3];
+    }
+    for (; i < n; i++)
+        r0 += a[i] * b[i];
+    return (r0 + r1) + (r2 + r3);
+}
+
+static void simd_fill_n_scalar(void* dst, const void* pattern, size_t bytes) {
+    char* d = dst;
+    for (; bytes >= SIMD_FILL_PATTERN; bytes -= SIMD_FILL_PATTERN, d += SIMD_FILL_PATTERN)
+        memcpy(d, pattern, SIMD_FILL_PATTERN);
+    memcpy(d, pattern, bytes);
+}
+
+static void simd_copy_n_scalar(void* dst, const void* src, size_t bytes) {
+    memcpy(dst, src, bytes);
+}
+
+static void simd_transpose_scalar(float* dst, size_t ldd, const float* src, size_t lds,
+                                  size_t rows, size_t cols) {
+    for (size_t i = 0; i < rows; i++)
+        for (size_t j = 0; j < cols; j++)
+            dst[i * ldd + j] = src[j * lds + i];
+}
+
+#define SCALAR_UNARY_N(name, func)                                              \
+static void name(float* dst, const float* a, size_t n) {                        \
+    for (size_t i = 0; i < n; i++)                                              \
+        dst[i] = func(a[i]);                                                    \
+}
+
+SCALAR_UNARY_N(simd_exp_n_scalar, simd_exp_f32)
+SCALAR_UNARY_N(simd_log_n_scalar, simd_log_f32)
+SCALAR_UNARY_N(simd_sigmoid_n_scalar, simd_sigmoid_f32)
+SCALAR_UNARY_N(simd_tanh_n_scalar, simd_tanh_f32)
+SCALAR_UNARY_N(simd_sqrt_n_scalar, sqrtf)
+SCALAR_UNARY_N(simd_rsqrt_n_scalar, simd_rsqrt_f32)
+
+static void simd_load_f64_n_scalar(float* dst, const void* src, size_t n) {
+    const double* s = src;
+    for (size_t i = 0; i < n; i++)
+        dst[i] = (float)s[i];
+}
+
+static void simd_store_f64_n_scalar(void* dst, const float* src, size_t n) {
+    double* d = dst;
+    for (size_t i = 0; i < n; i++)
+        d[i] = src[i];
+}
+
+static void simd_load_f16_n_scalar(float* dst, const void* src, size_t n) {
+    const uint16_t* s = src;
+    for (size_t i = 0; i < n; i++)
+        dst[i] = simd_f16_to_float(s[i]);
+}
+
+static void simd_store_f16_n_scalar(void* dst, const float* src, size_t n) {
+    uint16_t* d = dst;
+    for (size_t i = 0; i < n; i++)
+        d[i] = simd_float_to_f16(src[i]);
+}
+
+static void simd_load_bf16_n_scalar(float* dst, const void* src, size_t n) {
+    const uint16_t* s = src;
+    for (size_t i = 0; i < n; i++)
+        dst[i] = simd_bf16_to_float(s[i]);
+}
+
+static void simd_store_bf16_n_scalar(void* dst, const float* src, size_t n) {
+    uint16_t* d = dst;
+    for (size_t i = 0; i < n; i++)
+        d[i] = simd_float_to_bf16(src[i]);
+}
+
+static void simd_load_i32_n_scalar(float* dst, const void* src, size_t n) {
+    const int32_t* s = src;
+    for (size_t i = 0; i < n; i++)
+        dst[i] = (float)s[i];
+}
+
+static void simd_store_i32_n_scalar(void* dst, const float* src, size_t n) {
+    int32_t* d = dst;
+    for (size_t i = 0; i < n; i++)
+        d[i] = simd_float_to_i32(src[i]);
+}
+
+static void simd_load_i8_n_scalar(float* dst, const void* src, size_t n) {
+    const int8_t* s = src;
+    for (size_t i = 0; i < n; i++)
+        dst[i] = (float)s[i];
+}
+
+static void simd_store_i8_n_scalar(void* dst, const float* src, size_t n) {
+    int8_t* d = dst;
+    for (size_t i = 0; i < n; i++)
+        d[i] = simd_float_to_i8(src[i]);
+}
+
+static void simd_add_f64_n_scalar(double* dst, const double* a, const double* b, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        dst[i] = a[i] + b[i];
+}
+
+static void simd_sub_f64_n_scalar(double* dst, const double* a, const double* b, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        dst[i] = a[i] - b[i];
+}
+
+static void simd_mul_f64_n_scalar(double* dst, const double* a, const double* b, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        dst[i] = a[i] * b[i];
+}
+
+static void simd_fmadd_f64_n_scalar(double* dst, const double* a, const double* b, const double* c, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        dst[i] = a[i] * b[i] + c[i];
+}
+
+static void simd_scale_f64_n_scalar(double* dst, const double* a, double scalar, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        dst[i] = a[i] * scalar;
+}
+
+#define SCALAR_REDUCE_F64_N(name, combine, identity)                            \
+static double name(const double* a, size_t n) {                                 \
+    double r0 = identity, r1 = identity, r2 = identity, r3 = identity;          \
+    size_t i = 0;                                                               \
+    for (; i + 4 <= n; i += 4) {                                                \
+        r0 = combine(r0, a[i]);                                                 \
+        r1 = combine(r1, a[i + 1]);                                             \
+        r2 = combine(r2, a[i + 2]);                                             \
+        r3 = combine(r3, a[i + 3]);                                             \
+    }                                                                           \
+    for (; i < n; i++)                                                          \
+        r0 = combine(r0, a[i]);                                                 \
+    return combine(combine(r0, r1), combine(r2, r3));                           \
+}
+
+SCALAR_REDUCE_F64_N(simd_sum_f64_n_scalar, simd_combine_add_f64, 0.0)
+SCALAR_REDUCE_F64_N(simd_max_f64_n_scalar, simd_combine_max_f64, -INFINITY)
+SCALAR_REDUCE_F64_N(simd_min_f64_n_scalar, simd_combine_min_f64, INFINITY)
+
+static double simd_sigmoid_f64(double x) {
+    double e = exp(-fabs(x));
+    return x < 0.0 ? e / (1.0 + e) : 1.0 / (1.0 + e);
+}
+
+static double simd_rsqrt_f64(double x) {
+    return 1.0 / sqrt(x);
+}
+
+#define SCALAR_UNARY_F64_N(name, func)                                          \
+static void name(double* dst, const double* a, size_t n) {                      \
+    for (size_t i = 0; i < n; i++)                                              \
+        dst[i] = func(a[i]);                                                    \
+}
+
+SCALAR_UNARY_F64_N(simd_exp_f64_n_scalar, exp)
+SCALAR_UNARY_F64_N(simd_log_f64_n_scalar, log)
+SCALAR_UNARY_F64_N(simd_sigmoid_f64_n_scalar, simd_sigmoid_f64)
+SCALAR_UNARY_F64_N(simd_tanh_f64_n_scalar, tanh)
+SCALAR_UNARY_F64_N(simd_sqrt_f64_n_scalar, sqrt)
+SCALAR_UNARY_F64_N(simd_rsqrt_f64_n_scalar, simd_rsqrt_f64)
+
+void simd_use_math_f64(simd_dispatch_t* dispatch) {
+    dispatch->exp_f64_n = simd_exp_f64_n_scalar;
+    dispatch->log_f64_n = simd_log_f64_n_scalar;
+    dispatch->sigmoid_f64_n = simd_sigmoid_f64_n_scalar;
+    dispatch->tanh_f64_n = simd_tanh_f64_n_scalar;
+    dispatch->sqrt_f64_n = simd_sqrt_f64_n_scalar;
+    dispatch->rsqrt_f64_n = simd_rsqrt_f64_n_scalar;
+}
+
+void simd_use_scalar_formats(simd_dispatch_t* dispatch) {
+    dispatch->load_f64_n = simd_load_f64_n_scalar;
+    dispatch->store_f64_n = simd_store_f64_n_scalar;
+    dispatch->load_f16_n = simd_load_f16_n_scalar;
+    dispatch->store_f16_n = simd_store_f16_n_scalar;
+    dispatch->load_bf16_n = simd_load_bf16_n_scalar;
+    dispatch->store_bf16_n = simd_store_bf16_n_scalar;
+    dispatch->load_i32_n = simd_load_i32_n_scalar;
+    dispatch->store_i32_n = simd_store_i32_n_scalar;
+    dispatch->load_i8_n = simd_load_i8_n_scalar;
+    dispatch->store_i8_n = simd_store_i8_n_scalar;
+    dispatch->add_f64_n = simd_add_f64_n_scalar;
+    dispatch->sub_f64_n = simd_sub_f64_n_scalar;
+    dispatch->mul_f64_n = simd_mul_f64_n_scalar;
+    dispatch->fmadd_f64_n = simd_fmadd_f64_n_scalar;
+    dispatch->scale_f64_n = simd_scale_f64_n_scalar;
+    dispatch->sum_f64_n = simd_sum_f64_n_scalar;
+    dispatch->max_f64_n = simd_max_f64_n_scalar;
+    dispatch->min_f64_n = simd_min_f64_n_scalar;
+}
+
+// 4x4 tile, unrolled so the accumulators stay in registers
+static void simd_gemm_kernel_scalar(size_t k, const float* a, const float* b, float* c,
+                                    size_t ldc, int accumulate) {
+    float acc[4][4] = {{0.0f}};
+    for (size_t p = 0; p < k; p++) {
+        #pragma GCC unroll 4
+        for (int i = 0; i < 4; i++) {
+            #pragma GCC unroll 4
+            for (int j = 0; j < 4; j++)
+                acc[i][j] += a[p * 4 + i] * b[p * 4 + j];
+        }
+    }
+    #pragma GCC unroll 4
+    for (int i = 0; i < 4; i++) {
+        #pragma GCC unroll 4
+        for (int j = 0; j < 4; j++)
+            c[i * ldc + j] = accumulate ? c[i * ldc + j] + acc[i][j] : acc[i][j];
+    }
+}
+
+void simd_use_scalar(simd_dispatch_t* dispatch) {
+    dispatch->add = simd_add_scalar;
+    dispatch->mul = simd_mul_scalar;
+    dispatch->fmadd = simd_fmadd_scalar;
+    dispatch->add_n = simd_add_n_scalar;
+    dispatch->sub_n = simd_sub_n_scalar;
+    dispatch->mul_n = simd_mul_n_scalar;
+    dispatch->fmadd_n = simd_fmadd_n_scalar;
+    dispatch->axpy_n = simd_axpy_n_scalar;
+    dispatch->scale_n = simd_scale_n_scalar;
+    dispatch->add_scalar_n = simd_add_scalar_n_scalar;
+    dispatch->add_n_stream = simd_add_n_scalar;
+    dispatch->mul_n_stream = simd_mul_n_scalar;
+    dispatch->fmadd_n_stream = simd_fmadd_n_scalar;
+    dispatch->fill_n = simd_fill_n_scalar;
+    dispatch->fill_n_stream = simd_fill_n_scalar;
+    dispatch->copy_n = simd_copy_n_scalar;
+    dispatch->copy_n_stream = simd_copy_n_scalar;
+    dispatch->transpose = simd_transpose_scalar;
+    dispatch->sum_n = simd_sum_n_scalar;
+    dispatch->sum_kahan_n = simd_sum_kahan_n_scalar;
+    dispatch->max_n = simd_max_n_scalar;
+    dispatch->min_n = simd_min_n_scalar;
+    dispatch->dot_n = simd_dot_n_scalar;
+    dispatch->exp_n = simd_exp_n_scalar;
+    dispatch->log_n = simd_log_n_scalar;
+    dispatch->sigmoid_n = simd_sigmoid_n_scalar;
+    dispatch->tanh_n = simd_tanh_n_scalar;
+    dispatch->sqrt_n = simd_sqrt_n_scalar;
+    dispatch->rsqrt_n = simd_rsqrt_n_scalar;
+    dispatch->gemm_mr = 4;
+    dispatch->gemm_nr = 4;
+    dispatch->gemm_kernel = simd_gemm_kernel_scalar;
+    simd_use_scalar_formats(dispatch);
+    simd_use_math_f64(dispatch);
+}
@@ -0,0 +1,478 @@
+#include "simd_backends.h"
+
+#ifdef SIMD_HAVE_SSE2
+#include <emmintrin.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+static SIMD_TARGET_SSE2 simd_vec_t simd_add_sse(simd_vec_t a, simd_vec_t b) {
+    simd_vec_t result;
+    
+    __m128 va_low = _mm_loadu_ps(a.data);
+    __m128 vb_low = _mm_loadu_ps(b.data);
+    __m128 vr_low = _mm_add_ps(va_low, vb_low);
+    _mm_storeu_ps(result.data, vr_low);
+    
+    __m128 va_high = _mm_loadu_ps(a.data + 4);
+    __m128 vb_high = _mm_loadu_ps(b.data + 4);
+    __m128 vr_high = _mm_add_ps(va_high, vb_high);
+    _mm_storeu_ps(result.data + 4, vr_high);
+    
+    return result;
+}
+
+static SIMD_TARGET_SSE2 simd_vec_t simd_mul_sse(simd_vec_t a, simd_vec_t b) {
+    simd_vec_t result;
+    
+    __m128 va_low = _mm_loadu_ps(a.data);
+    __m128 vb_low = _mm_loadu_ps(b.data);
+    __m128 vr_low = _mm_mul_ps(va_low, vb_low);
+    _mm_storeu_ps(result.data, vr_low);
+    
+    __m128 va_high = _mm_loadu_ps(a.data + 4);
+    __m128 vb_high = _mm_loadu_ps(b.data + 4);
+    __m128 vr_high = _mm_mul_ps(va_high, vb_high);
+    _mm_storeu_ps(result.data + 4, vr_high);
+    
+    return result;
+}
+
+static SIMD_TARGET_SSE2 simd_vec_t simd_fmadd_sse(simd_vec_t a, simd_vec_t b, simd_vec_t c) {
+    simd_vec_t temp = simd_mul_sse(a, b);
+    return simd_add_sse(temp, c);
+}
+
+#define SSE_BINARY_N(name, vop, op, store, prefetch, finish)                    \
+static SIMD_TARGET_SSE2 void name(float* dst, const float* a, const float* b, size_t n) { \
+    size_t i = 0;                                                               \
+    for (; i < n && ((uintptr_t)(dst + i) & 15); i++)                           \
+        dst[i] = a[i] op b[i];                                                  \
+    for (; i + 16 <= n; i += 16) {                                              \
+        prefetch(a + i);                                                        \
+        prefetch(b + i);                                                        \
+        __m128 r0 = vop(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));              \
+        __m128 r1 = vop(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4));      \
+        __m128 r2 = vop(_mm_loadu_ps(a + i + 8), _mm_loadu_ps(b + i + 8));      \
+        __m128 r3 = vop(_mm_loadu_ps(a + i + 12), _mm_loadu_ps(b + i + 12));    \
+        store(dst + i, r0);                                                     \
+        store(dst + i + 4, r1);                                                 \
+        store(dst + i + 8, r2);                                                 \
+        store(dst + i + 12, r3);                                                \
+    }                                                                           \
+    for (; i + 4 <= n; i += 4)                                                  \
+        store(dst + i, vop(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));          \
+    finish;                                                                     \
+    for (; i < n; i++)                                                          \
+        dst[i] = a[i] op b[i];                                                  \
+}
+
+#define SSE_FMADD_N(name, store, prefetch, finish)                              \
+static SIMD_TARGET_SSE2 void name(float* dst, const float* a, const float* b, const float* c, size_t n) { \
+    size_t i = 0;                                                               \
+    for (; i < n && ((uintptr_t)(dst + i) & 15); i++)                           \
+        dst[i] = a[i] * b[i] + c[i];                                            \
+    for (; i + 8 <= n; i += 8) {                                                \
+        prefetch(a + i);                                                        \
+        prefetch(b + i);                                                        \
+        prefetch(c + i);                                                        \
+        __m128 r0 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)), \
+                               _mm_loadu_ps(c + i));                            \
+        __m128 r1 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)), \
+                               _mm_loadu_ps(c + i + 4));                        \
+        store(dst + i, r0);                                                     \
+        store(dst + i + 4, r1);                                                 \
+    }                                                                           \
+    finish;                                                                     \
+    for (; i < n; i++)                                                          \
+        dst[i] = a[i] * b[i] + c[i];                                            \
+}
+
+SSE_BINARY_N(simd_add_n_sse, _mm_add_ps, +, _mm_store_ps, SIMD_NO_PREFETCH, (void)0)
+SSE_BINARY_N(simd_sub_n_sse, _mm_sub_ps, -, _mm_store_ps, SIMD_NO_PREFETCH, (void)0)
+SSE_BINARY_N(simd_mul_n_sse, _mm_mul_ps, *, _mm_store_ps, SIMD_NO_PREFETCH, (void)0)
+SSE_FMADD_N(simd_fmadd_n_sse, _mm_store_ps, SIMD_NO_PREFETCH, (void)0)
+SSE_BINARY_N(simd_add_n_stream_sse, _mm_add_ps, +, _mm_stream_ps, SIMD_PREFETCH, _mm_sfence())
+SSE_BINARY_N(simd_mul_n_stream_sse, _mm_mul_ps, *, _mm_stream_ps, SIMD_PREFETCH, _mm_sfence())
+SSE_FMADD_N(simd_fmadd_n_stream_sse, _mm_stream_ps, SIMD_PREFETCH, _mm_sfence())
+
+// fill and copy move bytes: head and tail go through memcpy and the middle
+// is stored a whole aligned vector at a time. the head is a whole number of
+// elements, so the fill pattern is already in phase at the first aligned byte
+#define SSE_FILL_N(name, store, finish)                                         \
+static SIMD_TARGET_SSE2 void name(void* dst, const void* pattern, size_t bytes) { \
+    char* d = dst;                                                              \
+    size_t i = (16 - ((uintptr_t)d & 15)) & 15;                                 \
+    if (i > bytes) i = bytes;                                                   \
+    memcpy(d, pattern, i);                                                      \
+    __m128i v = _mm_loadu_si128((const __m128i*)pattern);                       \
+    for (; i + 64 <= bytes; i += 64) {                                          \
+        store((__m128i*)(d + i), v);                                            \
+        store((__m128i*)(d + i + 16), v);                                       \
+        store((__m128i*)(d + i + 32), v);                                       \
+        store((__m128i*)(d + i + 48), v);                                       \
+    }                                                                           \
+    for (; i + 16 <= bytes; i += 16)                                            \
+        store((__m128i*)(d + i), v);                                            \
+    finish;                                                                     \
+    memcpy(d + i, pattern, bytes - i);                                          \
+}
+
+#define SSE_COPY_N(name, store, prefetch, finish)                               \
+static SIMD_TARGET_SSE2 void name(void* dst, const void* src, size_t bytes) {   \
+    char* d = dst;                                                              \
+    const char* s = src;                                                        \
+    size_t i = (16 - ((uintptr_t)d & 15)) & 15;                                 \
+    if (i > bytes) i = bytes;                                                   \
+    memcpy(d, s, i);                                                            \
+    for (; i + 64 <= bytes; i += 64) {                                          \
+        prefetch(s + i);                                                        \
+        __m128i r0 = _mm_loadu_si128((const __m128i*)(s + i));                  \
+        __m128i r1 = _mm_loadu_si128((const __m128i*)(s + i + 16));             \
+        __m128i r2 = _mm_loadu_si128((const __m128i*)(s + i + 32));             \
+        __m128i r3 = _mm_loadu_si128((const __m128i*)(s + i + 48));             \
+        store((__m128i*)(d + i), r0);                                           \
+        store((__m128i*)(d + i + 16), r1);                                      \
+        store((__m128i*)(d + i + 32), r2);                                      \
+        store((__m128i*)(d + i + 48), r3);                                      \
+    }                                                                           \
+    for (; i + 16 <= bytes; i += 16)                                            \
+        store((__m128i*)(d + i), _mm_loadu_si128((const __m128i*)(s + i)));     \
+    finish;                                                                     \
+    memcpy(d + i, s + i, bytes - i);                                            \
+}
+
+SSE_FILL_N(simd_fill_n_sse, _mm_store_si128, (void)0)
+SSE_FILL_N(simd_fill_n_stream_sse, _mm_stream_si128, _mm_sfence())
+SSE_COPY_N(simd_copy_n_sse, _mm_store_si128, SIMD_NO_PREFETCH, (void)0)
+SSE_COPY_N(simd_copy_n_stream_sse, _mm_stream_si128, SIMD_PREFETCH, _mm_sfence())
+
+static SIMD_TARGET_SSE2 void simd_transpose_sse(float* dst, size_t ldd, const float* src, size_t lds,
+                                                size_t rows, size_t cols) {
+    size_t i = 0;
+    for (; i + 4 <= rows; i += 4) {
+        size_t j = 0;
+        for (; j + 4 <= cols; j += 4) {
+            const float* s = src + j * lds + i;
+            __m128 r0 = _mm_loadu_ps(s);
+            __m128 r1 = _mm_loadu_ps(s + lds);
+            __m128 r2 = _mm_loadu_ps(s + 2 * lds);
+            __m128 r3 = _mm_loadu_ps(s + 3 * lds);
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            float* d = dst + i * ldd + j;
+            _mm_storeu_ps(d, r0);
+            _mm_storeu_ps(d + ldd, r1);
+            _mm_storeu_ps(d + 2 * ldd, r2);
+            _mm_storeu_ps(d + 3 * ldd, r3);
+        }
+        for (; j < cols; j++)
+            for (size_t k = i; k < i + 4; k++)
+                dst[k * ldd + j] = src[j * lds + k];
+    }
+    for (; i < rows; i++)
+        for (size_t j = 0; j < cols; j++)
+            dst[i * ldd + j] = src[j * lds + i];
+}
+
+static SIMD_TARGET_SSE2 void simd_axpy_n_sse(float* y, float alpha, const float* x, size_t n) {
+    __m128 va = _mm_set1_ps(alpha);
+    size_t i = 0;
+    for (; i < n && ((uintptr_t)(y + i) & 15); i++)
+        y[i] = alpha * x[i] + y[i];
+    for (; i + 8 <= n; i += 8) {
+        __m128 r0 = _mm_add_ps(_mm_mul_ps(va, _mm_loadu_ps(x + i)), _mm_load_ps(y + i));
+        __m128 r1 = _mm_add_ps(_mm_mul_ps(va, _mm_loadu_ps(x + i + 4)), _mm_load_ps(y + i + 4));
+        _mm_store_ps(y + i, r0);
+        _mm_store_ps(y + i + 4, r1);
+    }
+    for (; i < n; i++)
+        y[i] = alpha * x[i] + y[i];
+}
+
+#define SSE_SCALAR_N(name, vop, op)                                             \
+static SIMD_TARGET_SSE2 void name(float* dst, const float* a, float scalar, size_t n) { \
+    __m128 vs = _mm_set1_ps(scalar);                                            \
+    size_t i = 0;                                                               \
+    for (; i < n && ((uintptr_t)(dst + i) & 15); i++)                           \
+        dst[i] = a[i] op scalar;                                                \
+    for (; i + 8 <= n; i += 8) {                                                \
+        _mm_store_ps(dst + i, vop(_mm_loadu_ps(a + i), vs));                    \
+        _mm_store_ps(dst + i + 4, vop(_mm_loadu_ps(a + i + 4), vs));            \
+    }                                                                           \
+    for (; i < n; i++)                                                          \
+        dst[i] = a[i] op scalar;                                                \
+}
+
+SSE_SCALAR_N(simd_scale_n_sse, _mm_mul_ps, *)
+SSE_SCALAR_N(simd_add_scalar_n_sse, _mm_add_ps, +)
+
+// lanes are folded in memory order with the scalar combine step, so every
+// backend agrees on how the final partials are merged
+#define SSE_REDUCE_N(name, vop, combine, identity)                              \
+static SIMD_TARGET_SSE2 float name(const float* a, size_t n) {                  \
+    __m128 r0 = _mm_set1_ps(identity), r1 = r0, r2 = r0, r3 = r0;               \
+    size_t i = 0;                                                               \
+    for (; i + 16 <= n; i += 16) {                                              \
+        r0 = vop(r0, _mm_loadu_ps(a + i));                                      \
+        r1 = vop(r1, _mm_loadu_ps(a + i + 4));                                  \
+        r2 = vop(r2, _mm_loadu_ps(a + i + 8));                                  \
+        r3 = vop(r3, _mm_loadu_ps(a + i + 12));                                 \
+    }                                                                           \
+    for (; i + 4 <= n; i += 4)                                                  \
+        r0 = vop(r0, _mm_loadu_ps(a + i));                                      \
+    float lanes[4];                                                             \
+    _mm_storeu_ps(lanes, vop(vop(r0, r1), vop(r2, r3)));                        \
+    float result = combine(combine(lanes[0], lanes[1]), combine(lanes[2], lanes[3])); \
+    for (; i < n; i++)                                                          \
+        result = combine(result, a[i]);                                         \
+    return result;                                                              \
+}
+
+SSE_REDUCE_N(simd_sum_n_sse, _mm_add_ps, simd_combine_add, 0.0f)
+SSE_REDUCE_N(simd_max_n_sse, _mm_max_ps, simd_combine_max, -INFINITY)
+SSE_REDUCE_N(simd_min_n_sse, _mm_min_ps, simd_combine_min, INFINITY)
+
+static SIMD_TARGET_SSE2 void simd_sum_kahan_n_sse(const float* a, size_t n, float* sum_out, float* comp_out) {
+    __m128 sum = _mm_setzero_ps(), comp = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 y = _mm_sub_ps(_mm_loadu_ps(a + i), comp);
+        __m128 t = _mm_add_ps(sum, y);
+        comp = _mm_sub_ps(_mm_sub_ps(t, sum), y);
+        sum = t;
+    }
+    float sums[4], comps[4];
+    _mm_storeu_ps(sums, sum);
+    _mm_storeu_ps(comps, comp);
+    for (int k = 0; k < 4; k++) {
+        simd_kahan_add(sum_out, comp_out, sums[k]);
+        simd_kahan_add(sum_out, comp_out, -comps[k]);
+    }
+    for (; i < n; i++)
+        simd_kahan_add(sum_out, comp_out, a[i]);
+}
+
+static SIMD_TARGET_SSE2 float simd_dot_n_sse(const float* a, const float* b, size_t n) {
+    __m128 r0 = _mm_setzero_ps(), r1 = r0, r2 = r0, r3 = r0;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        r0 = _mm_add_ps(r0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        r1 = _mm_add_ps(r1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+        r2 = _mm_add_ps(r2, _mm_mul_ps(_mm_loadu_ps(a + i + 8), _mm_loadu_ps(b + i + 8)));
+        r3 = _mm_add_ps(r3, _mm_mul_ps(_mm_loadu_ps(a + i + 12), _mm_loadu_ps(b + i + 12)));
+    }
+    for (; i + 4 <= n; i += 4)
+        r0 = _mm_add_ps(r0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    float lanes[4];
+    _mm_storeu_ps(lanes, _mm_add_ps(_mm_add_ps(r0, r1), _mm_add_ps(r2, r3)));
+    float result = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for (; i < n; i++)
+        result += a[i] * b[i];
+    return result;
+}
+
+// mask ? a : b, without SSE4.1's blendv
+static inline SIMD_TARGET_SSE2 __m128 sse_select(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// the vector forms of simd_exp_f32 and friends, step for step
+static inline SIMD_TARGET_SSE2 __m128 sse_exp_ps(__m128 x) {
+    // min and max return their second operand for NaN, which keeps it
+    x = _mm_max_ps(_mm_set1_ps(SIMD_EXP_MIN), _mm_min_ps(_mm_set1_ps(SIMD_EXP_MAX), x));
+
+    __m128 magic = _mm_set1_ps(SIMD_ROUND_MAGIC);
+    __m128 k = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(SIMD_LOG2E)), magic), magic);
+    __m128 r = _mm_sub_ps(x, _mm_mul_ps(k, _mm_set1_ps(SIMD_LN2_HI)));
+    r = _mm_sub_ps(r, _mm_mul_ps(k, _mm_set1_ps(SIMD_LN2_LO)));
+
+    __m128 p = _mm_set1_ps(SIMD_EXP_P0);
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(SIMD_EXP_P1));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(SIMD_EXP_P2));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(SIMD_EXP_P3));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(SIMD_EXP_P4));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(SIMD_EXP_P5));
+    p = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p, _mm_mul_ps(r, r)), r), _mm_set1_ps(1.0f));
+
+    __m128i ki = _mm_cvtps_epi32(k);
+    __m128i k1 = _mm_srai_epi32(ki, 1);
+    __m128i k2 = _mm_sub_epi32(ki, k1);
+    __m128i bias = _mm_set1_epi32(127);
+    __m128 s1 = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(k1, bias), 23));
+    __m128 s2 = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(k2, bias), 23));
+    return _mm_mul_ps(_mm_mul_ps(p, s1), s2);
+}
+
+static inline SIMD_TARGET_SSE2 __m128 sse_log_ps(__m128 x) {
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 sub = _mm_cmplt_ps(x, _mm_set1_ps(0x1p-126f));
+    __m128 xs = sse_select(sub, _mm_mul_ps(x, _mm_set1_ps(0x1p25f)), x);
+
+    __m128i bits = _mm_castps_si128(xs);
+    __m128i exp = _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(126));
+    __m128 e = _mm_add_ps(_mm_cvtepi32_ps(exp), _mm_and_ps(sub, _mm_set1_ps(-25.0f)));
+    __m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)),
+                                             _mm_set1_epi32(0x3f000000)));
+    __m128 small = _mm_cmplt_ps(m, _mm_set1_ps(SIMD_SQRT_HALF));
+    e = _mm_sub_ps(e, _mm_and_ps(small, one));
+    m = _mm_add_ps(_mm_sub_ps(m, one), _mm_and_ps(small, m));
+
+    __m128 z = _mm_mul_ps(m, m);
+    __m128 p = _mm_set1_ps(SIMD_LOG_P0);
+    p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(SIMD_LOG_P1));
+    p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(SIMD_LOG_P2));
+    p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(SIMD_LOG_P3));
+    p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(SIMD_LOG_P4));
+    p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(SIMD_LOG_P5));
+    p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(SIMD_LOG_P6));
+    p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(SIMD_LOG_P7));
+    p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(SIMD_LOG_P8));
+
+    __m128 y = _mm_mul_ps(_mm_mul_ps(p, m), z);
+    y = _mm_add_ps(y, _mm_mul_ps(e, _mm_set1_ps(SIMD_LN2_LO)));
+    y = _mm_sub_ps(y, _mm_mul_ps(_mm_set1_ps(0.5f), z));
+    __m128 r = _mm_add_ps(_mm_add_ps(m, y), _mm_mul_ps(e, _mm_set1_ps(SIMD_LN2_HI)));
+
+    // +inf stays +inf, zeros give -inf, and negative or NaN lanes become an
+    // all-ones NaN
+    __m128 inf = _mm_set1_ps(INFINITY);
+    r = sse_select(_mm_cmpeq_ps(x, inf), inf, r);
+    r = sse_select(_mm_cmpeq_ps(x, _mm_setzero_ps()), _mm_set1_ps(-INFINITY), r);
+    return _mm_or_ps(r, _mm_cmpnge_ps(x, _mm_setzero_ps()));
+}
+
+static inline SIMD_TARGET_SSE2 __m128 sse_sigmoid_ps(__m128 x) {
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 e = sse_exp_ps(_mm_or_ps(x, _mm_set1_ps(-0.0f)));
+    __m128 num = sse_select(_mm_cmplt_ps(x, _mm_setzero_ps()), e, one);
+    return _mm_div_ps(num, _mm_add_ps(one, e));
+}
+
+static inline SIMD_TARGET_SSE2 __m128 sse_tanh_ps(__m128 x) {
+    __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 z = _mm_andnot_ps(sign, x);
+
+    __m128 s = _mm_mul_ps(x, x);
+    __m128 p = _mm_set1_ps(SIMD_TANH_P0);
+    p = _mm_add_ps(_mm_mul_ps(p, s), _mm_set1_ps(SIMD_TANH_P1));
+    p = _mm_add_ps(_mm_mul_ps(p, s), _mm_set1_ps(SIMD_TANH_P2));
+    p = _mm_add_ps(_mm_mul_ps(p, s), _mm_set1_ps(SIMD_TANH_P3));
+    p = _mm_add_ps(_mm_mul_ps(p, s), _mm_set1_ps(SIMD_TANH_P4));
+    __m128 near = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(p, s), z), z);
+
+    __m128 e = sse_exp_ps(_mm_add_ps(z, z));
+    __m128 far = _mm_sub_ps(one, _mm_div_ps(_mm_set1_ps(2.0f), _mm_add_ps(e, one)));
+    __m128 r = sse_select(_mm_cmplt_ps(z, _mm_set1_ps(SIMD_TANH_SMALL)), near, far);
+    return _mm_or_ps(r, _mm_and_ps(sign, x));
+}
+
+// the 12-bit estimate refined by one Newton step. subnormals are scaled into
+// range first; zeros, infinities, negatives and NaN keep the estimate, which
+// is already exact for them
+static inline SIMD_TARGET_SSE2 __m128 sse_rsqrt_ps(__m128 x) {
+    __m128 sub = _mm_cmplt_ps(x, _mm_set1_ps(0x1p-126f));
+    __m128 xs = sse_select(sub, _mm_mul_ps(x, _mm_set1_ps(0x1p24f)), x);
+
+    __m128 y = _mm_rsqrt_ps(xs);
+    __m128 residual = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_mul_ps(xs, y), y));
+    __m128 nr = _mm_add_ps(y, _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), y), residual));
+    __m128 finite = _mm_and_ps(_mm_cmpgt_ps(xs, _mm_setzero_ps()), _mm_cmplt_ps(xs, _mm_set1_ps(INFINITY)));
+    __m128 r = sse_select(finite, nr, y);
+    return _mm_mul_ps(r, sse_select(sub, _mm_set1_ps(0x1p12f), _mm_set1_ps(1.0f)));
+}
+
+#define SSE_UNARY_N(name, vfunc, func)                                          \
+static SIMD_TARGET_SSE2 void name(float* dst, const float* a, size_t n) {       \
+    size_t i = 0;                                                               \
+    for (; i < n && ((uintptr_t)(dst + i) & 15); i++)                           \
+        dst[i] = func(a[i]);                                                    \
+    for (; i + 8 <= n; i += 8) {                                                \
+        __m128 r0 = vfunc(_mm_loadu_ps(a + i));                                 \
+        __m128 r1 = vfunc(_mm_loadu_ps(a + i + 4));                             \
+        _mm_store_ps(dst + i, r0);                                              \
+        _mm_store_ps(dst + i + 4, r1);                                          \
+    }                                                                           \
+    for (; i + 4 <= n; i += 4)                                                  \
+        _mm_store_ps(dst + i, vfunc(_mm_loadu_ps(a + i)));                      \
+    for (; i < n; i++)                                                          \
+        dst[i] = func(a[i]);                                                    \
+}
+
+SSE_UNARY_N(simd_exp_n_sse, sse_exp_ps, simd_exp_f32)
+SSE_UNARY_N(simd_log_n_sse, sse_log_ps, simd_log_f32)
+SSE_UNARY_N(simd_sigmoid_n_sse, sse_sigmoid_ps, simd_sigmoid_f32)
+SSE_UNARY_N(simd_tanh_n_sse, sse_tanh_ps, simd_tanh_f32)
+SSE_UNARY_N(simd_sqrt_n_sse, _mm_sqrt_ps, sqrtf)
+SSE_UNARY_N(simd_rsqrt_n_sse, sse_rsqrt_ps, simd_rsqrt_f32)
+
+// 6x8 tile: twelve accumulators, two b vectors and a broadcast fill the
+// sixteen xmm registers. the loops over the tile rows are fully unrolled
+// (#pragma GCC unroll) so that acc is never spilled to the stack
+static SIMD_TARGET_SSE2 void simd_gemm_kernel_sse(size_t k, const float* a, const float* b, float* c,
+                                                  size_t ldc, int accumulate) {
+    __m128 acc[6][2];
+    #pragma GCC unroll 6
+    for (int i = 0; i < 6; i++) {
+        acc[i][0] = _mm_setzero_ps();
+        acc[i][1] = _mm_setzero_ps();
+    }
+    for (size_t p = 0; p < k; p++) {
+        __m128 b0 = _mm_load_ps(b + p * 8);
+        __m128 b1 = _mm_load_ps(b + p * 8 + 4);
+        #pragma GCC unroll 6
+        for (int i = 0; i < 6; i++) {
+            __m128 ai = _mm_set1_ps(a[p * 6 + i]);
+            acc[i][0] = _mm_add_ps(acc[i][0], _mm_mul_ps(ai, b0));
+            acc[i][1] = _mm_add_ps(acc[i][1], _mm_mul_ps(ai, b1));
+        }
+    }
+    #pragma GCC unroll 6
+    for (int i = 0; i < 6; i++) {
+        float* row = c + i * ldc;
+        if (accumulate) {
+            acc[i][0] = _mm_add_ps(acc[i][0], _mm_loadu_ps(row));
+            acc[i][1] = _mm_add_ps(acc[i][1], _mm_loadu_ps(row + 4));
+        }
+        _mm_storeu_ps(row, acc[i][0]);
+        _mm_storeu_ps(row + 4, acc[i][1]);
+    }
+}
+
+void simd_use_sse(simd_dispatch_t* dispatch) {
+    dispatch->add = simd_add_sse;
+    dispatch->mul = simd_mul_sse;
+    dispatch->fmadd = simd_fmadd_sse;
+    dispatch->add_n = simd_add_n_sse;
+    dispatch->sub_n = simd_sub_n_sse;
+    dispatch->mul_n = simd_mul_n_sse;
+    dispatch->fmadd_n = simd_fmadd_n_sse;
+    dispatch->axpy_n = simd_axpy_n_sse;
+    dispatch->scale_n = simd_scale_n_sse;
+    dispatch->add_scalar_n = simd_add_scalar_n_sse;
+    dispatch->add_n_stream = simd_add_n_stream_sse;
+    dispatch->mul_n_stream = simd_mul_n_stream_sse;
+    dispatch->fmadd_n_stream = simd_fmadd_n_stream_sse;
+    dispatch->fill_n = simd_fill_n_sse;
+    dispatch->fill_n_stream = simd_fill_n_stream_sse;
+    dispatch->copy_n = simd_copy_n_sse;
+    dispatch->copy_n_stream = simd_copy_n_stream_sse;
+    dispatch->transpose = simd_transpose_sse;
+    dispatch->sum_n = simd_sum_n_sse;
+    dispatch->sum_kahan_n = simd_sum_kahan_n_sse;
+    dispatch->max_n = simd_max_n_sse;
+    dispatch->min_n = simd_min_n_sse;
+    dispatch->dot_n = simd_dot_n_sse;
+    dispatch->exp_n = simd_exp_n_sse;
+    dispatch->log_n = simd_log_n_sse;
+    dispatch->sigmoid_n = simd_sigmoid_n_sse;
+    dispatch->tanh_n = simd_tanh_n_sse;
+    dispatch->sqrt_n = simd_sqrt_n_sse;
+    dispatch->rsqrt_n = simd_rsqrt_n_sse;
+    dispatch->gemm_mr = 6;
+    dispatch->gemm_nr = 8;
+    dispatch->gemm_kernel = simd_gemm_kernel_sse;
+    simd_use_scalar_formats(dispatch);
+    simd_use_math_f64(dispatch);
+}
+#endif
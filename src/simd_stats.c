@@ -0,0 +1,82 @@
+#include "simd_stats.h"
+#include "simd_stats_record.h"
+#include <stdlib.h>
+#include <string.h>
+
+bool simd_stats_enabled(void) {
+#ifdef SIMD_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+simd_stats_t* simd_stats_create(void) {
+    return calloc(1, sizeof(simd_stats_t));
+}
+
+void simd_stats_free(simd_stats_t* stats) {
+    free(stats);
+}
+
+void simd_stats_reset(simd_stats_t* stats) {
+    for (int op = 0; op < SIMD_STATS_NOPS; op++) {
+        simd_stats_counters_t* c = &stats->ops[op];
+        __atomic_store_n(&c->calls, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&c->elements, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&c->bytes, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&c->fast, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&c->fallback, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&c->interpreted, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&c->cycles, 0, __ATOMIC_RELAXED);
+    }
+}
+
+// each counter is read atomically, but the snapshot as a whole is not: an
+// operation that is still running may show its runs but not its call yet
+void simd_stats_get(const simd_stats_t* stats, simd_stats_op_t op, simd_stats_counters_t* out) {
+    const simd_stats_counters_t* c = &stats->ops[op];
+    out->calls = __atomic_load_n(&c->calls, __ATOMIC_RELAXED);
+    out->elements = __atomic_load_n(&c->elements, __ATOMIC_RELAXED);
+    out->bytes = __atomic_load_n(&c->bytes, __ATOMIC_RELAXED);
+    out->fast = __atomic_load_n(&c->fast, __ATOMIC_RELAXED);
+    out->fallback = __atomic_load_n(&c->fallback, __ATOMIC_RELAXED);
+    out->interpreted = __atomic_load_n(&c->interpreted, __ATOMIC_RELAXED);
+    out->cycles = __atomic_load_n(&c->cycles, __ATOMIC_RELAXED);
+}
+
+const char* simd_stats_op_name(simd_stats_op_t op) {
+    static const char* names[SIMD_STATS_NOPS] = {
+        "add", "mul", "axpy", "scale", "unary", "fill", "copy", "astype", "reduce", "matmul",
+        "expr", "stream"
+    };
+    return op < SIMD_STATS_NOPS ? names[op] : "unknown";
+}
+
+bool simd_stats_write_json(const simd_dispatch_t* dispatch, FILE* out) {
+#if defined(__x86_64__) || defined(__i386__)
+    const char* timer = "tsc";
+#else
+    const char* timer = "ns";
+#endif
+    fprintf(out, "{\n  \"enabled\": %s,\n  \"backend\": \"%s\",\n  \"timer\": \"%s\",\n  \"ops\": {",
+            simd_stats_enabled() ? "true" : "false", simd_backend_name(dispatch->backend), timer);
+
+    for (int op = 0; op < SIMD_STATS_NOPS; op++) {
+        simd_stats_counters_t c;
+        if (dispatch->stats) {
+            simd_stats_get(dispatch->stats, (simd_stats_op_t)op, &c);
+        } else {
+            memset(&c, 0, sizeof(c));
+        }
+        fprintf(out, "%s\n    \"%s\": {\"calls\": %llu, \"elements\": %llu, \"bytes\": %llu, "
+                "\"fast\": %llu, \"fallback\": %llu, \"interpreted\": %llu, \"cycles\": %llu}",
+                op ? "," : "", simd_stats_op_name((simd_stats_op_t)op),
+                (unsigned long long)c.calls, (unsigned long long)c.elements,
+                (unsigned long long)c.bytes, (unsigned long long)c.fast,
+                (unsigned long long)c.fallback, (unsigned long long)c.interpreted,
+                (unsigned long long)c.cycles);
+    }
+    fprintf(out, "\n  }\n}\n");
+    return !ferror(out);
+}
@@ -0,0 +1,74 @@
+#ifndef SIMD_STATS_RECORD_H
+#define SIMD_STATS_RECORD_H
+
+#include "simd_stats.h"
+
+// recording hooks for the library's hot paths. counters are bumped with
+// relaxed atomics so that workers of a pool can share one stats object; a
+// dispatch table without stats costs one branch per hook. without
+// SIMD_STATS the hooks expand to nothing and their arguments are never
+// evaluated
+struct simd_stats {
+    simd_stats_counters_t ops[SIMD_STATS_NOPS];
+};
+
+#ifdef SIMD_STATS
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+
+static inline uint64_t simd_stats_now(void) {
+    return __rdtsc();
+}
+#else
+#include <time.h>
+
+static inline uint64_t simd_stats_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000u + (uint64_t)t.tv_nsec;
+}
+#endif
+
+typedef struct {
+    simd_stats_t* stats;
+    simd_stats_op_t op;
+    uint64_t start;
+} simd_stats_scope_t;
+
+static inline simd_stats_scope_t simd_stats_begin(simd_stats_t* stats, simd_stats_op_t op) {
+    simd_stats_scope_t scope = {stats, op, stats ? simd_stats_now() : 0};
+    return scope;
+}
+
+static inline void simd_stats_end(const simd_stats_scope_t* scope, size_t elements, size_t bytes) {
+    if (!scope->stats) return;
+    simd_stats_counters_t* c = &scope->stats->ops[scope->op];
+    uint64_t cycles = simd_stats_now() - scope->start;
+    __atomic_fetch_add(&c->calls, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&c->elements, elements, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&c->bytes, bytes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&c->cycles, cycles, __ATOMIC_RELAXED);
+}
+
+// times the code up to the matching SIMD_STATS_END in the same block
+#define SIMD_STATS_BEGIN(scope, stats, op) simd_stats_scope_t scope = simd_stats_begin(stats, op)
+#define SIMD_STATS_END(scope, elements, bytes) simd_stats_end(&(scope), elements, bytes)
+// bumps one counter (fast, fallback or interpreted) of an operation
+#define SIMD_STATS_COUNT(stats, op, field)                                      \
+    do {                                                                        \
+        simd_stats_t* stats_ = (stats);                                         \
+        if (stats_) {                                                           \
+            __atomic_fetch_add(&stats_->ops[op].field, 1, __ATOMIC_RELAXED);    \
+        }                                                                       \
+    } while (0)
+
+#else
+
+#define SIMD_STATS_BEGIN(scope, stats, op) ((void)0)
+#define SIMD_STATS_END(scope, elements, bytes) ((void)0)
+#define SIMD_STATS_COUNT(stats, op, field) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,228 @@
+#define _GNU_SOURCE
+#include "thread_pool.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// one worker's share of the current job, in chunk indices. owner and thieves
+// both claim chunks with fetch_add on `next`, so every chunk runs exactly once
+typedef struct {
+    _Alignas(64) atomic_size_t next;
+    size_t end;
+} pool_range_t;
+
+struct thread_pool {
+    size_t nthreads;
+    pthread_t* threads;
+    pool_range_t* ranges;
+
+    pthread_mutex_t job_lock;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    size_t generation;
+    size_t pending;
+    bool shutdown;
+
+    thread_pool_fn fn;
+    void* ctx;
+    size_t n;
+    size_t chunk;
+};
+
+typedef struct {
+    thread_pool_t* pool;
+    size_t id;
+} pool_worker_arg_t;
+
+static void pool_run_range(thread_pool_t* pool, size_t victim, size_t worker) {
+    pool_range_t* range = &pool->ranges[victim];
+    size_t c;
+    while ((c = atomic_fetch_add_explicit(&range->next, 1, memory_order_relaxed)) < range->end) {
+        size_t begin = c * pool->chunk;
+        size_t end = begin + pool->chunk < pool->n ? begin + pool->chunk : pool->n;
+        pool->fn(pool->ctx, begin, end, worker);
+    }
+}
+
+static void pool_run_worker(thread_pool_t* pool, size_t id) {
+    pool_run_range(pool, id, id);
+    for (size_t k = 1; k < pool->nthreads; k++) {
+        pool_run_range(pool, (id + k) % pool->nthreads, id);
+    }
+}
+
+static void* pool_worker_main(void* arg) {
+    pool_worker_arg_t* wa = arg;
+    thread_pool_t* pool = wa->pool;
+    size_t id = wa->id;
+    free(wa);
+
+    size_t seen = 0;
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->generation == seen && !pool->shutdown) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->shutdown) {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        pool_run_worker(pool, id);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+#ifdef __linux__
+// pins worker `id` to the id-th CPU the process may run on, so the static
+// chunk split keeps each range on one core (and its NUMA node after first touch)
+static void pool_pin_thread(pthread_t thread, size_t id) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return;
+
+    size_t count = (size_t)CPU_COUNT(&allowed);
+    if (count == 0) return;
+    size_t target = id % count;
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed)) continue;
+        if (target-- == 0) {
+            cpu_set_t one;
+            CPU_ZERO(&one);
+            CPU_SET(cpu, &one);
+            pthread_setaffinity_np(thread, sizeof(one), &one);
+            return;
+        }
+    }
+}
+
+static size_t pool_cpu_count(void) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        return (size_t)CPU_COUNT(&allowed);
+    }
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (size_t)n : 1;
+}
+#else
+static void pool_pin_thread(pthread_t thread, size_t id) {
+    (void)thread;
+    (void)id;
+}
+
+static size_t pool_cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (size_t)n : 1;
+}
+#endif
+
+thread_pool_t* thread_pool_create(size_t nthreads) {
+    if (nthreads == 0) nthreads = pool_cpu_count();
+    if (nthreads == 0) nthreads = 1;
+
+    thread_pool_t* pool = calloc(1, sizeof(thread_pool_t));
+    pool->nthreads = nthreads;
+    pool->ranges = aligned_alloc(64, nthreads * sizeof(pool_range_t));
+    pool->threads = malloc(nthreads * sizeof(pthread_t));
+
+    pthread_mutex_init(&pool->job_lock, NULL);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    for (size_t i = 0; i < nthreads; i++) {
+        atomic_init(&pool->ranges[i].next, 0);
+        pool->ranges[i].end = 0;
+    }
+
+    // worker 0 is whichever thread calls thread_pool_parallel_for
+    for (size_t i = 1; i < nthreads; i++) {
+        pool_worker_arg_t* wa = malloc(sizeof(pool_worker_arg_t));
+        wa->pool = pool;
+        wa->id = i;
+        pthread_create(&pool->threads[i], NULL, pool_worker_main, wa);
+        pool_pin_thread(pool->threads[i], i);
+    }
+
+    return pool;
+}
+
+void thread_pool_free(thread_pool_t* pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (size_t i = 1; i < pool->nthreads; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_mutex_destroy(&pool->job_lock);
+    free(pool->threads);
+    free(pool->ranges);
+    free(pool);
+}
+
+size_t thread_pool_size(const thread_pool_t* pool) {
+    return pool ? pool->nthreads : 1;
+}
+
+void thread_pool_parallel_for(thread_pool_t* pool, size_t n, size_t chunk,
+                              thread_pool_fn fn, void* ctx) {
+    if (n == 0) return;
+    if (chunk == 0) chunk = n;
+
+    size_t nchunks = (n + chunk - 1) / chunk;
+    // the serial path keeps the same chunk boundaries, so callers that keep
+    // one result per chunk see every chunk whatever the thread count
+    if (!pool || pool->nthreads == 1 || nchunks == 1) {
+        for (size_t begin = 0; begin < n; begin += chunk) {
+            fn(ctx, begin, begin + chunk < n ? begin + chunk : n, 0);
+        }
+        return;
+    }
+
+    // one job at a time per pool; concurrent callers queue here
+    pthread_mutex_lock(&pool->job_lock);
+
+    pool->fn = fn;
+    pool->ctx = ctx;
+    pool->n = n;
+    pool->chunk = chunk;
+    for (size_t i = 0; i < pool->nthreads; i++) {
+        atomic_store_explicit(&pool->ranges[i].next, i * nchunks / pool->nthreads, memory_order_relaxed);
+        pool->ranges[i].end = (i + 1) * nchunks / pool->nthreads;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->generation++;
+    pool->pending = pool->nthreads - 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    pool_run_worker(pool, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    pthread_mutex_unlock(&pool->job_lock);
+}
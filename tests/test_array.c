@@ -1,7 +1,13 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
 #include "array.h"
 #include "simd_abstraction.h"
+#include "simd_stats.h"
+#include "thread_pool.h"
 
 void test_basic_creation() {
     printf("Basic Array Creation \n");
@@ -186,12 +192,1066 @@ void test_lazy_evaluation() {
     printf("\n");
 }
 
+void test_fused_evaluation() {
+    printf("Fused Evaluation over Strided Views \n");
+    
+    simd_dispatch_t* dispatch = simd_init_dispatch();
+    
+    size_t shape[2] = {4, 12};
+    array_t* a = array_create(shape, 2);
+    array_t* b = array_create(shape, 2);
+    
+    for (size_t i = 0; i < 4; i++) {
+        for (size_t j = 0; j < 12; j++) {
+            size_t idx[2] = {i, j};
+            array_set(a, idx, (float)(i * 12 + j));
+            array_set(b, idx, 1.0f);
+        }
+    }
+    
+    size_t start[2] = {1, 1};
+    size_t end[2] = {3, 11};
+    array_t* va = array_view(a, start, end);
+    array_t* vb = array_view(b, start, end);
+    
+    expr_t* expr = expr_scalar_mul(2.0f, expr_mul(expr_add(expr_from_array(va), expr_from_array(vb)),
+                                                  expr_from_array(vb)));
+    
+    printf("Expression: 2 * ((A[1:3, 1:11] + B[1:3, 1:11]) * B[1:3, 1:11])\n");
+    
+    size_t out_shape[2] = {2, 10};
+    array_t* result = array_create(out_shape, 2);
+    expr_eval(expr, result, dispatch);
+    
+    printf("Result:\n");
+    array_print(result);
+    
+    expr_free(expr);
+    array_free(va);
+    array_free(vb);
+    array_free(a);
+    array_free(b);
+    array_free(result);
+    simd_free_dispatch(dispatch);
+    printf("\n");
+}
+
+void test_broadcast_operations() {
+    printf("Broadcast Eager Operations \n");
+    
+    simd_dispatch_t* dispatch = simd_init_dispatch();
+    
+    size_t shape_m[2] = {3, 10};
+    size_t shape_row[1] = {10};
+    size_t shape_col[2] = {3, 1};
+    
+    array_t* m = array_create(shape_m, 2);
+    array_t* row = array_create(shape_row, 1);
+    array_t* col = array_create(shape_col, 2);
+    array_t* result = array_create(shape_m, 2);
+    
+    array_fill(m, 1.0f);
+    for (size_t i = 0; i < 10; i++) {
+        size_t idx[1] = {i};
+        array_set(row, idx, (float)i);
+    }
+    for (size_t i = 0; i < 3; i++) {
+        size_t idx[2] = {i, 0};
+        array_set(col, idx, (float)(i + 1) * 10.0f);
+    }
+    
+    array_add_eager(result, m, row, dispatch);
+    printf("M (3x10) + row (10,):\n");
+    array_print(result);
+    
+    array_mul_eager(result, result, col, dispatch);
+    printf("(M + row) * col (3x1):\n");
+    array_print(result);
+    
+    size_t cols_start[2] = {0, 2};
+    size_t cols_end[2] = {3, 7};
+    array_t* cols = array_view(m, cols_start, cols_end);
+    size_t out_shape[2] = {3, 5};
+    array_t* strided = array_create(out_shape, 2);
+    
+    array_add_eager(strided, cols, col, dispatch);
+    printf("M[:, 2:7] + col:\n");
+    array_print(strided);
+    
+    simd_free_dispatch(dispatch);
+    array_free(cols);
+    array_free(strided);
+    array_free(m);
+    array_free(row);
+    array_free(col);
+    array_free(result);
+    printf("\n");
+}
+
+static void count_chunk(void* ctx, size_t begin, size_t end, size_t worker) {
+    (void)begin;
+    (void)end;
+    (void)worker;
+    __atomic_fetch_add((size_t*)ctx, 1, __ATOMIC_RELAXED);
+}
+
+void test_parallel_operations() {
+    printf("Parallel Element-wise Operations \n");
+    
+    simd_dispatch_t* dispatch = simd_init_dispatch();
+    dispatch->pool = thread_pool_create(4);
+    printf("Threads: %zu\n", thread_pool_size(dispatch->pool));
+    
+    size_t shape[2] = {512, 1000};
+    size_t row_shape[1] = {1000};
+    array_t* a = array_create(shape, 2);
+    array_t* row = array_create(row_shape, 1);
+    array_t* result = array_create(shape, 2);
+    
+    array_fill_eager(a, 2.0f, dispatch);
+    for (size_t i = 0; i < 1000; i++) {
+        size_t idx[1] = {i};
+        array_set(row, idx, (float)i);
+    }
+    
+    array_add_eager(result, a, row, dispatch);
+    
+    expr_t* expr = expr_mul(expr_from_array(result), expr_from_array(a));
+    expr_eval(expr, result, dispatch);
+    
+    size_t start[2] = {510, 995};
+    size_t end[2] = {512, 1000};
+    array_t* corner = array_view(result, start, end);
+    array_t* copy = array_copy_eager(corner, dispatch);
+    printf("2 * (A + row), last 2x5 corner:\n");
+    array_print(copy);
+    
+    expr_free(expr);
+    array_free(copy);
+    array_free(corner);
+    array_free(a);
+    array_free(row);
+    array_free(result);
+    thread_pool_free(dispatch->pool);
+    
+    // every pool size, and no pool, calls fn once per chunk
+    thread_pool_t* single = thread_pool_create(1);
+    size_t calls_single = 0, calls_none = 0;
+    thread_pool_parallel_for(single, 1000, 64, count_chunk, &calls_single);
+    thread_pool_parallel_for(NULL, 1000, 64, count_chunk, &calls_none);
+    printf("chunks of 64 over 1000: %zu (1 thread), %zu (no pool)\n", calls_single, calls_none);
+    thread_pool_free(single);
+    
+    simd_free_dispatch(dispatch);
+    printf("\n");
+}
+
+void test_aligned_and_pooled_allocation() {
+    printf("Aligned and Pooled Allocation \n");
+    
+    size_t shape[2] = {3, 5};
+    array_t* arr = array_create(shape, 2);
+    printf("Data 64-byte aligned: %s\n",
+           (uintptr_t)arr->data % ARRAY_ALIGNMENT == 0 ? "yes" : "no");
+    
+    array_pool_t* pool = array_pool_create(1 << 20);
+    array_t* first = array_create_pooled(pool, shape, 2);
+    float* first_data = first->data;
+    array_free(first);
+    
+    array_t* second = array_create_pooled(pool, shape, 2);
+    printf("Pooled buffer reused: %s\n", second->data == first_data ? "yes" : "no");
+    printf("Pooled data 64-byte aligned: %s\n",
+           (uintptr_t)second->data % ARRAY_ALIGNMENT == 0 ? "yes" : "no");
+    
+    array_free(second);
+    array_free(arr);
+    array_pool_free(pool);
+    printf("\n");
+}
+
+void test_reductions() {
+    printf("Reductions \n");
+    
+    simd_dispatch_t* dispatch = simd_init_dispatch();
+    
+    size_t shape[2] = {3, 4};
+    array_t* arr = array_create(shape, 2);
+    for (size_t i = 0; i < 3; i++) {
+        for (size_t j = 0; j < 4; j++) {
+            size_t idx[2] = {i, j};
+            array_set(arr, idx, (float)(i * 4 + j + 1));
+        }
+    }
+    
+    printf("sum %.2f, mean %.2f, max %.2f, min %.2f, norm2 %.2f\n",
+           array_sum(arr, dispatch), array_mean(arr, dispatch), array_max(arr, dispatch),
+           array_min(arr, dispatch), array_norm2(arr, dispatch));
+    
+    size_t start[2] = {1, 1};
+    size_t end[2] = {3, 3};
+    array_t* view = array_view(arr, start, end);
+    printf("View [1:3, 1:3]: sum %.2f, dot with itself %.2f, kahan sum %.2f\n",
+           array_sum(view, dispatch), array_dot(view, view, dispatch),
+           array_sum_mode(view, ARRAY_SUM_KAHAN, dispatch));
+    
+    size_t rows_shape[1] = {3};
+    size_t cols_shape[2] = {1, 4};
+    array_t* rows = array_create(rows_shape, 1);
+    array_t* cols = array_create(cols_shape, 2);
+    array_sum_axis(rows, arr, 1, dispatch);
+    array_max_axis(cols, arr, 0, dispatch);
+    printf("Sum over axis 1: ");
+    array_print(rows);
+    printf("Max over axis 0 (kept):\n");
+    array_print(cols);
+    
+    size_t all_shape[2] = {1, 1};
+    array_t* all = array_create(all_shape, 2);
+    array_reduce_to(all, arr, ARRAY_REDUCE_MEAN, dispatch);
+    printf("Mean over both axes: %.2f\n", all->data[0]);
+    
+    // large enough to be split into chunks; a single-thread pool must still
+    // combine every chunk's partial
+    dispatch->pool = thread_pool_create(1);
+    size_t big_shape[1] = {1 << 18};
+    array_t* big = array_create(big_shape, 1);
+    array_fill(big, 1.0f);
+    big->data[12345] = 3.0f;
+    big->data[200000] = -2.0f;
+    printf("2^18 elements on 1 thread: sum %.0f, kahan sum %.0f, max %.0f, min %.0f, dot %.0f\n",
+           array_sum(big, dispatch), array_sum_mode(big, ARRAY_SUM_KAHAN, dispatch),
+           array_max(big, dispatch), array_min(big, dispatch), array_dot(big, big, dispatch));
+    expr_t* big_sum = expr_sum(expr_mul(expr_from_array(big), expr_from_array(big)));
+    printf("fused sum of squares on 1 thread: %.0f\n", expr_eval_scalar(big_sum, dispatch));
+    expr_free(big_sum);
+    thread_pool_free(dispatch->pool);
+    dispatch->pool = NULL;
+    
+    array_free(big);
+    array_free(all);
+    array_free(rows);
+    array_free(cols);
+    array_free(view);
+    array_free(arr);
+    simd_free_dispatch(dispatch);
+    printf("\n");
+}
+
+void test_fused_reductions() {
+    printf("Fused Reductions \n");
+    
+    simd_dispatch_t* dispatch = simd_init_dispatch();
+    
+    size_t shape[2] = {3, 4};
+    array_t* a = array_create(shape, 2);
+    array_t* b = array_create(shape, 2);
+    for (size_t i = 0; i < 3; i++) {
+        for (size_t j = 0; j < 4; j++) {
+            size_t idx[2] = {i, j};
+            array_set(a, idx, (float)(i * 4 + j));
+            array_set(b, idx, (float)j);
+        }
+    }
+    
+    // sum((A - B) * (A - B)) without materialising A - B
+    expr_t* diff = expr_sub(expr_from_array(a), expr_from_array(b));
+    expr_t* diff2 = expr_sub(expr_from_array(a), expr_from_array(b));
+    expr_t* sq = expr_sum(expr_mul(diff, diff2));
+    printf("sum((A - B)^2) = %.2f\n", expr_eval_scalar(sq, dispatch));
+    
+    size_t row_shape[1] = {3};
+    array_t* rows = array_create(row_shape, 1);
+    expr_t* row_max = expr_reduce_axis(expr_scalar_mul(0.5f, expr_from_array(a)), 1, ARRAY_REDUCE_MAX);
+    expr_eval(row_max, rows, dispatch);
+    printf("max(0.5 * A, axis 1): ");
+    array_print(rows);
+    
+    // nested reductions are evaluated first and broadcast
+    array_t* centered = array_create(shape, 2);
+    expr_t* center = expr_sub(expr_from_array(a),
+                              expr_scalar_mul(0.25f, expr_sum_axis(expr_from_array(a), 1)));
+    expr_eval(center, centered, dispatch);
+    printf("A - mean(A, axis 1): ");
+    array_print(centered);
+    expr_t* scaled = expr_sum(expr_mul(expr_from_array(a), expr_sum(expr_from_array(b))));
+    printf("sum(A * sum(B)) = %.2f\n", expr_eval_scalar(scaled, dispatch));
+    
+    expr_free(center);
+    expr_free(scaled);
+    array_free(centered);
+    expr_free(sq);
+    expr_free(row_max);
+    array_free(rows);
+    array_free(a);
+    array_free(b);
+    simd_free_dispatch(dispatch);
+    printf("\n");
+}
+
+void test_optimized_expressions() {
+    printf("Optimized Expressions (FMA, scalar folding, shared subexpressions) \n");
+    
+    simd_dispatch_t* dispatch = simd_init_dispatch();
+    
+    size_t shape[1] = {6};
+    array_t* a = array_create(shape, 1);
+    array_t* b = array_create(shape, 1);
+    array_t* c = array_create(shape, 1);
+    array_t* result = array_create(shape, 1);
+    for (size_t i = 0; i < 6; i++) {
+        size_t idx[1] = {i};
+        array_set(a, idx, (float)i);
+        array_set(b, idx, 2.0f);
+        array_set(c, idx, 1.0f);
+    }
+    
+    expr_t* fma = expr_add(expr_mul(expr_from_array(a), expr_from_array(b)), expr_from_array(c));
+    expr_eval(fma, result, dispatch);
+    printf("A * B + C:         ");
+    array_print(result);
+    
+    expr_t* folded = expr_scalar_mul(2.0f, expr_scalar_mul(0.25f, expr_from_array(a)));
+    expr_eval(folded, result, dispatch);
+    printf("2 * (0.25 * A):    ");
+    array_print(result);
+    
+    expr_t* shared = expr_mul(expr_add(expr_from_array(a), expr_from_array(b)),
+                              expr_add(expr_from_array(b), expr_from_array(a)));
+    expr_eval(shared, result, dispatch);
+    printf("(A + B) * (B + A): ");
+    array_print(result);
+    
+    expr_free(fma);
+    expr_free(folded);
+    expr_free(shared);
+    array_free(a);
+    array_free(b);
+    array_free(c);
+    array_free(result);
+    simd_free_dispatch(dispatch);
+    printf("\n");
+}
+
+// 1*A + 2*A + ... as a balanced tree of the given depth; each level keeps
+// one more block register live
+static expr_t* balanced_sum(array_t* a, size_t depth, float* next) {
+    if (depth == 0) {
+        *next += 1.0f;
+        return expr_scalar_mul(*next, expr_from_array(a));
+    }
+    expr_t* left = balanced_sum(a, depth - 1, next);
+    return expr_add(left, balanced_sum(a, depth - 1, next));
+}
+
+void test_compiled_kernels() {
+    printf("Compiled Kernels \n");
+    
+    simd_dispatch_t* dispatch = simd_init_dispatch();
+    
+    size_t shape[1] = {4};
+    array_t* x = array_create(shape, 1);
+    array_t* y = array_create(shape, 1);
+    array_t* z = array_create(shape, 1);
+    array_t* result = array_create(shape, 1);
+    for (size_t i = 0; i < 4; i++) {
+        size_t idx[1] = {i};
+        array_set(x, idx, (float)i);
+        array_set(y, idx, 10.0f);
+        array_set(z, idx, -1.0f);
+    }
+    
+    // compile 0.5 * (P + Q) once and bind different arrays on each call
+    expr_t* avg = expr_scalar_mul(0.5f, expr_add(expr_from_array(x), expr_from_array(y)));
+    expr_kernel_t* kernel = expr_compile(avg);
+    printf("Kernel parameters: %zu\n", expr_kernel_nleaves(kernel));
+    
+    array_t* xy[2] = {x, y};
+    expr_kernel_eval(kernel, xy, result, dispatch);
+    printf("0.5 * (X + Y): ");
+    array_print(result);
+    
+    array_t* zx[2] = {z, x};
+    expr_kernel_eval(kernel, zx, result, dispatch);
+    printf("0.5 * (Z + X): ");
+    array_print(result);
+    
+    // the same structure over other arrays hits the cached kernel
+    expr_t* again = expr_scalar_mul(0.5f, expr_add(expr_from_array(y), expr_from_array(z)));
+    expr_eval(again, result, dispatch);
+    printf("0.5 * (Y + Z): ");
+    array_print(result);
+    
+    // more leaves than one kernel reads are evaluated in parts
+    array_t* many[40];
+    expr_t* chain = expr_from_array(x);
+    for (size_t k = 0; k < 40; k++) {
+        many[k] = array_create(shape, 1);
+        array_fill(many[k], (float)(k + 1));
+        chain = expr_add(chain, expr_from_array(many[k]));
+    }
+    printf("X + 1 + 2 + ... + 40: ");
+    expr_eval(chain, result, dispatch);
+    array_print(result);
+    printf("compiled: %s\n", expr_compile(chain) ? "yes" : "no");
+    expr_t* total = expr_sum(chain);
+    printf("sum: %g\n", expr_eval_scalar(total, dispatch));
+    
+    // more live values than a typical program, 17 block registers
+    float next = 0.0f;
+    expr_t* deep = balanced_sum(y, 16, &next);
+    expr_eval(deep, result, dispatch);
+    size_t first[1] = {0};
+    printf("10 * (1 + 2 + ... + 65536): %g\n", array_get(result, first));
+    
+    expr_free(deep);
+    expr_free(total);
+    for (size_t k = 0; k < 40; k++) {
+        array_free(many[k]);
+    }
+    expr_free(avg);
+    expr_free(again);
+    expr_kernel_free(kernel);
+    expr_cache_clear();
+    array_free(x);
+    array_free(y);
+    array_free(z);
+    array_free(result);
+    simd_free_dispatch(dispatch);
+    printf("\n");
+}
+
+void test_tiled_evaluation() {
+    printf("Tiled Evaluation (row-major + column-major operands) \n");
+    
+    simd_dispatch_t* dispatch = simd_init_dispatch();
+    
+    size_t rows = 300, cols = 200;
+    size_t shape[2] = {rows, cols};
+    array_t* a = array_create(shape, 2);
+    array_t* result = array_create(shape, 2);
+    float* buffer = malloc(rows * cols * sizeof(float));
+    for (size_t i = 0; i < rows; i++) {
+        for (size_t j = 0; j < cols; j++) {
+            size_t idx[2] = {i, j};
+            array_set(a, idx, (float)(i * cols + j));
+            buffer[j * rows + i] = (float)(i * cols + j);
+        }
+    }
+    
+    // the same values stored column by column
+    array_t* b = array_from_data(buffer, shape, 2);
+    b->strides[0] = 1;
+    b->strides[1] = rows;
+    
+    expr_t* expr = expr_sub(expr_scalar_mul(2.0f, expr_from_array(a)), expr_from_array(b));
+    expr_eval(expr, result, dispatch);
+    
+    bool match = true;
+    for (size_t i = 0; i < rows; i++) {
+        for (size_t j = 0; j < cols; j++) {
+            size_t idx[2] = {i, j};
+            if (array_get(result, idx) != (float)(i * cols + j)) match = false;
+        }
+    }
+    printf("2 * A - A (column-major) == A: %s\n", match ? "yes" : "no");
+    
+    expr_free(expr);
+    array_free(a);
+    array_free(b);
+    array_free(result);
+    free(buffer);
+    simd_free_dispatch(dispatch);
+    printf("\n");
+}
+
+void test_broadcast_expressions() {
+    printf("Broadcasting in Expressions \n");
+    
+    simd_dispatch_t* dispatch = simd_init_dispatch();
+    
+    size_t shape[2] = {2, 3};
+    size_t row_shape[1] = {3};
+    size_t col_shape[2] = {2, 1};
+    array_t* a = array_create(shape, 2);
+    array_t* row = array_create(row_shape, 1);
+    array_t* col = array_create(col_shape, 2);
+    array_fill(a, 1.0f);
+    for (size_t i = 0; i < 3; i++) {
+        size_t idx[1] = {i};
+        array_set(row, idx, (float)(i + 1));
+    }
+    for (size_t i = 0; i < 2; i++) {
+        size_t idx[2] = {i, 0};
+        array_set(col, idx, (float)(10 * (i + 1)));
+    }
+    
+    expr_t* outer = expr_mul(expr_from_array(col), expr_from_array(row));
+    printf("col (2x1) * row (3) has shape %zux%zu\n", outer->shape[0], outer->shape[1]);
+    
+    expr_t* expr = expr_add(expr_from_array(a), outer);
+    array_t* result = array_create(expr->shape, expr->ndim);
+    expr_eval(expr, result, dispatch);
+    printf("A + col * row:\n");
+    array_print(result);
+    printf("row still has %zu dimension(s)\n", row->ndim);
+    
+    expr_free(expr);
+    array_free(a);
+    array_free(row);
+    array_free(col);
+    array_free(result);
+    simd_free_dispatch(dispatch);
+    printf("\n");
+}
+
+void test_dtypes() {
+    printf("Array dtypes and mixed precision \n");
+    
+    simd_dispatch_t* dispatch = simd_init_dispatch();
+    
+    size_t shape[1] = {4};
+    array_t* a = array_create_typed(shape, 1, ARRAY_BFLOAT16);
+    array_t* b = array_create_typed(shape, 1, ARRAY_FLOAT16);
+    for (size_t i = 0; i < 4; i++) {
+        size_t idx[1] = {i};
+        array_set(a, idx, 1.5f * (float)i);
+        array_set(b, idx, 0.25f);
+    }
+    printf("bf16 uses %zu bytes per element\n", array_dtype_size(a->dtype));
+    
+    // bf16 and f16 storage, float32 arithmetic, float32 result
+    array_t* result = array_create(shape, 1);
+    expr_t* expr = expr_add(expr_scalar_mul(2.0f, expr_from_array(a)), expr_from_array(b));
+    expr_eval(expr, result, dispatch);
+    printf("2 * a(bf16) + b(f16): ");
+    array_print(result);
+    expr_free(expr);
+    
+    // rounding into int8 saturates
+    array_t* bytes = array_astype(result, ARRAY_INT8, dispatch);
+    array_t* scaled = array_create_typed(shape, 1, ARRAY_INT8);
+    expr = expr_scalar_mul(30.0f, expr_from_array(bytes));
+    expr_eval(expr, scaled, dispatch);
+    printf("30 * int8 saturates: ");
+    array_print(scaled);
+    expr_free(expr);
+    
+    // a float64 leaf makes the whole expression compute in float64
+    size_t big_shape[1] = {1000};
+    array_t* wide = array_create_typed(big_shape, 1, ARRAY_FLOAT64);
+    array_fill(wide, 1.0f);
+    size_t first[1] = {0};
+    ((double*)wide->raw)[0] = 1e9;
+    size_t one[1] = {1};
+    array_t* sum = array_create_typed(one, 1, ARRAY_FLOAT64);
+    expr = expr_sum(expr_from_array(wide));
+    expr_eval(expr, sum, dispatch);
+    printf("float64 sum of 1e9 and 999 ones: %.1f\n", ((double*)sum->raw)[0]);
+    printf("first element read back as float: %.1f\n", array_get(wide, first));
+    expr_free(expr);
+    
+    array_free(a);
+    array_free(b);
+    array_free(result);
+    array_free(bytes);
+    array_free(scaled);
+    array_free(wide);
+    array_free(sum);
+    simd_free_dispatch(dispatch);
+    printf("\n");
+}
+
+void test_save_and_mmap() {
+    printf("Saving and Memory-Mapping Arrays \n");
+    
+    simd_dispatch_t* dispatch = simd_init_dispatch();
+    
+    size_t shape[2] = {3, 4};
+    array_t* arr = array_create(shape, 2);
+    for (size_t i = 0; i < 3; i++) {
+        for (size_t j = 0; j < 4; j++) {
+            size_t idx[2] = {i, j};
+            array_set(arr, idx, (float)(i * 4 + j));
+        }
+    }
+    
+    char path[] = "/tmp/test_array_XXXXXX";
+    int fd = mkstemp(path);
+    close(fd);
+    
+    // a view is written out contiguously
+    size_t start[2] = {1, 1};
+    size_t end[2] = {3, 4};
+    array_t* view = array_view(arr, start, end);
+    printf("save view: %s\n", array_save(view, path) ? "ok" : "failed");
+    
+    array_t* mapped = array_mmap(path, ARRAY_MAP_READ | ARRAY_MAP_SEQUENTIAL);
+    printf("mapped %zux%zu, data 64-byte aligned: %s\n", mapped->shape[0], mapped->shape[1],
+           ((uintptr_t)mapped->raw % ARRAY_ALIGNMENT) == 0 ? "yes" : "no");
+    array_print(mapped);
+    printf("sum over the mapping: %.1f\n", array_sum(mapped, dispatch));
+    array_free(mapped);
+    
+    // writes through a shared mapping reach the file
+    array_t* writable = array_mmap(path, ARRAY_MAP_WRITE);
+    array_fill(writable, 1.0f);
+    array_free(writable);
+    mapped = array_mmap(path, ARRAY_MAP_READ);
+    printf("after writing through a mapping: %.1f\n", array_sum(mapped, dispatch));
+    array_free(mapped);
+    
+    FILE* junk = fopen(path, "wb");
+    fputs("not an array file, just some text that is long enough", junk);
+    fclose(junk);
+    printf("invalid file: %s\n", array_mmap(path, ARRAY_MAP_READ) ? "mapped" : "rejected");
+    
+    unlink(path);
+    array_free(view);
+    array_free(arr);
+    simd_free_dispatch(dispatch);
+    printf("\n");
+}
+
+// hands out i * 0.5 for element i
+static size_t read_ramp(void* ctx, void* dst, size_t offset, size_t count) {
+    (void)ctx;
+    float* out = dst;
+    for (size_t i = 0; i < count; i++) out[i] = (float)(offset + i) * 0.5f;
+    return count;
+}
+
+static size_t write_floats(void* ctx, const void* src, size_t offset, size_t count) {
+    float* out = ctx;
+    const float* in = src;
+    for (size_t i = 0; i < count; i++) out[offset + i] = in[i];
+    return count;
+}
+
+void test_streaming() {
+    printf("Streaming Evaluation \n");
+    
+    simd_dispatch_t* dispatch = simd_init_dispatch();
+    
+    // the leaves only stand in for the sources
+    size_t n = 10;
+    size_t shape[1] = {n};
+    array_t* a = array_create(shape, 1);
+    array_t* b = array_create(shape, 1);
+    expr_t* expr = expr_add(expr_scalar_mul(2.0f, expr_from_array(a)), expr_from_array(b));
+    
+    char path_a[] = "/tmp/test_array_XXXXXX";
+    char path_out[] = "/tmp/test_array_XXXXXX";
+    close(mkstemp(path_a));
+    close(mkstemp(path_out));
+    array_t* ones = array_create(shape, 1);
+    array_fill(ones, 1.0f);
+    array_save(ones, path_a);
+    
+    // a file source and a callback source, in blocks of 4 to a file sink
+    array_source_t* sources[2] = {array_source_open(path_a),
+                                  array_source_callback(ARRAY_FLOAT32, n, read_ramp, NULL)};
+    array_sink_t* sink = array_sink_create(path_out, ARRAY_FLOAT32, shape, 1);
+    bool ok = expr_eval_stream(expr, sources, sink, 4, dispatch);
+    ok = array_sink_close(sink) && ok;
+    printf("2 * ones + ramp into a file: %s\n", ok ? "ok" : "failed");
+    array_t* mapped = array_mmap(path_out, ARRAY_MAP_READ);
+    array_print(mapped);
+    array_free(mapped);
+    
+    // a full reduction sends its one value to the sink
+    float total = 0.0f;
+    expr_t* sum = expr_sum(expr_mul(expr_from_array(a), expr_from_array(b)));
+    sink = array_sink_callback(ARRAY_FLOAT32, write_floats, &total);
+    ok = expr_eval_stream(sum, sources, sink, 3, dispatch);
+    array_sink_close(sink);
+    printf("streamed sum of ones * ramp: %.1f (%s)\n", total, ok ? "ok" : "failed");
+    
+    // axis and nested reductions cannot stream
+    expr_t* rows = expr_sum_axis(expr_from_array(a), 0);
+    errno = 0;
+    ok = expr_eval_stream(rows, sources, NULL, 0, dispatch);
+    printf("axis reduction: %s\n", !ok && errno == EINVAL ? "rejected" : "accepted");
+    expr_t* nested = expr_add(expr_from_array(a), expr_sum(expr_from_array(b)));
+    errno = 0;
+    ok = expr_eval_stream(nested, sources, NULL, 0, dispatch);
+    printf("nested reduction: %s\n", !ok && errno == EINVAL ? "rejected" : "accepted");
+    expr_free(rows);
+    expr_free(nested);
+    
+    unlink(path_a);
+    unlink(path_out);
+    array_source_free(sources[0]);
+    array_source_free(sources[1]);
+    expr_free(sum);
+    expr_free(expr);
+    array_free(ones);
+    array_free(a);
+    array_free(b);
+    simd_free_dispatch(dispatch);
+    printf("\n");
+}
+
+void test_unary_math() {
+    printf("Elementwise math functions \n");
+    
+    simd_dispatch_t* dispatch = simd_init_dispatch();
+    
+    size_t shape[1] = {5};
+    array_t* x = array_create(shape, 1);
+    for (size_t i = 0; i < 5; i++) {
+        size_t idx[1] = {i};
+        array_set(x, idx, (float)i - 2.0f);
+    }
+    
+    // a softplus-like chain fuses into one pass: log(1 + exp(x)) has no
+    // temporaries between the exp and the log
+    array_t* result = array_create(shape, 1);
+    array_t* ones = array_create(shape, 1);
+    array_fill(ones, 1.0f);
+    expr_t* expr = expr_log(expr_add(expr_from_array(ones), expr_exp(expr_from_array(x))));
+    expr_eval(expr, result, dispatch);
+    printf("log(1 + exp(x)): ");
+    array_print(result);
+    expr_free(expr);
+    
+    expr = expr_mul(expr_from_array(x), expr_sigmoid(expr_from_array(x)));
+    expr_eval(expr, result, dispatch);
+    printf("x * sigmoid(x): ");
+    array_print(result);
+    expr_free(expr);
+    
+    // eager wrappers may run in place
+    array_tanh_eager(x, x, dispatch);
+    printf("tanh(x) in place: ");
+    array_print(x);
+    
+    // special values follow C99
+    size_t idx[1] = {0};
+    array_set(x, idx, -1.0f);
+    array_sqrt_eager(result, x, dispatch);
+    printf("sqrt(-1) is nan: %d\n", isnan(array_get(result, idx)));
+    array_set(x, idx, 0.0f);
+    array_log_eager(result, x, dispatch);
+    printf("log(0) = %.0f\n", array_get(result, idx));
+    array_rsqrt_eager(result, x, dispatch);
+    printf("rsqrt(0) = %.0f\n", array_get(result, idx));
+    
+    array_free(x);
+    array_free(ones);
+    array_free(result);
+    simd_free_dispatch(dispatch);
+    printf("\n");
+}
+
+void test_matmul() {
+    printf("Matrix multiply \n");
+    
+    simd_dispatch_t* dispatch = simd_init_dispatch();
+    
+    size_t a_shape[2] = {2, 3};
+    size_t b_shape[2] = {3, 2};
+    size_t c_shape[2] = {2, 2};
+    array_t* a = array_create(a_shape, 2);
+    array_t* b = array_create(b_shape, 2);
+    array_t* c = array_create(c_shape, 2);
+    for (size_t i = 0; i < 6; i++) {
+        a->data[i] = (float)(i + 1);
+        b->data[i] = (float)(6 - i);
+    }
+    array_matmul(c, a, b, dispatch);
+    printf("A (2x3) @ B (3x2):\n");
+    array_print(c);
+    
+    // the transpose of a 2x3 array as a 3x2 view with swapped strides; it is
+    // packed straight from a's storage
+    array_t* at = array_from_data(a->data, b_shape, 2);
+    at->strides[0] = 1;
+    at->strides[1] = 3;
+    array_t* gram = array_create(c_shape, 2);
+    array_matmul(gram, a, at, dispatch);
+    printf("A @ A^T:\n");
+    array_print(gram);
+    
+    // 3 batches of A against one shared B
+    size_t batch_a_shape[3] = {3, 2, 3};
+    size_t batch_c_shape[3] = {3, 2, 2};
+    array_t* batch_a = array_create(batch_a_shape, 3);
+    array_t* batch_c = array_create(batch_c_shape, 3);
+    for (size_t i = 0; i < batch_a->size; i++) batch_a->data[i] = (float)(i / 6 + 1);
+    array_matmul_batched(batch_c, batch_a, b, dispatch);
+    printf("batched, first element of each batch: %.0f %.0f %.0f\n",
+           batch_c->data[0], batch_c->data[4], batch_c->data[8]);
+    
+    // large enough to cross the cache blocks and the edge tiles
+    size_t big = 301;
+    size_t big_shape[2] = {big, big};
+    array_t* x = array_create(big_shape, 2);
+    array_t* y = array_create(big_shape, 2);
+    array_t* z = array_create(big_shape, 2);
+    array_fill(x, 0.5f);
+    array_fill(y, 2.0f);
+    array_matmul(z, x, y, dispatch);
+    printf("301x301 of 0.5 @ 2: every element is %.0f: %s\n", z->data[0],
+           array_min(z, dispatch) == (float)big && array_max(z, dispatch) == (float)big ? "yes" : "no");
+    
+    array_free(a);
+    array_free(b);
+    array_free(c);
+    array_free(at);
+    array_free(gram);
+    array_free(batch_a);
+    array_free(batch_c);
+    array_free(x);
+    array_free(y);
+    array_free(z);
+    simd_free_dispatch(dispatch);
+    printf("\n");
+}
+
+void test_stats() {
+    printf("Operation statistics \n");
+    
+    simd_dispatch_t* dispatch = simd_init_dispatch();
+    dispatch->stats = simd_stats_create();
+    
+    size_t shape[2] = {64, 64};
+    array_t* a = array_create(shape, 2);
+    array_t* b = array_create(shape, 2);
+    array_t* c = array_create(shape, 2);
+    array_t* half = array_create_typed(shape, 2, ARRAY_FLOAT16);
+    
+    // one contiguous run, 64 strided rows (b read as its own transpose),
+    // then a float16 operand that goes to the expression evaluator
+    array_add_eager(c, a, b, dispatch);
+    array_t* bt = array_from_data(b->data, shape, 2);
+    bt->strides[0] = 1;
+    bt->strides[1] = 64;
+    array_add_eager(c, a, bt, dispatch);
+    array_add_eager(c, a, half, dispatch);
+    
+    simd_stats_counters_t add, expr;
+    simd_stats_get(dispatch->stats, SIMD_STATS_ADD, &add);
+    simd_stats_get(dispatch->stats, SIMD_STATS_EXPR, &expr);
+    printf("recorded: %s\n", simd_stats_enabled() ? "yes" : "no (build with make STATS=1)");
+    printf("add: %llu calls, %llu elements, %llu fast, %llu fallback, %llu interpreted, timed: %s\n",
+           (unsigned long long)add.calls, (unsigned long long)add.elements,
+           (unsigned long long)add.fast, (unsigned long long)add.fallback,
+           (unsigned long long)add.interpreted, add.cycles > 0 ? "yes" : "no");
+    printf("expr: %llu calls\n", (unsigned long long)expr.calls);
+    
+    // the JSON goes through a temporary file so only its shape is printed
+    FILE* json = tmpfile();
+    bool written = simd_stats_write_json(dispatch, json);
+    long length = ftell(json);
+    rewind(json);
+    char head[2] = {0};
+    size_t got = fread(head, 1, 1, json);
+    fclose(json);
+    printf("JSON written: %s, starts with '%s', %s\n", written ? "yes" : "no", got ? head : "",
+           length > 0 ? "non-empty" : "empty");
+    
+    simd_stats_reset(dispatch->stats);
+    simd_stats_get(dispatch->stats, SIMD_STATS_ADD, &add);
+    printf("after reset: %llu calls\n", (unsigned long long)add.calls);
+    
+    array_free(a);
+    array_free(b);
+    array_free(bt);
+    array_free(c);
+    array_free(half);
+    simd_stats_free(dispatch->stats);
+    simd_free_dispatch(dispatch);
+    printf("\n");
+}
+
+void test_inplace() {
+    printf("In-place operations and aliasing \n");
+    
+    simd_dispatch_t* dispatch = simd_init_dispatch();
+    
+    size_t shape[2] = {3, 4};
+    array_t* x = array_create(shape, 2);
+    array_t* y = array_create(shape, 2);
+    for (size_t i = 0; i < 12; i++) {
+        x->data[i] = (float)i;
+        y->data[i] = 1.0f;
+    }
+    
+    // x = ((x + y) + 0.5 * y) * 2, with no result array
+    array_add_inplace(x, y, dispatch);
+    array_axpy(x, 0.5f, y, dispatch);
+    array_scale_inplace(x, 2.0f, dispatch);
+    printf("((x + 1) + 0.5) * 2:\n");
+    array_print(x);
+    
+    // the result is a leaf: one pass, updated in place
+    expr_t* expr = expr_add(expr_mul(expr_from_array(x), expr_from_array(y)), expr_from_array(x));
+    expr_eval(expr, x, dispatch);
+    expr_free(expr);
+    printf("x = x * y + x:\n");
+    array_print(x);
+    
+    // every row plus row 0 of the same array: row 0 must be read before it
+    // is overwritten, so this goes through a temporary
+    size_t start[2] = {0, 0};
+    size_t end[2] = {1, 4};
+    array_t* row = array_view(x, start, end);
+    array_add_eager(x, x, row, dispatch);
+    printf("x = x + x[0]:\n");
+    array_print(x);
+    printf("x and its row share memory: %s, x and y: %s\n",
+           array_shares_memory(x, row) ? "yes" : "no", array_shares_memory(x, y) ? "yes" : "no");
+    
+    array_free(row);
+    array_free(x);
+    array_free(y);
+    simd_free_dispatch(dispatch);
+    printf("\n");
+}
+
+void test_views() {
+    printf("Transpose, permute, reshape and step slicing \n");
+    
+    simd_dispatch_t* dispatch = simd_init_dispatch();
+    
+    size_t shape[2] = {2, 3};
+    array_t* a = array_create(shape, 2);
+    for (size_t i = 0; i < 6; i++) {
+        a->data[i] = (float)i;
+    }
+    
+    array_t* t = array_transpose(a);
+    printf("transpose (view: %s):\n", t->base == a ? "yes" : "no");
+    array_print(t);
+    
+    // every second column of every row
+    size_t start[2] = {0, 0};
+    size_t end[2] = {2, 3};
+    size_t step[2] = {1, 2};
+    array_t* s = array_slice(a, start, end, step);
+    printf("a[:, ::2]:\n");
+    array_print(s);
+    
+    // splitting a contiguous array is free; flattening its transpose copies
+    size_t split[2] = {3, 2};
+    array_t* r = array_reshape(a, split, 2, dispatch);
+    size_t flat[1] = {6};
+    array_t* f = array_reshape(t, flat, 1, dispatch);
+    printf("reshape (3, 2) view: %s, flatten transpose view: %s\n",
+           r->base == a ? "yes" : "no", f->base == t ? "yes" : "no");
+    array_print(f);
+    
+    // large enough to be copied tile by tile with the transpose kernel
+    size_t big_shape[3] = {2, 130, 200};
+    array_t* big = array_create(big_shape, 3);
+    for (size_t i = 0; i < big->size; i++) {
+        big->data[i] = (float)i;
+    }
+    size_t axes[3] = {0, 2, 1};
+    array_t* p = array_permute(big, axes);
+    array_t* c = array_make_contiguous(p, dispatch);
+    int ok = 1;
+    for (size_t b = 0; b < 2; b++)
+        for (size_t i = 0; i < 200; i++)
+            for (size_t j = 0; j < 130; j++)
+                if (c->data[(b * 200 + i) * 130 + j] != big->data[(b * 130 + j) * 200 + i]) ok = 0;
+    printf("make_contiguous of a (0, 2, 1) permutation: %s, contiguous: %s\n",
+           ok ? "matches" : "MISMATCH", array_is_contiguous(c) ? "yes" : "no");
+    
+    array_free(c);
+    array_free(p);
+    array_free(big);
+    array_free(f);
+    array_free(r);
+    array_free(s);
+    array_free(t);
+    array_free(a);
+    simd_free_dispatch(dispatch);
+    printf("\n");
+}
+
+void test_batch() {
+    printf("Batched small arrays \n");
+    
+    simd_dispatch_t* dispatch = simd_init_dispatch();
+    
+    // three vectors of 5 floats: a as separate buffers, b as one contiguous block
+    float a0[5] = {0, 1, 2, 3, 4};
+    float a1[5] = {10, 11, 12, 13, 14};
+    float a2[5] = {20, 21, 22, 23, 24};
+    float b_data[15];
+    float out0[5], out1[5], out2[5];
+    for (size_t i = 0; i < 15; i++) {
+        b_data[i] = (float)(i / 5 + 1);
+    }
+    void* a_items[3] = {a0, a1, a2};
+    void* out_items[3] = {out0, out1, out2};
+    array_batch_t a = {ARRAY_FLOAT32, a_items, NULL, 0};
+    array_batch_t b = {ARRAY_FLOAT32, NULL, b_data, 5};
+    array_batch_t out = {ARRAY_FLOAT32, out_items, NULL, 0};
+    
+    array_add_batch(&out, &a, &b, 3, 5, dispatch);
+    printf("a[k] + (k + 1):\n");
+    for (size_t k = 0; k < 3; k++) {
+        float* item = array_batch_item(&out, k);
+        printf("  %.0f %.0f %.0f %.0f %.0f\n", item[0], item[1], item[2], item[3], item[4]);
+    }
+    
+    // out[k] = out[k] * b[k] - a[k] in place, compiled once for the batch
+    size_t n = 5;
+    array_t* x = array_from_data(NULL, &n, 1);
+    array_t* y = array_from_data(NULL, &n, 1);
+    array_t* z = array_from_data(NULL, &n, 1);
+    expr_t* expr = expr_sub(expr_mul(expr_from_array(x), expr_from_array(y)), expr_from_array(z));
+    array_batch_t leaves[3] = {out, b, a};
+    expr_eval_batch(expr, leaves, &out, 3, 5, dispatch);
+    printf("(a[k] + (k + 1)) * (k + 1) - a[k]:\n");
+    for (size_t k = 0; k < 3; k++) {
+        float* item = array_batch_item(&out, k);
+        printf("  %.0f %.0f %.0f %.0f %.0f\n", item[0], item[1], item[2], item[3], item[4]);
+    }
+    
+    // a tree that would need temporaries is refused
+    expr_t* reduced = expr_sum(expr_from_array(x));
+    errno = 0;
+    bool ok = expr_eval_batch(reduced, leaves, &out, 3, 5, dispatch);
+    printf("reduction over a batch: %s\n", !ok && errno == EINVAL ? "rejected" : "accepted");
+    
+    expr_free(reduced);
+    expr_free(expr);
+    array_free(z);
+    array_free(y);
+    array_free(x);
+    simd_free_dispatch(dispatch);
+    printf("\n");
+}
+
 int main() {
     test_basic_creation();
     test_slicing();
     test_broadcasting();
     test_eager_operations();
+    test_broadcast_operations();
     test_lazy_evaluation();
+    test_fused_evaluation();
+    test_parallel_operations();
+    test_aligned_and_pooled_allocation();
+    test_reductions();
+    test_fused_reductions();
+    test_optimized_expressions();
+    test_compiled_kernels();
+    test_tiled_evaluation();
+    test_broadcast_expressions();
+    test_dtypes();
+    test_save_and_mmap();
+    test_streaming();
+    test_unary_math();
+    test_matmul();
+    test_stats();
+    test_inplace();
+    test_views();
+    test_batch();
     
     return 0;
 }
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "simd_abstraction.h"
 
 int main() {
@@ -49,6 +50,180 @@ int main() {
     for(int i = 0; i < 8; i++) printf("%.1f ", result[i]);
     printf("\n\n");
     
+    printf("Whole-Array Kernels (n = 19)\n");
+    float x[19], y[19], out[19];
+    for(int i = 0; i < 19; i++) {
+        x[i] = (float)i;
+        y[i] = 1.0f;
+    }
+    
+    dispatch->add_n(out, x, y, 19);
+    printf("add_n:   ");
+    for(int i = 0; i < 19; i++) printf("%.0f ", out[i]);
+    
+    dispatch->fmadd_n(out, x, x, y, 19);
+    printf("\nfmadd_n: ");
+    for(int i = 0; i < 19; i++) printf("%.0f ", out[i]);
+    
+    dispatch->axpy_n(y, 2.0f, x, 19);
+    printf("\naxpy_n:  ");
+    for(int i = 0; i < 19; i++) printf("%.0f ", y[i]);
+    
+    dispatch->scale_n(out, x, 0.5f, 19);
+    printf("\nscale_n: ");
+    for(int i = 0; i < 19; i++) printf("%.1f ", out[i]);
+    printf("\n\n");
+    
+    printf("Per-Backend fmadd_n (n = 37, masked tail on AVX-512)\n");
+    float p[37], q[37], r[37];
+    for(int i = 0; i < 37; i++) {
+        p[i] = (float)i;
+        q[i] = 2.0f;
+    }
+    for(int be = BACKEND_SCALAR; be <= BACKEND_AVX512; be++) {
+        simd_dispatch_t* forced = simd_init_dispatch_backend((simd_backend_t)be);
+        if (!forced) continue;
+        
+        forced->fmadd_n(r, p, q, p, 37);
+        simd_print_backend(forced->backend);
+        for(int i = 0; i < 37; i++) printf("%.0f ", r[i]);
+        printf("\n");
+        simd_free_dispatch(forced);
+    }
+    printf("\n");
+    
+    printf("Per-Backend Reductions (n = 37)\n");
+    for(int be = BACKEND_SCALAR; be <= BACKEND_AVX512; be++) {
+        simd_dispatch_t* forced = simd_init_dispatch_backend((simd_backend_t)be);
+        if (!forced) continue;
+        
+        float sum = 0.0f, comp = 0.0f;
+        forced->sum_kahan_n(p, 37, &sum, &comp);
+        simd_print_backend(forced->backend);
+        printf("sum %.0f, kahan %.0f, max %.0f, min %.0f, dot %.0f\n",
+               forced->sum_n(p, 37), sum - comp, forced->max_n(p, 37),
+               forced->min_n(p, 37), forced->dot_n(p, q, 37));
+        simd_free_dispatch(forced);
+    }
+    printf("\n");
+    
+    printf("Per-Backend Conversions (n = 19)\n");
+    float v[19], back[19];
+    unsigned short half[19];
+    signed char bytes[19];
+    double wide[19];
+    for(int i = 0; i < 19; i++) v[i] = (float)(i - 5) * 17.3f;
+    for(int be = BACKEND_SCALAR; be <= BACKEND_AVX512; be++) {
+        simd_dispatch_t* forced = simd_init_dispatch_backend((simd_backend_t)be);
+        if (!forced) continue;
+        
+        simd_print_backend(forced->backend);
+        forced->store_f16_n(half, v, 19);
+        forced->load_f16_n(back, half, 19);
+        printf("f16 %.3f, ", back[1]);
+        forced->store_bf16_n(half, v, 19);
+        forced->load_bf16_n(back, half, 19);
+        printf("bf16 %.3f, ", back[1]);
+        forced->store_i8_n(bytes, v, 19);
+        printf("i8 %d %d, ", bytes[0], bytes[18]);
+        forced->store_f64_n(wide, v, 19);
+        printf("f64 sum %.2f\n", forced->sum_f64_n(wide, 19));
+        simd_free_dispatch(forced);
+    }
+    printf("\n");
+
+    printf("Per-Backend Fill and Copy (2-byte elements, odd byte offsets for copy, regular / stream)\n");
+    unsigned char line[SIMD_FILL_PATTERN], bytes_out[64], bytes_in[64];
+    for(int i = 0; i < SIMD_FILL_PATTERN; i++) line[i] = (unsigned char)(i % 2 ? 0xab : 0xcd);
+    for(int i = 0; i < 64; i++) bytes_in[i] = (unsigned char)i;
+    for(int be = BACKEND_SCALAR; be <= BACKEND_AVX512; be++) {
+        simd_dispatch_t* forced = simd_init_dispatch_backend((simd_backend_t)be);
+        if (!forced) continue;
+
+        simd_print_backend(forced->backend);
+        for(int s = 0; s < 2; s++) {
+            simd_fill_n_func fill_n = s ? forced->fill_n_stream : forced->fill_n;
+            simd_copy_n_func copy_n = s ? forced->copy_n_stream : forced->copy_n;
+            int ok = 1;
+            memset(bytes_out, 0, sizeof(bytes_out));
+            fill_n(bytes_out + 2, line, 38);
+            for(int i = 0; i < 64; i++) {
+                unsigned char want = i < 2 || i >= 40 ? 0 : line[i - 2];
+                if (bytes_out[i] != want) ok = 0;
+            }
+            memset(bytes_out, 0, sizeof(bytes_out));
+            copy_n(bytes_out + 3, bytes_in + 5, 37);
+            if (memcmp(bytes_out + 3, bytes_in + 5, 37) || bytes_out[2] || bytes_out[40]) ok = 0;
+            printf("%s%s", s ? " / " : "", ok ? "ok" : "MISMATCH");
+        }
+        printf("\n");
+        simd_free_dispatch(forced);
+    }
+    printf("\n");
+
+    printf("Per-Backend Transpose (19 x 23 block, row pitches 21 / 25)\n");
+    float grid[23 * 21], grid_t[19 * 25];
+    for(int i = 0; i < 23 * 21; i++) grid[i] = (float)i;
+    for(int be = BACKEND_SCALAR; be <= BACKEND_AVX512; be++) {
+        simd_dispatch_t* forced = simd_init_dispatch_backend((simd_backend_t)be);
+        if (!forced) continue;
+
+        simd_print_backend(forced->backend);
+        for(int i = 0; i < 19 * 25; i++) grid_t[i] = -1.0f;
+        forced->transpose(grid_t, 25, grid, 21, 19, 23);
+        int ok = 1;
+        for(int i = 0; i < 19; i++)
+            for(int j = 0; j < 25; j++)
+                if (grid_t[i * 25 + j] != (j < 23 ? grid[j * 21 + i] : -1.0f)) ok = 0;
+        printf("%s\n", ok ? "ok" : "MISMATCH");
+        simd_free_dispatch(forced);
+    }
+    printf("\n");
+
+    printf("Per-Backend Math (n = 19, values at x = 1.5)\n");
+    float m[19], mo[19];
+    for(int i = 0; i < 19; i++) m[i] = (float)i * 0.25f - 1.0f;
+    m[0] = -0.0f;
+    for(int be = BACKEND_SCALAR; be <= BACKEND_AVX512; be++) {
+        simd_dispatch_t* forced = simd_init_dispatch_backend((simd_backend_t)be);
+        if (!forced) continue;
+
+        simd_print_backend(forced->backend);
+        forced->exp_n(mo, m, 19);
+        printf("exp %.6f, ", mo[10]);
+        forced->log_n(mo, m, 19);
+        printf("log %.6f, ", mo[10]);
+        forced->sigmoid_n(mo, m, 19);
+        printf("sigmoid %.6f, ", mo[10]);
+        forced->tanh_n(mo, m, 19);
+        printf("tanh %.6f (tanh -0 = %.1f), ", mo[10], mo[0]);
+        forced->sqrt_n(mo, m, 19);
+        printf("sqrt %.6f, ", mo[10]);
+        forced->rsqrt_n(mo, m, 19);
+        printf("rsqrt %.6f\n", mo[10]);
+        simd_free_dispatch(forced);
+    }
+    printf("\n");
+
+    printf("Default Dispatch\n");
+    const simd_features_t* features = simd_features();
+    printf("detected %s, best %s, avx512 bf16 %s\n", simd_backend_name(features->detected),
+           simd_backend_name(features->best), features->avx512_bf16 ? "yes" : "no");
+    const simd_dispatch_t* shared = simd_default_dispatch();
+    printf("default is %s, shared: %s, copies match: %s\n", simd_backend_name(shared->backend),
+           shared == simd_default_dispatch() ? "yes" : "no",
+           dispatch->backend == shared->backend && dispatch->add_n == shared->add_n ? "yes" : "no");
+    printf("forcing after first use: %s\n", simd_set_default_backend(BACKEND_SCALAR) ? "accepted" : "refused");
+    int names_ok = 1;
+    for(int be = BACKEND_SCALAR; be <= BACKEND_NEON; be++) {
+        simd_backend_t parsed;
+        if (!simd_backend_from_name(simd_backend_name((simd_backend_t)be), &parsed) || parsed != (simd_backend_t)be) names_ok = 0;
+    }
+    simd_backend_t parsed;
+    printf("names round-trip: %s, \"avx3\" rejected: %s\n", names_ok ? "yes" : "no",
+           simd_backend_from_name("avx3", &parsed) ? "no" : "yes");
+    printf("\n");
+
     simd_free_dispatch(dispatch);
     return 0;
 }